@@ -0,0 +1,703 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+// Time the kernels where ASP spends most of its time, on synthetic data, and
+// save the results as JSON, so that performance can be tracked over time. The
+// data is generated in memory, so no input files are needed. The cameras are
+// created as in sat_sim, for a satellite in a 700 km orbit. Only the kernels
+// are timed, not the generation of the data.
+
+#include <asp/Core/Common.h>
+#include <asp/Core/Macros.h>
+#include <asp/Core/Point2Grid.h>
+#include <asp/Core/MedianFilter.h>
+#include <asp/Core/ResampleKernel.h>
+#include <asp/Core/OrthoRasterizer.h>
+#include <asp/Core/InterestPointMatching.h>
+#include <asp/Core/StereoSettings.h>
+#include <asp/Camera/CsmModel.h>
+#include <asp/Camera/CsmUtils.h>
+#include <asp/Camera/RPCModel.h>
+
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Settings.h>
+#include <vw/Cartography/Datum.h>
+#include <vw/Image/Filter.h>
+#include <vw/Image/EdgeExtension.h>
+#include <vw/Stereo/StereoModel.h>
+
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+// For writing the results
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <random>
+#include <set>
+
+namespace po = boost::program_options;
+using json = nlohmann::json;
+
+struct Options: public vw::GdalWriteOptions {
+  std::string output_file, kernels;
+  std::set<std::string> selected; // parsed from kernels
+  int num_repeats;
+  double scale;
+  bool list;
+  Options(): num_repeats(5), scale(1.0), list(false) {}
+};
+
+// The time taken by a kernel on a given number of items
+struct BenchmarkResult {
+  std::string name, units;
+  std::int64_t num_items;
+  std::vector<double> times;
+  double checksum;
+};
+
+// A benchmark sets up its data, then times the kernel. The kernel returns
+// a checksum of its output, so that the work cannot be optimized away.
+typedef std::function<BenchmarkResult(Options const&)> Benchmark;
+
+// Scale a count by the --scale option. Image dimensions are scaled by the
+// square root of it, so that the number of pixels scales linearly.
+std::int64_t scaledCount(std::int64_t count, Options const& opt) {
+  return std::max(std::int64_t(1), std::int64_t(round(count * opt.scale)));
+}
+int scaledSide(int side, Options const& opt) {
+  return std::max(16, int(round(side * sqrt(opt.scale))));
+}
+
+// Run the kernel the desired number of times. Record the time for each run.
+BenchmarkResult timeKernel(Options const& opt, std::string const& name,
+                           std::string const& units, std::int64_t num_items,
+                           std::function<double()> kernel) {
+
+  vw::vw_out() << "Running: " << name << "\n";
+  BenchmarkResult result;
+  result.name = name;
+  result.units = units;
+  result.num_items = num_items;
+  result.checksum = 0.0;
+  for (int it = 0; it < opt.num_repeats; it++) {
+    vw::Stopwatch sw;
+    sw.start();
+    result.checksum = kernel();
+    sw.stop();
+    result.times.push_back(sw.elapsed_seconds());
+  }
+
+  return result;
+}
+
+// A synthetic linescan camera in a polar orbit at 700 km, with a ground
+// sample distance of 1 meter. The satellite is lon_offset degrees east of
+// the ground track it looks at, so that two such cameras form a stereo pair.
+// The camera orientations are found as in sat_sim: the z axis points to the
+// ground, the y axis is along the orbit, and the x axis is across it.
+void syntheticLinescan(vw::cartography::Datum const& datum, double lon_offset,
+                       vw::Vector2i const& image_size, asp::CsmModel & model) {
+
+  double lon0 = -122.0, lat0 = 37.0, height = 700000.0;
+  double focal_length = height; // in pixels, so the GSD is 1 meter
+  double dt_line = 1.0e-4;
+  double dlat_line = (180.0 / M_PI) / datum.semi_major_axis(); // 1 m on the ground
+
+  // Sample the positions every this many lines, with a margin on each side
+  // for interpolation, as done in sat_sim.
+  int lines_per_pos = 100, margin = 8;
+  int num_pos = image_size[1] / lines_per_pos + 1 + 2 * margin;
+  double dt_ephem = lines_per_pos * dt_line;
+  double first_line_time = 0.0;
+  double t0_ephem = first_line_time - margin * dt_ephem;
+
+  std::vector<vw::Vector3> positions(num_pos), targets(num_pos);
+  for (int i = 0; i < num_pos; i++) {
+    double lat = lat0 + (i - margin) * lines_per_pos * dlat_line;
+    positions[i] = datum.geodetic_to_cartesian(vw::Vector3(lon0 + lon_offset, lat, height));
+    targets[i]   = datum.geodetic_to_cartesian(vw::Vector3(lon0, lat, 0.0));
+  }
+
+  std::vector<vw::Vector3> velocities(num_pos);
+  std::vector<vw::Matrix3x3> cam2world(num_pos);
+  for (int i = 0; i < num_pos; i++) {
+    int prev = std::max(i - 1, 0), next = std::min(i + 1, num_pos - 1);
+    vw::Vector3 along = positions[next] - positions[prev];
+    velocities[i] = along / ((next - prev) * dt_ephem);
+
+    vw::Vector3 z = vw::math::normalize(targets[i] - positions[i]);
+    vw::Vector3 y = vw::math::normalize(along - vw::math::dot_prod(along, z) * z);
+    vw::Vector3 x = vw::math::cross_prod(y, z);
+    for (int row = 0; row < 3; row++) {
+      cam2world[i](row, 0) = x[row];
+      cam2world[i](row, 1) = y[row];
+      cam2world[i](row, 2) = z[row];
+    }
+  }
+
+  vw::Vector2 optical_center(image_size[0] / 2.0, 0.0);
+  asp::populateCsmLinescan(first_line_time, dt_line, t0_ephem, dt_ephem,
+                           t0_ephem, dt_ephem, focal_length, optical_center,
+                           image_size, datum, "SyntheticLinescan",
+                           positions, velocities, cam2world, model);
+}
+
+// A smooth random texture, which has plenty of interest points
+vw::ImageView<float> syntheticTexture(int cols, int rows, std::mt19937 & gen) {
+  std::uniform_real_distribution<float> dist(0.0, 1.0);
+  vw::ImageView<float> noise(cols, rows);
+  for (int row = 0; row < rows; row++)
+    for (int col = 0; col < cols; col++)
+      noise(col, row) = dist(gen);
+  vw::ImageView<float> texture = vw::gaussian_filter(noise, 1.5);
+  return texture;
+}
+
+BenchmarkResult benchCsmPointToPixel(Options const& opt) {
+
+  vw::cartography::Datum datum("WGS84");
+  vw::Vector2i image_size(10000, 10000);
+  asp::CsmModel cam;
+  syntheticLinescan(datum, 0.0, image_size, cam);
+
+  // Points on the ground seen by the camera
+  std::int64_t num = scaledCount(20000, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> col(0.0, image_size[0] - 1.0);
+  std::uniform_real_distribution<double> row(0.0, image_size[1] - 1.0);
+  std::vector<vw::Vector3> points(num);
+  for (std::int64_t i = 0; i < num; i++) {
+    vw::Vector2 pix(col(gen), row(gen));
+    points[i] = cam.camera_center(pix) + 700000.0 * cam.pixel_to_vector(pix);
+  }
+
+  return timeKernel(opt, "csm_point_to_pixel", "points", num, [&]() {
+    double sum = 0.0;
+    for (std::int64_t i = 0; i < num; i++) {
+      vw::Vector2 pix = cam.point_to_pixel(points[i]);
+      sum += pix[0] + pix[1];
+    }
+    return sum;
+  });
+}
+
+// A plausible RPC model. The cost of evaluating it does not depend on
+// the values of the coefficients.
+asp::RPCModel syntheticRpc() {
+  asp::RPCModel::CoeffVec line_num, line_den, samp_num, samp_den;
+  for (int i = 0; i < 20; i++) {
+    line_num[i] = 1.0e-4 * (i % 3);
+    samp_num[i] = 1.0e-4 * (i % 5);
+    line_den[i] = 1.0e-5 * (i % 2);
+    samp_den[i] = 1.0e-5 * (i % 4);
+  }
+  line_num[2] = -1.0;  line_num[3] = 0.01;
+  samp_num[1] =  1.0;  samp_num[3] = 0.02;
+  line_den[0] =  1.0;  samp_den[0] = 1.0;
+  return asp::RPCModel(vw::cartography::Datum("WGS84"), line_num, line_den,
+                       samp_num, samp_den, vw::Vector2(5000, 5000), vw::Vector2(5000, 5000),
+                       vw::Vector3(-122.0, 37.0, 0.0), vw::Vector3(0.05, 0.05, 500.0));
+}
+
+BenchmarkResult benchRpcGeodeticToPixel(Options const& opt) {
+
+  asp::RPCModel rpc = syntheticRpc();
+
+  std::int64_t num = scaledCount(2000000, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<vw::Vector3> llh(num);
+  for (std::int64_t i = 0; i < num; i++)
+    llh[i] = vw::Vector3(-122.0 + 0.05 * dist(gen), 37.0 + 0.05 * dist(gen),
+                         500.0 * dist(gen));
+
+  return timeKernel(opt, "rpc_geodetic_to_pixel", "points", num, [&]() {
+    double sum = 0.0;
+    for (std::int64_t i = 0; i < num; i++) {
+      vw::Vector2 pix = rpc.geodetic_to_pixel(llh[i]);
+      sum += pix[0] + pix[1];
+    }
+    return sum;
+  });
+}
+
+// Same points as above, projected with the batched function, a tile at a time
+BenchmarkResult benchRpcGeodeticToPixelBatch(Options const& opt) {
+
+  asp::RPCModel rpc = syntheticRpc();
+
+  std::int64_t num = scaledCount(2000000, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> lon(num), lat(num), height(num);
+  for (std::int64_t i = 0; i < num; i++) {
+    lon[i]    = -122.0 + 0.05 * dist(gen);
+    lat[i]    = 37.0 + 0.05 * dist(gen);
+    height[i] = 500.0 * dist(gen);
+  }
+
+  const std::int64_t tile_size = 256 * 256;
+  std::vector<double> pix_x(tile_size), pix_y(tile_size);
+  return timeKernel(opt, "rpc_geodetic_to_pixel_batch", "points", num, [&]() {
+    double sum = 0.0;
+    for (std::int64_t beg = 0; beg < num; beg += tile_size) {
+      int len = std::min(tile_size, num - beg);
+      rpc.geodetic_to_pixel(len, &lon[beg], &lat[beg], &height[beg], &pix_x[0], &pix_y[0]);
+      for (int i = 0; i < len; i++)
+        sum += pix_x[i] + pix_y[i];
+    }
+    return sum;
+  });
+}
+
+// Triangulate a tile of pixels, as done by stereo_tri for each tile
+BenchmarkResult benchStereoTriangulation(Options const& opt) {
+
+  vw::cartography::Datum datum("WGS84");
+  vw::Vector2i image_size(10000, 10000);
+  asp::CsmModel left_cam, right_cam;
+  syntheticLinescan(datum, 0.0, image_size, left_cam);
+  syntheticLinescan(datum, 1.0, image_size, right_cam); // about 7 degrees apart
+
+  // The matching pixels, as given by the disparity
+  int tile = scaledSide(256, opt);
+  std::int64_t num = std::int64_t(tile) * tile;
+  std::vector<vw::Vector2> left_pix(num), right_pix(num);
+  for (int row = 0; row < tile; row++) {
+    for (int col = 0; col < tile; col++) {
+      std::int64_t i = std::int64_t(row) * tile + col;
+      left_pix[i] = vw::Vector2(image_size[0] / 2 + col, image_size[1] / 2 + row);
+      vw::Vector3 xyz = left_cam.camera_center(left_pix[i])
+        + 700000.0 * left_cam.pixel_to_vector(left_pix[i]);
+      right_pix[i] = right_cam.point_to_pixel(xyz);
+    }
+  }
+
+  std::vector<const vw::camera::CameraModel*> cams = {&left_cam, &right_cam};
+  bool least_squares = false;
+  vw::stereo::StereoModel stereo_model(cams, least_squares);
+
+  return timeKernel(opt, "stereo_triangulation_tile", "pixels", num, [&]() {
+    double sum = 0.0;
+    std::vector<vw::Vector2> pixVec(2);
+    vw::Vector3 errorVec;
+    for (std::int64_t i = 0; i < num; i++) {
+      pixVec[0] = left_pix[i];
+      pixVec[1] = right_pix[i];
+      vw::Vector3 xyz = stereo_model(pixVec, errorVec);
+      sum += vw::math::norm_2(xyz) + vw::math::norm_2(errorVec);
+    }
+    return sum;
+  });
+}
+
+BenchmarkResult benchPoint2GridAddPoint(Options const& opt) {
+
+  int side = 1000;
+  double grid_size = 1.0, min_spacing = 0.0, radius = 1.5 * grid_size;
+  double sigma_factor = 0.0, percentile = 0.0;
+
+  std::int64_t num = scaledCount(2000000, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(0.0, side - 1.0);
+  std::vector<vw::Vector3> points(num);
+  for (std::int64_t i = 0; i < num; i++) {
+    double x = dist(gen), y = dist(gen);
+    points[i] = vw::Vector3(x, y, 100.0 * sin(x / 50.0) * cos(y / 50.0));
+  }
+
+  vw::ImageView<double> buffer, weights;
+  asp::Point2Grid grid(side, side, buffer, weights, 0.0, 0.0, grid_size, min_spacing,
+                       radius, sigma_factor, asp::f_weighted_average, percentile);
+
+  return timeKernel(opt, "point2grid_add_point", "points", num, [&]() {
+    grid.Clear(-32768.0);
+    for (std::int64_t i = 0; i < num; i++)
+      grid.AddPoint(points[i][0], points[i][1], points[i][2]);
+    grid.normalize();
+    return double(vw::sum_of_pixel_values(buffer));
+  });
+}
+
+BenchmarkResult benchFastMedianFilter(Options const& opt) {
+
+  int side = scaledSide(2048, opt);
+  int kernel_size = 9;
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> dist(0, 255);
+  vw::ImageView<vw::uint8> image(side, side);
+  for (int row = 0; row < side; row++)
+    for (int col = 0; col < side; col++)
+      image(col, row) = dist(gen);
+
+  return timeKernel(opt, "fast_median_filter", "pixels", std::int64_t(side) * side,
+                    [&]() {
+    vw::ImageView<vw::uint8> filtered = vw::fast_median_filter(image, kernel_size);
+    return double(vw::sum_of_pixel_values(vw::pixel_cast<double>(filtered)));
+  });
+}
+
+// Random float values with some invalid pixels, as in a disparity
+void syntheticMedianData(Options const& opt, vw::ImageView<float> & img,
+                         vw::ImageView<vw::uint8> & valid) {
+  int side = scaledSide(1024, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-50.0, 50.0);
+  img.set_size(side, side);
+  valid.set_size(side, side);
+  for (int row = 0; row < side; row++) {
+    for (int col = 0; col < side; col++) {
+      img(col, row) = dist(gen);
+      valid(col, row) = (dist(gen) > -45.0);
+    }
+  }
+}
+
+// The float median filter used for disparities, with each method, for a
+// kernel size where the two are comparable.
+BenchmarkResult benchMedianFilter(Options const& opt, std::string const& name,
+                                  asp::MedianFilterMethod method) {
+
+  vw::ImageView<float> img, out;
+  vw::ImageView<vw::uint8> valid, out_valid;
+  syntheticMedianData(opt, img, valid);
+  int kernel_size = 15;
+
+  return timeKernel(opt, name, "pixels", std::int64_t(img.cols()) * img.rows(), [&]() {
+    asp::median_filter(img, valid, kernel_size, out, out_valid, 0, method);
+    return double(vw::sum_of_pixel_values(out));
+  });
+}
+
+BenchmarkResult benchMedianFilterDirect(Options const& opt) {
+  return benchMedianFilter(opt, "median_filter_direct", asp::MEDIAN_DIRECT);
+}
+
+BenchmarkResult benchMedianFilterHistogram(Options const& opt) {
+  return benchMedianFilter(opt, "median_filter_histogram", asp::MEDIAN_HISTOGRAM);
+}
+
+// Filter both bands of a disparity
+BenchmarkResult benchDisparityMedianFilter(Options const& opt) {
+
+  vw::ImageView<float> img;
+  vw::ImageView<vw::uint8> valid;
+  syntheticMedianData(opt, img, valid);
+  vw::ImageView<vw::PixelMask<vw::Vector2f>> disp(img.cols(), img.rows()), out;
+  for (int row = 0; row < img.rows(); row++) {
+    for (int col = 0; col < img.cols(); col++) {
+      disp(col, row) = vw::PixelMask<vw::Vector2f>(vw::Vector2f(img(col, row),
+                                                                0.5 * img(col, row)));
+      if (!valid(col, row))
+        disp(col, row).invalidate();
+    }
+  }
+  int kernel_size = 25;
+
+  return timeKernel(opt, "disparity_median_filter", "pixels",
+                    std::int64_t(disp.cols()) * disp.rows(), [&]() {
+    asp::disparity_median_filter(disp, kernel_size, out);
+    double sum = 0.0;
+    for (int row = 0; row < out.rows(); row++) {
+      for (int col = 0; col < out.cols(); col++) {
+        if (is_valid(out(col, row)))
+          sum += out(col, row).child()[0] + out(col, row).child()[1];
+      }
+    }
+    return sum;
+  });
+}
+
+// Bicubic resampling of an image at random locations, as done by mapproject
+// once the camera pixel for each output pixel is known. The scalar kernel is
+// timed separately, to see the gain from the SIMD one.
+void syntheticResampleData(Options const& opt, vw::ImageView<float> & img,
+                           std::vector<float> & xs, std::vector<float> & ys) {
+  int side = scaledSide(1024, opt);
+  std::mt19937 gen(0);
+  img = syntheticTexture(side, side, gen);
+  std::int64_t num = std::int64_t(side) * side;
+  std::uniform_real_distribution<float> dist(-3.0, side + 3.0);
+  xs.resize(num);
+  ys.resize(num);
+  for (std::int64_t i = 0; i < num; i++) {
+    xs[i] = dist(gen);
+    ys[i] = dist(gen);
+  }
+}
+
+double sumValid(std::vector<float> const& vals) {
+  double sum = 0.0;
+  for (size_t i = 0; i < vals.size(); i++) {
+    if (!std::isnan(vals[i]))
+      sum += vals[i];
+  }
+  return sum;
+}
+
+BenchmarkResult benchResampleBlock(Options const& opt) {
+
+  vw::ImageView<float> img;
+  std::vector<float> xs, ys;
+  syntheticResampleData(opt, img, xs, ys);
+  std::vector<float> out(xs.size());
+
+  vw::vw_out() << "Resampling uses AVX2: " << asp::resampleUsesAvx2() << "\n";
+  return timeKernel(opt, "resample_block", "pixels", xs.size(), [&]() {
+    asp::resampleBlock(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0], xs.size(),
+                       asp::RESAMPLE_BICUBIC, &out[0]);
+    return sumValid(out);
+  });
+}
+
+BenchmarkResult benchResampleBlockScalar(Options const& opt) {
+
+  vw::ImageView<float> img;
+  std::vector<float> xs, ys;
+  syntheticResampleData(opt, img, xs, ys);
+  std::vector<float> out(xs.size());
+
+  return timeKernel(opt, "resample_block_scalar", "pixels", xs.size(), [&]() {
+    asp::resampleBlockScalar(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0],
+                             xs.size(), asp::RESAMPLE_BICUBIC, &out[0]);
+    return sumValid(out);
+  });
+}
+
+// Rasterize a DEM from a point cloud, tile by tile, as done by point2dem
+BenchmarkResult benchOrthoRasterizer(Options const& opt) {
+
+  // A point cloud on a regular grid, with some noise, and a few holes
+  int side = scaledSide(1024, opt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> noise(-0.25, 0.25);
+  vw::ImageView<vw::Vector3> cloud(side, side);
+  for (int row = 0; row < side; row++) {
+    for (int col = 0; col < side; col++) {
+      if ((col / 64 + row / 64) % 7 == 3 && col % 64 < 8 && row % 64 < 8)
+        continue; // no data
+      double x = col + noise(gen), y = -row + noise(gen);
+      cloud(col, row) = vw::Vector3(x, y, 100.0 * sin(x / 50.0) * cos(y / 50.0));
+    }
+  }
+
+  vw::ImageViewRef<vw::Vector3> point_image = cloud;
+  vw::ImageViewRef<double> error_image; // must outlive the rasterizer
+  std::int64_t num_invalid_pixels = 0;
+  vw::Mutex count_mutex;
+  asp::OrthoRasterizerView
+    rasterizer(point_image, vw::select_channel(point_image, 2),
+               0.0, 0.0, false, // search radius factor, sigma factor, surface sampling
+               256, vw::BBox2(), // point cloud tile size, projwin
+               asp::NO_OUTLIER_REMOVAL_METHOD, vw::Vector2(75.0, 3.0),
+               error_image, 0.0, vw::BBox3(), 0.0, // error image, max errors
+               vw::Vector2(0, 0), 0, false, // median filter, erode len, has las or csv
+               "weighted_average", 1.0, &num_invalid_pixels, &count_mutex,
+               vw::ProgressCallback::dummy_instance());
+  rasterizer.initialize_spacing();
+  rasterizer.set_default_value(-32768.0);
+
+  int tile_size = 256;
+  std::vector<vw::BBox2i> tiles
+    = vw::subdivide_bbox(vw::bounding_box(rasterizer), tile_size, tile_size);
+
+  return timeKernel(opt, "ortho_rasterizer_tile", "dem pixels",
+                    std::int64_t(rasterizer.cols()) * rasterizer.rows(), [&]() {
+    double sum = 0.0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+      vw::ImageView<vw::PixelGray<float>> dem = rasterizer.prerasterize(tiles[i]);
+      sum += vw::sum_of_pixel_values(vw::pixel_cast<double>(dem)).v();
+    }
+    return sum;
+  });
+}
+
+// Detect interest points in two images offset by a known amount, and match them
+void syntheticIpPair(Options const& opt, vw::ImageView<float> & left,
+                     vw::ImageView<float> & right) {
+  int side = scaledSide(1024, opt);
+  std::mt19937 gen(0);
+  left = syntheticTexture(side, side, gen);
+  right = vw::crop(vw::edge_extend(left, vw::ReflectEdgeExtension()),
+                   vw::BBox2i(13, 7, side, side));
+}
+
+BenchmarkResult benchIpDetection(Options const& opt) {
+
+  vw::ImageView<float> left, right;
+  syntheticIpPair(opt, left, right);
+
+  int ip_per_tile = 0; // use the default
+  double nodata = std::numeric_limits<double>::quiet_NaN();
+  return timeKernel(opt, "ip_detection", "pixels",
+                    std::int64_t(left.cols()) * left.rows(), [&]() {
+    vw::ip::InterestPointList ip;
+    asp::detect_ip(ip, left, ip_per_tile, "", nodata);
+    return double(ip.size());
+  });
+}
+
+BenchmarkResult benchIpMatching(Options const& opt) {
+
+  vw::ImageView<float> left, right;
+  syntheticIpPair(opt, left, right);
+
+  int ip_per_tile = 0; // use the default
+  double nodata = std::numeric_limits<double>::quiet_NaN();
+  vw::ip::InterestPointList ip1, ip2;
+  asp::detect_ip(ip1, left,  ip_per_tile, "", nodata);
+  asp::detect_ip(ip2, right, ip_per_tile, "", nodata);
+  std::vector<vw::ip::InterestPoint> ip1_vec(ip1.begin(), ip1.end());
+  std::vector<vw::ip::InterestPoint> ip2_vec(ip2.begin(), ip2.end());
+
+  asp::DetectIpMethod detect_method
+    = static_cast<asp::DetectIpMethod>(asp::stereo_settings().ip_matching_method);
+  double uniqueness_threshold = asp::stereo_settings().ip_uniqueness_thresh;
+  bool quiet = true;
+
+  return timeKernel(opt, "ip_matching", "interest points", ip1_vec.size(), [&]() {
+    std::vector<vw::ip::InterestPoint> matched_ip1, matched_ip2;
+    asp::match_ip_no_datum(ip1_vec, ip2_vec, detect_method, uniqueness_threshold, quiet,
+                           matched_ip1, matched_ip2);
+    return double(matched_ip1.size());
+  });
+}
+
+void handle_arguments(int argc, char *argv[], Options& opt,
+                      std::vector<std::pair<std::string, Benchmark>> const& benchmarks) {
+
+  po::options_description general_options("");
+  general_options.add_options()
+    ("output-file,o", po::value(&opt.output_file)->default_value("asp_benchmarks.json"),
+     "Save the results to this JSON file.")
+    ("kernels", po::value(&opt.kernels)->default_value(""),
+     "Run only these benchmarks. Specify as a list in quotes, separated by commas "
+     "or spaces. See --list for the names. The default is to run all of them.")
+    ("num-repeats", po::value(&opt.num_repeats)->default_value(5),
+     "Run each kernel this many times. The minimum and median times are reported.")
+    ("scale", po::value(&opt.scale)->default_value(1.0),
+     "Multiply the amount of data for each kernel by this factor.")
+    ("list", po::bool_switch(&opt.list)->default_value(false),
+     "List the benchmarks and quit.");
+
+  general_options.add(vw::GdalWriteOptionsDescription(opt));
+
+  po::options_description positional("");
+  po::positional_options_description positional_desc;
+
+  std::string usage("[options]");
+  bool allow_unregistered = false;
+  std::vector<std::string> unregistered;
+  po::variables_map vm =
+    asp::check_command_line(argc, argv, opt, general_options, general_options,
+                            positional, positional_desc, usage,
+                            allow_unregistered, unregistered);
+
+  if (opt.num_repeats <= 0)
+    vw::vw_throw(vw::ArgumentErr() << "The number of repeats must be positive.\n");
+  if (opt.scale <= 0)
+    vw::vw_throw(vw::ArgumentErr() << "The scale must be positive.\n");
+
+  std::string kernels = boost::trim_copy(opt.kernels);
+  if (kernels != "")
+    boost::split(opt.selected, kernels, boost::is_any_of(", "), boost::token_compress_on);
+  for (auto const& name: opt.selected) {
+    bool found = false;
+    for (auto const& b: benchmarks)
+      found = found || (b.first == name);
+    if (!found)
+      vw::vw_throw(vw::ArgumentErr() << "Unknown benchmark: " << name << ".\n");
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  // The names must match the ones reported by each benchmark
+  std::vector<std::pair<std::string, Benchmark>> benchmarks = {
+    {"csm_point_to_pixel",        benchCsmPointToPixel},
+    {"rpc_geodetic_to_pixel",     benchRpcGeodeticToPixel},
+    {"rpc_geodetic_to_pixel_batch", benchRpcGeodeticToPixelBatch},
+    {"stereo_triangulation_tile", benchStereoTriangulation},
+    {"point2grid_add_point",      benchPoint2GridAddPoint},
+    {"fast_median_filter",        benchFastMedianFilter},
+    {"median_filter_direct",      benchMedianFilterDirect},
+    {"median_filter_histogram",   benchMedianFilterHistogram},
+    {"disparity_median_filter",   benchDisparityMedianFilter},
+    {"resample_block",            benchResampleBlock},
+    {"resample_block_scalar",     benchResampleBlockScalar},
+    {"ortho_rasterizer_tile",     benchOrthoRasterizer},
+    {"ip_detection",              benchIpDetection},
+    {"ip_matching",               benchIpMatching}};
+
+  Options opt;
+  try {
+    handle_arguments(argc, argv, opt, benchmarks);
+
+    if (opt.list) {
+      for (auto const& b: benchmarks)
+        vw::vw_out() << b.first << "\n";
+      return 0;
+    }
+
+    json results = json::array();
+    for (auto const& b: benchmarks) {
+      if (!opt.selected.empty() && opt.selected.find(b.first) == opt.selected.end())
+        continue;
+
+      BenchmarkResult r = b.second(opt);
+      std::vector<double> times = r.times;
+      std::sort(times.begin(), times.end());
+      double min_time = times.front(), median_time = times[times.size() / 2];
+
+      vw::vw_out() << r.name << ": " << median_time << " s (median), "
+                   << r.num_items / std::max(min_time, 1e-12) << " "
+                   << r.units << "/s (best).\n";
+
+      json j;
+      j["name"]          = r.name;
+      j["units"]         = r.units;
+      j["num_items"]     = r.num_items;
+      j["times_sec"]     = r.times;
+      j["min_sec"]       = min_time;
+      j["median_sec"]    = median_time;
+      j["items_per_sec"] = r.num_items / std::max(min_time, 1e-12);
+      j["checksum"]      = r.checksum;
+      results.push_back(j);
+    }
+
+    json out;
+    out["asp_version"] = ASP_VERSION;
+    out["num_threads"] = vw::vw_settings().default_num_threads();
+    out["num_repeats"] = opt.num_repeats;
+    out["scale"]       = opt.scale;
+    out["benchmarks"]  = results;
+
+    std::ofstream ofs(opt.output_file.c_str());
+    if (!ofs)
+      vw::vw_throw(vw::ArgumentErr() << "Cannot write: " << opt.output_file << "\n");
+    ofs << out.dump(2) << "\n";
+    vw::vw_out() << "Wrote: " << opt.output_file << "\n";
+
+  } ASP_STANDARD_CATCHES;
+
+  return 0;
+}
@@ -80,12 +80,12 @@ struct BaBaseOptions: public vw::GdalWriteOptions {
     image_list, camera_list, mapprojected_data_list,
     fixed_image_list, camera_position_uncertainty_str;
   int overlap_limit, min_matches, max_pairwise_matches, num_iterations,
-    ip_edge_buffer_percent, max_num_reference_points, num_passes;
+    ip_edge_buffer_percent, max_num_reference_points, num_passes, checkpoint_interval;
   std::set<std::pair<std::string, std::string>> overlap_list;
   std::string overlap_list_file, auto_overlap_params, datum_str, proj_str,
     csv_format_str, csv_srs, csv_proj4_str, disparity_list, stereo_prefix_list;
   bool have_overlap_list, propagate_errors, match_first_to_last, single_threaded_cameras, 
-    update_isis_cubes_with_csm_state;
+    update_isis_cubes_with_csm_state, resume_from_checkpoint;
   double forced_triangulation_distance, min_triangulation_angle, max_init_reproj_error, 
     robust_threshold, parameter_tolerance;
   double heights_from_dem_uncertainty, reference_terrain_weight, 
@@ -111,7 +111,8 @@ struct BaBaseOptions: public vw::GdalWriteOptions {
    camera_position_robust_threshold(0.0), camera_weight(-1.0),
    rotation_weight(0.0), tri_weight(0.0),
    robust_threshold(0.0), min_matches(0),
-   num_iterations(0), num_passes(0), 
+   num_iterations(0), num_passes(0), checkpoint_interval(0),
+   resume_from_checkpoint(false),
    overlap_limit(0), have_overlap_list(false), propagate_errors(false),
    match_first_to_last(false), single_threaded_cameras(false), update_isis_cubes_with_csm_state(false),
    camera_type(BaCameraType_Other), max_num_reference_points(-1),
@@ -21,6 +21,7 @@
 #include <asp/Camera/BundleAdjustEigen.h>
 #include <asp/Core/EigenTransformUtils.h>
 #include <asp/Rig/nvm.h>
+#include <asp/Rig/nvm_binary.h>
 
 #include <vw/Camera/PinholeModel.h>
 namespace asp {
@@ -218,6 +219,13 @@ void saveNvm(asp::BaBaseOptions                const& opt,
   if (optical_offsets.empty())
     calcOpticalOffsets(opt.image_files, optimized_cams, optical_offsets);
     
+  // The binary format is written directly from the cnet
+  if (opt.output_cnet_type == "nvmb") {
+    rig::writeCnetAsBinaryNvm(cnet, optical_offsets, world_to_cam,
+                              opt.out_prefix + ".nvmb", tri_vec, outliers);
+    return;
+  }
+
   // Write the nvm
   std::string nvm_file = opt.out_prefix + ".nvm"; 
   rig::nvmData nvm;
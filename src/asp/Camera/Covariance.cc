@@ -24,6 +24,7 @@
 #include <vw/Stereo/StereoModel.h>
 #include <vw/Math/LinearAlgebra.h>
 
+#include <algorithm>
 #include <iostream>
 
 using namespace vw::camera;
@@ -91,6 +92,116 @@ int numCamsForCovariance() {
   return 15; 
 }
 
+// Spacing, in image lines, at which the ray differences are tabulated. Their
+// variation along the image follows the satellite attitude, which is sampled
+// much more coarsely than this.
+const int rayDiffsLineSpacing = 8;
+
+// Tabulate the center and ray differences. The rays of a line are sampled
+// at its first, middle, and last column. For each perturbation, the rotation
+// vector w with ray differences e = w x d is found by least squares, using
+// d x (w x d) = (I - d d^T) w for unit d.
+void DGRayJacobians::build(DGCameraModel const& cam) const {
+
+  if (cam.m_perturbed_cams.size() != 14)
+    vw::vw_throw(vw::ArgumentErr() << "The perturbed cameras were not set up.\n");
+
+  vw::Vector2 image_size = cam.get_image_size();
+  int cols = std::max(int(image_size[0]), 1), rows = std::max(int(image_size[1]), 1);
+  std::vector<double> sample_cols = {0.0, (cols - 1) / 2.0, cols - 1.0};
+
+  // Ensure the last line has tabulated lines on both sides
+  m_line_spacing = rayDiffsLineSpacing;
+  int num_lines = (rows - 1) / m_line_spacing + 2;
+  m_ctr_diffs.resize(7 * num_lines);
+  m_rot_vecs.resize(7 * num_lines);
+
+  for (int line_it = 0; line_it < num_lines; line_it++) {
+    double line = line_it * m_line_spacing;
+    vw::Vector2 mid_pix(sample_cols[1], line);
+
+    std::vector<vw::Vector3> dirs;
+    for (size_t c = 0; c < sample_cols.size(); c++)
+      dirs.push_back(cam.pixel_to_vector(vw::Vector2(sample_cols[c], line)));
+
+    for (int coord = 0; coord < 7; coord++) {
+      // See positionDelta() and quatDelta() for the order of perturbations
+      vw::camera::CameraModel const* plus  = cam.m_perturbed_cams[2*coord].get();
+      vw::camera::CameraModel const* minus = cam.m_perturbed_cams[2*coord + 1].get();
+
+      m_ctr_diffs[7*line_it + coord]
+        = (plus->camera_center(mid_pix) - minus->camera_center(mid_pix)) / 2.0;
+
+      vw::Matrix3x3 M;
+      vw::Vector3 rhs;
+      for (size_t c = 0; c < sample_cols.size(); c++) {
+        vw::Vector2 pix(sample_cols[c], line);
+        vw::Vector3 e = (plus->pixel_to_vector(pix) - minus->pixel_to_vector(pix)) / 2.0;
+        vw::Vector3 const& d = dirs[c];
+        M += vw::math::identity_matrix<3>() - vw::math::outer_prod(d, d);
+        rhs += vw::math::cross_prod(d, e);
+      }
+      m_rot_vecs[7*line_it + coord] = vw::math::inverse(M) * rhs;
+    }
+  }
+}
+
+void DGRayJacobians::rayDiffs(DGCameraModel const& cam, vw::Vector2 const& pix,
+                              vw::Vector3 const& dir,
+                              vw::Vector3 ctr_diffs[7], vw::Vector3 dir_diffs[7]) const {
+
+  std::call_once(m_built, [this, &cam]() { this->build(cam); });
+
+  // Linear interpolation between tabulated lines. Lines out of range,
+  // which can happen for the right image, are extrapolated.
+  int num_lines = m_ctr_diffs.size() / 7;
+  double t = pix.y() / m_line_spacing;
+  int j = std::min(std::max(int(floor(t)), 0), num_lines - 2);
+  double a = t - j;
+
+  for (int coord = 0; coord < 7; coord++) {
+    int i0 = 7*j + coord, i1 = 7*(j + 1) + coord;
+    ctr_diffs[coord] = (1.0 - a) * m_ctr_diffs[i0] + a * m_ctr_diffs[i1];
+    vw::Vector3 w    = (1.0 - a) * m_rot_vecs[i0]  + a * m_rot_vecs[i1];
+    dir_diffs[coord] = vw::math::cross_prod(w, dir);
+  }
+}
+
+// Find the ray directions and camera centers at a pixel for a DG camera.
+// The nominal ones are at index 0, followed by the positive and negative
+// perturbations of each satellite position and quaternion coordinate, in
+// the order of positionDelta() and quatDelta(). These are found either with
+// the tabulated differences, or by evaluating the perturbed cameras.
+void dgRaysForCovariance(DGCameraModel const* dg_cam, vw::Vector2 const& pix,
+                         std::vector<vw::Vector3> & dirs,
+                         std::vector<vw::Vector3> & ctrs) {
+
+  dirs.clear();
+  ctrs.clear();
+  vw::Vector3 dir = dg_cam->pixel_to_vector(pix);
+  vw::Vector3 ctr = dg_cam->camera_center(pix);
+  dirs.push_back(dir);
+  ctrs.push_back(ctr);
+
+  if (asp::stereo_settings().propagate_errors_method != "numerical" &&
+      dg_cam->m_ray_jacobians) {
+    vw::Vector3 ctr_diffs[7], dir_diffs[7];
+    dg_cam->m_ray_jacobians->rayDiffs(*dg_cam, pix, dir, ctr_diffs, dir_diffs);
+    for (int coord = 0; coord < 7; coord++) {
+      dirs.push_back(dir + dir_diffs[coord]);
+      ctrs.push_back(ctr + ctr_diffs[coord]);
+      dirs.push_back(dir - dir_diffs[coord]);
+      ctrs.push_back(ctr - ctr_diffs[coord]);
+    }
+    return;
+  }
+
+  for (size_t it = 0; it < dg_cam->m_perturbed_cams.size(); it++) {
+    dirs.push_back(dg_cam->m_perturbed_cams[it]->pixel_to_vector(pix));
+    ctrs.push_back(dg_cam->m_perturbed_cams[it]->camera_center(pix));
+  }
+}
+
 // Given two DG cameras and a pixel in each camera image, consider the
 // following transform. Go from the perturbed joint vector of
 // satellite positions and quaternions for this pixel pair to the
@@ -144,7 +255,8 @@ void scaledDGTriangulationJacobian(vw::cartography::Datum const& datum,
 
   // Numerical differences will be used. Camera models with deltaPosition and deltaQuat
   // perturbations have already been created in LinescanDGModel.cc using the positionDelta()
-  // and quatDelta() functions from above.
+  // and quatDelta() functions from above. With the analytic method these are
+  // evaluated only at some image lines, when tabulating the ray differences.
   if (dg_cam1->m_perturbed_cams.empty() || dg_cam2->m_perturbed_cams.empty()) 
     vw::vw_throw(vw::ArgumentErr() << "The perturbed cameras were not set up.\n");
   
@@ -156,16 +268,8 @@ void scaledDGTriangulationJacobian(vw::cartography::Datum const& datum,
   // camera, and for the perturbed versions. Same for the second
   // camera.
   std::vector<vw::Vector3> cam1_dirs, cam1_ctrs, cam2_dirs, cam2_ctrs;
-  cam1_dirs.push_back(dg_cam1->pixel_to_vector(pix1));
-  cam1_ctrs.push_back(dg_cam1->camera_center(pix1));
-  cam2_dirs.push_back(dg_cam2->pixel_to_vector(pix2));
-  cam2_ctrs.push_back(dg_cam2->camera_center(pix2));
-  for (size_t it = 0; it < dg_cam1->m_perturbed_cams.size(); it++) {
-    cam1_dirs.push_back(dg_cam1->m_perturbed_cams[it]->pixel_to_vector(pix1));
-    cam1_ctrs.push_back(dg_cam1->m_perturbed_cams[it]->camera_center(pix1));
-    cam2_dirs.push_back(dg_cam2->m_perturbed_cams[it]->pixel_to_vector(pix2));
-    cam2_ctrs.push_back(dg_cam2->m_perturbed_cams[it]->camera_center(pix2));
-  }
+  dgRaysForCovariance(dg_cam1, pix1, cam1_dirs, cam1_ctrs);
+  dgRaysForCovariance(dg_cam2, pix2, cam2_dirs, cam2_ctrs);
 
   // Apply adjustments
   if (adjusted_cameras) {
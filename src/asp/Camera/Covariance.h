@@ -27,6 +27,11 @@
 #include <vw/Math/Matrix.h>
 #include <vw/Camera/CameraModel.h>
 
+#include <boost/noncopyable.hpp>
+
+#include <mutex>
+#include <vector>
+
 namespace vw {
   namespace cartography {
     class Datum;
@@ -35,6 +40,8 @@ namespace vw {
 
 namespace asp {
 
+  class DGCameraModel;
+
   // Given 0 <= num < 15, return a perturbation in position. The
   // starting one is the zero perturbation, then perturb first
   // coordinate in the positive and then negative direction, then same
@@ -50,6 +57,35 @@ namespace asp {
   // Number of nominal and perturbed cameras when the covariance is computed
   int numCamsForCovariance();
 
+  // For a DG camera, the centered differences of the camera center and ray
+  // direction with respect to each of the 3 satellite position and 4
+  // quaternion coordinates, not divided by the spacing, as in
+  // scaledDGTriangulationJacobian(). A perturbation moves the camera
+  // center and rotates all rays of an image line the same way, so these
+  // are found, from the perturbed cameras, only at some lines, and are
+  // interpolated in between. That is much faster than evaluating
+  // the perturbed cameras at each pixel.
+  class DGRayJacobians: private boost::noncopyable {
+  public:
+    DGRayJacobians(): m_line_spacing(1) {}
+
+    // Given a pixel and the unadjusted ray direction at it, find the
+    // differences for the unadjusted camera. The tables are built on the
+    // first call. This is thread-safe.
+    void rayDiffs(DGCameraModel const& cam, vw::Vector2 const& pix,
+                  vw::Vector3 const& dir,
+                  vw::Vector3 ctr_diffs[7], vw::Vector3 dir_diffs[7]) const;
+
+  private:
+    void build(DGCameraModel const& cam) const;
+
+    mutable std::once_flag m_built;
+    mutable int m_line_spacing;
+    // For each tabulated line, 7 center differences, and 7 rotation
+    // vectors, which when crossed with a ray give its differences
+    mutable std::vector<vw::Vector3> m_ctr_diffs, m_rot_vecs;
+  };
+
   // Propagate horizontal ground plane covariances or DG's satellite
   // ephemeris and attitude covariances to triangulation in NED
   // coordinates. Return the square root of horizontal and vertical
@@ -220,6 +220,7 @@ vw::CamPtr load_dg_camera_model_from_xml(std::string const& path) {
   cam->m_satellite_quat_dt = adt;
   if (asp::stereo_settings().propagate_errors) {
     cam->m_perturbed_cams = perturbed_cams; 
+    cam->m_ray_jacobians.reset(new DGRayJacobians());
     cam->m_satellite_pos_cov = eph.satellite_pos_cov;
     cam->m_satellite_quat_cov = att.satellite_quat_cov;
   }
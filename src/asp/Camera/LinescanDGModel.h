@@ -37,6 +37,8 @@ class UsgsAstroLsSensorModel;
 
 namespace asp {
 
+  class DGRayJacobians;
+
   // Upper-right portion of the 3x3 satellite position covariance
   // matrix and 4x4 satellite quaternion matrix.
   const int SAT_POS_COV_SIZE = 6, SAT_QUAT_COV_SIZE = 10;
@@ -67,6 +69,7 @@ namespace asp {
 
     // For error propagation
     std::vector<vw::CamPtr> m_perturbed_cams;
+    boost::shared_ptr<DGRayJacobians> m_ray_jacobians; // built on first use
     std::vector<double> m_satellite_pos_cov, m_satellite_quat_cov;
     double m_satellite_pos_t0, m_satellite_pos_dt;
     double m_satellite_quat_t0, m_satellite_quat_dt;
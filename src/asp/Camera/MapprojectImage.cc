@@ -23,16 +23,25 @@
 #include <asp/Camera/MapprojectImage.h>
 #include <asp/Core/StereoSettings.h>
 #include <asp/Core/Common.h>
+#include <asp/Core/ResampleKernel.h>
+#include <asp/Camera/SparseCamGrid.h>
 
 #include <vw/Cartography/PointImageManipulation.h>
 #include <vw/Cartography/Map2CamTrans.h>
 #include <vw/Cartography/PointImageManipulation.h>
 #include <vw/Image/Filter.h>
+#include <vw/Image/Interpolation.h>
 #include <vw/Image/Algorithms2.h>
 #include <vw/FileIO/FileUtils.h>
+#include <vw/Core/Thread.h>
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 namespace fs = boost::filesystem;
 
 namespace asp {
@@ -161,9 +170,195 @@ void write_parallel_type(std::string              const& filename,
     vw_throw( NoImplErr() << "Unsupported output type: " << opt.output_type << ".\n" );
 }
 
+// Count how many camera projections were done exactly, across all tiles
+struct CamProjStats {
+  vw::Mutex mutex;
+  long long num_exact, num_total;
+  CamProjStats(): num_exact(0), num_total(0) {}
+  void add(long long exact, long long total) {
+    vw::Mutex::Lock lock(mutex);
+    num_exact += exact;
+    num_total += total;
+  }
+};
+
+// The largest part of the input image to bring in memory for one output
+// tile. Beyond this, as can happen for oblique views, the pixels are
+// interpolated one at a time, as transform_nodata() does.
+const long long BLOCK_RESAMPLE_MAX_READ_PIXELS = 16 * 1024 * 1024;
+
+// Mapproject a single-channel image one tile at a time. Find the camera pixel
+// for each output pixel, bring the needed part of the input image in memory,
+// and resample it with a vectorized kernel. This gives the same result as
+// transform_nodata() with an invalid edge extension and bilinear or bicubic
+// interpolation, without going through an interpolation view for each pixel.
+class BlockResampleView: public ImageViewBase<BlockResampleView> {
+  ImageViewRef<float> m_img;
+  double m_nodata;
+  vw::TransformPtr m_trans;
+  int m_cols, m_rows;
+  asp::ResampleMethod m_method;
+  double m_grid_tol;
+  boost::shared_ptr<CamProjStats> m_stats;
+  bool m_has_dem;
+  ImageViewRef<PixelMask<float>> m_dem;
+  GeoReference m_dem_georef, m_image_georef;
+
+public:
+  // If a DEM is given, the sparse grid uses it to find where the
+  // camera projection fails.
+  BlockResampleView(ImageViewRef<float> const& img, double nodata,
+                    vw::TransformPtr trans, int cols, int rows,
+                    asp::ResampleMethod method, double grid_tol,
+                    boost::shared_ptr<CamProjStats> stats,
+                    std::string const& dem_file, GeoReference const& dem_georef,
+                    GeoReference const& image_georef):
+    m_img(img), m_nodata(nodata), m_trans(trans), m_cols(cols), m_rows(rows),
+    m_method(method), m_grid_tol(grid_tol), m_stats(stats), m_has_dem(false),
+    m_dem_georef(dem_georef), m_image_georef(image_georef) {
+    if (dem_file != "") {
+      m_has_dem = true;
+      boost::shared_ptr<DiskImageResource> dem_rsrc(vw::DiskImageResourcePtr(dem_file));
+      double dem_nodata = -std::numeric_limits<float>::max();
+      if (dem_rsrc->has_nodata_read())
+        dem_nodata = dem_rsrc->nodata_read();
+      m_dem = create_mask(DiskImageView<float>(dem_rsrc), dem_nodata);
+    }
+  }
+
+  typedef PixelMask<float> pixel_type;
+  typedef PixelMask<float> result_type;
+  typedef ProceduralPixelAccessor<BlockResampleView> pixel_accessor;
+
+  inline int32 cols() const { return m_cols; }
+  inline int32 rows() const { return m_rows; }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor(*this, 0, 0); }
+
+  inline pixel_type operator()(double/*i*/, double/*j*/, int32/*p*/ = 0) const {
+    vw_throw(NoImplErr() << "BlockResampleView::operator()(...) is not implemented.\n");
+    return pixel_type();
+  }
+
+  typedef CropView<ImageView<pixel_type>> prerasterize_type;
+  inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+
+    ImageView<pixel_type> tile(bbox.width(), bbox.height()); // all invalid
+    int num = bbox.width() * bbox.height();
+
+    // Use a copy of the transform, as it caches data for the current tile.
+    // The call to reverse_bbox() creates that cache.
+    vw::TransformPtr trans = vw::cartography::mapproj_trans_copy(m_trans);
+    trans->reverse_bbox(bbox);
+
+    // Find the camera pixels
+    std::vector<Vector2> cam_pix(num);
+    if (m_grid_tol > 0) {
+      boost::shared_ptr<DemCoverage> coverage;
+      if (m_has_dem)
+        coverage.reset(new DemCoverage(m_dem, m_dem_georef, m_image_georef, bbox));
+      SparseCamGrid grid(*trans, bbox, m_grid_tol, coverage.get(), cam_pix);
+      grid.compute();
+      m_stats->add(grid.num_exact, num);
+    } else {
+      for (int row = 0; row < bbox.height(); row++) {
+        for (int col = 0; col < bbox.width(); col++)
+          cam_pix[row * bbox.width() + col]
+            = trans->reverse(Vector2(col + bbox.min().x(), row + bbox.min().y()));
+      }
+      m_stats->add(num, num);
+    }
+
+    // Find the image box the camera pixels fall in
+    BBox2 img_box = bounding_box(m_img);
+    BBox2 pix_box;
+    bool has_valid = false;
+    for (int k = 0; k < num; k++) {
+      Vector2 & pix = cam_pix[k];
+      if (!SparseCamGrid::isValid(pix) ||
+          !(pix[0] >= 0 && pix[0] <= img_box.max().x() - 1 &&
+            pix[1] >= 0 && pix[1] <= img_box.max().y() - 1)) {
+        pix = Vector2(std::numeric_limits<double>::quiet_NaN(),
+                      std::numeric_limits<double>::quiet_NaN());
+      } else {
+        pix_box.grow(pix);
+        has_valid = true;
+      }
+    }
+
+    if (!has_valid)
+      return prerasterize_type(tile, -bbox.min().x(), -bbox.min().y(), cols(), rows());
+
+    // Bring in memory the needed part of the image, with a margin for the
+    // bicubic footprint. Pixels outside the image or equal to nodata are NaN.
+    int margin = 2;
+    BBox2i read_box(Vector2i(floor(pix_box.min().x()) - margin,
+                             floor(pix_box.min().y()) - margin),
+                    Vector2i(floor(pix_box.max().x()) + margin + 1,
+                             floor(pix_box.max().y()) + margin + 1));
+    // The nodata value must be compared with the pixels in their own type,
+    // or else it may never match.
+    float nodata = m_nodata;
+    if ((long long)read_box.width() * (long long)read_box.height()
+        > BLOCK_RESAMPLE_MAX_READ_PIXELS) {
+      auto interp = interpolate(create_mask(m_img, nodata), BicubicInterpolation(),
+                                ValueEdgeExtension<pixel_type>(pixel_type()));
+      for (int row = 0; row < bbox.height(); row++) {
+        for (int col = 0; col < bbox.width(); col++) {
+          Vector2 const& pix = cam_pix[row * bbox.width() + col];
+          if (!std::isnan(pix[0]))
+            tile(col, row) = interp(pix[0], pix[1]);
+        }
+      }
+      return prerasterize_type(tile, -bbox.min().x(), -bbox.min().y(), cols(), rows());
+    }
+
+    BBox2i inner_box = read_box;
+    inner_box.crop(bounding_box(m_img));
+    ImageView<float> buf(read_box.width(), read_box.height());
+    float nan = std::numeric_limits<float>::quiet_NaN();
+    fill(buf, nan);
+    crop(buf, inner_box - read_box.min()) = crop(m_img, inner_box);
+    for (int row = 0; row < buf.rows(); row++) {
+      for (int col = 0; col < buf.cols(); col++) {
+        if (buf(col, row) == nodata)
+          buf(col, row) = nan;
+      }
+    }
+
+    // The locations relative to the buffer fit well in single precision
+    std::vector<float> xs(num), ys(num), vals(num);
+    for (int k = 0; k < num; k++) {
+      xs[k] = cam_pix[k][0] - read_box.min().x();
+      ys[k] = cam_pix[k][1] - read_box.min().y();
+    }
+
+    asp::resampleBlock(&buf(0, 0), buf.cols(), buf.rows(), &xs[0], &ys[0], num,
+                       m_method, &vals[0]);
+
+    for (int row = 0; row < bbox.height(); row++) {
+      for (int col = 0; col < bbox.width(); col++) {
+        float val = vals[row * bbox.width() + col];
+        if (!std::isnan(val))
+          tile(col, row) = pixel_type(val);
+      }
+    }
+
+    return prerasterize_type(tile, -bbox.min().x(), -bbox.min().y(), cols(), rows());
+  }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
+  }
+};
+
 /// Mapproject the image with a nodata value.  Used for single channel images.
 template <class ImagePixelT, class Map2CamTransT>
 void project_image_nodata(asp::MapprojOptions & opt,
+                          GeoReference  const& dem_georef,
+                          GeoReference  const& target_georef,
                           GeoReference  const& croppedGeoRef,
                           Vector2i      const& virtual_image_size,
                           BBox2i        const& croppedImageBB,
@@ -183,7 +378,28 @@ void project_image_nodata(asp::MapprojOptions & opt,
     ImageMaskPixelT nodata_mask = ImageMaskPixelT(); // invalid value for a PixelMask
 
     // TODO: This is a lot of code duplication, is there a better way?
-    if (opt.nearest_neighbor) {
+    if (!opt.nearest_neighbor && !opt.legacy_resample) {
+      boost::shared_ptr<CamProjStats> stats(new CamProjStats);
+      std::string dem_file;
+      if (fs::path(opt.dem_file).extension() != "")
+        dem_file = opt.dem_file; // otherwise a datum is used, with no holes
+      write_parallel_type
+        (opt.output_file,
+         crop(apply_mask(BlockResampleView(DiskImageView<ImagePixelT>(img_rsrc),
+                                           opt.nodata_value,
+                                           vw::TransformPtr(new Map2CamTransT(transform)),
+                                           virtual_image_size[0], virtual_image_size[1],
+                                           asp::RESAMPLE_BICUBIC, opt.sparse_grid_tol,
+                                           stats, dem_file, dem_georef, target_georef),
+                         opt.nodata_value),
+              croppedImageBB),
+         croppedGeoRef, has_img_nodata, opt.nodata_value, opt,
+         TerminalProgressCallback("",""));
+      if (opt.sparse_grid_tol > 0 && stats->num_total > 0)
+        vw_out() << "Exact camera projections: " << stats->num_exact << " out of "
+                 << stats->num_total << " pixels ("
+                 << 100.0 * double(stats->num_exact) / double(stats->num_total) << "%).\n";
+    } else if (opt.nearest_neighbor) {
       write_parallel_type
         ( // Write to the output file
         opt.output_file,
@@ -303,7 +519,7 @@ void project_image_nodata_pick_transform(asp::MapprojOptions & opt,
   const bool        call_from_mapproject = true;
   if (fs::path(opt.dem_file).extension() != "") {
     // A DEM file was provided
-    return project_image_nodata<ImagePixelT>(opt, croppedGeoRef,
+    return project_image_nodata<ImagePixelT>(opt, dem_georef, target_georef, croppedGeoRef,
                                              virtual_image_size, croppedImageBB,
                                              Map2CamTrans(// Converts coordinates in DEM
                                                           // georeference to camera pixels
@@ -313,7 +529,7 @@ void project_image_nodata_pick_transform(asp::MapprojOptions & opt,
                                                           opt.nearest_neighbor));
   } else {
     // A constant datum elevation was provided
-    return project_image_nodata<ImagePixelT>(opt, croppedGeoRef,
+    return project_image_nodata<ImagePixelT>(opt, dem_georef, target_georef, croppedGeoRef,
                                              virtual_image_size, croppedImageBB,
                                              Datum2CamTrans
                                              (// Converts coordinates in DEM
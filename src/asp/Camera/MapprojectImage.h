@@ -34,7 +34,8 @@ struct MapprojOptions: vw::GdalWriteOptions {
   // Input
   std::string dem_file, image_file, camera_file, output_file, stereo_session,
     bundle_adjust_prefix;
-  bool isQuery, noGeoHeaderInfo, nearest_neighbor, parseOptions, aster_use_csm;
+  bool isQuery, noGeoHeaderInfo, nearest_neighbor, parseOptions, aster_use_csm,
+    legacy_resample;
   bool multithreaded_model; // This is set based on the session type
   
   // Keep a copy of the model here to not have to pass it around separately
@@ -42,7 +43,7 @@ struct MapprojOptions: vw::GdalWriteOptions {
   
   // Settings
   std::string target_srs_string, output_type, metadata;
-  double nodata_value, tr, mpp, ppd, datum_offset;
+  double nodata_value, tr, mpp, ppd, datum_offset, sparse_grid_tol;
   vw::BBox2 target_projwin, target_pixelwin;
   vw::Vector2 query_pixel;
 };
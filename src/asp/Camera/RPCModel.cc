@@ -29,10 +29,164 @@
 #include <boost/smart_ptr/scoped_ptr.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// The AVX2 code for the batched functions is compiled with a function
+// attribute and selected at run time, so no special build flags are needed.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ASP_RPC_HAVE_AVX2 1
+#else
+#define ASP_RPC_HAVE_AVX2 0
+#endif
+
 using namespace vw;
 
 namespace asp {
 
+namespace {
+
+  const int NUM_TERMS = 20;
+
+#if ASP_RPC_HAVE_AVX2
+  // Four doubles, with the arithmetic operators applying to each of them
+  typedef double Double4 __attribute__((vector_size(32)));
+#endif
+
+  // Evaluate the normalized pixel, and optionally its Jacobian in the
+  // normalized geodetic, at the normalized geodetic (x, y, z). The
+  // coefficients c are the sample numerator and denominator, followed by
+  // the line numerator and denominator. This is written once for a single
+  // point (T = double) and four points at a time (T = Double4), and
+  // inlined in the callers, so both are compiled for their own instruction
+  // set with the same order of operations.
+  template <class T>
+  inline __attribute__((always_inline))
+  void eval_rpc(double const* c, T const& x, T const& y, T const& z,
+                bool with_jac, T & px, T & py, T * jac) {
+
+    // Same as RPCModel::calculate_terms()
+    T t[NUM_TERMS];
+    t[ 0] = T() + 1.0;
+    t[ 1] = x;
+    t[ 2] = y;
+    t[ 3] = z;
+    t[ 4] = x*y;
+    t[ 5] = x*z;
+    t[ 6] = y*z;
+    t[ 7] = x*x;
+    t[ 8] = y*y;
+    t[ 9] = z*z;
+    t[10] = x*y*z;
+    t[11] = x*x*x;
+    t[12] = x*y*y;
+    t[13] = x*z*z;
+    t[14] = x*x*y;
+    t[15] = y*y*y;
+    t[16] = y*z*z;
+    t[17] = x*x*z;
+    t[18] = y*y*z;
+    t[19] = z*z*z;
+
+    // The four polynomials, summed in the same order as dot_prod()
+    T v[4];
+    for (int k = 0; k < 4; k++) {
+      double const* ck = c + k * NUM_TERMS;
+      T sum = t[0] * ck[0];
+      for (int i = 1; i < NUM_TERMS; i++)
+        sum = sum + t[i] * ck[i];
+      v[k] = sum;
+    }
+    px = v[0] / v[1];
+    py = v[2] / v[3];
+
+    if (!with_jac)
+      return;
+
+    // The partial derivatives of the numerator and denominator in x, y, z,
+    // then those of their quotient, as (n' d - n d') / d^2.
+    for (int q = 0; q < 2; q++) {
+      T d[2][3];
+      for (int k = 0; k < 2; k++) {
+        double const* ck = c + (2 * q + k) * NUM_TERMS;
+        d[k][0] = ck[1] + t[2]*ck[4] + t[3]*ck[5] + 2.0*t[1]*ck[7] + t[6]*ck[10]
+          + 3.0*t[7]*ck[11] + t[8]*ck[12] + t[9]*ck[13] + 2.0*t[4]*ck[14]
+          + 2.0*t[5]*ck[17];
+        d[k][1] = ck[2] + t[1]*ck[4] + t[3]*ck[6] + 2.0*t[2]*ck[8] + t[5]*ck[10]
+          + 2.0*t[4]*ck[12] + t[7]*ck[14] + 3.0*t[8]*ck[15] + t[9]*ck[16]
+          + 2.0*t[6]*ck[18];
+        d[k][2] = ck[3] + t[1]*ck[5] + t[2]*ck[6] + 2.0*t[3]*ck[9] + t[4]*ck[10]
+          + 2.0*t[5]*ck[13] + 2.0*t[6]*ck[16] + t[7]*ck[17] + t[8]*ck[18]
+          + 3.0*t[9]*ck[19];
+      }
+      T den2 = v[2 * q + 1] * v[2 * q + 1];
+      for (int j = 0; j < 3; j++)
+        jac[3 * q + j] = (d[0][j] * v[2 * q + 1] - v[2 * q] * d[1][j]) / den2;
+    }
+  }
+
+  // Evaluate the points from beg to end, one at a time. The Jacobians, if
+  // jac is not NULL, are stored as in RPCModel::geodetic_to_pixel_Jacobian().
+  void eval_rpc_range(double const* c, double const* x, double const* y,
+                      double const* z, int beg, int end, int num,
+                      double * px, double * py, double * jac) {
+    double J[6];
+    for (int i = beg; i < end; i++) {
+      eval_rpc<double>(c, x[i], y[i], z[i], jac != NULL, px[i], py[i], J);
+      if (jac != NULL) {
+        for (int k = 0; k < 6; k++)
+          jac[k * num + i] = J[k];
+      }
+    }
+  }
+
+#if ASP_RPC_HAVE_AVX2
+  __attribute__((target("avx2")))
+  void eval_rpc_avx2(double const* c, double const* x, double const* y,
+                     double const* z, int num, double * px, double * py, double * jac) {
+    int i = 0;
+    for (; i + 4 <= num; i += 4) {
+      Double4 X, Y, Z, PX, PY, J[6];
+      std::memcpy(&X, x + i, sizeof(X));
+      std::memcpy(&Y, y + i, sizeof(Y));
+      std::memcpy(&Z, z + i, sizeof(Z));
+      eval_rpc<Double4>(c, X, Y, Z, jac != NULL, PX, PY, J);
+      std::memcpy(px + i, &PX, sizeof(PX));
+      std::memcpy(py + i, &PY, sizeof(PY));
+      if (jac != NULL) {
+        for (int k = 0; k < 6; k++)
+          std::memcpy(jac + k * num + i, &J[k], sizeof(J[k]));
+      }
+    }
+    eval_rpc_range(c, x, y, z, i, num, num, px, py, jac);
+  }
+#endif
+
+  // Evaluate num normalized points, with AVX2 if available
+  void eval_rpc_batch(double const* c, double const* x, double const* y,
+                      double const* z, int num, double * px, double * py, double * jac) {
+#if ASP_RPC_HAVE_AVX2
+    if (RPCModel::batch_uses_avx2()) {
+      eval_rpc_avx2(c, x, y, z, num, px, py, jac);
+      return;
+    }
+#endif
+    eval_rpc_range(c, x, y, z, 0, num, num, px, py, jac);
+  }
+
+  // The coefficients in the order expected by eval_rpc()
+  void rpc_coeffs(RPCModel const& rpc, double * c) {
+    for (int i = 0; i < NUM_TERMS; i++) {
+      c[i]                 = rpc.sample_num_coeff()[i];
+      c[i + NUM_TERMS]     = rpc.sample_den_coeff()[i];
+      c[i + 2 * NUM_TERMS] = rpc.line_num_coeff()[i];
+      c[i + 3 * NUM_TERMS] = rpc.line_den_coeff()[i];
+    }
+  }
+
+} // end anonymous namespace
+
   void RPCModel::initialize(DiskImageResourceGDAL* resource) {
     // Extract the datum (by means of georeference)
     cartography::GeoReference georef;
@@ -558,6 +712,171 @@ namespace asp {
     P = P_up - dir*LONG_SCALE_UP;
   }
 
+  bool RPCModel::batch_uses_avx2() {
+#if ASP_RPC_HAVE_AVX2
+    static const bool ans = __builtin_cpu_supports("avx2");
+    return ans;
+#else
+    return false;
+#endif
+  }
+
+  void RPCModel::geodetic_to_pixel(int num, double const* lon, double const* lat,
+                                   double const* height,
+                                   double * pix_x, double * pix_y) const {
+
+    if (num <= 0)
+      return;
+
+    std::vector<double> x(num), y(num), z(num);
+    for (int i = 0; i < num; i++) {
+      x[i] = (lon[i]    - m_lonlatheight_offset[0]) / m_lonlatheight_scale[0];
+      y[i] = (lat[i]    - m_lonlatheight_offset[1]) / m_lonlatheight_scale[1];
+      z[i] = (height[i] - m_lonlatheight_offset[2]) / m_lonlatheight_scale[2];
+    }
+
+    double c[4 * NUM_TERMS];
+    rpc_coeffs(*this, c);
+    eval_rpc_batch(c, &x[0], &y[0], &z[0], num, pix_x, pix_y, NULL);
+
+    for (int i = 0; i < num; i++) {
+      pix_x[i] = pix_x[i] * m_xy_scale[0] + m_xy_offset[0];
+      pix_y[i] = pix_y[i] * m_xy_scale[1] + m_xy_offset[1];
+    }
+  }
+
+  void RPCModel::geodetic_to_pixel_Jacobian(int num, double const* lon, double const* lat,
+                                            double const* height,
+                                            double * pix_x, double * pix_y,
+                                            double * jac) const {
+
+    if (num <= 0)
+      return;
+
+    std::vector<double> x(num), y(num), z(num);
+    for (int i = 0; i < num; i++) {
+      x[i] = (lon[i]    - m_lonlatheight_offset[0]) / m_lonlatheight_scale[0];
+      y[i] = (lat[i]    - m_lonlatheight_offset[1]) / m_lonlatheight_scale[1];
+      z[i] = (height[i] - m_lonlatheight_offset[2]) / m_lonlatheight_scale[2];
+    }
+
+    double c[4 * NUM_TERMS];
+    rpc_coeffs(*this, c);
+    eval_rpc_batch(c, &x[0], &y[0], &z[0], num, pix_x, pix_y, jac);
+
+    // Undo the normalization, in the output and in the input
+    for (int r = 0; r < 2; r++) {
+      for (int col = 0; col < 3; col++) {
+        double factor = m_xy_scale[r] / m_lonlatheight_scale[col];
+        double * J = jac + (3 * r + col) * num;
+        for (int i = 0; i < num; i++)
+          J[i] *= factor;
+      }
+    }
+    for (int i = 0; i < num; i++) {
+      pix_x[i] = pix_x[i] * m_xy_scale[0] + m_xy_offset[0];
+      pix_y[i] = pix_y[i] * m_xy_scale[1] + m_xy_offset[1];
+    }
+  }
+
+  // The same Newton's method as in image_to_ground(), for all points at once.
+  // A point stops being updated once it converges.
+  void RPCModel::image_to_ground(int num, double const* pix_x, double const* pix_y,
+                                 double const* height, double * lon, double * lat) const {
+
+    if (num <= 0)
+      return;
+
+    // The absolute tolerance is the same as for a single point
+    double abs_tolerance = 1e-6;
+
+    std::vector<double> norm_px(num), norm_py(num), x(num), y(num), z(num);
+    for (int i = 0; i < num; i++) {
+      norm_px[i] = (pix_x[i] - m_xy_offset[0]) / m_xy_scale[0];
+      norm_py[i] = (pix_y[i] - m_xy_offset[1]) / m_xy_scale[1];
+
+      double lon_guess = lon[i], lat_guess = lat[i];
+      if (lon_guess == 0.0 && lat_guess == 0.0) {
+        lon_guess = m_lonlatheight_offset[0];
+        lat_guess = m_lonlatheight_offset[1];
+      }
+      x[i] = (lon_guess - m_lonlatheight_offset[0]) / m_lonlatheight_scale[0];
+      y[i] = (lat_guess - m_lonlatheight_offset[1]) / m_lonlatheight_scale[1];
+      double len = sqrt(x[i]*x[i] + y[i]*y[i]);
+      if (len != len || len > 1.5) {
+        // If the input guess is NaN or unreasonable, use 0 as initial guess
+        x[i] = 0.0;
+        y[i] = 0.0;
+      }
+      z[i] = (height[i] - m_lonlatheight_offset[2]) / m_lonlatheight_scale[2];
+    }
+
+    double c[4 * NUM_TERMS];
+    rpc_coeffs(*this, c);
+    std::vector<double> px(num), py(num), jac(6 * num);
+    std::vector<char> active(num, 1);
+    for (int iter = 0; iter < 10; iter++) {
+
+      eval_rpc_batch(c, &x[0], &y[0], &z[0], num, &px[0], &py[0], &jac[0]);
+
+      bool any_active = false;
+      for (int i = 0; i < num; i++) {
+        if (!active[i])
+          continue;
+
+        // The inverse of the Jacobian in x and y, computed analytically
+        double J00 = jac[i], J01 = jac[num + i], J10 = jac[3 * num + i], J11 = jac[4 * num + i];
+        double det = J00*J11 - J01*J10;
+        double inv00 =  J11/det, inv01 = -J01/det;
+        double inv10 = -J10/det, inv11 =  J00/det;
+
+        double err_x = px[i] - norm_px[i], err_y = py[i] - norm_py[i];
+        x[i] -= inv00*err_x + inv01*err_y;
+        y[i] -= inv10*err_x + inv11*err_y;
+
+        if (sqrt(err_x*err_x + err_y*err_y) < abs_tolerance)
+          active[i] = 0;
+        else
+          any_active = true;
+      }
+
+      if (!any_active)
+        break;
+    }
+
+    for (int i = 0; i < num; i++) {
+      lon[i] = x[i] * m_lonlatheight_scale[0] + m_lonlatheight_offset[0];
+      lat[i] = y[i] * m_lonlatheight_scale[1] + m_lonlatheight_offset[1];
+    }
+  }
+
+  void RPCModel::point_and_dir(int num, double const* pix_x, double const* pix_y,
+                               Vector3 * P, Vector3 * dir) const {
+
+    if (num <= 0)
+      return;
+
+    // Same logic as in the single-pixel version
+    const double VERT_SCALE_FACTOR = 0.9;
+    double height_up = m_lonlatheight_offset[2] + m_lonlatheight_scale[2]*VERT_SCALE_FACTOR;
+    double height_dn = m_lonlatheight_offset[2] - m_lonlatheight_scale[2]*VERT_SCALE_FACTOR;
+
+    std::vector<double> h_up(num, height_up), h_dn(num, height_dn);
+    std::vector<double> lon_up(num, m_lonlatheight_offset[0]);
+    std::vector<double> lat_up(num, m_lonlatheight_offset[1]);
+    image_to_ground(num, pix_x, pix_y, &h_up[0], &lon_up[0], &lat_up[0]);
+    std::vector<double> lon_dn = lon_up, lat_dn = lat_up;
+    image_to_ground(num, pix_x, pix_y, &h_dn[0], &lon_dn[0], &lat_dn[0]);
+
+    const double LONG_SCALE_UP = 100000.0; // 100 km above ground
+    for (int i = 0; i < num; i++) {
+      Vector3 P_up = m_datum.geodetic_to_cartesian(Vector3(lon_up[i], lat_up[i], height_up));
+      Vector3 P_dn = m_datum.geodetic_to_cartesian(Vector3(lon_dn[i], lat_dn[i], height_dn));
+      dir[i] = normalize(P_dn - P_up);
+      P[i] = P_up - dir[i]*LONG_SCALE_UP;
+    }
+  }
+
   Vector3 RPCModel::camera_center(Vector2 const& pix) const{
     // Return an arbitrarily chosen point on the ray back-projected
     // through the camera from the current pixel.
@@ -131,6 +131,34 @@ namespace asp {
     /// and the direction of the ray going through that point.
     void point_and_dir(vw::Vector2 const& pix, vw::Vector3 & P, vw::Vector3 & dir ) const;
 
+    // Batched versions of the functions above, for many points at once, such
+    // as for a tile. Each coordinate is in its own array (structure of
+    // arrays), so that several points are processed together with SIMD
+    // instructions (AVX2, if the processor supports it). The results agree
+    // with the single-point functions up to rounding.
+
+    /// Project num points with given lon, lat, and height into the camera.
+    void geodetic_to_pixel(int num, double const* lon, double const* lat,
+                           double const* height, double * pix_x, double * pix_y) const;
+
+    /// Same as above, and also find the Jacobians. Entry (r, c) of the 2x3
+    /// Jacobian of point i is stored in jac[(3*r + c)*num + i].
+    void geodetic_to_pixel_Jacobian(int num, double const* lon, double const* lat,
+                                    double const* height, double * pix_x, double * pix_y,
+                                    double * jac) const;
+
+    /// Find the lon and lat of num points given their pixels and heights.
+    /// On input, lon and lat have the initial guesses, as for image_to_ground().
+    void image_to_ground(int num, double const* pix_x, double const* pix_y,
+                         double const* height, double * lon, double * lat) const;
+
+    /// Find the rays through num pixels, as done by point_and_dir().
+    void point_and_dir(int num, double const* pix_x, double const* pix_y,
+                       vw::Vector3 * P, vw::Vector3 * dir) const;
+
+    /// If the batched functions use AVX2 instructions.
+    static bool batch_uses_avx2();
+
     // Will be read only for DG RPC camera models and set to 0 for the rest
     double m_err_bias, m_err_rand;
 
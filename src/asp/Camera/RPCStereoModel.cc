@@ -26,7 +26,8 @@
 #include <asp/Camera/RPCModel.h>
 #include <asp/Camera/RPCStereoModel.h>
 
-// TODO(oalexan1): See if to wipe all this code as it is no longer in use.
+// This is used in stereo_tri to triangulate a tile at a time with the
+// rays found with the batched RPC functions.
 
 using namespace vw;
 using namespace std;
@@ -74,33 +75,53 @@ namespace asp {
     errorVec = Vector3();
 
     try {
-      vector<Vector3> camDirs(num_cams), 
-                      camCtrs(num_cams);
-      vector<const RPCModel*> rpc_cams(num_cams);
-      camDirs.clear(); 
-      camCtrs.clear(); 
-      rpc_cams.clear();
+      vector<Vector3> camDirs(num_cams), camCtrs(num_cams);
 
-      // Pick the valid rays
       for (int p = 0; p < num_cams; p++){
 
         // Get the RPC pointer so we can call RPC specific functions on it
         const RPCModel *rpc_cam = dynamic_cast<const RPCModel*>(vw::camera::unadjusted_model(m_cameras[p]));
         VW_ASSERT(rpc_cam != NULL,
                   vw::ArgumentErr() << "Camera models are not RPC.\n");
-        rpc_cams.push_back(rpc_cam);
 
         Vector2 pix = pixVec[p];
         if (pix != pix || // i.e., NaN
             pix == camera::CameraModel::invalid_pixel() ) continue;
 
         // The base class function would call point_and_dir twice, but we only need to call it once!
-        Vector3 ctr, dir;
-        rpc_cam->point_and_dir(pix, ctr, dir);
-        camDirs.push_back(dir);
-        camCtrs.push_back(ctr);
+        rpc_cam->point_and_dir(pix, camCtrs[p], camDirs[p]);
       }
 
+      return triangulate_rays(pixVec, camCtrs, camDirs, errorVec);
+
+    } catch (const camera::PixelToRayErr& /*e*/) {}
+    return Vector3();
+  }
+
+  Vector3 RPCStereoModel::triangulate_rays(vector<Vector2> const& pixVec,
+                                           vector<Vector3> const& ctrs,
+                                           vector<Vector3> const& dirs,
+                                           Vector3& errorVec) const {
+
+    int num_cams = m_cameras.size();
+    VW_ASSERT((int)pixVec.size() == num_cams &&
+              (int)ctrs.size() == num_cams && (int)dirs.size() == num_cams,
+              vw::ArgumentErr() << "the number of rays must match "
+                                << "the number of cameras.\n");
+
+    errorVec = Vector3();
+
+    try {
+      vector<Vector3> camDirs, camCtrs;
+
+      // Pick the valid rays
+      for (int p = 0; p < num_cams; p++){
+        Vector2 pix = pixVec[p];
+        if (pix != pix || // i.e., NaN
+            pix == camera::CameraModel::invalid_pixel() ) continue;
+        camDirs.push_back(dirs[p]);
+        camCtrs.push_back(ctrs[p]);
+      }
 
       // Not enough valid rays
       if (camDirs.size() < 2) 
@@ -120,6 +141,13 @@ namespace asp {
           vw::vw_throw(vw::NoImplErr() << "Least squares refinement is not "
                        << "implemented for multi-view stereo.");
 
+        vector<const RPCModel*> rpc_cams(num_cams);
+        for (int p = 0; p < num_cams; p++) {
+          rpc_cams[p] = dynamic_cast<const RPCModel*>(vw::camera::unadjusted_model(m_cameras[p]));
+          VW_ASSERT(rpc_cams[p] != NULL,
+                    vw::ArgumentErr() << "Camera models are not RPC.\n");
+        }
+
         detail::RPCTriangulateLMA model(rpc_cams[0], rpc_cams[1]);
         Vector4 objective(pixVec[0][0], pixVec[0][1], pixVec[1][0], pixVec[1][1]);
         int status = 0;
@@ -148,6 +176,17 @@ namespace asp {
     return Vector3();
   }
 
+  vector<const RPCModel*> RPCStereoModel::rpc_cameras() const {
+    vector<const RPCModel*> rpc_cams;
+    for (size_t p = 0; p < m_cameras.size(); p++) {
+      const RPCModel *rpc_cam = dynamic_cast<const RPCModel*>(m_cameras[p]);
+      if (rpc_cam == NULL)
+        return vector<const RPCModel*>();
+      rpc_cams.push_back(rpc_cam);
+    }
+    return rpc_cams;
+  }
+
   Vector3 RPCStereoModel::operator()(vw::Vector2 const& pix1,
                                      vw::Vector2 const& pix2,
                                      double& error ) const {
@@ -32,6 +32,8 @@ namespace vw {
 
 namespace asp {
 
+  class RPCModel;
+
   /// Derived StereoModel class implementing the RPC camera model.
   /// - Using a seperate class allows us to get a speed improvement in ray generation.
   class RPCStereoModel: public vw::stereo::StereoModel {
@@ -51,6 +53,10 @@ namespace asp {
                    bool least_squares_refine = false,
                    double angle_tol = 0.0):
       vw::stereo::StereoModel(camera_model1, camera_model2, least_squares_refine, angle_tol){}
+
+    /// Use the cameras and settings of an existing stereo model.
+    explicit RPCStereoModel(vw::stereo::StereoModel const& stereo_model):
+      vw::stereo::StereoModel(stereo_model){}
     
     virtual ~RPCStereoModel() {}
     
@@ -65,6 +71,20 @@ namespace asp {
     virtual vw::Vector3 operator()(vw::Vector2 const& pix1,
                                    vw::Vector2 const& pix2,
                                    double& error) const;
+
+    /// Same as operator(), but with the rays through the pixels already
+    /// found, such as with the batched RPCModel::point_and_dir() for a whole
+    /// tile. The rays for the NaN or invalid pixels are not used. Without
+    /// least squares refinement, the rays are intersected as in
+    /// vw::stereo::StereoModel, so the points and errors are the same.
+    vw::Vector3 triangulate_rays(std::vector<vw::Vector2> const& pixVec,
+                                 std::vector<vw::Vector3> const& ctrs,
+                                 std::vector<vw::Vector3> const& dirs,
+                                 vw::Vector3& errorVec) const;
+
+    /// Return the RPC models of the cameras, if all of them are RPC models
+    /// with no adjustments applied, and an empty vector otherwise.
+    std::vector<const RPCModel*> rpc_cameras() const;
   };
   
 } // namespace asp
@@ -28,6 +28,7 @@
 #include <asp/Rig/rig_config.h>
 
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Cartography/CameraBBox.h>
 #include <vw/Geometry/baseUtils.h>
 #include <vw/Cartography/CameraBBox.h>
@@ -1461,6 +1462,278 @@ public:
   }
 };
 
+// Data shared by all tiles when rendering a synthetic image with a z-buffer.
+// Each DEM grid point seen by the camera is projected once into the image.
+// The DEM cells are then binned by the image regions their projections
+// overlap, so that each tile needs to look only at the cells that
+// may be visible in it.
+struct ZBufferScene {
+  int num_cols, num_rows; // dimensions of the DEM crop
+  // Per DEM grid point: camera pixel, distance to the camera, and
+  // orthoimage pixel. NaN if the point is invalid.
+  std::vector<float> pix_x, pix_y, depth, ortho_x, ortho_y;
+  int bin_size, num_bin_cols, num_bin_rows;
+  std::vector<std::vector<int>> bins; // DEM cell indices, for each bin
+  vw::ImageView<vw::PixelMask<float>> crop_ortho;
+};
+
+// Project a range of DEM rows into the camera
+class ProjectDemRowsTask: public vw::Task, private boost::noncopyable {
+  vw::CamPtr m_cam;
+  vw::ImageView<vw::PixelMask<float>> const& m_dem;
+  vw::cartography::GeoReference m_dem_georef;   // make a copy to be thread-safe
+  vw::cartography::GeoReference m_ortho_georef; // make a copy to be thread-safe
+  int m_beg_row, m_end_row;
+  ZBufferScene & m_scene;
+
+public:
+  ProjectDemRowsTask(vw::CamPtr cam,
+                     vw::ImageView<vw::PixelMask<float>> const& dem,
+                     vw::cartography::GeoReference const& dem_georef,
+                     vw::cartography::GeoReference const& ortho_georef,
+                     int beg_row, int end_row, ZBufferScene & scene):
+    m_cam(cam), m_dem(dem), m_dem_georef(dem_georef), m_ortho_georef(ortho_georef),
+    m_beg_row(beg_row), m_end_row(end_row), m_scene(scene) {}
+
+  void operator()() {
+    float nan = std::numeric_limits<float>::quiet_NaN();
+    for (int row = m_beg_row; row < m_end_row; row++) {
+      for (int col = 0; col < m_dem.cols(); col++) {
+        int index = row * m_dem.cols() + col;
+        m_scene.pix_x[index] = nan;
+        if (!is_valid(m_dem(col, row)))
+          continue;
+
+        vw::Vector2 lonlat = m_dem_georef.pixel_to_lonlat(vw::Vector2(col, row));
+        vw::Vector3 llh(lonlat[0], lonlat[1], m_dem(col, row).child());
+        vw::Vector3 xyz = m_dem_georef.datum().geodetic_to_cartesian(llh);
+
+        vw::Vector2 pix;
+        try {
+          pix = m_cam->point_to_pixel(xyz);
+        } catch (...) {
+          continue;
+        }
+        if (std::isnan(pix[0]) || std::isnan(pix[1]))
+          continue;
+
+        vw::Vector2 ortho_pix = m_ortho_georef.lonlat_to_pixel(lonlat);
+        m_scene.pix_x[index]   = pix[0];
+        m_scene.pix_y[index]   = pix[1];
+        m_scene.depth[index]   = norm_2(xyz - m_cam->camera_center(pix));
+        m_scene.ortho_x[index] = ortho_pix[0];
+        m_scene.ortho_y[index] = ortho_pix[1];
+      }
+    }
+  }
+};
+
+// Project the DEM into the camera and bin the DEM cells by image region
+void buildZBufferScene(SatSimOptions const& opt,
+                       vw::CamPtr const& cam,
+                       vw::cartography::GeoReference const& dem_georef,
+                       vw::ImageViewRef<vw::PixelMask<float>> const& dem,
+                       vw::cartography::GeoReference const& ortho_georef,
+                       vw::ImageViewRef<vw::PixelMask<float>> const& ortho,
+                       ZBufferScene & scene) {
+
+  // Bring in memory the portions of the DEM and ortho seen by the camera. This
+  // is done once for the whole image, rather than for each tile.
+  vw::ImageView<vw::PixelMask<float>> crop_dem;
+  vw::cartography::GeoReference crop_dem_georef, crop_ortho_georef;
+  setupCroppedDemAndOrtho(opt.image_size, cam, dem, dem_georef, ortho, ortho_georef,
+                          opt.blur_sigma,
+                          // Outputs
+                          crop_dem, crop_dem_georef, scene.crop_ortho, crop_ortho_georef);
+
+  scene.num_cols = crop_dem.cols();
+  scene.num_rows = crop_dem.rows();
+  int num_pts = scene.num_cols * scene.num_rows;
+  scene.pix_x.resize(num_pts);
+  scene.pix_y.resize(num_pts);
+  scene.depth.resize(num_pts);
+  scene.ortho_x.resize(num_pts);
+  scene.ortho_y.resize(num_pts);
+
+  // Project the DEM grid points using multiple threads
+  int rows_per_task = 64;
+  vw::FifoWorkQueue queue(vw::vw_settings().default_num_threads());
+  for (int beg_row = 0; beg_row < scene.num_rows; beg_row += rows_per_task) {
+    int end_row = std::min(beg_row + rows_per_task, scene.num_rows);
+    boost::shared_ptr<ProjectDemRowsTask>
+      task(new ProjectDemRowsTask(cam, crop_dem, crop_dem_georef, crop_ortho_georef,
+                                  beg_row, end_row, scene));
+    queue.add_task(task);
+  }
+  queue.join_all();
+
+  // Bin each DEM cell by the image regions its projection overlaps. A cell
+  // that straddles several bins is added to each of them.
+  int num_img_cols = opt.image_size[0], num_img_rows = opt.image_size[1];
+  scene.bin_size     = 256;
+  scene.num_bin_cols = (num_img_cols + scene.bin_size - 1) / scene.bin_size;
+  scene.num_bin_rows = (num_img_rows + scene.bin_size - 1) / scene.bin_size;
+  scene.bins.clear();
+  scene.bins.resize(scene.num_bin_cols * scene.num_bin_rows);
+  for (int row = 0; row < scene.num_rows - 1; row++) {
+    for (int col = 0; col < scene.num_cols - 1; col++) {
+      int index = row * scene.num_cols + col;
+      int corners[4] = {index, index + 1, index + scene.num_cols,
+                        index + scene.num_cols + 1};
+      vw::BBox2 box;
+      bool valid = true;
+      for (int k = 0; k < 4; k++) {
+        if (std::isnan(scene.pix_x[corners[k]])) {
+          valid = false;
+          break;
+        }
+        box.grow(vw::Vector2(scene.pix_x[corners[k]], scene.pix_y[corners[k]]));
+      }
+      if (!valid)
+        continue;
+
+      // Only pixel centers inside the box can be rendered
+      int min_col = std::max(0, int(ceil(box.min().x())));
+      int min_row = std::max(0, int(ceil(box.min().y())));
+      int max_col = std::min(num_img_cols - 1, int(floor(box.max().x())));
+      int max_row = std::min(num_img_rows - 1, int(floor(box.max().y())));
+      if (min_col > max_col || min_row > max_row)
+        continue;
+
+      for (int by = min_row / scene.bin_size; by <= max_row / scene.bin_size; by++) {
+        for (int bx = min_col / scene.bin_size; bx <= max_col / scene.bin_size; bx++)
+          scene.bins[by * scene.num_bin_cols + bx].push_back(index);
+      }
+    }
+  }
+}
+
+// Rasterize a triangle with given DEM grid point indices into the z-buffer
+// for the given tile. Keep the ortho pixel of the closest surface.
+void drawZBufferTriangle(ZBufferScene const& scene, int i0, int i1, int i2,
+                         vw::BBox2i const& bbox,
+                         vw::ImageView<float> & zbuf,
+                         vw::ImageView<vw::Vector2f> & ortho_pix) {
+
+  double x0 = scene.pix_x[i0], y0 = scene.pix_y[i0];
+  double x1 = scene.pix_x[i1], y1 = scene.pix_y[i1];
+  double x2 = scene.pix_x[i2], y2 = scene.pix_y[i2];
+  double area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+  if (std::abs(area) < 1e-12)
+    return;
+
+  int min_col = std::max(bbox.min().x(), int(ceil(std::min(x0, std::min(x1, x2)))));
+  int min_row = std::max(bbox.min().y(), int(ceil(std::min(y0, std::min(y1, y2)))));
+  int max_col = std::min(bbox.max().x() - 1, int(floor(std::max(x0, std::max(x1, x2)))));
+  int max_row = std::min(bbox.max().y() - 1, int(floor(std::max(y0, std::max(y1, y2)))));
+
+  // A little tolerance so that pixels on shared edges are not missed
+  double eps = -1e-6;
+  for (int row = min_row; row <= max_row; row++) {
+    for (int col = min_col; col <= max_col; col++) {
+      // Barycentric coordinates
+      double w0 = ((x2 - x1) * (row - y1) - (y2 - y1) * (col - x1)) / area;
+      double w1 = ((x0 - x2) * (row - y2) - (y0 - y2) * (col - x2)) / area;
+      double w2 = 1.0 - w0 - w1;
+      if (w0 < eps || w1 < eps || w2 < eps)
+        continue;
+
+      // The triangles are small, so there is no need for perspective-correct
+      // interpolation
+      float z = w0 * scene.depth[i0] + w1 * scene.depth[i1] + w2 * scene.depth[i2];
+      int c = col - bbox.min().x(), r = row - bbox.min().y();
+      if (z >= zbuf(c, r))
+        continue;
+      zbuf(c, r) = z;
+      ortho_pix(c, r)
+        = vw::Vector2f(w0 * scene.ortho_x[i0] + w1 * scene.ortho_x[i1] + w2 * scene.ortho_x[i2],
+                       w0 * scene.ortho_y[i0] + w1 * scene.ortho_y[i1] + w2 * scene.ortho_y[i2]);
+    }
+  }
+}
+
+// Create a synthetic image with multiple threads, by projecting the DEM
+// triangles into the camera and keeping the closest surface at each pixel.
+// The DEM is projected into the camera once per image, in
+// buildZBufferScene(), rather than intersecting each pixel ray with the DEM.
+class ZBufferImageView: public vw::ImageViewBase<ZBufferImageView> {
+  typedef vw::PixelMask<float> PixelT;
+  SatSimOptions const& m_opt;
+  boost::shared_ptr<ZBufferScene> m_scene;
+
+public:
+  ZBufferImageView(SatSimOptions const& opt, boost::shared_ptr<ZBufferScene> scene):
+    m_opt(opt), m_scene(scene) {}
+
+  typedef PixelT pixel_type;
+  typedef PixelT result_type;
+  typedef vw::ProceduralPixelAccessor<ZBufferImageView> pixel_accessor;
+
+  inline vw::int32 cols() const { return m_opt.image_size[0]; }
+  inline vw::int32 rows() const { return m_opt.image_size[1]; }
+  inline vw::int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor(*this, 0, 0); }
+
+  inline pixel_type operator()( double/*i*/, double/*j*/, vw::int32/*p*/ = 0 ) const {
+    vw::vw_throw(vw::NoImplErr() 
+      << "ZBufferImageView::operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  typedef vw::CropView<vw::ImageView<pixel_type>> prerasterize_type;
+  inline prerasterize_type prerasterize(vw::BBox2i const& bbox) const {
+
+    ZBufferScene const& scene = *m_scene;
+    vw::ImageView<float> zbuf(bbox.width(), bbox.height());
+    vw::ImageView<vw::Vector2f> ortho_pix(bbox.width(), bbox.height());
+    vw::fill(zbuf, std::numeric_limits<float>::max());
+
+    // Draw the two triangles of each DEM cell in the bins overlapping this
+    // tile. A cell may be drawn more than once, which is harmless.
+    int beg_bx = bbox.min().x() / scene.bin_size;
+    int end_bx = std::min(scene.num_bin_cols - 1, (bbox.max().x() - 1) / scene.bin_size);
+    int beg_by = bbox.min().y() / scene.bin_size;
+    int end_by = std::min(scene.num_bin_rows - 1, (bbox.max().y() - 1) / scene.bin_size);
+    for (int by = beg_by; by <= end_by; by++) {
+      for (int bx = beg_bx; bx <= end_bx; bx++) {
+        std::vector<int> const& cells = scene.bins[by * scene.num_bin_cols + bx];
+        for (size_t k = 0; k < cells.size(); k++) {
+          int i00 = cells[k], i10 = i00 + 1;
+          int i01 = i00 + scene.num_cols, i11 = i01 + 1;
+          drawZBufferTriangle(scene, i00, i10, i11, bbox, zbuf, ortho_pix);
+          drawZBufferTriangle(scene, i00, i11, i01, bbox, zbuf, ortho_pix);
+        }
+      }
+    }
+
+    // Bicubic interpolation with invalid pixel edge extension
+    vw::PixelMask<float> nodata_mask = vw::PixelMask<float>(); // invalid value
+    nodata_mask.invalidate();
+    auto interp_ortho = vw::interpolate(scene.crop_ortho, vw::BicubicInterpolation(),
+                                        vw::ValueEdgeExtension<vw::PixelMask<float>>(nodata_mask));
+
+    vw::ImageView<result_type> tile(bbox.width(), bbox.height());
+    for (int r = 0; r < bbox.height(); r++) {
+      for (int c = 0; c < bbox.width(); c++) {
+        tile(c, r) = vw::PixelMask<float>();
+        tile(c, r).invalidate();
+        if (zbuf(c, r) == std::numeric_limits<float>::max())
+          continue; // no surface seen at this pixel
+        tile(c, r) = interp_ortho(ortho_pix(c, r)[0], ortho_pix(c, r)[1]);
+      }
+    }
+
+    return prerasterize_type(tile, -bbox.min().x(), -bbox.min().y(),
+                             cols(), rows());
+  }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, vw::BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
+  }
+};
+
 // Generate images by projecting rays from the sensor to the ground
 void genImages(SatSimOptions const& opt,
     bool external_cameras,
@@ -1499,15 +1772,29 @@ void genImages(SatSimOptions const& opt,
     vw::vw_out() << "Writing: " << image_names[i] << std::endl;
     bool has_georef = false; // the produced image is raw, it has no georef
     bool has_nodata = true;
-    SatSimOptions local_opt = opt;
-    local_opt.raster_tile_size = vw::Vector2i(512, 512);
-    block_write_gdal_image(image_names[i], 
-                           vw::apply_mask(SynImageView(opt, cams[i], dem_georef, dem, 
-                                                       height_guess, ortho_georef, 
-                                                       ortho, ortho_nodata_val), 
-                                          ortho_nodata_val),
-                           has_georef, ortho_georef, has_nodata, ortho_nodata_val, 
-                           local_opt, vw::TerminalProgressCallback("", "\t--> "));
+    vw::Stopwatch sw;
+    sw.start();
+    if (opt.render_method == "zbuffer") {
+      boost::shared_ptr<ZBufferScene> scene(new ZBufferScene);
+      buildZBufferScene(opt, cams[i], dem_georef, dem, ortho_georef, ortho, *scene);
+      block_write_gdal_image(image_names[i], 
+                             vw::apply_mask(ZBufferImageView(opt, scene), ortho_nodata_val),
+                             has_georef, ortho_georef, has_nodata, ortho_nodata_val, 
+                             opt, vw::TerminalProgressCallback("", "\t--> "));
+    } else {
+      SatSimOptions local_opt = opt;
+      local_opt.raster_tile_size = vw::Vector2i(512, 512);
+      block_write_gdal_image(image_names[i], 
+                             vw::apply_mask(SynImageView(opt, cams[i], dem_georef, dem, 
+                                                         height_guess, ortho_georef, 
+                                                         ortho, ortho_nodata_val), 
+                                            ortho_nodata_val),
+                             has_georef, ortho_georef, has_nodata, ortho_nodata_val, 
+                             local_opt, vw::TerminalProgressCallback("", "\t--> "));
+    }
+    sw.stop();
+    vw::vw_out(vw::DebugMessage, "asp") << "Image rendering time: " 
+                                        << sw.elapsed_seconds() << " s.\n";
   }  
 
   // Write the list of images only if we are not skipping the first camera
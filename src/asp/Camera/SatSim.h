@@ -52,7 +52,7 @@ struct SatSimOptions: vw::GdalWriteOptions {
   double roll, pitch, yaw, velocity, frame_rate, ref_time;
   std::vector<double> jitter_frequency, jitter_amplitude, jitter_phase, horizontal_uncertainty;
   std::string jitter_frequency_str, jitter_amplitude_str, jitter_phase_str, 
-    horizontal_uncertainty_str, rig_config, sensor_name;
+    horizontal_uncertainty_str, rig_config, sensor_name, render_method;
   bool no_images, save_ref_cams, non_square_pixels, save_as_csm, model_time;
   SatSimOptions() {}
 };
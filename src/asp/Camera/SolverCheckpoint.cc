@@ -0,0 +1,144 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file SolverCheckpoint.cc
+
+#include <asp/Camera/SolverCheckpoint.h>
+
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace fs = boost::filesystem;
+
+namespace asp {
+
+// The file starts with this string. Then come the pass, the parameter blocks,
+// the strings, and the outliers, each preceded by its length. All numbers are
+// 64-bit, in native byte order.
+const char CHECKPOINT_MAGIC[] = "ASPCHECKPOINT1";
+
+std::string checkpointFile(std::string const& out_prefix) {
+  return out_prefix + "-checkpoint.bin";
+}
+
+namespace {
+
+void writeInt(std::ofstream & ofs, std::int64_t val) {
+  ofs.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+std::int64_t readInt(std::ifstream & ifs, std::string const& file) {
+  std::int64_t val = 0;
+  ifs.read(reinterpret_cast<char*>(&val), sizeof(val));
+  if (!ifs.good() || val < 0)
+    vw::vw_throw(vw::IOErr() << "Invalid checkpoint file: " << file << "\n");
+  return val;
+}
+
+// Read the number of items which follow, each taking at least item_size
+// bytes. A number larger than what the rest of the file can hold is from a
+// corrupt file, so do not trust it for allocating memory.
+std::int64_t readCount(std::ifstream & ifs, std::int64_t file_size,
+                       std::int64_t item_size, std::string const& file) {
+  std::int64_t count = readInt(ifs, file);
+  std::int64_t remaining = file_size - std::int64_t(ifs.tellg());
+  if (remaining < 0 || count > remaining / item_size)
+    vw::vw_throw(vw::IOErr() << "Invalid checkpoint file: " << file << "\n");
+  return count;
+}
+
+} // end anonymous namespace
+
+void writeCheckpoint(std::string const& file, SolverCheckpoint const& cp) {
+
+  std::string tmp_file = file + ".tmp";
+  {
+    std::ofstream ofs(tmp_file.c_str(), std::ios::binary);
+    if (!ofs.good())
+      vw::vw_throw(vw::IOErr() << "Cannot write: " << tmp_file << "\n");
+
+    ofs.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeInt(ofs, cp.pass);
+
+    writeInt(ofs, cp.param_blocks.size());
+    for (size_t it = 0; it < cp.param_blocks.size(); it++) {
+      std::vector<double> const& block = cp.param_blocks[it];
+      writeInt(ofs, block.size());
+      ofs.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(double));
+    }
+
+    writeInt(ofs, cp.strings.size());
+    for (size_t it = 0; it < cp.strings.size(); it++) {
+      writeInt(ofs, cp.strings[it].size());
+      ofs.write(cp.strings[it].data(), cp.strings[it].size());
+    }
+
+    writeInt(ofs, cp.outliers.size());
+    for (auto const& outlier: cp.outliers)
+      writeInt(ofs, outlier);
+
+    if (!ofs.good())
+      vw::vw_throw(vw::IOErr() << "Failed writing: " << tmp_file << "\n");
+  }
+  fs::rename(tmp_file, file);
+
+  vw::vw_out() << "Wrote checkpoint: " << file << "\n";
+}
+
+void readCheckpoint(std::string const& file, SolverCheckpoint & cp) {
+
+  cp = SolverCheckpoint();
+  std::ifstream ifs(file.c_str(), std::ios::binary);
+  if (!ifs.good())
+    vw::vw_throw(vw::IOErr() << "Cannot read checkpoint: " << file << "\n");
+
+  std::int64_t file_size = fs::file_size(file);
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  ifs.read(magic, sizeof(magic));
+  if (!ifs.good() || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+    vw::vw_throw(vw::IOErr() << "Invalid checkpoint file: " << file << "\n");
+
+  cp.pass = readInt(ifs, file);
+
+  cp.param_blocks.resize(readCount(ifs, file_size, sizeof(std::int64_t), file));
+  for (size_t it = 0; it < cp.param_blocks.size(); it++) {
+    std::vector<double> & block = cp.param_blocks[it];
+    block.resize(readCount(ifs, file_size, sizeof(double), file));
+    ifs.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(double));
+  }
+
+  cp.strings.resize(readCount(ifs, file_size, sizeof(std::int64_t), file));
+  for (size_t it = 0; it < cp.strings.size(); it++) {
+    cp.strings[it].resize(readCount(ifs, file_size, 1, file));
+    ifs.read(&cp.strings[it][0], cp.strings[it].size());
+  }
+
+  std::int64_t num_outliers = readCount(ifs, file_size, sizeof(std::int64_t), file);
+  for (std::int64_t it = 0; it < num_outliers; it++)
+    cp.outliers.insert(readInt(ifs, file));
+
+  if (!ifs.good())
+    vw::vw_throw(vw::IOErr() << "Invalid checkpoint file: " << file << "\n");
+}
+
+} // end namespace asp
@@ -0,0 +1,76 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file SolverCheckpoint.h
+
+// Save the state of a long bundle_adjust or jitter_solve optimization
+// periodically, so that it can be resumed if the run is interrupted.
+
+#ifndef __ASP_CAMERA_SOLVER_CHECKPOINT_H__
+#define __ASP_CAMERA_SOLVER_CHECKPOINT_H__
+
+#include <ceres/ceres.h>
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace asp {
+
+/// The state of the optimization. The meaning of the parameter blocks and
+/// strings is up to the caller.
+struct SolverCheckpoint {
+  int pass; // the pass at which to resume
+  std::vector<std::vector<double>> param_blocks;
+  std::vector<std::string> strings;
+  std::set<int> outliers;
+  SolverCheckpoint(): pass(0) {}
+};
+
+/// The checkpoint file for the given output prefix
+std::string checkpointFile(std::string const& out_prefix);
+
+/// Write the checkpoint to a temporary file, then rename it, so an
+/// interruption while writing never leaves behind a corrupted checkpoint.
+void writeCheckpoint(std::string const& file, SolverCheckpoint const& cp);
+
+/// Read a checkpoint. Throw an exception if the file is not valid.
+void readCheckpoint(std::string const& file, SolverCheckpoint & cp);
+
+/// A Ceres callback that saves a checkpoint every given number of iterations.
+/// The state must be kept up-to-date during the optimization, so
+/// ceres::Solver::Options::update_state_every_iteration must be set.
+class CheckpointCallback: public ceres::IterationCallback {
+public:
+  CheckpointCallback(int interval, std::function<void()> save_checkpoint):
+    m_interval(interval), m_save_checkpoint(save_checkpoint) {}
+
+  virtual ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) {
+    if (m_interval > 0 && summary.iteration > 0 && summary.iteration % m_interval == 0)
+      m_save_checkpoint();
+    return ceres::SOLVER_CONTINUE;
+  }
+
+private:
+  int m_interval;
+  std::function<void()> m_save_checkpoint;
+};
+
+} // end namespace asp
+
+#endif // __ASP_CAMERA_SOLVER_CHECKPOINT_H__
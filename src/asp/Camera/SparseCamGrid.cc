@@ -0,0 +1,280 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file SparseCamGrid.cc
+
+#include <asp/Camera/SparseCamGrid.h>
+
+#include <vw/Camera/CameraModel.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/Algorithms.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace asp {
+
+using namespace vw;
+
+// Samples along the tile edges when finding the DEM pixels under the tile,
+// and the extra DEM pixels around the tile and around each cell. The latter
+// account for the bilinear interpolation footprint and for the mapping
+// between the georeferences not being linear over a cell.
+const int COVERAGE_EDGE_STEP = 16;
+const int COVERAGE_TILE_MARGIN = 4;
+const int COVERAGE_CELL_MARGIN = 2;
+
+// Do not keep track of more DEM pixels than this for a tile. This can happen
+// only if the DEM is much finer than the output. Then the coverage is not
+// known, and all pixels are projected exactly.
+const long long COVERAGE_MAX_PIXELS = 64 * 1024 * 1024;
+
+DemCoverage::DemCoverage(ImageViewRef<PixelMask<float>> const& dem,
+                         cartography::GeoReference const& dem_georef,
+                         cartography::GeoReference const& image_georef,
+                         BBox2i const& tile):
+  m_dem_georef(dem_georef), m_image_georef(image_georef), m_tile(tile) {
+
+  // The DEM pixels under the tile. Sample the tile edges, as the mapping
+  // between the georeferences need not be linear.
+  BBox2 box;
+  try {
+    for (int i = 0; i <= 1; i++) {
+      for (int t = 0; ; t += COVERAGE_EDGE_STEP) {
+        int tc = std::min(t, tile.width()), tr = std::min(t, tile.height());
+        Vector2 pts[] = {Vector2(tile.min().x() + tc, tile.min().y() + i * tile.height()),
+                         Vector2(tile.min().x() + i * tile.width(), tile.min().y() + tr)};
+        for (int k = 0; k < 2; k++)
+          box.grow(m_dem_georef.lonlat_to_pixel(m_image_georef.pixel_to_lonlat(pts[k])));
+        if (tc >= tile.width() && tr >= tile.height())
+          break;
+      }
+    }
+  } catch (...) {
+    return; // The coverage is not known
+  }
+  if (box.empty() || !std::isfinite(box.min().x()) || !std::isfinite(box.min().y()) ||
+      !std::isfinite(box.max().x()) || !std::isfinite(box.max().y()))
+    return;
+
+  m_dem_box = BBox2i(Vector2i(floor(box.min().x()) - COVERAGE_TILE_MARGIN,
+                              floor(box.min().y()) - COVERAGE_TILE_MARGIN),
+                     Vector2i(floor(box.max().x()) + COVERAGE_TILE_MARGIN + 1,
+                              floor(box.max().y()) + COVERAGE_TILE_MARGIN + 1));
+  long long cols = m_dem_box.width(), rows = m_dem_box.height();
+  if (cols * rows > COVERAGE_MAX_PIXELS) {
+    m_dem_box = BBox2i();
+    return;
+  }
+
+  // Read the DEM pixels under the tile. The ones outside the DEM have no data.
+  ImageView<char> valid(cols, rows);
+  fill(valid, 0);
+  BBox2i inner_box = m_dem_box;
+  inner_box.crop(bounding_box(dem));
+  if (!inner_box.empty()) {
+    ImageView<PixelMask<float>> dem_crop = crop(dem, inner_box);
+    for (int row = 0; row < dem_crop.rows(); row++) {
+      for (int col = 0; col < dem_crop.cols(); col++) {
+        PixelMask<float> const& h = dem_crop(col, row);
+        if (is_valid(h) && !std::isnan(h.child()))
+          valid(col + inner_box.min().x() - m_dem_box.min().x(),
+                row + inner_box.min().y() - m_dem_box.min().y()) = 1;
+      }
+    }
+  }
+
+  m_sum.assign((cols + 1) * (rows + 1), 0);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++)
+      m_sum[(row + 1) * (cols + 1) + col + 1]
+        = valid(col, row) + m_sum[row * (cols + 1) + col + 1]
+        + m_sum[(row + 1) * (cols + 1) + col] - m_sum[row * (cols + 1) + col];
+  }
+}
+
+void DemCoverage::count(int c0, int r0, int c1, int r1, long long & num_valid,
+                        long long & num_total) const {
+
+  num_valid = -1;
+  num_total = -1;
+  if (m_sum.empty())
+    return;
+
+  BBox2 box;
+  try {
+    int cs[] = {c0, c1}, rs[] = {r0, r1};
+    for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < 2; j++) {
+        Vector2 pix(cs[i] + m_tile.min().x(), rs[j] + m_tile.min().y());
+        box.grow(m_dem_georef.lonlat_to_pixel(m_image_georef.pixel_to_lonlat(pix)));
+      }
+    }
+  } catch (...) {
+    return;
+  }
+  if (!std::isfinite(box.min().x()) || !std::isfinite(box.min().y()) ||
+      !std::isfinite(box.max().x()) || !std::isfinite(box.max().y()))
+    return;
+
+  // The DEM pixels used by bilinear interpolation, with a margin
+  BBox2i dem_box(Vector2i(floor(box.min().x()) - COVERAGE_CELL_MARGIN + 1,
+                          floor(box.min().y()) - COVERAGE_CELL_MARGIN + 1),
+                 Vector2i(floor(box.max().x()) + COVERAGE_CELL_MARGIN + 1,
+                          floor(box.max().y()) + COVERAGE_CELL_MARGIN + 1));
+  if (!m_dem_box.contains(dem_box))
+    return;
+
+  dem_box -= m_dem_box.min();
+  int w = m_dem_box.width() + 1;
+  int x0 = dem_box.min().x(), y0 = dem_box.min().y();
+  int x1 = dem_box.max().x(), y1 = dem_box.max().y();
+  num_valid = m_sum[y1 * w + x1] - m_sum[y0 * w + x1] - m_sum[y1 * w + x0]
+    + m_sum[y0 * w + x0];
+  num_total = (long long)dem_box.width() * dem_box.height();
+}
+
+bool DemCoverage::allValid(int c0, int r0, int c1, int r1) const {
+  long long num_valid = 0, num_total = 0;
+  count(c0, r0, c1, r1, num_valid, num_total);
+  return num_total > 0 && num_valid == num_total;
+}
+
+bool DemCoverage::noneValid(int c0, int r0, int c1, int r1) const {
+  long long num_valid = 0, num_total = 0;
+  count(c0, r0, c1, r1, num_valid, num_total);
+  return num_total > 0 && num_valid == 0;
+}
+
+// Bilinear interpolation in the cell with corners (c0, r0) and (c1, r1)
+static Vector2 interp(int c0, int r0, int c1, int r1,
+                      Vector2 const& p00, Vector2 const& p10,
+                      Vector2 const& p01, Vector2 const& p11, int c, int r) {
+  double nx = (c1 > c0) ? double(c - c0) / (c1 - c0) : 0.0;
+  double ny = (r1 > r0) ? double(r - r0) / (r1 - r0) : 0.0;
+  return (1.0 - ny) * ((1.0 - nx) * p00 + nx * p10) + ny * ((1.0 - nx) * p01 + nx * p11);
+}
+
+SparseCamGrid::SparseCamGrid(vw::Transform const& trans, BBox2i const& bbox, double tol,
+                             DemCoverage const* coverage, std::vector<Vector2> & cam_pix):
+  num_exact(0), m_trans(trans), m_bbox(bbox), m_tol(tol), m_coverage(coverage),
+  m_cam_pix(cam_pix), m_exact(bbox.width() * bbox.height(), 0) {}
+
+// Start with cells of a modest size, so that the check points sample the
+// tile densely enough.
+void SparseCamGrid::compute() {
+  int max_cell = 64;
+  int cols = m_bbox.width(), rows = m_bbox.height();
+  for (int r0 = 0; ; r0 += max_cell) {
+    int r1 = std::min(r0 + max_cell, rows - 1);
+    for (int c0 = 0; ; c0 += max_cell) {
+      int c1 = std::min(c0 + max_cell, cols - 1);
+      fillCell(c0, r0, c1, r1);
+      if (c1 >= cols - 1)
+        break;
+    }
+    if (r1 >= rows - 1)
+      break;
+  }
+}
+
+bool SparseCamGrid::isValid(Vector2 const& p) {
+  return std::isfinite(p[0]) && std::isfinite(p[1]) &&
+    p != vw::camera::CameraModel::invalid_pixel();
+}
+
+// Project exactly, unless done already
+Vector2 const& SparseCamGrid::exact(int col, int row) {
+  int k = row * m_bbox.width() + col;
+  if (!m_exact[k]) {
+    m_cam_pix[k] = m_trans.reverse(Vector2(col + m_bbox.min().x(),
+                                           row + m_bbox.min().y()));
+    m_exact[k] = 1;
+    num_exact++;
+  }
+  return m_cam_pix[k];
+}
+
+// Handle the cell with corners (c0, r0) and (c1, r1), inclusive
+void SparseCamGrid::fillCell(int c0, int r0, int c1, int r1) {
+
+  // Small cells are projected exactly
+  if (c1 - c0 <= 1 && r1 - r0 <= 1) {
+    for (int r = r0; r <= r1; r++)
+      for (int c = c0; c <= c1; c++)
+        exact(c, r);
+    return;
+  }
+
+  if (m_coverage != NULL) {
+    // With no DEM data the transform fails everywhere in the cell
+    if (m_coverage->noneValid(c0, r0, c1, r1)) {
+      for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+          if (!m_exact[r * m_bbox.width() + c])
+            pix(c, r) = vw::camera::CameraModel::invalid_pixel();
+        }
+      }
+      return;
+    }
+    // With partial DEM data, the transform may fail in between the check points
+    if (!m_coverage->allValid(c0, r0, c1, r1)) {
+      splitCell(c0, r0, c1, r1);
+      return;
+    }
+  }
+
+  Vector2 p00 = exact(c0, r0), p10 = exact(c1, r0);
+  Vector2 p01 = exact(c0, r1), p11 = exact(c1, r1);
+  int cm = (c0 + c1) / 2, rm = (r0 + r1) / 2;
+
+  bool good = isValid(p00) && isValid(p10) && isValid(p01) && isValid(p11);
+  int check_c[] = {cm, cm, cm, c0, c1};
+  int check_r[] = {rm, r0, r1, rm, rm};
+  for (int i = 0; i < 5 && good; i++) {
+    Vector2 p = exact(check_c[i], check_r[i]);
+    if (!isValid(p) || norm_2(p - interp(c0, r0, c1, r1, p00, p10, p01, p11,
+                                         check_c[i], check_r[i])) > m_tol)
+      good = false;
+  }
+
+  if (!good) {
+    splitCell(c0, r0, c1, r1);
+    return;
+  }
+
+  for (int r = r0; r <= r1; r++) {
+    for (int c = c0; c <= c1; c++) {
+      if (!m_exact[r * m_bbox.width() + c])
+        pix(c, r) = interp(c0, r0, c1, r1, p00, p10, p01, p11, c, r);
+    }
+  }
+}
+
+// Split in four, or in two if the cell is thin
+void SparseCamGrid::splitCell(int c0, int r0, int c1, int r1) {
+  int cm = (c0 + c1) / 2, rm = (r0 + r1) / 2;
+  std::vector<int> cs, rs;
+  cs.push_back(c0); if (c1 - c0 >= 2) cs.push_back(cm); cs.push_back(c1);
+  rs.push_back(r0); if (r1 - r0 >= 2) rs.push_back(rm); rs.push_back(r1);
+  for (size_t j = 0; j + 1 < rs.size(); j++)
+    for (size_t i = 0; i + 1 < cs.size(); i++)
+      fillCell(cs[i], rs[j], cs[i + 1], rs[j + 1]);
+}
+
+} // end namespace asp
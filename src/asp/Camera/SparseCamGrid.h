@@ -0,0 +1,112 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file SparseCamGrid.h
+
+// Find the camera pixel for each pixel of a mapprojected tile by projecting
+// exactly only on a sparse grid and interpolating bilinearly in between.
+
+#ifndef __ASP_CAMERA_SPARSE_CAM_GRID_H__
+#define __ASP_CAMERA_SPARSE_CAM_GRID_H__
+
+#include <vw/Math/BBox.h>
+#include <vw/Math/Vector.h>
+#include <vw/Image/ImageViewRef.h>
+#include <vw/Image/PixelMask.h>
+#include <vw/Image/Transform.h>
+#include <vw/Cartography/GeoReference.h>
+
+#include <vector>
+
+namespace asp {
+
+/// Which parts of a mapprojected tile have DEM data under them. The DEM
+/// pixels under the tile are counted in a summed-area table, so any cell of
+/// the tile can be checked in constant time. The DEM is interpolated
+/// bilinearly, so a cell is covered if all the DEM pixels around it have
+/// data. Pixels outside the DEM have no data.
+class DemCoverage {
+public:
+  DemCoverage(vw::ImageViewRef<vw::PixelMask<float>> const& dem,
+              vw::cartography::GeoReference const& dem_georef,
+              vw::cartography::GeoReference const& image_georef,
+              vw::BBox2i const& tile);
+
+  /// If all the DEM pixels under the cell with the given corners, inclusive,
+  /// have data. The corners are relative to the tile origin.
+  bool allValid(int c0, int r0, int c1, int r1) const;
+
+  /// If none of the DEM pixels under the cell have data
+  bool noneValid(int c0, int r0, int c1, int r1) const;
+
+private:
+  // The number of DEM pixels with data under the cell, and the number of DEM
+  // pixels it covers. Both are -1 if not known.
+  void count(int c0, int r0, int c1, int r1, long long & num_valid,
+             long long & num_total) const;
+
+  vw::cartography::GeoReference m_dem_georef, m_image_georef;
+  vw::BBox2i m_tile, m_dem_box;
+  std::vector<long long> m_sum; // summed-area table of valid DEM pixels
+};
+
+/// Find the camera pixel for each output pixel in a tile by projecting exactly
+/// only on a sparse grid and interpolating bilinearly in between. Each grid
+/// cell is validated by projecting exactly at its center and edge midpoints.
+/// For a mapping with bounded second derivatives, which is the case for smooth
+/// terrain, the bilinear interpolation error is largest at those points, so if
+/// the error there is under the tolerance, the cell is accepted. Otherwise the
+/// cell is split in four, and the check points become corners of the new cells,
+/// so no exact projection is wasted.
+///
+/// The transform returns an invalid pixel where the DEM has no data, and a
+/// small hole in the DEM can be missed by the check points. If the DEM
+/// coverage is given, a cell is interpolated only if the DEM has data all
+/// under it. Cells with no DEM data are invalid. The rest are split, down to
+/// single pixels, which are projected exactly.
+class SparseCamGrid {
+public:
+  long long num_exact;
+
+  SparseCamGrid(vw::Transform const& trans, vw::BBox2i const& bbox, double tol,
+                DemCoverage const* coverage, std::vector<vw::Vector2> & cam_pix);
+
+  /// Fill in all the camera pixels
+  void compute();
+
+  /// If a camera pixel is valid. The transform returns an invalid pixel, not
+  /// NaN, where it fails.
+  static bool isValid(vw::Vector2 const& p);
+
+private:
+
+  vw::Vector2 & pix(int col, int row) { return m_cam_pix[row * m_bbox.width() + col]; }
+  vw::Vector2 const& exact(int col, int row);
+  void fillCell(int c0, int r0, int c1, int r1);
+  void splitCell(int c0, int r0, int c1, int r1);
+
+  vw::Transform const& m_trans;
+  vw::BBox2i m_bbox;
+  double m_tol;
+  DemCoverage const* m_coverage;
+  std::vector<vw::Vector2> & m_cam_pix;
+  std::vector<char> m_exact; // which pixels were projected exactly
+};
+
+} // end namespace asp
+
+#endif // __ASP_CAMERA_SPARSE_CAM_GRID_H__
@@ -17,6 +17,8 @@
 
 
 #include <asp/Camera/LinescanDGModel.h>
+#include <asp/Camera/Covariance.h>
+#include <asp/Core/StereoSettings.h>
 #include <asp/Camera/RPC_XML.h>
 #include <asp/Camera/XMLBase.h>
 #include <asp/Camera/RPCModel.h>
@@ -161,3 +163,41 @@ TEST(DGCameraModel, CreateCamera) {
   XMLPlatformUtils::Terminate();
 }
 
+TEST(DGCameraModel, ErrorPropagation) {
+
+  xercesc::XMLPlatformUtils::Initialize();
+
+  // The perturbed cameras are created only if errors are propagated
+  asp::stereo_settings().propagate_errors = true;
+  vw::CamPtr cam1 = load_dg_camera_model_from_xml("dg_example1.xml");
+  vw::CamPtr cam2 = load_dg_camera_model_from_xml("dg_example2.xml");
+  asp::stereo_settings().propagate_errors = false;
+  vw::cartography::Datum datum("WGS84");
+
+  // Pixel pairs on tabulated lines and in between
+  Vector2 m1(2*13864, 2*5351), m2(2*15045, 2*5183);
+  std::vector<double> line_shifts = {0.0, 6.0, 3.25, 2000.5};
+  for (size_t it = 0; it < line_shifts.size(); it++) {
+    Vector2 pix1 = m1 + Vector2(0, line_shifts[it]);
+    Vector2 pix2 = m2 + Vector2(0, line_shifts[it]);
+
+    stereo::StereoModel sm(cam1.get(), cam2.get());
+    double error;
+    Vector3 tri = sm(pix1, pix2, error);
+
+    // The analytic method must agree with evaluating perturbed cameras
+    asp::stereo_settings().propagate_errors_method = "numerical";
+    Vector2 numerical = asp::propagateCovariance(tri, datum, 0, 0,
+                                                 cam1.get(), cam2.get(), pix1, pix2);
+    asp::stereo_settings().propagate_errors_method = "analytic";
+    Vector2 analytic = asp::propagateCovariance(tri, datum, 0, 0,
+                                                cam1.get(), cam2.get(), pix1, pix2);
+
+    EXPECT_GT(numerical[0], 0.0);
+    EXPECT_GT(numerical[1], 0.0);
+    EXPECT_NEAR(analytic[0], numerical[0], 1e-3 * numerical[0]);
+    EXPECT_NEAR(analytic[1], numerical[1], 1e-3 * numerical[1]);
+  }
+
+  XMLPlatformUtils::Terminate();
+}
@@ -216,6 +216,126 @@ TEST( StereoSessionRPC, CheckStereo ) {
 
 
 
+// The batched functions must agree with the ones for a single point
+TEST( RPCModel, Batch ) {
+  xercesc::XMLPlatformUtils::Initialize();
+
+  RPCXML xml;
+  xml.read_from_file( "dg_example1.xml" );
+  RPCModel model( *xml.rpc_ptr() );
+
+  // An odd number of points, so that not all go through SIMD code
+  const int num = 23;
+  std::vector<double> lon(num), lat(num), height(num), pix_x(num), pix_y(num);
+  std::vector<double> jac(6 * num), jac_x(num), jac_y(num);
+  for (int i = 0; i < num; i++) {
+    lon[i]    = -105.29 + 0.005 * (i % 5);
+    lat[i]    =   39.745 - 0.004 * (i % 7);
+    height[i] = 2281.0 + 20.0 * i;
+  }
+  model.geodetic_to_pixel(num, &lon[0], &lat[0], &height[0], &pix_x[0], &pix_y[0]);
+  model.geodetic_to_pixel_Jacobian(num, &lon[0], &lat[0], &height[0],
+                                   &jac_x[0], &jac_y[0], &jac[0]);
+  for (int i = 0; i < num; i++) {
+    Vector3 llh(lon[i], lat[i], height[i]);
+    Vector2 pix = model.geodetic_to_pixel(llh);
+    EXPECT_VECTOR_NEAR( pix, Vector2(pix_x[i], pix_y[i]), 1e-8 );
+    EXPECT_VECTOR_NEAR( pix, Vector2(jac_x[i], jac_y[i]), 1e-8 );
+    Matrix<double, 2, 3> J = model.geodetic_to_pixel_Jacobian(llh);
+    for (int r = 0; r < 2; r++) {
+      for (int c = 0; c < 3; c++)
+        EXPECT_NEAR( J(r, c), jac[(3 * r + c) * num + i], 1e-8 * max(abs(J)) );
+    }
+  }
+
+  // Go back to the ground, and find the rays
+  std::vector<double> lon2(num, 0.0), lat2(num, 0.0);
+  model.image_to_ground(num, &pix_x[0], &pix_y[0], &height[0], &lon2[0], &lat2[0]);
+  std::vector<Vector3> P(num), dir(num);
+  model.point_and_dir(num, &pix_x[0], &pix_y[0], &P[0], &dir[0]);
+  for (int i = 0; i < num; i++) {
+    Vector2 pix(pix_x[i], pix_y[i]);
+    Vector2 lonlat = model.image_to_ground(pix, height[i]);
+    EXPECT_VECTOR_NEAR( lonlat, Vector2(lon2[i], lat2[i]), 1e-10 );
+    EXPECT_VECTOR_NEAR( lonlat, Vector2(lon[i], lat[i]), 1e-8 );
+    Vector3 P1, dir1;
+    model.point_and_dir(pix, P1, dir1);
+    EXPECT_VECTOR_NEAR( P1, P[i], 1e-3 );
+    EXPECT_VECTOR_NEAR( dir1, dir[i], 1e-10 );
+  }
+
+  // Rays found in advance give the same triangulated point
+  RPCStereoModel stereo_model(&model, &model);
+  EXPECT_EQ( stereo_model.rpc_cameras().size(), 2u );
+  std::vector<Vector2> pixVec(2, Vector2(pix_x[0], pix_y[0]));
+  pixVec[1] += Vector2(3.0, 0.0);
+  std::vector<Vector3> ctrs(2), dirs(2);
+  model.point_and_dir(pixVec[0], ctrs[0], dirs[0]);
+  model.point_and_dir(pixVec[1], ctrs[1], dirs[1]);
+  Vector3 err1, err2;
+  Vector3 xyz1 = stereo_model(pixVec, err1);
+  Vector3 xyz2 = stereo_model.triangulate_rays(pixVec, ctrs, dirs, err2);
+  EXPECT_VECTOR_NEAR( xyz1, xyz2, 1e-8 );
+  EXPECT_VECTOR_NEAR( err1, err2, 1e-8 );
+
+  xercesc::XMLPlatformUtils::Terminate();
+}
+
+// Triangulation in stereo_tri with the batched rays must agree with the
+// VW stereo model, which it used before, in the points and in the
+// intersection error.
+TEST( RPCStereoModel, BatchTriangulation ) {
+  xercesc::XMLPlatformUtils::Initialize();
+
+  boost::shared_ptr<CameraModel> cam1 = load_rpc_camera_model("wv_mvp_1.xml");
+  boost::shared_ptr<CameraModel> cam2 = load_rpc_camera_model("wv_mvp_2.xml");
+  RPCModel const* rpc1 = dynamic_cast<RPCModel const*>(cam1.get());
+  RPCModel const* rpc2 = dynamic_cast<RPCModel const*>(cam2.get());
+  ASSERT_TRUE( rpc1 != NULL && rpc2 != NULL );
+
+  vw::stereo::StereoModel plainStereoModel(cam1.get(), cam2.get());
+  asp::RPCStereoModel     rpcStereoModel  (cam1.get(), cam2.get());
+  ASSERT_EQ( rpcStereoModel.rpc_cameras().size(), 2u );
+
+  // Matching pixels, from ground points over the scene. Perturb the right
+  // ones so that the rays do not meet exactly.
+  Vector3 offset = rpc1->lonlatheight_offset(), scale = rpc1->lonlatheight_scale();
+  const int num = 25;
+  std::vector<double> x1(num), y1(num), x2(num), y2(num);
+  for (int i = 0; i < num; i++) {
+    Vector3 llh = offset + elem_prod(Vector3(0.15 * (i % 5 - 2), 0.15 * (i / 5 - 2),
+                                             0.1 * (i % 3 - 1)), scale);
+    Vector2 pix1 = rpc1->geodetic_to_pixel(llh);
+    Vector2 pix2 = rpc2->geodetic_to_pixel(llh) + Vector2(0.3 * (i % 4), -0.2 * (i % 3));
+    x1[i] = pix1[0]; y1[i] = pix1[1];
+    x2[i] = pix2[0]; y2[i] = pix2[1];
+  }
+
+  std::vector<Vector3> P1(num), D1(num), P2(num), D2(num);
+  rpc1->point_and_dir(num, &x1[0], &y1[0], &P1[0], &D1[0]);
+  rpc2->point_and_dir(num, &x2[0], &y2[0], &P2[0], &D2[0]);
+
+  for (int i = 0; i < num; i++) {
+    std::vector<Vector2> pixVec(2);
+    pixVec[0] = Vector2(x1[i], y1[i]);
+    pixVec[1] = Vector2(x2[i], y2[i]);
+    std::vector<Vector3> ctrs(2), dirs(2);
+    ctrs[0] = P1[i]; dirs[0] = D1[i];
+    ctrs[1] = P2[i]; dirs[1] = D2[i];
+
+    Vector3 errPlain, errBatch;
+    Vector3 xyzPlain = plainStereoModel(pixVec, errPlain);
+    Vector3 xyzBatch = rpcStereoModel.triangulate_rays(pixVec, ctrs, dirs, errBatch);
+
+    EXPECT_GT( norm_2(xyzPlain), 0.0 );
+    EXPECT_VECTOR_NEAR( xyzPlain, xyzBatch, 1e-3 );
+    EXPECT_VECTOR_NEAR( errPlain, errBatch, 1e-3 );
+    EXPECT_NEAR( norm_2(errPlain), norm_2(errBatch), 1e-3 );
+  }
+
+  xercesc::XMLPlatformUtils::Terminate();
+}
+
 /// Make sure that the AdjustedCameraModel class handles cropping with RPC models
 TEST( StereoSessionRPC, CheckRpcCrop ) {
 
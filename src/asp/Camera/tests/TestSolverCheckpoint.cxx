@@ -0,0 +1,98 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Camera/SolverCheckpoint.h>
+
+#include <vw/Core/Exception.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+
+using namespace vw;
+using namespace vw::test;
+
+TEST(SolverCheckpoint, WriteRead) {
+
+  asp::SolverCheckpoint cp;
+  cp.pass = 3;
+  cp.param_blocks.push_back(std::vector<double>{1.5, -2.25, 1e-300, 7.0});
+  cp.param_blocks.push_back(std::vector<double>()); // empty blocks must survive
+  cp.param_blocks.push_back(std::vector<double>{42.0});
+  cp.strings.push_back("first state");
+  cp.strings.push_back(std::string("with\0null", 9));
+  cp.strings.push_back("");
+  cp.outliers = {0, 5, 17};
+
+  UnlinkName file("checkpoint.bin");
+  asp::writeCheckpoint(file, cp);
+  EXPECT_FALSE(boost::filesystem::exists(file + ".tmp"));
+
+  asp::SolverCheckpoint cp2;
+  cp2.pass = -1;
+  cp2.outliers.insert(100); // must be cleared on reading
+  asp::readCheckpoint(file, cp2);
+
+  EXPECT_EQ(cp2.pass, cp.pass);
+  EXPECT_EQ(cp2.param_blocks, cp.param_blocks);
+  EXPECT_EQ(cp2.strings, cp.strings);
+  EXPECT_EQ(cp2.outliers, cp.outliers);
+}
+
+TEST(SolverCheckpoint, InvalidFile) {
+
+  asp::SolverCheckpoint cp;
+  cp.pass = 1;
+  cp.param_blocks.push_back(std::vector<double>(10, 1.0));
+  cp.strings.push_back("state");
+
+  UnlinkName file("checkpoint_invalid.bin");
+  asp::writeCheckpoint(file, cp);
+
+  // Truncate it
+  boost::filesystem::resize_file(file.c_str(), boost::filesystem::file_size(file.c_str()) - 5);
+  asp::SolverCheckpoint cp2;
+  EXPECT_THROW(asp::readCheckpoint(file, cp2), vw::IOErr);
+
+  // Not a checkpoint
+  {
+    std::ofstream ofs(file.c_str());
+    ofs << "not a checkpoint file\n";
+  }
+  EXPECT_THROW(asp::readCheckpoint(file, cp2), vw::IOErr);
+
+  // Huge counts must give an error, rather than be used to allocate memory.
+  // They are the number of blocks, the size of the first block, and the
+  // number of strings. They follow the magic string and the pass.
+  std::int64_t magic_len = sizeof("ASPCHECKPOINT1");
+  std::int64_t num_pos[] = {magic_len + 8, magic_len + 16, magic_len + 24 + 10 * 8};
+  for (std::int64_t pos: num_pos) {
+    asp::writeCheckpoint(file, cp);
+    std::fstream fh(file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    fh.seekp(pos);
+    std::int64_t big = std::numeric_limits<std::int64_t>::max() / 2;
+    fh.write(reinterpret_cast<const char*>(&big), sizeof(big));
+    fh.close();
+    EXPECT_THROW(asp::readCheckpoint(file, cp2), vw::IOErr) << "position " << pos;
+  }
+
+  UnlinkName missing("checkpoint_missing.bin");
+  EXPECT_THROW(asp::readCheckpoint(missing, cp2), vw::IOErr);
+}
@@ -0,0 +1,123 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Camera/SparseCamGrid.h>
+
+#include <vw/Camera/CameraModel.h>
+#include <vw/Cartography/Datum.h>
+#include <vw/Cartography/GeoReference.h>
+#include <vw/Image/ImageView.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace vw;
+
+namespace {
+
+// A DEM with a smooth surface and a small hole
+ImageView<PixelMask<float>> makeDem(int cols, int rows, BBox2i const& hole) {
+  ImageView<PixelMask<float>> dem(cols, rows);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      if (!hole.contains(Vector2i(col, row)))
+        dem(col, row) = PixelMask<float>(20.0 * sin(col / 40.0) * cos(row / 50.0));
+    }
+  }
+  return dem;
+}
+
+// Mimic the mapprojection transform. The output pixels are the DEM pixels.
+// The height is interpolated bilinearly, and it is invalid if any DEM pixel
+// used for that has no data. Then an invalid pixel is returned.
+class DemTrans: public vw::Transform {
+  ImageView<PixelMask<float>> const& m_dem;
+public:
+  DemTrans(ImageView<PixelMask<float>> const& dem): m_dem(dem) {}
+
+  virtual Vector2 reverse(Vector2 const& p) const {
+    int x = floor(p[0]), y = floor(p[1]);
+    if (x < 0 || y < 0 || x + 1 >= m_dem.cols() || y + 1 >= m_dem.rows())
+      return vw::camera::CameraModel::invalid_pixel();
+    double h = 0.0, dx = p[0] - x, dy = p[1] - y;
+    for (int j = 0; j <= 1; j++) {
+      for (int i = 0; i <= 1; i++) {
+        if (!is_valid(m_dem(x + i, y + j)))
+          return vw::camera::CameraModel::invalid_pixel();
+        h += (i ? dx : 1.0 - dx) * (j ? dy : 1.0 - dy) * m_dem(x + i, y + j).child();
+      }
+    }
+    return Vector2(1.3 * p[0] + 0.2 * p[1] + 0.05 * h + 1e-5 * p[0] * p[0],
+                   0.9 * p[1] - 0.1 * p[0] + 0.03 * h);
+  }
+
+  virtual Vector2 forward(Vector2 const& p) const {
+    vw_throw(NoImplErr() << "DemTrans::forward() is not implemented.\n");
+    return Vector2();
+  }
+};
+
+} // end anonymous namespace
+
+// The hole is inside a grid cell and away from its check points, so only
+// the DEM coverage can find it.
+TEST(SparseCamGrid, DemWithHole) {
+
+  int cols = 160, rows = 130;
+  BBox2i hole(70, 45, 2, 2);
+  ImageView<PixelMask<float>> dem = makeDem(cols, rows, hole);
+  DemTrans trans(dem);
+
+  cartography::GeoReference georef;
+  georef.set_datum(cartography::Datum("WGS84"));
+  georef.set_geographic();
+  Matrix3x3 T;
+  T(0, 0) = 1e-4;  T(0, 2) = -122.0;
+  T(1, 1) = -1e-4; T(1, 2) = 37.0;
+  T(2, 2) = 1.0;
+  georef.set_transform(T);
+
+  BBox2i tile(0, 0, cols, rows);
+  asp::DemCoverage coverage(dem, georef, georef, tile);
+  double tol = 0.05;
+  std::vector<Vector2> cam_pix(cols * rows);
+  asp::SparseCamGrid grid(trans, tile, tol, &coverage, cam_pix);
+  grid.compute();
+
+  int num_invalid = 0;
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      Vector2 exact = trans.reverse(Vector2(col, row));
+      Vector2 approx = cam_pix[row * cols + col];
+      bool valid = asp::SparseCamGrid::isValid(exact);
+      ASSERT_EQ(valid, asp::SparseCamGrid::isValid(approx))
+        << "at pixel " << col << ' ' << row;
+      if (valid)
+        EXPECT_LT(norm_2(exact - approx), 4 * tol) << "at pixel " << col << ' ' << row;
+      else
+        num_invalid++;
+    }
+  }
+
+  // The hole, and the last row and column, where the interpolation
+  // footprint goes outside the DEM
+  EXPECT_EQ(num_invalid, 3 * 3 + cols + rows - 1);
+
+  // Most pixels are interpolated
+  EXPECT_LT(grid.num_exact, cols * rows / 4);
+}
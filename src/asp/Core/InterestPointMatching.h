@@ -220,6 +220,14 @@ void match_ip_pair(vw::ip::InterestPointList const& ip1,
                        DETECT_IP_METHOD_SIFT     = 1,
                        DETECT_IP_METHOD_ORB      = 2};
 
+// Match ip without a datum, cameras, epipolar lines.
+void match_ip_no_datum(std::vector<vw::ip::InterestPoint> const& ip1_copy,
+                       std::vector<vw::ip::InterestPoint> const& ip2_copy,
+                       DetectIpMethod detect_method, double uniqueness_threshold,
+                       bool quiet,
+                       // Outputs
+                       std::vector<vw::ip::InterestPoint>& matched_ip1,
+                       std::vector<vw::ip::InterestPoint>& matched_ip2);
 
 /// Detect interest points
 ///
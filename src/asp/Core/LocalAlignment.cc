@@ -30,6 +30,7 @@
 #include <asp/Core/IpMatchingAlgs.h>         // Lightweight header
 #include <asp/Core/OpenCVUtils.h>
 #include <asp/Core/DisparityProcessing.h>
+#include <asp/Core/Tracing.h>
 
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -365,6 +366,8 @@ namespace asp {
                        std::string                   & right_aligned_file,
                        int                           & min_disp,
                        int                           & max_disp) {
+
+    asp::ScopedTrace trace("local_alignment");
   
     // Read the unaligned images
     std::string left_unaligned_file = opt.in_file1;
@@ -18,6 +18,16 @@
 
 #include <asp/Core/MedianFilter.h>
 #include <vw/Math/Vector.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Image/Manipulation.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 using namespace vw;
 
@@ -39,3 +49,320 @@ uint8 find_median_in_histogram(Vector<int, CALC_PIXEL_NUM_VALS> histogram,
 
   return i;
 }
+
+namespace asp {
+
+// The size of the tiles of output pixels, without the halo. With the
+// histogram method, the tiles shrink as the kernel grows, to keep the
+// column histograms small.
+const int MEDIAN_TILE_SIZE = 128;
+const int MEDIAN_MIN_HIST_TILE_SIZE = 32;
+
+// Below this kernel size sorting the values in each window is faster
+const int MEDIAN_MIN_HIST_KERNEL_SIZE = 13;
+
+// Median of the valid values in each window, by partial sorting. The input
+// has dimensions (out_cols + 2*r) x (out_rows + 2*r).
+void median_tile_direct(std::vector<float> const& vals,
+                        std::vector<uint8> const& valid,
+                        int out_cols, int out_rows, int r,
+                        ImageView<float> & out, ImageView<uint8> & out_valid) {
+
+  int W = out_cols + 2*r;
+  std::vector<float> window;
+  window.reserve((2*r + 1) * (2*r + 1));
+  for (int y = 0; y < out_rows; y++) {
+    for (int x = 0; x < out_cols; x++) {
+      if (!valid[(y + r)*W + x + r]) {
+        out(x, y) = 0;
+        out_valid(x, y) = 0;
+        continue;
+      }
+      window.clear();
+      for (int yy = y; yy <= y + 2*r; yy++) {
+        for (int xx = x; xx <= x + 2*r; xx++) {
+          if (valid[yy*W + xx])
+            window.push_back(vals[yy*W + xx]);
+        }
+      }
+      std::nth_element(window.begin(), window.begin() + window.size()/2, window.end());
+      out(x, y) = window[window.size()/2];
+      out_valid(x, y) = 1;
+    }
+  }
+}
+
+// Median of the valid values in each window, with the method of Perreault
+// and Hebert, "Median Filtering in Constant Time", 2007. The values are
+// replaced by their ranks among the distinct values in the tile, and these
+// are binned into a two-level histogram. Each column keeps a histogram of
+// the 2*r+1 values in the current row window, which is updated with one
+// addition and one removal when moving down a row. The kernel coarse
+// histogram is updated from the column histograms when moving right, and
+// a fine histogram of the kernel is brought up to date only when the
+// median falls in its coarse bin. Unlike in the paper, which uses 8-bit
+// values, the number of bins is not fixed. With M distinct values in the
+// tile there are about sqrt(M) coarse bins and as many fine bins in each,
+// so the cost per pixel is O(sqrt(M)) rather than constant. It still does
+// not grow with the kernel size, unlike for the direct method.
+void median_tile_histogram(std::vector<float> const& vals,
+                           std::vector<uint8> const& valid,
+                           int out_cols, int out_rows, int r,
+                           ImageView<float> & out, ImageView<uint8> & out_valid) {
+
+  int W = out_cols + 2*r;
+  int k = 2*r + 1;
+
+  // Replace the values with ranks
+  std::vector<float> uniq;
+  for (size_t i = 0; i < vals.size(); i++) {
+    if (valid[i])
+      uniq.push_back(vals[i]);
+  }
+  std::sort(uniq.begin(), uniq.end());
+  uniq.erase(std::unique(uniq.begin(), uniq.end()), uniq.end());
+  int M = uniq.size();
+  std::vector<int> rank(vals.size(), -1);
+  for (size_t i = 0; i < vals.size(); i++) {
+    if (valid[i])
+      rank[i] = std::lower_bound(uniq.begin(), uniq.end(), vals[i]) - uniq.begin();
+  }
+
+  // Coarse and fine bins
+  int C = std::max(1, int(ceil(sqrt(double(M)))));
+  int F = std::max(1, (M + C - 1) / C);
+
+  std::vector<int> colC(W*C, 0), colF(W*C*F, 0), colTotal(W, 0);
+  std::vector<int> kerC(C), kerF(C*F), lastX(C);
+
+  for (int x = 0; x < W; x++) {
+    for (int y = 0; y < k; y++) {
+      int v = rank[y*W + x];
+      if (v < 0)
+        continue;
+      colC[x*C + v/F]++;
+      colF[(x*C + v/F)*F + v%F]++;
+      colTotal[x]++;
+    }
+  }
+
+  for (int y = 0; y < out_rows; y++) {
+
+    // Move the column histograms down a row
+    if (y > 0) {
+      for (int x = 0; x < W; x++) {
+        int v = rank[(y - 1)*W + x];
+        if (v >= 0) {
+          colC[x*C + v/F]--;
+          colF[(x*C + v/F)*F + v%F]--;
+          colTotal[x]--;
+        }
+        v = rank[(y + 2*r)*W + x];
+        if (v >= 0) {
+          colC[x*C + v/F]++;
+          colF[(x*C + v/F)*F + v%F]++;
+          colTotal[x]++;
+        }
+      }
+    }
+
+    // The kernel at the start of the row
+    std::fill(kerC.begin(), kerC.end(), 0);
+    std::fill(lastX.begin(), lastX.end(), -1);
+    int count = 0;
+    for (int x = 0; x < k; x++) {
+      for (int c = 0; c < C; c++)
+        kerC[c] += colC[x*C + c];
+      count += colTotal[x];
+    }
+
+    for (int x = 0; x < out_cols; x++) {
+
+      if (x > 0) {
+        int const* add = &colC[(x + 2*r)*C];
+        int const* sub = &colC[(x - 1)*C];
+        for (int c = 0; c < C; c++)
+          kerC[c] += add[c] - sub[c];
+        count += colTotal[x + 2*r] - colTotal[x - 1];
+      }
+
+      if (!valid[(y + r)*W + x + r] || count == 0) {
+        out(x, y) = 0;
+        out_valid(x, y) = 0;
+        continue;
+      }
+
+      // Find the coarse bin having the median
+      int target = count/2, acc = 0, c = 0;
+      for (c = 0; c < C; c++) {
+        if (acc + kerC[c] > target)
+          break;
+        acc += kerC[c];
+      }
+      int t = target - acc;
+
+      // Update the fine histogram of that bin, either from scratch or by
+      // moving it right from where it was last used
+      int * kf = &kerF[c*F];
+      if (lastX[c] < 0 || x - lastX[c] > k) {
+        std::fill(kf, kf + F, 0);
+        for (int xx = x; xx < x + k; xx++) {
+          int const* add = &colF[(xx*C + c)*F];
+          for (int f = 0; f < F; f++)
+            kf[f] += add[f];
+        }
+      } else {
+        for (int xs = lastX[c] + 1; xs <= x; xs++) {
+          int const* add = &colF[((xs + 2*r)*C + c)*F];
+          int const* sub = &colF[((xs - 1)*C + c)*F];
+          for (int f = 0; f < F; f++)
+            kf[f] += add[f] - sub[f];
+        }
+      }
+      lastX[c] = x;
+
+      // Find the median in the fine bin
+      acc = 0;
+      int f = 0;
+      for (f = 0; f < F; f++) {
+        acc += kf[f];
+        if (acc > t)
+          break;
+      }
+      out(x, y) = uniq[c*F + f];
+      out_valid(x, y) = 1;
+    }
+  }
+}
+
+// Filter one tile of the image, with its halo
+class MedianTileTask: public vw::Task, private boost::noncopyable {
+  ImageView<float> const& m_img;
+  ImageView<uint8> const& m_valid;
+  BBox2i m_box;
+  int m_r;
+  bool m_use_hist;
+  ImageView<float> & m_out;
+  ImageView<uint8> & m_out_valid;
+
+public:
+  MedianTileTask(ImageView<float> const& img, ImageView<uint8> const& valid,
+                 BBox2i const& box, int r, bool use_hist,
+                 ImageView<float> & out, ImageView<uint8> & out_valid):
+    m_img(img), m_valid(valid), m_box(box), m_r(r), m_use_hist(use_hist),
+    m_out(out), m_out_valid(out_valid) {}
+
+  void operator()() {
+
+    // Copy the tile with its halo. Pixels outside the image are invalid.
+    int W = m_box.width() + 2*m_r, H = m_box.height() + 2*m_r;
+    std::vector<float> vals(W*H, 0);
+    std::vector<uint8> valid(W*H, 0);
+    for (int y = 0; y < H; y++) {
+      int row = m_box.min().y() - m_r + y;
+      if (row < 0 || row >= m_img.rows())
+        continue;
+      for (int x = 0; x < W; x++) {
+        int col = m_box.min().x() - m_r + x;
+        if (col < 0 || col >= m_img.cols())
+          continue;
+        vals[y*W + x]  = m_img(col, row);
+        valid[y*W + x] = (m_valid(col, row) != 0);
+      }
+    }
+
+    ImageView<float> out(m_box.width(), m_box.height());
+    ImageView<uint8> out_valid(m_box.width(), m_box.height());
+    if (m_use_hist)
+      median_tile_histogram(vals, valid, m_box.width(), m_box.height(), m_r,
+                            out, out_valid);
+    else
+      median_tile_direct(vals, valid, m_box.width(), m_box.height(), m_r,
+                         out, out_valid);
+
+    // The tiles do not overlap, so no locking is needed
+    crop(m_out, m_box) = out;
+    crop(m_out_valid, m_box) = out_valid;
+  }
+};
+
+void median_filter(ImageView<float> const& img,
+                   ImageView<uint8> const& valid,
+                   int kernel_size,
+                   ImageView<float>      & out,
+                   ImageView<uint8>      & out_valid,
+                   int num_threads,
+                   MedianFilterMethod method) {
+
+  if (img.cols() != valid.cols() || img.rows() != valid.rows())
+    vw_throw(ArgumentErr() << "median_filter: The image and its validity mask "
+             << "must have the same dimensions.\n");
+
+  out.set_size(img.cols(), img.rows());
+  out_valid.set_size(img.cols(), img.rows());
+
+  if (kernel_size < 2) {
+    out = copy(img);
+    out_valid = copy(valid);
+    return;
+  }
+
+  int r = kernel_size/2;
+  bool use_hist = (method == MEDIAN_HISTOGRAM ||
+                   (method == MEDIAN_AUTO && kernel_size >= MEDIAN_MIN_HIST_KERNEL_SIZE));
+  int tile_size = MEDIAN_TILE_SIZE;
+  if (use_hist)
+    tile_size = std::max(MEDIAN_MIN_HIST_TILE_SIZE, MEDIAN_TILE_SIZE - 2*r);
+
+  if (num_threads <= 0)
+    num_threads = vw_settings().default_num_threads();
+
+  vw::FifoWorkQueue queue(num_threads);
+  for (int row = 0; row < img.rows(); row += tile_size) {
+    for (int col = 0; col < img.cols(); col += tile_size) {
+      BBox2i box(col, row,
+                 std::min(tile_size, img.cols() - col),
+                 std::min(tile_size, img.rows() - row));
+      boost::shared_ptr<MedianTileTask>
+        task(new MedianTileTask(img, valid, box, r, use_hist, out, out_valid));
+      queue.add_task(task);
+    }
+  }
+  queue.join_all();
+}
+
+void disparity_median_filter(ImageView<PixelMask<Vector2f>> const& disp,
+                             int kernel_size,
+                             ImageView<PixelMask<Vector2f>> & out,
+                             int num_threads,
+                             MedianFilterMethod method) {
+
+  ImageView<float> band(disp.cols(), disp.rows());
+  ImageView<uint8> valid(disp.cols(), disp.rows());
+  for (int col = 0; col < disp.cols(); col++) {
+    for (int row = 0; row < disp.rows(); row++)
+      valid(col, row) = is_valid(disp(col, row));
+  }
+
+  out.set_size(disp.cols(), disp.rows());
+  ImageView<float> band_out;
+  ImageView<uint8> valid_out;
+  for (int b = 0; b < 2; b++) {
+    for (int col = 0; col < disp.cols(); col++) {
+      for (int row = 0; row < disp.rows(); row++)
+        band(col, row) = disp(col, row).child()[b];
+    }
+    median_filter(band, valid, kernel_size, band_out, valid_out, num_threads, method);
+    for (int col = 0; col < disp.cols(); col++) {
+      for (int row = 0; row < disp.rows(); row++) {
+        out(col, row).child()[b] = band_out(col, row);
+        if (valid_out(col, row))
+          out(col, row).validate();
+        else
+          out(col, row).invalidate();
+      }
+    }
+  }
+}
+
+} // end namespace asp
@@ -31,6 +31,7 @@
 #include <vw/Image/ImageView.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/PerPixelAccessorViews.h>
+#include <vw/Image/PixelMask.h>
 
 namespace vw {
 
@@ -142,4 +143,38 @@ namespace vw {
 
 }
 
+namespace asp {
+
+  enum MedianFilterMethod {
+    MEDIAN_AUTO,      // Pick based on the kernel size
+    MEDIAN_DIRECT,    // Partial sort of the values in each window
+    MEDIAN_HISTOGRAM  // Perreault-Hebert column histograms
+  };
+
+  /// Median filter with a square kernel of odd size. Only the pixels with a
+  /// nonzero value in 'valid' are used, and windows are clipped at the image
+  /// boundary. Pixels which are not valid stay so in the output. For an even
+  /// number of values, the upper of the two middle ones is used. The image
+  /// is processed in tiles, in parallel. The histogram method works with the
+  /// ranks of the values in each tile, so there is no quantization. Its cost
+  /// per pixel is O(sqrt(M)) for M distinct values in a tile, and does not
+  /// grow with the kernel size. A kernel size less than 2 results in a copy
+  /// of the input.
+  void median_filter(vw::ImageView<float>      const& img,
+                     vw::ImageView<vw::uint8>  const& valid,
+                     int kernel_size,
+                     vw::ImageView<float>           & out,
+                     vw::ImageView<vw::uint8>       & out_valid,
+                     int num_threads = 0,
+                     MedianFilterMethod method = MEDIAN_AUTO);
+
+  /// Median filter of a disparity, with each band filtered separately.
+  void disparity_median_filter(vw::ImageView<vw::PixelMask<vw::Vector2f>> const& disp,
+                               int kernel_size,
+                               vw::ImageView<vw::PixelMask<vw::Vector2f>> & out,
+                               int num_threads = 0,
+                               MedianFilterMethod method = MEDIAN_AUTO);
+
+} // end namespace asp
+
 #endif // __MEDIAN_FILTER_H__
@@ -22,12 +22,17 @@
 #include <asp/Core/Common.h>
 #include <asp/Core/PointUtils.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/filesystem.hpp>
 
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/math/special_functions/next.hpp>
 
 using namespace vw;
 using namespace vw::cartography;
+namespace fs = boost::filesystem;
 
 //------------------------------------------------------------------------------------------
 // Class CsvConv functions
@@ -217,51 +222,97 @@ bool asp::CsvConv::parse_georef(vw::cartography::GeoReference & georef) const {
   return success;
 }
 
-asp::CsvConv::CsvRecord asp::CsvConv::parse_csv_line(bool & is_first_line, bool & success,
-                                                     std::string const& line) const {
-  // Parse a CSV file line in given format
-  success = true;
+// Search for "color = red" and find "red". Return false on failure.
+// Can handle uppercase strings, also "color=red" and "color red".
+bool parse_color(std::string const& line, std::string & color) {
 
-  // Copy the input line into a temporary buffer
-  const int bufSize = 2048;
-  char temp[bufSize];
-  strncpy(temp, line.c_str(), bufSize);
+  color = ""; // reset the output
+  if (line.empty() || line[0] == '#') 
+    return false;
+
+  std::string line_lc = boost::to_lower_copy(line); // make lowercase
+
+  size_t pos = line_lc.find("color");
+  if (pos == std::string::npos) 
+    return false;
+
+  pos += 5; // go past the color
+
+  // Skip past spaces and equal sign
+  while (pos < line_lc.size() && (line_lc[pos] < 'a' || line_lc[pos] > 'z'))
+    pos++;
+  
+  if (pos >= line_lc.size())
+    return false; // no color was set
+
+  line_lc = line_lc.substr(pos);
+
+  // Return the first token. This is useful if there are spaces and other things
+  // afterward.
+  std::istringstream iss(line_lc);
+  std::string token;
+  if (iss >> token) {
+    color = token;
+    return true;
+  }
+  
+  return false;
+}
+
+// Parse a CSV line given as a range of characters. Does not use strtok(),
+// so it is thread-safe.
+bool asp::CsvConv::parse_csv_chars(char const* beg, char const* end,
+                                   CsvRecord & values) const {
+
+  values = CsvRecord();
+
+  // Quietly ignore empty lines, lines with spaces only, and lines starting with comments
+  if (beg == end || *beg == '#')
+    return false;
+  char const* p = beg;
+  while (p < end && (*p == ' ' || *p == '\n' || *p == '\t'))
+    p++;
+  if (p == end)
+    return false;
 
   std::string sep = asp::csv_separator();
+  auto is_sep = [&sep](char c) { return sep.find(c) != std::string::npos; };
 
+  bool success = true;
   int col_index = -1; // The current column we are reading
   int num_floats_read = 0;
   int num_values_read = 0;
-
-  CsvRecord values;
-
-  // Quietly ignore empty lines, lines with spaces only, and lines starting with comments
-  if (line.empty() || line[0] == '#' || hasSpacesOnly(line)) {
-    success = false;
-    is_first_line = false;
-    return values;
-  }
+  std::string token;
   
-  char * ptr = temp;
+  p = beg;
   while (1) {
 
     col_index++; // Increment the column counter
-    const char* token = strtok(ptr, sep.c_str());  // Split line on seperator char
-    ptr = NULL; // After the first call, strtok expects a null pointer as input.
-    if (token == NULL) break; // no more tokens
+
+    // Split line on separator chars, skipping repeated separators
+    while (p < end && is_sep(*p))
+      p++;
+    if (p == end) break; // no more tokens
     if (num_values_read >= this->num_fields) break; // read enough values
+    char const* q = p;
+    while (q < end && !is_sep(*q))
+      q++;
+    char const* token_beg = p;
+    p = q;
 
     // Check if this is one of the columns we need to read
-    if (this->col2name.find(col_index) == this->col2name.end())
+    auto it = this->col2name.find(col_index);
+    if (it == this->col2name.end())
       continue;
 
-    if (this->col2name.at(col_index) == "file") // This is a string input
+    token.assign(token_beg, q);
+    if (it->second == "file") // This is a string input
       values.file = token;
     else {
       // Parse the floating point value from the token
-      double val;
-      int flag = sscanf(token, "%lg", &val);
-      if (flag == 0){ // Handle parsing failure
+      char * num_end = NULL;
+      double val = strtod(token.c_str(), &num_end);
+      if (num_end == token.c_str()) { // Handle parsing failure
         success = false;
         break;
       }
@@ -276,80 +327,164 @@ asp::CsvConv::CsvRecord asp::CsvConv::parse_csv_line(bool & is_first_line, bool
   if (num_values_read != this->num_fields || values.point_data != values.point_data)
     success = false;
 
-  if (!success) {
-    if (!is_first_line) {
-      // Not the header
-      vw_out () << "Failed to read line: " << line << "\n";
-    }
+  return success;
+}
+
+asp::CsvConv::CsvRecord asp::CsvConv::parse_csv_line(bool & is_first_line, bool & success,
+                                                     std::string const& line) const {
+  // Parse a CSV file line in given format
+  CsvRecord values;
+  success = parse_csv_chars(line.data(), line.data() + line.size(), values);
+
+  // Do not complain about empty lines, lines with spaces only, and comments
+  if (!success && !is_first_line && !line.empty() && line[0] != '#' &&
+      !hasSpacesOnly(line)) {
+    // Not the header
+    vw_out () << "Failed to read line: " << line << "\n";
   }
 
   is_first_line = false;
   return values;
 }
 
-// Search for "color = red" and find "red". Return false on failure.
-// Can handle uppercase strings, also "color=red" and "color red".
-bool parse_color(std::string const& line, std::string & color) {
+namespace asp {
+
+// Parse a chunk of a memory-mapped CSV file. The chunk starts at the
+// beginning of a line and ends at the end of a line or of the file.
+class ParseCsvChunkTask: public vw::Task, private boost::noncopyable {
+  CsvConv const& m_conv;
+  char const* m_beg;
+  char const* m_end;
+  bool m_starts_file;
+  std::vector<CsvConv::CsvRecord> & m_records;
+  std::vector<std::string> & m_failed_lines;
+  size_t & m_num_lines;
+
+public:
+  ParseCsvChunkTask(CsvConv const& conv, char const* beg, char const* end,
+                    bool starts_file,
+                    std::vector<CsvConv::CsvRecord> & records,
+                    std::vector<std::string> & failed_lines,
+                    size_t & num_lines):
+    m_conv(conv), m_beg(beg), m_end(end), m_starts_file(starts_file),
+    m_records(records), m_failed_lines(failed_lines), m_num_lines(num_lines) {}
+
+  void operator()() {
+    m_num_lines = 0;
+    char const* line_beg = m_beg;
+    while (line_beg < m_end) {
+      char const* line_end
+        = static_cast<char const*>(memchr(line_beg, '\n', m_end - line_beg));
+      if (line_end == NULL)
+        line_end = m_end;
+
+      CsvConv::CsvRecord record;
+      if (m_conv.parse_csv_chars(line_beg, line_end, record)) {
+        m_records.push_back(record);
+      } else {
+        // Quietly skip the header, empty lines, lines with spaces only,
+        // and comments
+        std::string line(line_beg, line_end);
+        bool is_header = (m_starts_file && m_num_lines == 0);
+        if (!is_header && !line.empty() && line[0] != '#' && !hasSpacesOnly(line))
+          m_failed_lines.push_back(line);
+      }
 
-  color = ""; // reset the output
-  if (line.empty() || line[0] == '#') 
-    return false;
+      m_num_lines++;
+      line_beg = line_end + 1;
+    }
+  }
+};
 
-  std::string line_lc = boost::to_lower_copy(line); // make lowercase
+} // end namespace asp
 
-  size_t pos = line_lc.find("color");
-  if (pos == std::string::npos) 
-    return false;
+size_t asp::CsvConv::read_csv_file(std::string const & file_path,
+                                   std::vector<CsvRecord> & output) const {
 
-  pos += 5; // go past the color
+  // Clear output object
+  output.clear();
 
-  // Skip past spaces and equal sign
-  while (pos < line_lc.size() && (line_lc[pos] < 'a' || line_lc[pos] > 'z'))
-    pos++;
-  
-  if (pos >= line_lc.size())
-    return false; // no color was set
+  if (!fs::exists(file_path))
+    vw_throw(vw::IOErr() << "Unable to open file \"" << file_path << "\"");
+  if (fs::file_size(file_path) == 0)
+    return 0; // Cannot memory-map an empty file
 
-  line_lc = line_lc.substr(pos);
+  vw::Stopwatch sw;
+  sw.start();
 
-  // Return the first token. This is useful if there are spaces and other things
-  // afterward.
-  std::istringstream iss(line_lc);
-  std::string token;
-  if (iss >> token) {
-    color = token;
-    return true;
+  boost::iostreams::mapped_file_source mapped;
+  try {
+    mapped.open(file_path);
+  } catch (std::exception const& e) {
+    vw_throw(vw::IOErr() << "Unable to open file \"" << file_path << "\": "
+             << e.what() << "\n");
   }
-  
-  return false;
-}
+  char const* data = mapped.data();
+  size_t      size = mapped.size();
+
+  // Split the file into chunks of at least 1 MB, a few per thread, with each
+  // chunk starting at the beginning of a line.
+  size_t num_threads = vw_settings().default_num_threads();
+  size_t num_chunks  = std::min(size / (1 << 20) + 1, 4 * num_threads);
+  std::vector<size_t> starts;
+  starts.push_back(0);
+  for (size_t k = 1; k < num_chunks; k++) {
+    size_t pos = std::max(starts.back(), k * size / num_chunks);
+    char const* nl = static_cast<char const*>(memchr(data + pos, '\n', size - pos));
+    if (nl == NULL)
+      break;
+    pos = (nl - data) + 1;
+    if (pos >= size)
+      break;
+    if (pos > starts.back())
+      starts.push_back(pos);
+  }
+  starts.push_back(size);
+  num_chunks = starts.size() - 1;
+
+  // Parse the chunks in parallel
+  std::vector<std::vector<CsvRecord>> records(num_chunks);
+  std::vector<std::vector<std::string>> failed_lines(num_chunks);
+  std::vector<size_t> num_lines(num_chunks, 0);
+  vw::FifoWorkQueue queue(num_threads);
+  for (size_t k = 0; k < num_chunks; k++) {
+    boost::shared_ptr<ParseCsvChunkTask>
+      task(new ParseCsvChunkTask(*this, data + starts[k], data + starts[k + 1],
+                                 (k == 0), records[k], failed_lines[k], num_lines[k]));
+    queue.add_task(task);
+  }
+  queue.join_all();
 
-size_t asp::CsvConv::read_csv_file(std::string const & file_path,
-				   std::list<CsvRecord> & output_list) const {
+  // Put the results together, in the order of the lines in the file
+  size_t num_records = 0, total_lines = 0;
+  for (size_t k = 0; k < num_chunks; k++) {
+    num_records += records[k].size();
+    total_lines += num_lines[k];
+  }
+  output.reserve(num_records);
+  for (size_t k = 0; k < num_chunks; k++) {
+    for (size_t it = 0; it < failed_lines[k].size(); it++)
+      vw_out() << "Failed to read line: " << failed_lines[k][it] << "\n";
+    output.insert(output.end(), records[k].begin(), records[k].end());
+    std::vector<CsvRecord>().swap(records[k]); // free up the memory
+  }
 
-  // Clear output object
-  output_list.clear();
+  sw.stop();
+  double elapsed = sw.elapsed_seconds();
+  vw_out(DebugMessage, "asp") << "Read " << total_lines << " lines from " << file_path
+                              << " in " << elapsed << " seconds ("
+                              << total_lines / std::max(elapsed, 1e-6)
+                              << " lines/second).\n";
 
-  // Open input file
-  std::ifstream file( file_path.c_str() );
-  if (!file)
-    vw_throw(vw::IOErr() << "Unable to open file \"" << file_path << "\"");
+  return output.size();
+}
 
-  // Read through all the lines of the input file, parse each line, and build the output list.
-  bool success;
-  bool first_line = true; // TODO(oalexan1): Wipe this variable.
-  std::string line = "";
-  
-  while (std::getline(file, line, '\n')) {
-    
-    CsvRecord new_record = asp::CsvConv::parse_csv_line(first_line, success, line);
-    if (success)
-      output_list.push_back(new_record);
-    
-    first_line = false;
-  }
+size_t asp::CsvConv::read_csv_file(std::string const & file_path,
+				   std::list<CsvRecord> & output_list) const {
 
-  file.close();
+  std::vector<CsvRecord> records;
+  read_csv_file(file_path, records);
+  output_list.assign(records.begin(), records.end());
 
   return output_list.size();
 }
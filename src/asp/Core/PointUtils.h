@@ -33,6 +33,8 @@
 #include <vw/FileIO/DiskImageUtils.h>
 
 #include <string>
+#include <vector>
+#include <list>
 
 namespace vw{
   namespace cartography {
@@ -95,8 +97,17 @@ namespace asp {
     CsvRecord parse_csv_line(bool & is_first_line, bool & success,
                               std::string const& line) const;
 
-    /// Reads an entire CSV file and stores a record for each line.
-    /// - Intended for use with smaller files.
+    /// Same as parse_csv_line(), but for a range of characters, and without
+    /// printing anything. Returns true on success. Thread-safe.
+    bool parse_csv_chars(char const* beg, char const* end, CsvRecord & record) const;
+
+    /// Reads an entire CSV file and stores a record for each valid line, in
+    /// the order of the lines. The file is memory-mapped and parsed in
+    /// chunks with multiple threads.
+    size_t read_csv_file(std::string const      & file_path,
+                         std::vector<CsvRecord> & output) const;
+
+    /// Same as above, but store the records in a list.
     size_t read_csv_file(std::string const    & file_path,
                          std::list<CsvRecord> & output_list) const;
       
@@ -0,0 +1,262 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file ResampleKernel.cc
+///
+
+#include <asp/Core/ResampleKernel.h>
+
+#include <cmath>
+#include <limits>
+
+// The AVX2 code is compiled with a function attribute and selected at run
+// time, so the rest of the build does not need any special flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ASP_RESAMPLE_HAVE_AVX2 1
+#include <immintrin.h>
+#else
+#define ASP_RESAMPLE_HAVE_AVX2 0
+#endif
+
+namespace asp {
+
+namespace {
+
+const float g_nan = std::numeric_limits<float>::quiet_NaN();
+
+// Bilinear interpolation at one location.
+inline float bilinearScalar(float const* src, int cols, int rows, float x, float y) {
+
+  float fx = std::floor(x), fy = std::floor(y);
+  if (!(fx >= 0.0f && fx <= cols - 2 && fy >= 0.0f && fy <= rows - 2))
+    return g_nan; // this also catches NaN locations
+
+  int ix = int(fx), iy = int(fy);
+  float nx = x - fx, ny = y - fy;
+  float mx = 1.0f - nx, my = 1.0f - ny;
+  float const* p = src + (long)iy * cols + ix;
+  float top = mx * p[0]    + nx * p[1];
+  float bot = mx * p[cols] + nx * p[cols + 1];
+  return my * top + ny * bot;
+}
+
+// Bicubic interpolation at one location. Same weights as in VW, which are
+// the Catmull-Rom weights scaled by 2 in each direction.
+inline float bicubicScalar(float const* src, int cols, int rows, float x, float y) {
+
+  float fx = std::floor(x), fy = std::floor(y);
+  if (!(fx >= 1.0f && fx <= cols - 3 && fy >= 1.0f && fy <= rows - 3))
+    return g_nan;
+
+  int ix = int(fx), iy = int(fy);
+  float nx = x - fx, ny = y - fy;
+  float s0 = ((2.0f - nx) * nx - 1.0f) * nx;
+  float s1 = (3.0f * nx - 5.0f) * nx * nx + 2.0f;
+  float s2 = ((4.0f - 3.0f * nx) * nx + 1.0f) * nx;
+  float s3 = (nx - 1.0f) * nx * nx;
+  float t0 = ((2.0f - ny) * ny - 1.0f) * ny;
+  float t1 = (3.0f * ny - 5.0f) * ny * ny + 2.0f;
+  float t2 = ((4.0f - 3.0f * ny) * ny + 1.0f) * ny;
+  float t3 = (ny - 1.0f) * ny * ny;
+
+  float const* p = src + (long)(iy - 1) * cols + (ix - 1);
+  float r[4];
+  for (int j = 0; j < 4; j++) {
+    float const* q = p + (long)j * cols;
+    r[j] = s0 * q[0] + s1 * q[1] + s2 * q[2] + s3 * q[3];
+  }
+
+  return (t0 * r[0] + t1 * r[1] + t2 * r[2] + t3 * r[3]) * 0.25f;
+}
+
+// Process the locations from beg to end, one at a time.
+void resampleRange(float const* src, int cols, int rows,
+                   float const* xs, float const* ys, int beg, int end,
+                   ResampleMethod method, float * out) {
+  if (method == RESAMPLE_BILINEAR) {
+    for (int i = beg; i < end; i++)
+      out[i] = bilinearScalar(src, cols, rows, xs[i], ys[i]);
+  } else {
+    for (int i = beg; i < end; i++)
+      out[i] = bicubicScalar(src, cols, rows, xs[i], ys[i]);
+  }
+}
+
+#if ASP_RESAMPLE_HAVE_AVX2
+
+// The operations below are done in the same order as in the scalar code, and
+// FMA is not enabled, so the two code paths produce identical results.
+
+__attribute__((target("avx2")))
+inline __m256 gatherAt(float const* src, __m256i idx) {
+  return _mm256_i32gather_ps(src, idx, 4);
+}
+
+// Find the integer part of the locations, the offset of the footprint corner
+// in the buffer, and which lanes have their footprint inside the buffer.
+// The offsets of invalid lanes are set to 0 so that gathering from them is safe.
+__attribute__((target("avx2")))
+inline void footprint(__m256 x, __m256 y, int cols, int rows, int margin_lo, int margin_hi,
+                      __m256 & fx, __m256 & fy, __m256 & valid, __m256i & idx) {
+
+  fx = _mm256_floor_ps(x);
+  fy = _mm256_floor_ps(y);
+
+  // Ordered comparisons are false for NaN, so NaN locations are invalid
+  __m256 lo_x = _mm256_set1_ps(float(margin_lo));
+  __m256 lo_y = lo_x;
+  __m256 hi_x = _mm256_set1_ps(float(cols - 1 - margin_hi));
+  __m256 hi_y = _mm256_set1_ps(float(rows - 1 - margin_hi));
+  valid = _mm256_and_ps(_mm256_cmp_ps(fx, lo_x, _CMP_GE_OQ),
+                        _mm256_cmp_ps(fx, hi_x, _CMP_LE_OQ));
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(fy, lo_y, _CMP_GE_OQ));
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(fy, hi_y, _CMP_LE_OQ));
+
+  // Zero out invalid lanes before the conversion to avoid garbage values
+  __m256i ix = _mm256_cvttps_epi32(_mm256_and_ps(fx, valid));
+  __m256i iy = _mm256_cvttps_epi32(_mm256_and_ps(fy, valid));
+  idx = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(iy, _mm256_set1_epi32(margin_lo)),
+                                            _mm256_set1_epi32(cols)),
+                         _mm256_sub_epi32(ix, _mm256_set1_epi32(margin_lo)));
+  idx = _mm256_and_si256(idx, _mm256_castps_si256(valid));
+}
+
+__attribute__((target("avx2")))
+void bilinearAvx2(float const* src, int cols, int rows,
+                  float const* xs, float const* ys, int num, float * out) {
+
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 nan = _mm256_set1_ps(g_nan);
+
+  int i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m256 x = _mm256_loadu_ps(xs + i);
+    __m256 y = _mm256_loadu_ps(ys + i);
+    __m256 fx, fy, valid;
+    __m256i idx;
+    footprint(x, y, cols, rows, 0, 1, fx, fy, valid, idx);
+
+    __m256 nx = _mm256_sub_ps(x, fx), ny = _mm256_sub_ps(y, fy);
+    __m256 mx = _mm256_sub_ps(one, nx), my = _mm256_sub_ps(one, ny);
+
+    __m256 v00 = gatherAt(src,            idx);
+    __m256 v10 = gatherAt(src + 1,        idx);
+    __m256 v01 = gatherAt(src + cols,     idx);
+    __m256 v11 = gatherAt(src + cols + 1, idx);
+
+    __m256 top = _mm256_add_ps(_mm256_mul_ps(mx, v00), _mm256_mul_ps(nx, v10));
+    __m256 bot = _mm256_add_ps(_mm256_mul_ps(mx, v01), _mm256_mul_ps(nx, v11));
+    __m256 res = _mm256_add_ps(_mm256_mul_ps(my, top), _mm256_mul_ps(ny, bot));
+
+    _mm256_storeu_ps(out + i, _mm256_blendv_ps(nan, res, valid));
+  }
+
+  resampleRange(src, cols, rows, xs, ys, i, num, RESAMPLE_BILINEAR, out);
+}
+
+// The four bicubic weights for each of the 8 lanes
+__attribute__((target("avx2")))
+inline void bicubicWeights(__m256 n, __m256 & w0, __m256 & w1, __m256 & w2, __m256 & w3) {
+  const __m256 one   = _mm256_set1_ps(1.0f);
+  const __m256 two   = _mm256_set1_ps(2.0f);
+  const __m256 three = _mm256_set1_ps(3.0f);
+  const __m256 four  = _mm256_set1_ps(4.0f);
+  const __m256 five  = _mm256_set1_ps(5.0f);
+  w0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(two, n), n), one), n);
+  w1 = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(three, n),
+                                                                five), n), n), two);
+  w2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(four,
+                                                                _mm256_mul_ps(three, n)), n),
+                                   one), n);
+  w3 = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(n, one), n), n);
+}
+
+__attribute__((target("avx2")))
+void bicubicAvx2(float const* src, int cols, int rows,
+                 float const* xs, float const* ys, int num, float * out) {
+
+  const __m256 quarter = _mm256_set1_ps(0.25f);
+  const __m256 nan     = _mm256_set1_ps(g_nan);
+
+  int i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m256 x = _mm256_loadu_ps(xs + i);
+    __m256 y = _mm256_loadu_ps(ys + i);
+    __m256 fx, fy, valid;
+    __m256i idx; // offset of the upper-left corner of the 4x4 footprint
+    footprint(x, y, cols, rows, 1, 2, fx, fy, valid, idx);
+
+    __m256 s0, s1, s2, s3, t0, t1, t2, t3;
+    bicubicWeights(_mm256_sub_ps(x, fx), s0, s1, s2, s3);
+    bicubicWeights(_mm256_sub_ps(y, fy), t0, t1, t2, t3);
+
+    __m256 r[4];
+    for (int j = 0; j < 4; j++) {
+      float const* q = src + (long)j * cols;
+      r[j] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s0, gatherAt(q,     idx)),
+                                                       _mm256_mul_ps(s1, gatherAt(q + 1, idx))),
+                                         _mm256_mul_ps(s2, gatherAt(q + 2, idx))),
+                           _mm256_mul_ps(s3, gatherAt(q + 3, idx)));
+    }
+    __m256 res = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(t0, r[0]),
+                                                           _mm256_mul_ps(t1, r[1])),
+                                             _mm256_mul_ps(t2, r[2])),
+                               _mm256_mul_ps(t3, r[3]));
+    res = _mm256_mul_ps(res, quarter);
+
+    _mm256_storeu_ps(out + i, _mm256_blendv_ps(nan, res, valid));
+  }
+
+  resampleRange(src, cols, rows, xs, ys, i, num, RESAMPLE_BICUBIC, out);
+}
+
+#endif // ASP_RESAMPLE_HAVE_AVX2
+
+} // end anonymous namespace
+
+bool resampleUsesAvx2() {
+#if ASP_RESAMPLE_HAVE_AVX2
+  static const bool ans = __builtin_cpu_supports("avx2");
+  return ans;
+#else
+  return false;
+#endif
+}
+
+void resampleBlockScalar(float const* src, int cols, int rows,
+                         float const* xs, float const* ys, int num,
+                         ResampleMethod method, float * out) {
+  resampleRange(src, cols, rows, xs, ys, 0, num, method, out);
+}
+
+void resampleBlock(float const* src, int cols, int rows,
+                   float const* xs, float const* ys, int num,
+                   ResampleMethod method, float * out) {
+#if ASP_RESAMPLE_HAVE_AVX2
+  if (resampleUsesAvx2()) {
+    if (method == RESAMPLE_BILINEAR)
+      bilinearAvx2(src, cols, rows, xs, ys, num, out);
+    else
+      bicubicAvx2(src, cols, rows, xs, ys, num, out);
+    return;
+  }
+#endif
+
+  resampleBlockScalar(src, cols, rows, xs, ys, num, method, out);
+}
+
+} // end namespace asp
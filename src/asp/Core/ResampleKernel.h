@@ -0,0 +1,51 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file ResampleKernel.h
+/// Resample a block of an image at arbitrary locations. This is the inner
+/// loop of mapprojection, once the camera pixel for each output pixel is
+/// known. An AVX2 version is used if the processor supports it.
+
+#ifndef __ASP_CORE_RESAMPLE_KERNEL_H__
+#define __ASP_CORE_RESAMPLE_KERNEL_H__
+
+namespace asp {
+
+enum ResampleMethod {RESAMPLE_BILINEAR, RESAMPLE_BICUBIC};
+
+/// Interpolate a dense float buffer with the given number of columns and rows,
+/// stored row after row, at the locations (xs[i], ys[i]), measured from the
+/// buffer origin. Invalid source pixels must be NaN. The result is NaN if the
+/// location is NaN, if any pixel in the interpolation footprint is NaN, or if
+/// the footprint is not fully inside the buffer. This agrees with VW's
+/// bilinear and bicubic interpolation of masked pixels with an invalid
+/// edge extension.
+void resampleBlock(float const* src, int cols, int rows,
+                   float const* xs, float const* ys, int num,
+                   ResampleMethod method, float * out);
+
+/// Same as resampleBlock(), but never use SIMD instructions.
+void resampleBlockScalar(float const* src, int cols, int rows,
+                         float const* xs, float const* ys, int num,
+                         ResampleMethod method, float * out);
+
+/// Return true if resampleBlock() will use the AVX2 code path.
+bool resampleUsesAvx2();
+
+} // end namespace asp
+
+#endif // __ASP_CORE_RESAMPLE_KERNEL_H__
@@ -145,6 +145,10 @@ namespace asp {
        "Turn off the tri-ip filtering step.")
       ("ip-debug-images", po::bool_switch(&global.ip_debug_images)->default_value(false)->implicit_value(true),
        "Write debug images to disk when detecting and matching interest points.")
+      ("no-camera-cache", po::bool_switch(&global.no_camera_cache)->default_value(false)->implicit_value(true),
+       "Do not save the camera models in preprocessing for faster loading in later stereo steps, and do not use a previously saved cache.")
+      ("trace", po::bool_switch(&global.trace)->default_value(false)->implicit_value(true),
+       "Record the run time, peak memory usage, and bytes read and written for the main functions of each stereo step, and save these per tile as <prefix>-<program>-trace.json, in the Chrome trace format. With parallel_stereo, the traces are merged into <output prefix>-trace.json and summarized in <output prefix>-trace-report.txt.")
       ("num-obalog-scales", po::value(&global.num_scales)->default_value(-1),
        "How many scales to use if detecting interest points with OBALoG. If not specified, 8 will be used. More can help for images with high frequency artifacts.")
       ("nodata-value",             po::value(&global.nodata_value)->default_value(g_nan_val),
@@ -397,6 +401,8 @@ namespace asp {
                                "Kernel size to perform texture aware disparity smoothing with. Can only be used with median smoothing.")
       ("texture-smooth-scale", po::value(&global.disp_smooth_texture)->default_value(0.15),
        "Scaling factor for texture smoothing.  Larger is more smoothing.")
+      ("compare-filter-outputs", po::bool_switch(&global.compare_filter_outputs)->default_value(false)->implicit_value(true),
+                              "Also produce F.tif and GoodPixelMap.tif with the original, slower filtering approach, with the suffix '-legacy', and report how many pixels differ from the outputs of the default approach. For testing.")
       ("gotcha-disparity-refinement",   po::bool_switch(&global.gotcha_disparity_refinement)->default_value(false)->implicit_value(true),
                               "Turn on the experimental Gotcha disparity refinement. It refines and overwrites F.tif. See the option 'casp-go-param-file' for customizing its behavior.")
       ("casp-go-param-file", po::value(&global.casp_go_param_file)->default_value(""),
@@ -432,6 +438,8 @@ namespace asp {
        "Propagate the errors from the input cameras to the triangulated point cloud.")
       ("horizontal-stddev", po::value(&global.horizontal_stddev)->default_value(Vector2(0, 0), "0 0"), "If positive, propagate these left and right camera horizontal ground plane stddev through triangulation. To be used with --propagate-errors.")
       
+      ("propagate-errors-method", po::value(&global.propagate_errors_method)->default_value("analytic"),
+       "How to propagate the satellite position and orientation covariances for Maxar (DigitalGlobe) linescan cameras. Options: analytic (find the derivatives of the camera center and rays with respect to these only at some image lines, then interpolate), numerical (evaluate perturbed cameras at each pixel, which is much slower).")
       ("position-covariance-factor", po::value(&global.position_covariance_factor)->default_value(1.0),
        "Multiply the satellite position covariances by this number before propagating them to the triangulated point cloud. Applicable only to Maxar(DigitalGlobe) linescan cameras.")
       ("orientation-covariance-factor", po::value(&global.orientation_covariance_factor)->default_value(1.0),
@@ -505,6 +513,12 @@ namespace asp {
         "Start with all images turned off (if all images are in the same window, useful with a large number of images).")
       ("delete-temporary-files-on-exit",   po::bool_switch(&global.delete_temporary_files_on_exit)->default_value(false)->implicit_value(true),
        "Delete any subsampled and other files created by the GUI when exiting.")
+      ("cache-dir", po::value(&global.cache_dir)->default_value(""),
+       "Keep the image pyramids and the hillshaded and thresholded images in this directory, to reuse them in later sessions. The default is $XDG_CACHE_HOME/asp/stereo_gui, or $HOME/.cache/asp/stereo_gui. Entries for an image become stale once it is modified. This directory can be deleted at any time.")
+      ("cache-size-limit", po::value(&global.cache_size_limit)->default_value(10.0),
+       "Once the cache directory is larger than this, in GB, remove from it the entries used least recently. The entries in use by any session are kept. Set to 0 for no limit.")
+      ("no-cache",   po::bool_switch(&global.no_cache)->default_value(false)->implicit_value(true),
+       "Do not use the cache directory. Then image pyramids are written next to the images, or in the current directory.")
       ("create-image-pyramids-only",   po::bool_switch(&global.create_image_pyramids_only)->default_value(false)->implicit_value(true),
        "Without starting the GUI, build multi-resolution pyramids for the inputs, to be able to load them fast later.")
       ("pairwise-matches",   po::bool_switch(&global.pairwise_matches)->default_value(false)->implicit_value(true), "Show images side-by-side. If just two of them are selected, load their corresponding match file, determined by the output prefix. Also accessible from the menu.")
@@ -593,6 +607,8 @@ namespace asp {
     StereoSettings& global = stereo_settings();
     (*this).add_options()
       ("trans-crop-win", po::value(&global.trans_crop_win)->default_value(BBox2i(0, 0, 0, 0), "xoff yoff xsize ysize"), "Left image crop window in respect to L.tif. This is an internal option. [default: use the entire image].")
+      ("tile-list", po::value(&global.tile_list)->default_value(""),
+       "Process all the tiles listed in this file, one per line, in the same process, instead of using --trans-crop-win. Each line has the output prefix for the tile and the tile box, as xoff yoff xsize ysize, optionally followed by the correlation tile size. This is an internal option.")
       ("attach-georeference-to-lowres-disparity", po::bool_switch(&global.attach_georeference_to_lowres_disparity)->default_value(false)->implicit_value(true),
        "If input images are georeferenced, make D_sub and D_sub_spread georeferenced.");
   }
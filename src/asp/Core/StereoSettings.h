@@ -118,6 +118,8 @@ namespace asp {
     double ip_triangulation_max_error;      ///< Remove IP matches with triangulation error higher than this.
     int    ip_num_ransac_iterations;        ///< How many ransac iterations to do in ip matching.
     bool   disable_tri_filtering;           ///< Turn of tri-ip filtering.
+    bool   no_camera_cache;                 ///< Do not cache the cameras across stereo steps
+    bool   trace;                           ///< Save timing, memory, and I/O traces
     
     int num_scales;                         /// How many scales to use if detecting interest points with OBALoG. If not specified, 8 will be used. 
     int    ip_edge_buffer_percent;          ///< When detecting IP, throw out points within this many % of pixels
@@ -247,6 +249,7 @@ namespace asp {
     int   median_filter_size;         // Filter subpixel results with median filter of this size
     int   disp_smooth_size;           // Adaptive disparity smoothing size
     double disp_smooth_texture;        // Adaptive disparity smoothing max texture value    
+    bool  compare_filter_outputs;     // Also filter the original way and compare
     bool  gotcha_disparity_refinement;
     std::string casp_go_param_file;
 
@@ -263,6 +266,7 @@ namespace asp {
     bool propagate_errors;
     vw::Vector2 horizontal_stddev;
     double position_covariance_factor, orientation_covariance_factor;
+    std::string propagate_errors_method;
     
     bool compute_error_vector;              // Compute the triangulation error vector, not just its length
 
@@ -287,7 +291,9 @@ namespace asp {
     double hillshade_azimuth, hillshade_elevation;
     bool view_matches, view_several_side_by_side, colorize, preview;
     std::string match_file, gcp_file, dem_file, csv_datum, csv_format_str, csv_srs, nvm, isis_cnet;
-    bool delete_temporary_files_on_exit;
+    bool delete_temporary_files_on_exit, no_cache;
+    std::string cache_dir;
+    double cache_size_limit;
     bool create_image_pyramids_only, hide_all, nvm_no_shift;
     bool pairwise_matches, pairwise_clean_matches, no_georef;
     std::vector<std::string> vwip_files;
@@ -307,6 +313,7 @@ namespace asp {
     
     // Undocumented options. We don't want these exposed to the user.
     vw::BBox2i trans_crop_win;        // Left image crop window in respect to L.tif.
+    std::string tile_list;            // File listing tiles to process in one process.
     bool attach_georeference_to_lowres_disparity;
 
     // Internal variable, to ensure we always initialize this class before using it
@@ -0,0 +1,248 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <asp/Core/Tracing.h>
+#include <asp/Core/Common.h>
+
+#include <vw/Core/Log.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/Exception.h>
+
+// For writing the trace
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace asp {
+
+namespace {
+
+const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+// A complete event. Times are in microseconds since the epoch, so that
+// the traces of different processes can be merged.
+struct TraceEvent {
+  std::string name, category;
+  std::int64_t start_us, duration_us;
+  int tid;
+  std::int64_t read_bytes, written_bytes; // during the event, or -1
+  double peak_rss_mb;                     // at the end of the event
+};
+
+// Set once at startup, so reading it needs no lock
+std::atomic<bool> g_tracing_enabled(false);
+
+class Tracer {
+public:
+  Tracer(): m_read_bytes(0), m_written_bytes(0) {}
+
+  void start(std::string const& prog_name) {
+    vw::Mutex::Lock lock(m_mutex);
+    m_prog_name = prog_name;
+    m_events.clear();
+    processIoBytes(m_read_bytes, m_written_bytes);
+  }
+
+  void add(TraceEvent & event) {
+    vw::Mutex::Lock lock(m_mutex);
+    // Small thread ids, in the order the threads are seen
+    auto it = m_tids.find(std::this_thread::get_id());
+    if (it == m_tids.end())
+      it = m_tids.insert(std::make_pair(std::this_thread::get_id(), int(m_tids.size()))).first;
+    event.tid = it->second;
+    m_events.push_back(event);
+  }
+
+  void save(std::string const& out_prefix);
+
+private:
+  vw::Mutex m_mutex;
+  std::string m_prog_name;
+  std::vector<TraceEvent> m_events;
+  std::map<std::thread::id, int> m_tids;
+  std::int64_t m_read_bytes, m_written_bytes; // when the current trace started
+};
+
+// Never destroyed, so it can be used until the process exits
+Tracer & tracer() {
+  static Tracer * t = new Tracer();
+  return *t;
+}
+
+std::int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>
+    (std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string hostName() {
+  char buf[256];
+  if (gethostname(buf, sizeof(buf)) != 0)
+    return "";
+  buf[sizeof(buf) - 1] = '\0';
+  return std::string(buf);
+}
+
+void Tracer::save(std::string const& out_prefix) {
+
+  vw::Mutex::Lock lock(m_mutex);
+
+  int pid = getpid();
+  json events = json::array();
+
+  json meta;
+  meta["name"] = "process_name";
+  meta["ph"]   = "M";
+  meta["pid"]  = pid;
+  meta["tid"]  = 0;
+  meta["args"]["name"] = m_prog_name + " " + out_prefix;
+  events.push_back(meta);
+
+  for (auto const& e: m_events) {
+    json j;
+    j["name"] = e.name;
+    j["cat"]  = e.category;
+    j["ph"]   = "X";
+    j["ts"]   = e.start_us;
+    j["dur"]  = e.duration_us;
+    j["pid"]  = pid;
+    j["tid"]  = e.tid;
+    j["args"]["peak_rss_mb"] = e.peak_rss_mb;
+    if (e.read_bytes >= 0) {
+      j["args"]["read_mb"]    = e.read_bytes / BYTES_PER_MB;
+      j["args"]["written_mb"] = e.written_bytes / BYTES_PER_MB;
+    }
+    events.push_back(j);
+
+    // Plotted as a graph over time
+    json c;
+    c["name"] = "peak_rss_mb";
+    c["ph"]   = "C";
+    c["ts"]   = e.start_us + e.duration_us;
+    c["pid"]  = pid;
+    c["args"]["value"] = e.peak_rss_mb;
+    events.push_back(c);
+  }
+
+  // Totals for the trace
+  json other;
+  other["program"]     = m_prog_name;
+  other["out_prefix"]  = out_prefix;
+  other["host"]        = hostName();
+  other["pid"]         = pid;
+  other["peak_rss_mb"] = peak_memory_mb();
+  std::int64_t read_bytes = 0, written_bytes = 0;
+  if (processIoBytes(read_bytes, written_bytes)) {
+    other["read_mb"]    = (read_bytes - m_read_bytes) / BYTES_PER_MB;
+    other["written_mb"] = (written_bytes - m_written_bytes) / BYTES_PER_MB;
+    m_read_bytes    = read_bytes;
+    m_written_bytes = written_bytes;
+  }
+
+  json trace;
+  trace["traceEvents"]     = events;
+  trace["displayTimeUnit"] = "ms";
+  trace["otherData"]       = other;
+
+  std::string trace_file = out_prefix + "-" + m_prog_name + "-trace.json";
+  std::ofstream ofs(trace_file.c_str());
+  if (!ofs.good()) {
+    vw::vw_out(vw::WarningMessage) << "Cannot write: " << trace_file << "\n";
+  } else {
+    ofs << trace.dump(1) << "\n";
+    vw::vw_out() << "Wrote: " << trace_file << "\n";
+  }
+
+  m_events.clear();
+}
+
+} // end local namespace
+
+void startTracing(std::string const& prog_name) {
+  tracer().start(prog_name);
+  g_tracing_enabled = true;
+}
+
+bool tracingEnabled() {
+  return g_tracing_enabled;
+}
+
+void saveTrace(std::string const& out_prefix) {
+  if (!tracingEnabled())
+    return;
+  tracer().save(out_prefix);
+}
+
+bool processIoBytes(std::int64_t & read_bytes, std::int64_t & written_bytes) {
+  read_bytes = -1;
+  written_bytes = -1;
+
+  // The rchar and wchar fields count all bytes passed to read() and write()
+  std::ifstream ifs("/proc/self/io");
+  std::string key;
+  std::int64_t val = 0;
+  while (ifs >> key >> val) {
+    if (key == "rchar:")
+      read_bytes = val;
+    else if (key == "wchar:")
+      written_bytes = val;
+  }
+
+  return read_bytes >= 0 && written_bytes >= 0;
+}
+
+ScopedTrace::ScopedTrace(std::string const& name, std::string const& category):
+  m_enabled(tracingEnabled()), m_start_us(0), m_read_bytes(-1), m_written_bytes(-1) {
+  if (!m_enabled)
+    return;
+
+  m_name = name;
+  m_category = category;
+  processIoBytes(m_read_bytes, m_written_bytes);
+  m_start_us = nowUs();
+}
+
+ScopedTrace::~ScopedTrace() {
+  if (!m_enabled)
+    return;
+
+  TraceEvent event;
+  event.name = m_name;
+  event.category = m_category;
+  event.start_us = m_start_us;
+  event.duration_us = nowUs() - m_start_us;
+  event.tid = 0;
+  event.peak_rss_mb = peak_memory_mb();
+  event.read_bytes = -1;
+  event.written_bytes = -1;
+  std::int64_t read_bytes = 0, written_bytes = 0;
+  if (m_read_bytes >= 0 && processIoBytes(read_bytes, written_bytes)) {
+    event.read_bytes = read_bytes - m_read_bytes;
+    event.written_bytes = written_bytes - m_written_bytes;
+  }
+
+  tracer().add(event);
+}
+
+} // end namespace asp
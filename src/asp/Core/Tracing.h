@@ -0,0 +1,67 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file Tracing.h
+///
+/// Record how long the main functions of the stereo steps take, together
+/// with the peak memory usage and the bytes read and written by the process,
+/// and save this in the Chrome trace format (chrome://tracing, Perfetto).
+/// This is turned on with the --trace option. Otherwise the timers only
+/// check a flag.
+///
+#ifndef __ASP_CORE_TRACING_H__
+#define __ASP_CORE_TRACING_H__
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace asp {
+
+  /// Start recording the events. The program name is used for the name of
+  /// the trace file.
+  void startTracing(std::string const& prog_name);
+
+  /// If the events are being recorded.
+  bool tracingEnabled();
+
+  /// Save the events recorded so far to <out_prefix>-<prog_name>-trace.json,
+  /// and start anew. Do nothing if tracing is not enabled.
+  void saveTrace(std::string const& out_prefix);
+
+  /// The number of bytes read and written so far by this process, including
+  /// from the page cache. Return false if this is not known, as on OSX.
+  bool processIoBytes(std::int64_t & read_bytes, std::int64_t & written_bytes);
+
+  /// Time the current scope, and record the bytes read and written by the
+  /// process in the meantime. If other threads do I/O at the same time,
+  /// that will be counted as well.
+  class ScopedTrace: private boost::noncopyable {
+  public:
+    ScopedTrace(std::string const& name, std::string const& category = "stereo");
+    ~ScopedTrace();
+  private:
+    bool m_enabled;
+    std::string m_name, m_category;
+    std::int64_t m_start_us;
+    std::int64_t m_read_bytes, m_written_bytes;
+  };
+
+} // end namespace asp
+
+#endif // __ASP_CORE_TRACING_H__
@@ -0,0 +1,113 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Core/MedianFilter.h>
+
+#include <vw/Image/ImageView.h>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace vw;
+
+namespace {
+
+// Random values with few distinct levels, so that ties occur, and some
+// invalid pixels
+void makeData(int cols, int rows, ImageView<float> & img, ImageView<uint8> & valid) {
+  img.set_size(cols, rows);
+  valid.set_size(cols, rows);
+  srand(0);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      img(col, row)   = 0.25 * (rand() % 40) - 3.0;
+      valid(col, row) = (rand() % 7 != 0);
+    }
+  }
+}
+
+// The median of the valid values in a window clipped to the image
+void bruteForce(ImageView<float> const& img, ImageView<uint8> const& valid,
+                int kernel_size, int col, int row, float & val, bool & is_valid) {
+  is_valid = valid(col, row);
+  if (!is_valid)
+    return;
+  int r = kernel_size/2;
+  std::vector<float> vals;
+  for (int c = std::max(col - r, 0); c <= std::min(col + r, img.cols() - 1); c++) {
+    for (int l = std::max(row - r, 0); l <= std::min(row + r, img.rows() - 1); l++) {
+      if (valid(c, l))
+        vals.push_back(img(c, l));
+    }
+  }
+  std::sort(vals.begin(), vals.end());
+  val = vals[vals.size()/2];
+}
+
+} // end anonymous namespace
+
+TEST(MedianFilter, AgreesWithBruteForce) {
+
+  ImageView<float> img, out;
+  ImageView<uint8> valid, out_valid;
+  makeData(301, 157, img, valid); // several tiles, not multiples of the tile size
+
+  int kernel_sizes[] = {3, 7, 15, 41};
+  asp::MedianFilterMethod methods[] = {asp::MEDIAN_DIRECT, asp::MEDIAN_HISTOGRAM};
+  for (int k = 0; k < 4; k++) {
+    for (int m = 0; m < 2; m++) {
+      asp::median_filter(img, valid, kernel_sizes[k], out, out_valid, 4, methods[m]);
+      ASSERT_EQ(out.cols(), img.cols());
+      ASSERT_EQ(out.rows(), img.rows());
+      for (int row = 0; row < img.rows(); row += 3) {
+        for (int col = 0; col < img.cols(); col += 3) {
+          float val = 0;
+          bool is_valid = false;
+          bruteForce(img, valid, kernel_sizes[k], col, row, val, is_valid);
+          ASSERT_EQ(bool(out_valid(col, row)), is_valid);
+          if (is_valid)
+            EXPECT_EQ(out(col, row), val);
+        }
+      }
+    }
+  }
+}
+
+TEST(MedianFilter, Disparity) {
+
+  ImageView<PixelMask<Vector2f>> disp(50, 40), out;
+  for (int row = 0; row < disp.rows(); row++) {
+    for (int col = 0; col < disp.cols(); col++) {
+      disp(col, row) = PixelMask<Vector2f>(Vector2f(col, -row));
+      if ((col + row) % 11 == 0)
+        disp(col, row).invalidate();
+    }
+  }
+
+  // A median filter preserves a linear ramp away from the boundary
+  asp::disparity_median_filter(disp, 5, out, 2);
+  EXPECT_FALSE(is_valid(out(11, 0)));
+  EXPECT_TRUE(is_valid(out(20, 20)));
+  EXPECT_EQ(out(20, 20).child()[0], 20.0f);
+  EXPECT_EQ(out(20, 20).child()[1], -20.0f);
+
+  // Size less than 2 makes a copy
+  asp::disparity_median_filter(disp, 1, out);
+  EXPECT_EQ(out(7, 9).child(), disp(7, 9).child());
+}
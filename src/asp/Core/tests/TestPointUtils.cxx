@@ -19,6 +19,9 @@
 #include <test/Helpers.h>
 #include <asp/Core/PointUtils.h>
 
+#include <boost/filesystem.hpp>
+#include <fstream>
+
 using namespace vw;
 using namespace asp;
 
@@ -127,6 +130,57 @@ TEST( PointUtils, CsvConv ) {
   
 }
 
+// The parallel file reader must produce the same records as parsing
+// the lines one at a time.
+TEST( PointUtils, CsvReadFile ) {
+
+  CsvConv conv;
+  conv.parse_csv_format("2:file 3:lon 4:lat 5:height_above_datum", "");
+  EXPECT_TRUE(conv.is_configured());
+
+  std::vector<std::string> lines;
+  lines.push_back("id, name, lon, lat, height"); // header
+  lines.push_back("# A comment");
+  lines.push_back("1, a.tif, 10.5, 20.25, 100");
+  lines.push_back("");
+  lines.push_back("2\tb.tif\t-11.5\t-21.25\t-200.125");
+  lines.push_back("3, c.tif, bad, 22, 300");
+  lines.push_back("   ");
+  lines.push_back("4, d.tif, 13, 23, 400, 5, 6");
+
+  std::string file = "test_csv_read_file.csv";
+  {
+    std::ofstream ofs(file.c_str());
+    for (size_t it = 0; it < lines.size(); it++)
+      ofs << lines[it] << "\n";
+  }
+
+  std::vector<CsvConv::CsvRecord> expected;
+  bool is_first_line = true;
+  for (size_t it = 0; it < lines.size(); it++) {
+    bool success = false;
+    CsvConv::CsvRecord vals = conv.parse_csv_line(is_first_line, success, lines[it]);
+    if (success)
+      expected.push_back(vals);
+  }
+  ASSERT_EQ(3u, expected.size());
+
+  std::vector<CsvConv::CsvRecord> records;
+  EXPECT_EQ(expected.size(), conv.read_csv_file(file, records));
+  ASSERT_EQ(expected.size(), records.size());
+  for (size_t it = 0; it < records.size(); it++) {
+    EXPECT_EQ(expected[it].file, records[it].file);
+    EXPECT_VECTOR_NEAR(expected[it].point_data, records[it].point_data, 1e-16);
+  }
+  EXPECT_EQ("b.tif", records[1].file);
+  EXPECT_EQ(-200.125, records[1].point_data[2]);
+
+  std::list<CsvConv::CsvRecord> record_list;
+  EXPECT_EQ(expected.size(), conv.read_csv_file(file, record_list));
+
+  boost::filesystem::remove(file);
+}
+
 // Open up an ascii style PCD file and make sure we can read all of the values from it.
 TEST( PointUtils, PcdReader ) {
 
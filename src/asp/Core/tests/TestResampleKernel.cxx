@@ -0,0 +1,133 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Core/ResampleKernel.h>
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Interpolation.h>
+#include <vw/Image/EdgeExtension.h>
+#include <vw/Image/PixelMask.h>
+
+#include <vector>
+#include <cstdlib>
+#include <limits>
+
+using namespace vw;
+
+namespace {
+
+// A smooth image with a few invalid pixels, and random locations, some
+// of them outside the image.
+void makeData(int cols, int rows, int num, ImageView<float> & img,
+              std::vector<float> & xs, std::vector<float> & ys) {
+  img.set_size(cols, rows);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++)
+      img(col, row) = 100.0 + 50.0 * sin(0.1 * col) * cos(0.07 * row);
+  }
+  img(cols/2, rows/2) = std::numeric_limits<float>::quiet_NaN();
+  img(3, rows - 4)    = std::numeric_limits<float>::quiet_NaN();
+
+  srand(0);
+  xs.resize(num);
+  ys.resize(num);
+  for (int i = 0; i < num; i++) {
+    xs[i] = -3.0 + (cols + 6.0) * double(rand()) / RAND_MAX;
+    ys[i] = -3.0 + (rows + 6.0) * double(rand()) / RAND_MAX;
+  }
+}
+
+// The reference result, using VW interpolation of masked pixels
+template <class InterpT>
+void vwResample(ImageView<float> const& img, std::vector<float> const& xs,
+                std::vector<float> const& ys, std::vector<float> & out) {
+  ImageView<PixelMask<float>> masked(img.cols(), img.rows());
+  for (int row = 0; row < img.rows(); row++) {
+    for (int col = 0; col < img.cols(); col++) {
+      if (!std::isnan(img(col, row)))
+        masked(col, row) = PixelMask<float>(img(col, row));
+    }
+  }
+  PixelMask<float> invalid;
+  invalid.invalidate();
+  ImageViewRef<PixelMask<float>> interp
+    = interpolate(masked, InterpT(), ValueEdgeExtension<PixelMask<float>>(invalid));
+  out.resize(xs.size());
+  for (size_t i = 0; i < xs.size(); i++) {
+    PixelMask<float> val = interp(xs[i], ys[i]);
+    out[i] = is_valid(val) ? val.child() : std::numeric_limits<float>::quiet_NaN();
+  }
+}
+
+void compare(std::vector<float> const& a, std::vector<float> const& b, double tol,
+             int & num_valid) {
+  ASSERT_EQ(a.size(), b.size());
+  num_valid = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    EXPECT_EQ(std::isnan(a[i]), std::isnan(b[i])) << "at location " << i;
+    if (!std::isnan(a[i]) && !std::isnan(b[i])) {
+      EXPECT_NEAR(a[i], b[i], tol);
+      num_valid++;
+    }
+  }
+}
+
+} // end anonymous namespace
+
+TEST(ResampleKernel, SimdAgreesWithScalar) {
+
+  ImageView<float> img;
+  std::vector<float> xs, ys;
+  makeData(67, 45, 10003, img, xs, ys); // not a multiple of the SIMD width
+  xs[7] = std::numeric_limits<float>::quiet_NaN();
+
+  asp::ResampleMethod methods[] = {asp::RESAMPLE_BILINEAR, asp::RESAMPLE_BICUBIC};
+  for (int m = 0; m < 2; m++) {
+    std::vector<float> a(xs.size()), b(xs.size());
+    asp::resampleBlock(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0], xs.size(),
+                       methods[m], &a[0]);
+    asp::resampleBlockScalar(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0], xs.size(),
+                             methods[m], &b[0]);
+    int num_valid = 0;
+    compare(a, b, 0.0, num_valid);
+    EXPECT_GT(num_valid, 0);
+    EXPECT_TRUE(std::isnan(a[7]));
+  }
+}
+
+TEST(ResampleKernel, AgreesWithVW) {
+
+  ImageView<float> img;
+  std::vector<float> xs, ys;
+  makeData(67, 45, 5000, img, xs, ys);
+
+  std::vector<float> a(xs.size()), b;
+  int num_valid = 0;
+
+  asp::resampleBlock(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0], xs.size(),
+                     asp::RESAMPLE_BILINEAR, &a[0]);
+  vwResample<BilinearInterpolation>(img, xs, ys, b);
+  compare(a, b, 1e-3, num_valid);
+  EXPECT_GT(num_valid, 0);
+
+  asp::resampleBlock(&img(0, 0), img.cols(), img.rows(), &xs[0], &ys[0], xs.size(),
+                     asp::RESAMPLE_BICUBIC, &a[0]);
+  vwResample<BicubicInterpolation>(img, xs, ys, b);
+  compare(a, b, 1e-3, num_valid);
+  EXPECT_GT(num_valid, 0);
+}
@@ -277,8 +277,10 @@ ColorAxesData(imageData & image, double min_x, double min_y, double max_x, doubl
   bool poly_or_xyz = (m_image.m_isPoly || m_image.m_isCsv);
   if (poly_or_xyz) {
     m_nodata_val = -std::numeric_limits<double>::max();
-    if (std::isnan(m_min_val) || std::isnan(m_max_val)) 
-      findRobustBounds(m_image.scattered_data, m_min_val, m_max_val);
+    if (std::isnan(m_min_val) || std::isnan(m_max_val)) {
+      m_min_val = m_image.robust_val_range[0];
+      m_max_val = m_image.robust_val_range[1];
+    }
   } else {
     auto const& img = m_image.img.m_img_ch1_double;
     if (img.planes() != 1)
@@ -407,16 +409,28 @@ void drawScatteredData(imageData         const & image,
   if (den <= 0.0)
     den = 1.0;
 
-  for (size_t pt_it = 0; pt_it < image.scattered_data.size(); pt_it++) {
-    auto const& P = image.scattered_data[pt_it];
+  // Visit only the data in view, at about the resolution of the plotted points
+  vw::BBox2 data_box;
+  data_box.grow(vw::Vector2(xMap.invTransform(0), yMap.invTransform(0)));
+  data_box.grow(vw::Vector2(xMap.invTransform(canvasRect.width()),
+                            yMap.invTransform(canvasRect.height())));
+  double pix_size = std::max(std::abs(xMap.invTransform(1) - xMap.invTransform(0)),
+                             std::abs(yMap.invTransform(1) - yMap.invTransform(0)));
+  data_box.expand((r + 1) * pix_size);
+  std::vector<ScatteredBin> bins;
+  image.scattered_index.select(data_box, pix_size * std::max(r, 1),
+                               image.scattered_data, bins);
+
+  for (size_t it = 0; it < bins.size(); it++) {
+    ScatteredBin const& b = bins[it];
 
     // Find the location on the screen. Adjust for the canvas offset.
     QPointF q;
-    q.setX(xMap.transform(P.x()) + canvasRect.left());
-    q.setY(yMap.transform(P.y()) + canvasRect.top());
+    q.setX(xMap.transform(b.x) + canvasRect.left());
+    q.setY(yMap.transform(b.y) + canvasRect.top());
   
     // Find the scaled intensity
-    double val = P.z();
+    double val = b.mean_val;
     if (val != val || val == nodata_val) 
       val = nodata_plot_val;
     else if (val < min_val)
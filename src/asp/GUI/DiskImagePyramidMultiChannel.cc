@@ -16,12 +16,15 @@
 // __END_LICENSE__
 
 #include <asp/GUI/DiskImagePyramidMultiChannel.h>
+#include <asp/GUI/PyramidCache.h>
 #include <asp/Core/StereoSettings.h>
 #include <vw/Core/Stopwatch.h>
 #include <QtWidgets>
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <limits>
 
 using namespace vw;
 using namespace vw::gui;
@@ -42,21 +45,33 @@ TemporaryFiles& temporary_files() {
 DiskImagePyramidMultiChannel::
 DiskImagePyramidMultiChannel(std::string const& image_file,
  vw::GdalWriteOptions const& opt,
-                             int top_image_max_pix, int subsample):
+                             int top_image_max_pix, int subsample,
+                             bool base_level_only):
   m_opt(opt), m_num_channels(0), m_rows(0), m_cols(0), m_type(UNINIT) {
   
   if (image_file == "")
     return;
 
   // alias
-  int & lowres_size = asp::stereo_settings().lowest_resolution_subimage_num_pixels;
-  if (lowres_size <= 0) // bug fix, longer term need to improve the workflow
-    lowres_size = 1000 * 1000;
+  int & settings_lowres_size = asp::stereo_settings().lowest_resolution_subimage_num_pixels;
+  if (settings_lowres_size <= 0) // bug fix, longer term need to improve the workflow
+    settings_lowres_size = 1000 * 1000;
 
   boost::shared_ptr<DiskImageResource> image_rsrc
     = vw::DiskImageResourcePtr(image_file);
   ImageFormat image_fmt = image_rsrc->format();
 
+  // A single level if the coarsest one can be as large as the image
+  int lowres_size = settings_lowres_size;
+  if (base_level_only)
+    lowres_size = std::max<vw::int64>(lowres_size,
+                                      std::min<vw::int64>(std::numeric_limits<int>::max(),
+                                                          vw::int64(image_fmt.cols) *
+                                                          image_fmt.rows));
+
+  // Files in the cache directory persist across sessions
+  bool is_temporary = !isInCacheDir(image_file);
+
   // Redirect to the correctly typed function to perform the actual map projection.
   // - Must correspond to the type of the input image.
   // Instantiate the correct DiskImagePyramid then record information including
@@ -78,8 +93,9 @@ DiskImagePyramidMultiChannel(std::string const& image_file,
       m_rows = m_img_ch1_double.rows();
       m_cols = m_img_ch1_double.cols();
       m_type = CH1_DOUBLE;
-      temporary_files().files.insert(m_img_ch1_double.get_temporary_files().begin(), 
-                                     m_img_ch1_double.get_temporary_files().end());
+      if (is_temporary)
+        temporary_files().files.insert(m_img_ch1_double.get_temporary_files().begin(), 
+                                       m_img_ch1_double.get_temporary_files().end());
     }else if (m_num_channels == 2) {
       // uint8 image with an alpha channel.
       m_img_ch2_uint8 = vw::mosaic::DiskImagePyramid<Vector<vw::uint8, 2>>
@@ -88,8 +104,9 @@ DiskImagePyramidMultiChannel(std::string const& image_file,
       m_rows = m_img_ch2_uint8.rows();
       m_cols = m_img_ch2_uint8.cols();
       m_type = CH2_UINT8;
-      temporary_files().files.insert(m_img_ch2_uint8.get_temporary_files().begin(), 
-                                     m_img_ch2_uint8.get_temporary_files().end());
+      if (is_temporary)
+        temporary_files().files.insert(m_img_ch2_uint8.get_temporary_files().begin(), 
+                                       m_img_ch2_uint8.get_temporary_files().end());
     } else if (m_num_channels == 3) {
       // RGB image with three uint8 channels.
       m_img_ch3_uint8 = vw::mosaic::DiskImagePyramid<Vector<vw::uint8, 3>>
@@ -98,8 +115,9 @@ DiskImagePyramidMultiChannel(std::string const& image_file,
       m_rows = m_img_ch3_uint8.rows();
       m_cols = m_img_ch3_uint8.cols();
       m_type = CH3_UINT8;
-      temporary_files().files.insert(m_img_ch3_uint8.get_temporary_files().begin(), 
-                                     m_img_ch3_uint8.get_temporary_files().end());
+      if (is_temporary)
+        temporary_files().files.insert(m_img_ch3_uint8.get_temporary_files().begin(), 
+                                       m_img_ch3_uint8.get_temporary_files().end());
     } else if (m_num_channels == 4) {
       // RGB image with three uint8 channels and an alpha channel
       m_img_ch4_uint8 = vw::mosaic::DiskImagePyramid<Vector<vw::uint8, 4>>
@@ -108,8 +126,9 @@ DiskImagePyramidMultiChannel(std::string const& image_file,
       m_rows = m_img_ch4_uint8.rows();
       m_cols = m_img_ch4_uint8.cols();
       m_type = CH4_UINT8;
-      temporary_files().files.insert(m_img_ch4_uint8.get_temporary_files().begin(), 
-                                     m_img_ch4_uint8.get_temporary_files().end());
+      if (is_temporary)
+        temporary_files().files.insert(m_img_ch4_uint8.get_temporary_files().begin(), 
+                                       m_img_ch4_uint8.get_temporary_files().end());
     }else{
       vw_throw(ArgumentErr() << "Unsupported image with " << m_num_channels
                << " bands.\n");
@@ -169,12 +169,14 @@ namespace vw { namespace gui {
     int m_rows, m_cols;
     ImgType m_type; // keeps track of which of the above images we use
 
-    // Constructor
+    // Constructor. With base_level_only, no lower-resolution levels are
+    // created, so this is fast, but rendering a large image zoomed out is slow.
     DiskImagePyramidMultiChannel(std::string const& image_file = "",
                                  vw::GdalWriteOptions const&
                                  opt = vw::GdalWriteOptions(),
                                  int top_image_max_pix = 1000*1000,
-                                 int subsample = 2);
+                                 int subsample = 2,
+                                 bool base_level_only = false);
 
     // This function will return a QImage to be shown on screen.
     // How we create it, depends on the type of image we want to display.
@@ -41,6 +41,7 @@
 #include <vw/Core/Stopwatch.h>
 
 #include <asp/GUI/GuiUtilities.h>
+#include <asp/GUI/WidgetBase.h> // for findRobustBounds()
 #include <asp/Core/StereoSettings.h>
 #include <asp/Core/PointUtils.h>
 #include <asp/GUI/chooseFilesDlg.h>
@@ -130,8 +131,31 @@ bool write_hillshade(vw::GdalWriteOptions const& opt,
   oss << "_hillshade_a" << azimuth << "_e" << elevation << ".tif"; 
   std::string suffix = oss.str();
 
-  output_file = vw::mosaic::filename_from_suffix1(input_file, suffix);
   bool align_light_to_georef = false;
+
+  // Use the cache directory if enabled. The file is reused in later sessions.
+  std::string view_params = suffix;
+  output_file = cachedViewFile(input_file, view_params, "_hillshade.tif");
+  if (output_file != "") {
+    if (fs::exists(output_file))
+      return true;
+    std::string tmp_file = cacheTmpFile(output_file);
+    try {
+      vw_out() << "Writing: " << output_file << std::endl;
+      vw::cartography::do_multitype_hillshade(input_file, tmp_file, azimuth, elevation,
+                                              scale, nodata_val, blur_sigma,
+                                              align_light_to_georef);
+      commitCachedFile(tmp_file, output_file);
+      return true;
+    } catch(...) {
+      // Fall back to writing next to the input or in the current dir
+      vw_out() << "Failed to write: " << output_file << "\n";
+      boost::system::error_code ec;
+      fs::remove(tmp_file, ec);
+    }
+  }
+
+  output_file = vw::mosaic::filename_from_suffix1(input_file, suffix);
   try {
     DiskImageView<float> input(input_file);
     // TODO(oalexan1): Factor out repeated logic below.
@@ -664,6 +688,16 @@ void parseCsvHeader(std::string const& file, std::string & wkt,
 // Load the image is not loaded so far
 void imageData::load() {
 
+  // Use the pyramids which got built in the background since the last call
+  if (loaded_regular)
+    pyramidBuilder().take(name, img);
+  if (loaded_hillshaded)
+    pyramidBuilder().take(hillshaded_name, hillshaded_img);
+  if (loaded_thresholded)
+    pyramidBuilder().take(thresholded_name, thresholded_img);
+  if (loaded_colorized)
+    pyramidBuilder().take(colorized_name, colorized_img);
+
   // Loaded data need not be reloaded
   if (m_display_mode == REGULAR_VIEW) {
     if (loaded_regular) 
@@ -769,27 +803,26 @@ void imageData::load() {
     if (isPoly) {
       formPoly(color, contiguous_blocks, colors, scattered_data, polyVec);
       scattered_data.clear(); // the data is now in the poly structure
+    } else {
+      // Do the expensive work once, rather than at each repaint
+      findRobustBounds(scattered_data, robust_val_range[0], robust_val_range[1]);
+      scattered_index.build(scattered_data);
     }
     
   }else{
-    // Read an image
-    int top_image_max_pix = 1000*1000;
-    int subsample = 4;
+    // Read an image. Its pyramid may be cached or built in the background.
     has_georef = vw::cartography::read_georeference(georef, name);
     if (m_display_mode == REGULAR_VIEW) {
-      img = DiskImagePyramidMultiChannel(name, m_opt, top_image_max_pix, subsample);
+      img = loadPyramid(name, m_opt);
       image_bbox = BBox2(0, 0, img.cols(), img.rows());
     } else if (m_display_mode == HILLSHADED_VIEW) {
-      hillshaded_img = DiskImagePyramidMultiChannel(hillshaded_name, m_opt,
-                                                    top_image_max_pix, subsample);
+      hillshaded_img = loadPyramid(hillshaded_name, m_opt);
       image_bbox = BBox2(0, 0, hillshaded_img.cols(), hillshaded_img.rows());
     } else if (m_display_mode == THRESHOLDED_VIEW) {
-      thresholded_img = DiskImagePyramidMultiChannel(thresholded_name, m_opt,
-                                                     top_image_max_pix, subsample);
+      thresholded_img = loadPyramid(thresholded_name, m_opt);
       image_bbox = BBox2(0, 0, thresholded_img.cols(), thresholded_img.rows());
     } else if (m_display_mode == COLORIZED_VIEW) {
-      colorized_img = DiskImagePyramidMultiChannel(colorized_name, m_opt,
-                                                     top_image_max_pix, subsample);
+      colorized_img = loadPyramid(colorized_name, m_opt);
       image_bbox = BBox2(0, 0, colorized_img.cols(), colorized_img.rows());
     }
   }
@@ -36,6 +36,8 @@
 // ASP
 #include <asp/Core/Common.h>
 #include <asp/GUI/DiskImagePyramidMultiChannel.h>
+#include <asp/GUI/ScatteredDataIndex.h>
+#include <asp/GUI/PyramidCache.h>
 
 // Vision Workbench
 #include <vw/Core/Thread.h>
@@ -128,8 +130,11 @@ namespace vw { namespace gui {
     bool colorbar; // if a given image must be colorized
     
     // Scattered data to be plotted at (x, y) location with z giving
-    // the intensity. May be colorized.
+    // the intensity. May be colorized. Indexed for fast drawing. The
+    // range of values without outliers is found once at load time.
     std::vector<vw::Vector3> scattered_data;
+    ScatteredDataIndex       scattered_index;
+    vw::Vector2              robust_val_range;
     
     imageData(): m_display_mode(REGULAR_VIEW), has_georef(false),
                  loaded_regular(false), loaded_hillshaded(false),
@@ -187,6 +192,20 @@ private:
                                         bool has_nodata,
                                         double nodata_val);
 
+  // Same as write_in_orig_or_curr_dir(), but if the cache directory is
+  // enabled write the image there, named after the input file and the view
+  // parameters, unless such a file exists already.
+  template<class PixelT>
+  std::string write_cached_view(vw::GdalWriteOptions const& opt,
+                                ImageViewRef<PixelT> & image,
+                                std::string const& input_file,
+                                std::string const& view_params,
+                                std::string const& suffix,
+                                bool has_georef,
+                                vw::cartography::GeoReference const & georef,
+                                bool has_nodata,
+                                double nodata_val);
+
   // Find the closest point in a given vector of polygons to a given point.
   void findClosestPolyVertex(// inputs
 			     double x0, double y0,
@@ -284,6 +303,41 @@ std::string write_in_orig_or_curr_dir(vw::GdalWriteOptions const& opt,
   return output_file;
 }
 
+template<class PixelT>
+std::string write_cached_view(vw::GdalWriteOptions const& opt,
+                              ImageViewRef<PixelT> & image,
+                              std::string const& input_file,
+                              std::string const& view_params,
+                              std::string const& suffix,
+                              bool has_georef,
+                              vw::cartography::GeoReference const & georef,
+                              bool has_nodata,
+                              double nodata_val) {
+
+  std::string output_file = cachedViewFile(input_file, view_params, suffix);
+  if (output_file == "")
+    return write_in_orig_or_curr_dir(opt, image, input_file, suffix,
+                                     has_georef, georef, has_nodata, nodata_val);
+  if (fs::exists(output_file))
+    return output_file;
+
+  std::string tmp_file = cacheTmpFile(output_file);
+  TerminalProgressCallback tpc("asp", ": ");
+  vw_out() << "Writing: " << output_file << std::endl;
+  try {
+    vw::cartography::block_write_gdal_image(tmp_file, image, has_georef, georef,
+                                            has_nodata, nodata_val, opt, tpc);
+    commitCachedFile(tmp_file, output_file);
+  } catch(...) {
+    vw_out() << "Failed to write: " << output_file << "\n";
+    boost::system::error_code ec;
+    fs::remove(tmp_file, ec);
+    return write_in_orig_or_curr_dir(opt, image, input_file, suffix,
+                                     has_georef, georef, has_nodata, nodata_val);
+  }
+  return output_file;
+}
+
 // See if we are in the mode where the images are displayed side-by-side with a
 // dialog to choose which ones to display.
 bool sideBySideWithDialog();
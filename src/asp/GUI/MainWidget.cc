@@ -669,21 +669,25 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
         = apply_mask(create_mask_less_or_equal(DiskImageView<double>(input_file),
                                                nodata_val), nodata_val);
 
-      // TODO(oalexan1): Need to do something like in write_hillshade()
-      // so that we don't have to always re-write the thresholded image.
+      // If the cache is enabled, an image with this threshold is written
+      // only once, and reused in later sessions.
       std::string suffix = "_thresh.tif";
+      std::ostringstream view_params;
+      view_params.precision(17);
+      view_params << "thresh " << nodata_val;
       bool has_nodata = true;
       std::string thresholded_file
-        = write_in_orig_or_curr_dir(m_opt,
-                                    thresh_image, input_file, suffix,
-                                    m_images[image_iter].has_georef,
-                                    m_images[image_iter].georef,
-                                    has_nodata, nodata_val);
+        = write_cached_view(m_opt,
+                            thresh_image, input_file, view_params.str(), suffix,
+                            m_images[image_iter].has_georef,
+                            m_images[image_iter].georef,
+                            has_nodata, nodata_val);
 
       // Read it back right away
       m_images[image_iter].loaded_thresholded = false; // force reload
       m_images[image_iter].read(thresholded_file, m_opt, THRESHOLDED_VIEW);
-      temporary_files().files.insert(thresholded_file);
+      if (!isInCacheDir(thresholded_file))
+        temporary_files().files.insert(thresholded_file);
     }
 
     // We may not want to refresh the pixmap right away if we are going to
@@ -754,7 +758,8 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
       }
 
       m_images[image_iter].read(hillshaded_file, m_opt, HILLSHADED_VIEW);
-      temporary_files().files.insert(hillshaded_file);
+      if (!isInCacheDir(hillshaded_file))
+        temporary_files().files.insert(hillshaded_file);
     }
   }
 
@@ -833,6 +838,11 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
     refreshPixmap();
   }
 
+  void MainWidget::refreshPyramids(){
+    // The images pick up the new pyramids when loaded for drawing
+    refreshPixmap();
+  }
+
   void MainWidget::zoomToImage() {
 
     for (auto it = m_indicesWithAction.begin(); it != m_indicesWithAction.end(); it++) {
@@ -1301,17 +1311,22 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
   } // End function drawInterestPoints
   
   // Draw irregular xyz data to be plotted at (x, y) location with z giving
-  // the intensity. May be colorized.
+  // the intensity. May be colorized. Only the data in view is visited, at
+  // about the screen resolution, with nearby points merged and colored by
+  // their mean value. It is rasterized into an image which is then drawn.
   void MainWidget::drawScatteredData(QPainter* paint, int image_index) {
     
     int r = asp::stereo_settings().plot_point_radius;
+    imageData const& image = m_images[image_index];
 
-    // If set, use --min and --max values. Otherwise, find them and 
-    // remove outliers along the way to not skew the plotting range.
+    // If set, use --min and --max values. Otherwise, use the range found
+    // at load time, with outliers removed.
     double min_val = asp::stereo_settings().min;
     double max_val = asp::stereo_settings().max;
-    if (std::isnan(min_val) || std::isnan(max_val)) 
-      findRobustBounds(m_images[image_index].scattered_data, min_val, max_val);
+    if (std::isnan(min_val) || std::isnan(max_val)) {
+      min_val = image.robust_val_range[0];
+      max_val = image.robust_val_range[1];
+    }
     
     std::map<float, vw::cm::Vector3u> lut_map;
     try {
@@ -1322,16 +1337,50 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
       vw::cm::parse_color_style(m_images[image_index].colormap, lut_map);
     }
     vw::cm::Colormap colormap(lut_map);
-      
-    for (size_t pt_it = 0; pt_it < m_images[image_index].scattered_data.size(); pt_it++) {
-      auto const& P = m_images[image_index].scattered_data[pt_it];
 
-      vw::Vector2 world_P = projpoint2world(subvector(P, 0, 2), image_index);
+    if (m_window_width <= 0 || m_window_height <= 0)
+      return;
+
+    // The region in view, in the coordinates of the data. Sample the
+    // boundary, as the transform need not be linear.
+    BBox2 data_box;
+    int num = 10;
+    for (int i = 0; i <= num; i++) {
+      for (int j = 0; j <= num; j++) {
+        if (i != 0 && i != num && j != 0 && j != num)
+          continue;
+        Vector2 world = m_current_view.min()
+          + elem_prod(Vector2(double(i)/num, double(j)/num), m_current_view.size());
+        Vector2 proj = world2projpoint(world, image_index);
+        if (proj == proj) // not NaN
+          data_box.grow(proj);
+      }
+    }
+    if (data_box.empty())
+      return;
+
+    // The size of a screen pixel in data units. Don't draw bins much
+    // smaller than a plotted point.
+    double pix_size = std::max(data_box.width()  / m_window_width,
+                               data_box.height() / m_window_height);
+    data_box.expand((r + 1) * pix_size);
+    std::vector<ScatteredBin> bins;
+    image.scattered_index.select(data_box, pix_size * std::max(r, 1),
+                                 image.scattered_data, bins);
+
+    QImage buffer(m_window_width, m_window_height, QImage::Format_ARGB32_Premultiplied);
+    buffer.fill(Qt::transparent);
+    for (size_t it = 0; it < bins.size(); it++) {
+      ScatteredBin const& b = bins[it];
+
+      vw::Vector2 world_P = projpoint2world(Vector2(b.x, b.y), image_index);
       Vector2 screen_P = world2screen(world_P);
-      QPoint Q(screen_P.x(), screen_P.y());
+      int x0 = round(screen_P.x()), y0 = round(screen_P.y());
+      if (x0 < -r || x0 >= m_window_width + r || y0 < -r || y0 >= m_window_height + r)
+        continue;
 
       // Scale the intensity to [0, 1]
-      double s = (P[2] - min_val) / (max_val - min_val);
+      double s = (b.mean_val - min_val) / (max_val - min_val);
       if (max_val <= min_val) 
         s = 0.0; // degenerate case
       if (s > 1.0)
@@ -1339,23 +1388,28 @@ BBox2 MainWidget::expand_box_to_keep_aspect_ratio(BBox2 const& box) {
       if (s < 0.0)
         s = 0.0;
 
-      QColor c;
+      QRgb c;
       if (asp::stereo_settings().colorize) {
         // Get the color from the colormap
         PixelRGB<uint8> v = colormap(s).child();
-        c = QColor(v[0], v[1], v[2]);
+        c = qRgb(v[0], v[1], v[2]);
       } else {
         // Grayscale color
-        s = round(255.0 * s);
-        c = QColor(s, s, s);
+        int g = round(255.0 * s);
+        c = qRgb(g, g, g);
       }
 
       // Draw the ball
-      paint->setPen(QPen(c));
-      paint->setBrush(QBrush(c));
-      paint->drawEllipse(Q, r, r); 
+      for (int y = std::max(y0 - r, 0); y <= std::min(y0 + r, m_window_height - 1); y++) {
+        QRgb * line = reinterpret_cast<QRgb*>(buffer.scanLine(y));
+        for (int x = std::max(x0 - r, 0); x <= std::min(x0 + r, m_window_width - 1); x++) {
+          if ((x - x0) * (x - x0) + (y - y0) * (y - y0) <= r * r + r)
+            line[x] = c;
+        }
+      }
     }
 
+    paint->drawImage(0, 0, buffer);
     return;
   }
   
@@ -186,6 +186,7 @@ public slots:
     void toggleHillshadeImageRightClick(); ///< Turn on/off hillshading on right-click on image
     void toggleHillshadeFromImageList(); ///< Toggle hillshade by right-click on image list
     void refreshHillshade       (); ///< Update the display if the state of hillshading changed.
+    void refreshPyramids        (); ///< Redraw once pyramids built in the background are ready.
     void bringImageOnTopSlot    (); ///< Show this image on top of other images.
     void pushImageToBottomSlot  (); ///< Show all other images on top of this
     void zoomToImage            (); ///< Zoom to have this image in full view.
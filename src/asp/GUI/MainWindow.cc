@@ -26,6 +26,7 @@
 #include <asp/Core/StereoSettings.h>
 #include <asp/GUI/chooseFilesDlg.h>
 #include <asp/GUI/ColorAxes.h>
+#include <asp/GUI/PyramidCache.h>
 #include <asp/Core/GCP.h>
 #include <asp/Rig/nvm.h>
 #include <asp/Core/IpMatchingAlgs.h>
@@ -290,6 +291,14 @@ MainWindow::MainWindow(vw::GdalWriteOptions const& opt,
 
   m_display_mode = asp::stereo_settings().hillshade ? HILLSHADED_VIEW : REGULAR_VIEW;
 
+  // Build the image pyramids not in the cache in the background. Once one
+  // is ready, redraw. The notifier is invoked from a worker thread, so
+  // queue the call to the GUI thread.
+  vw::gui::setBuildPyramidsInBackground(true);
+  vw::gui::pyramidBuilder().setNotifier([this]() {
+      QMetaObject::invokeMethod(this, "refreshPyramids", Qt::QueuedConnection);
+    });
+
   if (!stereo_settings().zoom_proj_win.empty())
     m_use_georef = true;
   
@@ -1762,6 +1771,13 @@ void MainWindow::thresholdCalc() {
   }
 }
 
+void MainWindow::refreshPyramids() {
+  for (size_t i = 0; i < m_widgets.size(); i++) {
+    if (mw(m_widgets[i]))
+      mw(m_widgets[i])->refreshPyramids();
+  }
+}
+
 void MainWindow::viewThreshImages() {
   if (m_viewThreshImages_action->isChecked())
     m_display_mode = THRESHOLDED_VIEW;
@@ -65,6 +65,7 @@ namespace vw { namespace gui {
 
   private slots:
     void forceQuit                  (); // Ensure the program shuts down.
+    void refreshPyramids            (); // Show pyramids built in the background
     void sizeToFit                  ();
     void viewSingleWindow           ();
     void viewAllSideBySide          ();
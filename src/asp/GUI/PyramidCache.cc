@@ -0,0 +1,530 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <asp/GUI/PyramidCache.h>
+#include <asp/Core/StereoSettings.h>
+
+#include <vw/Core/Log.h>
+#include <vw/Core/Exception.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace vw { namespace gui {
+
+namespace {
+
+// Set on startup by the GUI, read later, so no lock is needed
+bool g_build_pyramids_in_background = false;
+
+std::string findCacheDir() {
+
+  if (asp::stereo_settings().no_cache)
+    return "";
+
+  std::string dir = asp::stereo_settings().cache_dir;
+  if (dir == "") {
+    char * xdg  = getenv("XDG_CACHE_HOME");
+    char * home = getenv("HOME");
+    if (xdg != NULL && std::string(xdg) != "")
+      dir = std::string(xdg) + "/asp/stereo_gui";
+    else if (home != NULL && std::string(home) != "")
+      dir = std::string(home) + "/.cache/asp/stereo_gui";
+    else
+      return "";
+  }
+
+  boost::system::error_code ec;
+  fs::create_directories(dir, ec);
+  if (!fs::is_directory(dir)) {
+    vw_out(WarningMessage) << "Cannot create the cache directory: " << dir
+                           << ". Image pyramids will not be cached.\n";
+    return "";
+  }
+
+  return fs::canonical(dir).string();
+}
+
+// The pyramid parameters used before pyramids were cached, in imageData::load
+const int PYRAMID_TOP_IMAGE_MAX_PIX = 1000*1000;
+const int PYRAMID_SUBSAMPLE = 4;
+
+// The minimum number of pixels in the coarsest pyramid level. See the
+// DiskImagePyramidMultiChannel constructor.
+int lowResSize() {
+  int lowres_size = asp::stereo_settings().lowest_resolution_subimage_num_pixels;
+  if (lowres_size <= 0)
+    lowres_size = 1000 * 1000;
+  return lowres_size;
+}
+
+// The file recording that the pyramid of the given source file is complete.
+// The pyramid levels are named after the source file by VW, so they live
+// next to it.
+std::string pyramidMarkerFile(std::string const& src_file) {
+  fs::path p(src_file);
+  return (p.parent_path() / (p.stem().string() + ".pyramid")).string();
+}
+
+bool pyramidIsCached(std::string const& src_file) {
+  std::ifstream ifs(pyramidMarkerFile(src_file).c_str());
+  int lowres_size = -1, subsample = -1;
+  if (!(ifs >> lowres_size >> subsample))
+    return false;
+  return lowres_size == lowResSize() && subsample == PYRAMID_SUBSAMPLE;
+}
+
+// The files for a cached image or view are named <stem>-<key>, followed by
+// nothing or by a suffix starting with '.' or '_'. The key has 16 hex digits.
+// Such files form a cache entry. Return the path without the suffix, or the
+// empty string if the file is not named like that.
+std::string cacheEntry(std::string const& file) {
+  fs::path p(file);
+  std::string name = p.filename().string();
+  const size_t key_len = 16;
+
+  // Use the last match, as the stem may have dashes
+  size_t pos = name.rfind('-');
+  while (pos != std::string::npos) {
+    size_t end = pos + 1 + key_len;
+    bool is_key = (end <= name.size());
+    for (size_t it = pos + 1; it < end && is_key; it++)
+      is_key = (std::isdigit(name[it]) || (name[it] >= 'a' && name[it] <= 'f'));
+    if (is_key && (end == name.size() || name[end] == '.' || name[end] == '_'))
+      return (p.parent_path() / name.substr(0, end)).string();
+    if (pos == 0)
+      break;
+    pos = name.rfind('-', pos - 1);
+  }
+
+  return "";
+}
+
+// Open and lock a file, creating it if needed. Return the file descriptor, or
+// -1 if the lock is held elsewhere and not waiting for it, or on failure.
+// Another session may remove the file between opening and locking it, so
+// check that the locked file is still the one at that path.
+int lockFile(std::string const& file, bool exclusive, bool wait) {
+  while (true) {
+    int fd = open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+      return -1;
+    if (flock(fd, (exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB)) != 0) {
+      close(fd);
+      return -1;
+    }
+    struct stat fd_stat, path_stat;
+    if (fstat(fd, &fd_stat) == 0 && stat(file.c_str(), &path_stat) == 0 &&
+        fd_stat.st_dev == path_stat.st_dev && fd_stat.st_ino == path_stat.st_ino)
+      return fd;
+    close(fd);
+  }
+}
+
+// A lock on a file, released when this goes out of scope
+class FileLock: private boost::noncopyable {
+  int m_fd;
+public:
+  FileLock(std::string const& file, bool exclusive, bool wait):
+    m_fd(lockFile(file, exclusive, wait)) {}
+  ~FileLock() {
+    if (m_fd >= 0)
+      close(m_fd);
+  }
+  bool locked() const { return m_fd >= 0; }
+};
+
+// The entries used by this session. Each has a shared lock on <entry>.lock,
+// held until the session quits, so no session evicts it. A session evicts an
+// entry only with an exclusive lock on that file. Eviction in this session is
+// serialized with the same mutex.
+vw::Mutex g_cache_mutex;
+std::map<std::string, int> g_entries_in_use;
+
+// Mark the cache entry having this file as used by this session. Record the
+// time, so that the least recently used entries are evicted first.
+void useCacheEntry(std::string const& cached_file) {
+  std::string entry = cacheEntry(cached_file);
+  if (entry == "")
+    return;
+
+  vw::Mutex::Lock lock(g_cache_mutex);
+  if (g_entries_in_use.find(entry) != g_entries_in_use.end())
+    return;
+  bool exclusive = false, wait = true;
+  int fd = lockFile(entry + ".lock", exclusive, wait);
+  if (fd < 0)
+    return;
+  g_entries_in_use[entry] = fd;
+  futimens(fd, NULL); // set the modification time to now
+}
+
+struct CacheEntryInfo {
+  std::vector<fs::path> files;
+  std::uintmax_t size;
+  std::time_t last_use;
+  CacheEntryInfo(): size(0), last_use(0) {}
+};
+
+// If the cache is larger than --cache-size-limit, remove the least recently
+// used entries until it is not. Skip the entries used by any session.
+void evictCache() {
+
+  std::string dir = cacheDir();
+  double limit_gb = asp::stereo_settings().cache_size_limit;
+  if (dir == "" || limit_gb <= 0)
+    return;
+  std::uintmax_t limit = limit_gb * 1024.0 * 1024.0 * 1024.0;
+
+  vw::Mutex::Lock lock(g_cache_mutex);
+
+  // The last use is the time of the lock file, if present, as it is updated
+  // on each use
+  std::map<std::string, CacheEntryInfo> entries;
+  std::uintmax_t total = 0;
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+    fs::path p = it->path();
+    std::string entry = cacheEntry(p.string());
+    if (entry == "")
+      continue;
+    CacheEntryInfo & info = entries[entry];
+    info.files.push_back(p);
+
+    boost::system::error_code ec2;
+    if (fs::is_regular_file(fs::symlink_status(p, ec2))) {
+      std::uintmax_t size = fs::file_size(p, ec2);
+      if (!ec2) {
+        info.size += size;
+        total += size;
+      }
+    }
+    std::time_t t = fs::last_write_time(p, ec2);
+    if (ec2)
+      continue;
+    if (p.string() == entry + ".lock")
+      info.last_use = t;
+    else if (!fs::exists(entry + ".lock"))
+      info.last_use = std::max(info.last_use, t);
+  }
+  if (total <= limit)
+    return;
+
+  std::vector<std::pair<std::time_t, std::string>> by_age;
+  for (auto const& e: entries)
+    by_age.push_back(std::make_pair(e.second.last_use, e.first));
+  std::sort(by_age.begin(), by_age.end());
+
+  int num_removed = 0;
+  for (size_t it = 0; it < by_age.size() && total > limit; it++) {
+    std::string const& entry = by_age[it].second;
+    if (g_entries_in_use.find(entry) != g_entries_in_use.end())
+      continue;
+    bool exclusive = true, wait = false;
+    FileLock entry_lock(entry + ".lock", exclusive, wait);
+    if (!entry_lock.locked())
+      continue; // in use by another session
+
+    CacheEntryInfo const& info = entries[entry];
+    for (size_t f = 0; f < info.files.size(); f++)
+      fs::remove(info.files[f], ec);
+    fs::remove(entry + ".lock", ec);
+    total -= info.size;
+    num_removed++;
+  }
+
+  if (num_removed > 0)
+    vw_out() << "Removed " << num_removed << " least recently used entries from: "
+             << dir << "\n";
+}
+
+// Remove any levels left by a build which did not finish, as they
+// may be incomplete. The levels are named <stem>_<suffix>. This must be
+// called with the build lock held, so that no session is still writing them.
+void removeStaleLevels(std::string const& src_file) {
+  fs::path p(src_file);
+  std::string prefix = p.stem().string() + "_";
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(p.parent_path(), ec), end; !ec && it != end;
+       it.increment(ec)) {
+    std::string name = it->path().filename().string();
+    if (boost::starts_with(name, prefix))
+      fs::remove(it->path(), ec);
+  }
+}
+
+// Build the pyramid, and record that it is complete. This is done under a
+// lock, so two sessions never build the same pyramid at the same time. The
+// session waiting for the lock then finds the pyramid complete. The lock is
+// released when a session quits, so then the levels it left are stale.
+DiskImagePyramidMultiChannel buildPyramid(std::string const& src_file,
+                                          vw::GdalWriteOptions const& opt) {
+
+  useCacheEntry(src_file);
+  std::string entry = cacheEntry(src_file);
+  if (entry == "") {
+    fs::path p(src_file);
+    entry = (p.parent_path() / p.stem()).string();
+  }
+  bool exclusive = true, wait = true;
+  bool is_built = false;
+  DiskImagePyramidMultiChannel pyramid;
+  {
+    FileLock build_lock(entry + ".build.lock", exclusive, wait);
+    is_built = !pyramidIsCached(src_file);
+    if (is_built)
+      removeStaleLevels(src_file);
+    pyramid = DiskImagePyramidMultiChannel(src_file, opt, PYRAMID_TOP_IMAGE_MAX_PIX,
+                                           PYRAMID_SUBSAMPLE);
+    if (is_built) {
+      std::ofstream ofs(pyramidMarkerFile(src_file).c_str());
+      ofs << lowResSize() << " " << PYRAMID_SUBSAMPLE << "\n";
+    }
+  }
+
+  if (is_built)
+    evictCache();
+
+  return pyramid;
+}
+
+class PyramidTask: public vw::Task, private boost::noncopyable {
+  std::string m_file, m_src_file;
+  vw::GdalWriteOptions m_opt;
+public:
+  PyramidTask(std::string const& file, std::string const& src_file,
+              vw::GdalWriteOptions const& opt):
+    m_file(file), m_src_file(src_file), m_opt(opt) {}
+
+  void operator()() {
+    boost::shared_ptr<DiskImagePyramidMultiChannel> pyramid;
+    try {
+      pyramid.reset(new DiskImagePyramidMultiChannel(buildPyramid(m_src_file, m_opt)));
+    } catch (std::exception const& e) {
+      vw_out(WarningMessage) << "Failed to build the pyramid for: " << m_file
+                             << ". " << e.what() << "\n";
+    }
+    pyramidBuilder().finished(m_file, pyramid);
+  }
+};
+
+// The 64-bit FNV-1a hash. Unlike std::hash, it is the same for all builds,
+// so a cache directory can be shared.
+uint64_t fnv1aHash(std::string const& str) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t it = 0; it < str.size(); it++) {
+    hash ^= static_cast<unsigned char>(str[it]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+} // end local namespace
+
+std::string cacheDir() {
+  // Computed once, after the options are parsed
+  static std::string dir = findCacheDir();
+  return dir;
+}
+
+bool isInCacheDir(std::string const& file) {
+  std::string dir = cacheDir();
+  if (dir == "")
+    return false;
+
+  boost::system::error_code ec;
+  fs::path parent = fs::canonical(fs::absolute(file).parent_path(), ec);
+  return !ec && parent.string() == dir;
+}
+
+std::string cacheKey(std::string const& file, std::string const& view_params) {
+
+  boost::system::error_code ec;
+  std::string path = fs::canonical(file, ec).string();
+  if (ec)
+    path = fs::absolute(file).string();
+
+  std::ostringstream os;
+  os << path << "\n";
+  if (fs::exists(file))
+    os << fs::last_write_time(file) << "\n" << fs::file_size(file) << "\n";
+  os << view_params;
+
+  std::ostringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0')
+      << static_cast<unsigned long long>(fnv1aHash(os.str()));
+  return key.str();
+}
+
+std::string cachedViewFile(std::string const& file, std::string const& view_params,
+                           std::string const& suffix) {
+  std::string dir = cacheDir();
+  if (dir == "")
+    return "";
+
+  std::string stem = fs::path(file).stem().string();
+  std::string cached_file = dir + "/" + stem + "-" + cacheKey(file, view_params) + suffix;
+  useCacheEntry(cached_file);
+  return cached_file;
+}
+
+std::string cacheTmpFile(std::string const& cached_file) {
+  // Keep the extension, as the image format is deduced from it
+  fs::path p(cached_file);
+  std::ostringstream os;
+  os << (p.parent_path() / p.stem()).string() << ".tmp" << getpid()
+     << p.extension().string();
+  return os.str();
+}
+
+void commitCachedFile(std::string const& tmp_file, std::string const& cached_file) {
+  fs::rename(tmp_file, cached_file);
+  evictCache();
+}
+
+std::string pyramidSourceFile(std::string const& file) {
+  if (cacheDir() == "")
+    return "";
+
+  if (isInCacheDir(file)) {
+    useCacheEntry(file);
+    return file;
+  }
+
+  // A link to a file in a format which may refer to other files relative
+  // to its own location (.vrt, .cub with detached labels) would break
+  // those references.
+  std::string ext = boost::to_lower_copy(fs::path(file).extension().string());
+  if (ext != ".tif" && ext != ".tiff" && ext != ".ntf" && ext != ".nitf" &&
+      ext != ".jp2" && ext != ".png"  && ext != ".jpg" && ext != ".jpeg")
+    return "";
+
+  boost::system::error_code ec;
+  fs::path target = fs::canonical(file, ec);
+  if (ec)
+    return "";
+
+  std::string link = cachedViewFile(file, "pyramid", fs::path(file).extension().string());
+  if (!fs::is_symlink(link)) {
+    fs::create_symlink(target, link, ec);
+    if (ec && !fs::is_symlink(link)) {
+      vw_out(WarningMessage) << "Cannot create a link to " << file << " in "
+                             << cacheDir() << ". Its pyramid will not be cached.\n";
+      return "";
+    }
+  }
+
+  return link;
+}
+
+DiskImagePyramidMultiChannel loadPyramid(std::string const& file,
+                                         vw::GdalWriteOptions const& opt) {
+
+  std::string src_file = pyramidSourceFile(file);
+  if (src_file == "") // no caching
+    return DiskImagePyramidMultiChannel(file, opt, PYRAMID_TOP_IMAGE_MAX_PIX,
+                                        PYRAMID_SUBSAMPLE);
+
+  if (pyramidIsCached(src_file) || !g_build_pyramids_in_background)
+    return buildPyramid(src_file, opt);
+
+  // Show the full-resolution image until the pyramid is built
+  pyramidBuilder().request(file, opt);
+  bool base_level_only = true;
+  return DiskImagePyramidMultiChannel(src_file, opt, PYRAMID_TOP_IMAGE_MAX_PIX,
+                                      PYRAMID_SUBSAMPLE, base_level_only);
+}
+
+void setBuildPyramidsInBackground(bool background) {
+  g_build_pyramids_in_background = background;
+}
+
+// Reading is mostly serialized by GDAL, so more threads do not help much
+PyramidBuilder::PyramidBuilder(): m_queue(2) {}
+
+void PyramidBuilder::request(std::string const& file, vw::GdalWriteOptions const& opt) {
+  std::string src_file = pyramidSourceFile(file);
+  if (src_file == "")
+    return;
+
+  {
+    vw::Mutex::Lock lock(m_mutex);
+    if (m_pending.find(file) != m_pending.end() || m_ready.find(file) != m_ready.end())
+      return;
+    m_pending.insert(file);
+  }
+
+  vw_out() << "Building in the background the pyramid for: " << file << "\n";
+  m_queue.add_task(boost::shared_ptr<PyramidTask>(new PyramidTask(file, src_file, opt)));
+}
+
+bool PyramidBuilder::take(std::string const& file, DiskImagePyramidMultiChannel & pyramid) {
+  vw::Mutex::Lock lock(m_mutex);
+  auto it = m_ready.find(file);
+  if (it == m_ready.end())
+    return false;
+  pyramid = *it->second;
+  m_ready.erase(it);
+  return true;
+}
+
+void PyramidBuilder::setNotifier(boost::function<void()> const& notifier) {
+  vw::Mutex::Lock lock(m_mutex);
+  m_notifier = notifier;
+}
+
+void PyramidBuilder::finished(std::string const& file,
+                              boost::shared_ptr<DiskImagePyramidMultiChannel> pyramid) {
+  boost::function<void()> notifier;
+  {
+    vw::Mutex::Lock lock(m_mutex);
+    m_pending.erase(file);
+    if (!pyramid)
+      return;
+    m_ready[file] = pyramid;
+    notifier = m_notifier;
+  }
+
+  if (notifier)
+    notifier();
+}
+
+PyramidBuilder& pyramidBuilder() {
+  // Never destroyed, so that quitting does not wait for builds in progress.
+  // Their levels are not reused, as the pyramid is not marked complete.
+  static PyramidBuilder * builder = new PyramidBuilder();
+  return *builder;
+}
+
+}} // namespace vw::gui
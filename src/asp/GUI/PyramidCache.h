@@ -0,0 +1,121 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file PyramidCache.h
+///
+/// A persistent on-disk cache for image pyramids and for views derived from
+/// images (hillshaded, thresholded). Entries are keyed by the absolute path
+/// and modification time of the input, and by the view parameters, so they
+/// are reused across sessions and become stale when the input changes.
+/// Pyramids not in the cache can be built in the background, while the
+/// full-resolution image is shown. Sessions coordinate with lock files in
+/// the cache directory, so a pyramid is built by one session at a time, and
+/// the least recently used entries are evicted only if no session uses them.
+///
+#ifndef __STEREO_GUI_PYRAMID_CACHE_H__
+#define __STEREO_GUI_PYRAMID_CACHE_H__
+
+#include <asp/GUI/DiskImagePyramidMultiChannel.h>
+
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace vw { namespace gui {
+
+  /// The directory having the cached pyramids and views. It is set with
+  /// --cache-dir, and defaults to $XDG_CACHE_HOME/asp/stereo_gui or
+  /// $HOME/.cache/asp/stereo_gui. Return the empty string if caching is off
+  /// or the directory cannot be created.
+  std::string cacheDir();
+
+  /// If this file is in the cache directory.
+  bool isInCacheDir(std::string const& file);
+
+  /// A key which changes when the file changes or when the view parameters
+  /// change. It is used to form the names of the cached files.
+  std::string cacheKey(std::string const& file, std::string const& view_params);
+
+  /// The name of the cached view of a file with given parameters. The suffix
+  /// must include the extension. Return the empty string if caching is off.
+  std::string cachedViewFile(std::string const& file, std::string const& view_params,
+                             std::string const& suffix);
+
+  /// A temporary name for writing a cached file. Such a file is renamed
+  /// with commitCachedFile() once complete, so an interrupted write is never
+  /// mistaken for a cache entry.
+  std::string cacheTmpFile(std::string const& cached_file);
+  void commitCachedFile(std::string const& tmp_file, std::string const& cached_file);
+
+  /// The file from which to build the pyramid of an image, so that the
+  /// levels end up in the cache directory. This is the image itself, if
+  /// already there, or a link to it otherwise. Return the empty string if
+  /// caching is off or the format of the image does not allow linking.
+  std::string pyramidSourceFile(std::string const& file);
+
+  /// Build the pyramid for an image, or open it if the levels are cached.
+  /// When building in the background is enabled and the levels are not
+  /// cached, start building them and return a pyramid having only the
+  /// full-resolution image. The complete pyramid must then be fetched with
+  /// PyramidBuilder::take().
+  DiskImagePyramidMultiChannel loadPyramid(std::string const& file,
+                                           vw::GdalWriteOptions const& opt);
+
+  /// Enable building pyramids in the background. Off by default, so
+  /// that tools running without a GUI get complete pyramids.
+  void setBuildPyramidsInBackground(bool background);
+
+  /// Build image pyramids in background threads, one per file.
+  class PyramidBuilder {
+  public:
+    PyramidBuilder();
+
+    /// Start building the pyramid for this file, unless this is in progress
+    /// or done and not taken yet.
+    void request(std::string const& file, vw::GdalWriteOptions const& opt);
+
+    /// If the pyramid for this file is ready, copy it to the output and
+    /// return true. A pyramid can be taken only once.
+    bool take(std::string const& file, DiskImagePyramidMultiChannel & pyramid);
+
+    /// This is called from a background thread each time a pyramid is ready.
+    void setNotifier(boost::function<void()> const& notifier);
+
+    /// Called by the background tasks
+    void finished(std::string const& file,
+                  boost::shared_ptr<DiskImagePyramidMultiChannel> pyramid);
+
+  private:
+    vw::Mutex m_mutex;
+    std::set<std::string> m_pending;
+    std::map<std::string, boost::shared_ptr<DiskImagePyramidMultiChannel>> m_ready;
+    boost::function<void()> m_notifier;
+    vw::FifoWorkQueue m_queue;
+  };
+
+  /// Access the global builder
+  PyramidBuilder& pyramidBuilder();
+
+}} // namespace vw::gui
+
+#endif  // __STEREO_GUI_PYRAMID_CACHE_H__
@@ -0,0 +1,286 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <asp/GUI/ScatteredDataIndex.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vw { namespace gui {
+
+// The number of cells along the longer side of the finest grid. This
+// bounds the memory used by the index.
+const int SCATTERED_MAX_GRID_SIZE = 2048;
+
+// Stop adding coarser levels when the grid is this small
+const int SCATTERED_MIN_GRID_SIZE = 16;
+
+// Draw the original points if no more than this many are in view
+const size_t SCATTERED_MAX_RAW_POINTS = 100000;
+
+void ScatteredDataIndex::clear() {
+  m_cell_size = 0.0;
+  m_num_cols = 0;
+  m_num_rows = 0;
+  m_point_row_start.clear();
+  m_levels.clear();
+}
+
+int ScatteredDataIndex::pointCol(vw::Vector3 const& P) const {
+  double col = floor((P[0] - m_origin[0]) / m_cell_size);
+  return std::max(0.0, std::min(col, m_num_cols - 1.0));
+}
+
+int ScatteredDataIndex::pointRow(vw::Vector3 const& P) const {
+  double row = floor((P[1] - m_origin[1]) / m_cell_size);
+  return std::max(0.0, std::min(row, m_num_rows - 1.0));
+}
+
+double ScatteredDataIndex::cellSize(int level) const {
+  if (level < 0)
+    return 0.0;
+  return m_cell_size * double(1 << level);
+}
+
+// Merge a bin into the last one in the list if they are in the same cell,
+// else append it
+void mergeBin(ScatteredBin const& b, std::pair<int, int> const& cell, // (row, col)
+              std::vector<ScatteredBin> & out,
+              std::vector<std::pair<int, int>> & out_cells) {
+  if (out.empty() || out_cells.back() != cell) {
+    out.push_back(b);
+    out_cells.push_back(cell);
+    return;
+  }
+  ScatteredBin & a = out.back();
+  double n = a.count + b.count;
+  a.x        = (a.count * a.x        + b.count * b.x)        / n;
+  a.y        = (a.count * a.y        + b.count * b.y)        / n;
+  a.mean_val = (a.count * a.mean_val + b.count * b.mean_val) / n;
+  a.min_val  = std::min(a.min_val, b.min_val);
+  a.max_val  = std::max(a.max_val, b.max_val);
+  a.count   += b.count;
+}
+
+void ScatteredDataIndex::build(std::vector<vw::Vector3> & points) {
+
+  clear();
+  if (points.empty())
+    return;
+
+  vw::BBox2 box;
+  for (size_t it = 0; it < points.size(); it++)
+    box.grow(subvector(points[it], 0, 2));
+  double extent = std::max(box.width(), box.height());
+  if (extent <= 0.0)
+    extent = 1.0;
+  m_origin    = box.min();
+  m_cell_size = extent / SCATTERED_MAX_GRID_SIZE;
+  m_num_cols  = std::min(int(floor(box.width()  / m_cell_size)) + 1, SCATTERED_MAX_GRID_SIZE);
+  m_num_rows  = std::min(int(floor(box.height() / m_cell_size)) + 1, SCATTERED_MAX_GRID_SIZE);
+
+  // Sort the points by cell, row after row
+  std::sort(points.begin(), points.end(),
+            [this](vw::Vector3 const& a, vw::Vector3 const& b) {
+              int ra = pointRow(a), rb = pointRow(b);
+              if (ra != rb)
+                return ra < rb;
+              return pointCol(a) < pointCol(b);
+            });
+  m_point_row_start.assign(m_num_rows + 1, 0);
+  for (size_t it = 0; it < points.size(); it++)
+    m_point_row_start[pointRow(points[it]) + 1]++;
+  for (int row = 0; row < m_num_rows; row++)
+    m_point_row_start[row + 1] += m_point_row_start[row];
+
+  // The finest level, from the points, which are now sorted by cell
+  std::vector<ScatteredBin> merged;
+  std::vector<std::pair<int, int>> merged_cells;
+  for (size_t it = 0; it < points.size(); it++) {
+    auto const& P = points[it];
+    ScatteredBin b;
+    b.x = P[0];
+    b.y = P[1];
+    b.min_val = b.mean_val = b.max_val = P[2];
+    b.count = 1;
+    mergeBin(b, std::make_pair(pointRow(P), pointCol(P)), merged, merged_cells);
+  }
+
+  int num_cols = m_num_cols, num_rows = m_num_rows;
+  while (1) {
+
+    Level level;
+    level.num_cols = num_cols;
+    level.num_rows = num_rows;
+    level.bins     = merged;
+    level.cols.resize(merged.size());
+    level.row_start.assign(num_rows + 1, 0);
+    for (size_t it = 0; it < merged.size(); it++) {
+      level.cols[it] = merged_cells[it].second;
+      level.row_start[merged_cells[it].first + 1]++;
+    }
+    for (int row = 0; row < num_rows; row++)
+      level.row_start[row + 1] += level.row_start[row];
+    m_levels.push_back(level);
+
+    if (std::max(num_cols, num_rows) <= SCATTERED_MIN_GRID_SIZE || merged.size() <= 1)
+      break;
+
+    // The next level has cells twice as large. Sort by the new cells and merge.
+    num_cols = (num_cols + 1) / 2;
+    num_rows = (num_rows + 1) / 2;
+    std::vector<size_t> order(merged.size());
+    for (size_t it = 0; it < order.size(); it++) {
+      order[it] = it;
+      merged_cells[it].first  /= 2;
+      merged_cells[it].second /= 2;
+    }
+    std::stable_sort(order.begin(), order.end(), [&merged_cells](size_t a, size_t b) {
+        return merged_cells[a] < merged_cells[b];
+      });
+    std::vector<ScatteredBin> next;
+    std::vector<std::pair<int, int>> next_cells;
+    for (size_t it = 0; it < order.size(); it++)
+      mergeBin(merged[order[it]], merged_cells[order[it]], next, next_cells);
+    merged.swap(next);
+    merged_cells.swap(next_cells);
+  }
+}
+
+// The range of cells at the given level intersecting the box. The end
+// values are exclusive. The range is empty if the box misses the grid.
+void ScatteredDataIndex::cellRange(vw::BBox2 const& box, int level,
+                                   int & beg_col, int & end_col,
+                                   int & beg_row, int & end_row) const {
+  beg_col = end_col = beg_row = end_row = 0;
+  if (m_levels.empty() || box.empty())
+    return;
+  int lev = std::max(level, 0);
+  double cell = cellSize(lev);
+  int num_cols = m_levels[lev].num_cols, num_rows = m_levels[lev].num_rows;
+  // Clamp before casting to int, as the box can be much larger than the grid
+  beg_col = std::max(0.0, floor((box.min()[0] - m_origin[0]) / cell));
+  beg_row = std::max(0.0, floor((box.min()[1] - m_origin[1]) / cell));
+  end_col = std::min(double(num_cols), floor((box.max()[0] - m_origin[0]) / cell) + 1.0);
+  end_row = std::min(double(num_rows), floor((box.max()[1] - m_origin[1]) / cell) + 1.0);
+  if (beg_col >= end_col || beg_row >= end_row)
+    beg_col = end_col = beg_row = end_row = 0;
+}
+
+size_t ScatteredDataIndex::countPoints(vw::BBox2 const& box,
+                                       std::vector<vw::Vector3> const& points) const {
+  if (m_levels.empty())
+    return 0;
+  int beg_col, end_col, beg_row, end_row;
+  cellRange(box, 0, beg_col, end_col, beg_row, end_row);
+  size_t count = 0;
+  Level const& L = m_levels[0];
+  for (int row = beg_row; row < end_row; row++) {
+    auto beg = L.cols.begin() + L.row_start[row];
+    auto end = L.cols.begin() + L.row_start[row + 1];
+    auto it = std::lower_bound(beg, end, beg_col);
+    for (; it != end && *it < end_col; it++)
+      count += L.bins[it - L.cols.begin()].count;
+  }
+  return count;
+}
+
+void ScatteredDataIndex::query(vw::BBox2 const& box, int level,
+                               std::vector<vw::Vector3> const& points,
+                               std::vector<ScatteredBin> & bins) const {
+
+  if (m_levels.empty())
+    return;
+  level = std::min(level, numLevels() - 1);
+
+  int beg_col, end_col, beg_row, end_row;
+  cellRange(box, level, beg_col, end_col, beg_row, end_row);
+
+  if (level < 0) {
+    // The original points
+    for (int row = beg_row; row < end_row; row++) {
+      auto beg = points.begin() + m_point_row_start[row];
+      auto end = points.begin() + m_point_row_start[row + 1];
+      auto it = std::lower_bound(beg, end, beg_col,
+                                 [this](vw::Vector3 const& P, int col) {
+                                   return pointCol(P) < col;
+                                 });
+      for (; it != end && pointCol(*it) < end_col; it++) {
+        ScatteredBin b;
+        b.x = (*it)[0];
+        b.y = (*it)[1];
+        b.min_val = b.mean_val = b.max_val = (*it)[2];
+        b.count = 1;
+        bins.push_back(b);
+      }
+    }
+    return;
+  }
+
+  Level const& L = m_levels[level];
+  for (int row = beg_row; row < end_row; row++) {
+    auto beg = L.cols.begin() + L.row_start[row];
+    auto end = L.cols.begin() + L.row_start[row + 1];
+    auto it = std::lower_bound(beg, end, beg_col);
+    for (; it != end && *it < end_col; it++)
+      bins.push_back(L.bins[it - L.cols.begin()]);
+  }
+}
+
+void ScatteredDataIndex::select(vw::BBox2 const& box, double max_cell_size,
+                                std::vector<vw::Vector3> const& points,
+                                std::vector<ScatteredBin> & bins) const {
+  bins.clear();
+  if (m_levels.empty())
+    return;
+
+  // If there are too many points in view, use the coarsest level with
+  // small enough cells
+  int level = -1;
+  if (countPoints(box, points) > SCATTERED_MAX_RAW_POINTS) {
+    for (int lev = numLevels() - 1; lev >= 0; lev--) {
+      if (cellSize(lev) <= max_cell_size) {
+        level = lev;
+        break;
+      }
+    }
+  }
+
+  query(box, level, points, bins);
+  if (level >= 0 || bins.size() <= SCATTERED_MAX_RAW_POINTS)
+    return;
+
+  // On a deep zoom even the finest cells are too large, and merging the
+  // points in them would lose detail. Draw instead the original points in
+  // the box, skipping some if there are still too many. As they are sorted
+  // by cell, the ones kept are spread over the box.
+  size_t count = 0;
+  for (size_t it = 0; it < bins.size(); it++) {
+    if (box.contains(vw::Vector2(bins[it].x, bins[it].y)))
+      bins[count++] = bins[it];
+  }
+  size_t stride = (count + SCATTERED_MAX_RAW_POINTS - 1) / SCATTERED_MAX_RAW_POINTS;
+  if (stride > 1) {
+    size_t num_kept = 0;
+    for (size_t it = 0; it < count; it += stride)
+      bins[num_kept++] = bins[it];
+    count = num_kept;
+  }
+  bins.resize(count);
+}
+
+}} // namespace vw::gui
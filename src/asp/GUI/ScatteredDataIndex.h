@@ -0,0 +1,104 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file ScatteredDataIndex.h
+///
+/// A multi-resolution spatial index for scattered (x, y, value) data, as read
+/// from CSV files. It is built once, at load time. When drawing, only the
+/// cells in view are visited, at a level of detail no finer than the screen
+/// resolution, so the cost of a repaint does not grow with the number of
+/// points.
+///
+#ifndef __STEREO_GUI_SCATTERED_DATA_INDEX_H__
+#define __STEREO_GUI_SCATTERED_DATA_INDEX_H__
+
+#include <vw/Math/BBox.h>
+#include <vw/Math/Vector.h>
+
+#include <vector>
+
+namespace vw { namespace gui {
+
+  /// The points in one grid cell, merged. For an original point the count
+  /// is 1 and all values are the same.
+  struct ScatteredBin {
+    double x, y;                        // mean position
+    double min_val, mean_val, max_val;  // of the plotted value
+    int    count;
+  };
+
+  class ScatteredDataIndex {
+  public:
+    ScatteredDataIndex(): m_cell_size(0.0) {}
+
+    /// Build the index. The points are reordered, to be sorted by cell.
+    void build(std::vector<vw::Vector3> & points);
+
+    void clear();
+
+    /// The number of aggregated levels. Level 0 is the finest. The
+    /// original points are level -1.
+    int numLevels() const { return m_levels.size(); }
+
+    /// The size of a grid cell at the given level, in units of the data.
+    double cellSize(int level) const;
+
+    /// The number of original points in the cells intersecting the box.
+    size_t countPoints(vw::BBox2 const& box, std::vector<vw::Vector3> const& points) const;
+
+    /// Append to 'bins' the bins at the given level intersecting the box.
+    /// Level -1 gives the original points.
+    void query(vw::BBox2 const& box, int level, std::vector<vw::Vector3> const& points,
+               std::vector<ScatteredBin> & bins) const;
+
+    /// Find the bins to draw in the box, at the coarsest level whose cells
+    /// are no larger than the given size, which should be about a screen
+    /// pixel or a plotted point. Use the original points if there are not
+    /// many of them in the box, or if even the finest cells are too large.
+    /// In the latter case, if there are too many, only some are kept.
+    void select(vw::BBox2 const& box, double max_cell_size,
+                std::vector<vw::Vector3> const& points,
+                std::vector<ScatteredBin> & bins) const;
+
+  private:
+
+    // A grid of bins. Those in row r are in [row_start[r], row_start[r+1]),
+    // sorted by column.
+    struct Level {
+      int num_cols, num_rows;
+      std::vector<ScatteredBin> bins;
+      std::vector<int>          cols;
+      std::vector<size_t>       row_start;
+    };
+
+    // The grid at level 0. Coarser levels have cells twice as large.
+    vw::Vector2 m_origin;
+    double      m_cell_size;
+    int         m_num_cols, m_num_rows;
+    std::vector<size_t> m_point_row_start; // the points, indexed by level 0 cells
+
+    std::vector<Level> m_levels;
+
+    int pointCol(vw::Vector3 const& P) const;
+    int pointRow(vw::Vector3 const& P) const;
+    void cellRange(vw::BBox2 const& box, int level,
+                   int & beg_col, int & end_col, int & beg_row, int & end_row) const;
+  };
+
+}} // namespace vw::gui
+
+#endif  // __STEREO_GUI_SCATTERED_DATA_INDEX_H__
@@ -0,0 +1,107 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/GUI/ScatteredDataIndex.h>
+
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace vw;
+using namespace vw::gui;
+
+// The most original points drawn, as in ScatteredDataIndex.cc
+const size_t MAX_RAW_POINTS = 100000;
+
+// A dense cluster of points in [0, 1e-3] x [0, 1e-3], and two points far
+// away, so the finest grid cells are much larger than the cluster.
+std::vector<Vector3> clusterPoints(int side) {
+  std::vector<Vector3> points;
+  double spacing = 1e-3 / side;
+  for (int row = 0; row < side; row++) {
+    for (int col = 0; col < side; col++)
+      points.push_back(Vector3(col * spacing, row * spacing, row + col));
+  }
+  points.push_back(Vector3(-500.0, -500.0, 0.0));
+  points.push_back(Vector3(500.0, 500.0, 0.0));
+  return points;
+}
+
+TEST(ScatteredDataIndex, DeepZoom) {
+
+  // More points in view than are drawn as they are
+  int side = 400;
+  std::vector<Vector3> points = clusterPoints(side);
+  ScatteredDataIndex index;
+  index.build(points);
+  ASSERT_GT(index.numLevels(), 0);
+
+  BBox2 box(Vector2(0, 0), Vector2(1e-3, 1e-3));
+  double max_cell_size = 1e-3 / 1000.0; // as for a 1000 pixel wide view
+  ASSERT_GT(index.cellSize(0), max_cell_size);
+  ASSERT_GT(index.countPoints(box, points), MAX_RAW_POINTS);
+
+  // The points must not be merged into a few bins. The ones drawn must be
+  // original points in the box, spread over it.
+  std::vector<ScatteredBin> bins;
+  index.select(box, max_cell_size, points, bins);
+  EXPECT_LE(bins.size(), MAX_RAW_POINTS);
+  EXPECT_GT(bins.size(), MAX_RAW_POINTS / 2);
+  std::set<std::pair<double, double>> distinct;
+  BBox2 bins_box;
+  for (size_t it = 0; it < bins.size(); it++) {
+    EXPECT_EQ(bins[it].count, 1);
+    EXPECT_TRUE(box.contains(Vector2(bins[it].x, bins[it].y)));
+    distinct.insert(std::make_pair(bins[it].x, bins[it].y));
+    bins_box.grow(Vector2(bins[it].x, bins[it].y));
+  }
+  EXPECT_EQ(distinct.size(), bins.size());
+  EXPECT_GT(bins_box.width(),  0.9e-3);
+  EXPECT_GT(bins_box.height(), 0.9e-3);
+
+  // With few points in view, all are drawn
+  BBox2 small_box(Vector2(0, 0), Vector2(1e-4, 1e-4));
+  index.select(small_box, max_cell_size, points, bins);
+  size_t num_in_box = 0;
+  for (size_t it = 0; it < points.size(); it++) {
+    if (small_box.contains(subvector(points[it], 0, 2)))
+      num_in_box++;
+  }
+  EXPECT_GE(bins.size(), num_in_box);
+  for (size_t it = 0; it < bins.size(); it++)
+    EXPECT_EQ(bins[it].count, 1);
+}
+
+TEST(ScatteredDataIndex, ZoomedOut) {
+
+  // When the view shows all the data, the points are merged at a level
+  // whose cells are no larger than asked for.
+  std::vector<Vector3> points = clusterPoints(400);
+  ScatteredDataIndex index;
+  index.build(points);
+
+  BBox2 box(Vector2(-500, -500), Vector2(500, 500));
+  double max_cell_size = 1000.0 / 100.0;
+  std::vector<ScatteredBin> bins;
+  index.select(box, max_cell_size, points, bins);
+  EXPECT_LT(bins.size(), 10u);
+  int total = 0;
+  for (size_t it = 0; it < bins.size(); it++)
+    total += bins[it].count;
+  EXPECT_EQ(total, int(points.size()));
+}
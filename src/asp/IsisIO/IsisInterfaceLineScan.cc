@@ -33,6 +33,7 @@
 #include <Angle.h>
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 #include <boost/smart_ptr/scoped_ptr.hpp>
 
@@ -47,6 +48,11 @@ IsisInterfaceLineScan::IsisInterfaceLineScan(std::string const& filename): IsisI
   m_distortmap = m_camera->DistortionMap();
   m_focalmap   = m_camera->FocalPlaneMap();
   m_detectmap  = m_camera->DetectorMap();
+
+  m_eph_table_ready     = false;
+  m_have_ground_to_time = false;
+  m_line_duration       = 0.0;
+  m_time_mean           = 0.0;
 }
 
 // Custom function to help avoid over invoking the deeply buried
@@ -130,10 +136,9 @@ EphemerisLMA::operator()(EphemerisLMA::domain_type const& x) const {
 // TODO(oalexan1): Move this to a more general place and test with Earth cameras.
 namespace asp {
 template<class ModelT>
-double secant_method(ModelT const& model, double start, double tol) {
+double secant_method(ModelT const& model, double start, double tol, double dt = 0.1) {
       
   Vector<double> t0(1), t1(1);
-  double dt = 0.1;
   t0[0] = start;
   t1[0] = start + dt;
   Vector<double> f0 = model(t0);
@@ -169,16 +174,218 @@ double secant_method(ModelT const& model, double start, double tol) {
 }
 } // end namespace asp
 
+// Same as EphemerisLMA, but the sensor position and pose are interpolated
+// in a precomputed table rather than looked up with SPICE.
+class CachedEphemerisLMA : public vw::math::LeastSquaresModelBase<CachedEphemerisLMA> {
+  vw::Vector3 m_point;
+  std::vector<double>      const& m_times;
+  std::vector<vw::Vector3> const& m_positions;
+  std::vector<vw::Quat>    const& m_poses;
+  double m_focal_length;
+  Isis::CameraDistortionMap *m_distortmap;
+  Isis::CameraFocalPlaneMap *m_focalmap;
+public:
+  typedef vw::Vector<double> result_type; // Back project result
+  typedef vw::Vector<double> domain_type; // Ephemeris time
+  typedef vw::Matrix<double> jacobian_type;
+
+  CachedEphemerisLMA(vw::Vector3 const& point,
+                     std::vector<double>      const& times,
+                     std::vector<vw::Vector3> const& positions,
+                     std::vector<vw::Quat>    const& poses,
+                     double focal_length,
+                     Isis::CameraDistortionMap* distortmap,
+                     Isis::CameraFocalPlaneMap* focalmap):
+    m_point(point), m_times(times), m_positions(positions), m_poses(poses),
+    m_focal_length(focal_length), m_distortmap(distortmap), m_focalmap(focalmap) {}
+
+  result_type operator()(domain_type const& x) const {
+
+    // Linear interpolation in position and normalized linear interpolation
+    // in the pose. The table is dense, so this is accurate enough for a guess.
+    double t = std::max(m_times.front(), std::min(m_times.back(), x[0]));
+    int i = std::upper_bound(m_times.begin(), m_times.end(), t) - m_times.begin() - 1;
+    i = std::max(0, std::min(i, int(m_times.size()) - 2));
+    double a = (t - m_times[i]) / (m_times[i+1] - m_times[i]);
+    Vector3 pos = (1.0 - a) * m_positions[i] + a * m_positions[i+1];
+    Quat const& q0 = m_poses[i];
+    Quat const& q1 = m_poses[i+1];
+    double b = a;
+    if (q0.w()*q1.w() + q0.x()*q1.x() + q0.y()*q1.y() + q0.z()*q1.z() < 0)
+      b = -a; // q and -q are the same rotation
+    Vector4 v = normalize(Vector4((1.0 - a)*q0.w() + b*q1.w(),
+                                  (1.0 - a)*q0.x() + b*q1.x(),
+                                  (1.0 - a)*q0.y() + b*q1.y(),
+                                  (1.0 - a)*q0.z() + b*q1.z()));
+    Quat pose(v[0], v[1], v[2], v[3]);
+
+    // Calculating the look direction in camera frame
+    Vector3 look = inverse(pose).rotate(normalize(m_point - pos));
+
+    // Projecting to mm focal plane
+    look = m_focal_length * (look / look[2]);
+    m_distortmap->SetUndistortedFocalPlane(look[0], look[1]);
+    m_focalmap->SetFocalPlane(m_distortmap->FocalPlaneX(),
+                              m_distortmap->FocalPlaneY());
+    result_type result(1);
+    result[0] = m_focalmap->DetectorLineOffset() - m_focalmap->DetectorLine();
+    return result;
+  }
+};
+
+// Sample the sensor position and pose at a dense set of lines, and fit
+// an affine function from ground points to time.
+void IsisInterfaceLineScan::build_ephemeris_table() const {
+
+  m_eph_table_ready = true;
+  m_eph_times.clear();
+  m_eph_positions.clear();
+  m_eph_poses.clear();
+  m_have_ground_to_time = false;
+
+  int num_lines = lines();
+  int num_samples = std::max(2, std::min(num_lines / 8 + 1, 2048));
+  std::vector<std::pair<double, int>> time_index;
+  try {
+    for (int k = 0; k < num_samples; k++) {
+      double line = 0.5 + double(num_lines) * k / (num_samples - 1.0);
+      m_detectmap->SetParent(1, m_alphacube.AlphaLine(line));
+      m_eph_times.push_back(m_camera->time().Et());
+
+      Vector3 center;
+      m_camera->instrumentPosition(&center[0]);
+      m_eph_positions.push_back(center * 1000); // Spice gives in km
+
+      std::vector<double> rot_inst = m_camera->instrumentRotation()->Matrix();
+      std::vector<double> rot_body = m_camera->bodyRotation()->Matrix();
+      MatrixProxy<double,3,3> R_inst(&(rot_inst[0]));
+      MatrixProxy<double,3,3> R_body(&(rot_body[0]));
+      m_eph_poses.push_back(Quat(R_body*transpose(R_inst)));
+      time_index.push_back(std::make_pair(m_eph_times.back(), k));
+    }
+  } catch (...) {
+    // Do without the table
+    m_eph_times.clear();
+  }
+
+  // The camera state was changed behind the back of SetTime()
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  m_c_location = Vector2(nan, nan);
+
+  // Sort by time, and make sure the times are distinct
+  std::sort(time_index.begin(), time_index.end());
+  std::vector<double> times;
+  std::vector<Vector3> positions;
+  std::vector<Quat> poses;
+  for (size_t k = 0; k < time_index.size() && !m_eph_times.empty(); k++) {
+    if (!times.empty() && time_index[k].first <= times.back())
+      continue;
+    times.push_back(time_index[k].first);
+    positions.push_back(m_eph_positions[time_index[k].second]);
+    poses.push_back(m_eph_poses[time_index[k].second]);
+  }
+  m_eph_times.swap(times);
+  m_eph_positions.swap(positions);
+  m_eph_poses.swap(poses);
+  if (m_eph_times.size() < 2) {
+    m_eph_times.clear();
+    return;
+  }
+  m_line_duration = (m_eph_times.back() - m_eph_times.front()) / std::max(num_lines, 1);
+
+  // Fit time = m_time_mean + dot(m_ground_to_time, xyz - m_ground_mean), as
+  // done for CSM cameras. Use points at two heights along each ray, as
+  // points on the ground alone can be close to coplanar.
+  std::vector<Vector3> pts;
+  std::vector<double> pt_times;
+  int num = 10;
+  for (int r = 0; r < num; r++) {
+    for (int c = 0; c < num; c++) {
+      double sample = 1.0 + (samples() - 1.0) * c / (num - 1.0);
+      double line   = 1.0 + (num_lines - 1.0) * r / (num - 1.0);
+      try {
+        if (!m_camera->SetImage(sample, line))
+          continue;
+        Vector3 ground, center;
+        m_camera->Coordinate(&ground[0]);
+        m_camera->instrumentPosition(&center[0]);
+        ground *= 1000;
+        center *= 1000;
+        double t = m_camera->time().Et();
+        pts.push_back(ground);
+        pt_times.push_back(t);
+        pts.push_back(ground + 0.01 * (center - ground));
+        pt_times.push_back(t);
+      } catch (...) {
+        continue;
+      }
+    }
+  }
+  m_c_location = Vector2(nan, nan);
+  if (pts.size() < 8)
+    return;
+
+  Vector3 mean_pt;
+  double mean_t = 0.0;
+  for (size_t k = 0; k < pts.size(); k++) {
+    mean_pt += pts[k];
+    mean_t  += pt_times[k];
+  }
+  mean_pt /= pts.size();
+  mean_t  /= pts.size();
+  Matrix3x3 normal;
+  Vector3 rhs;
+  for (size_t k = 0; k < pts.size(); k++) {
+    Vector3 d = pts[k] - mean_pt;
+    normal += outer_prod(d, d);
+    rhs    += d * (pt_times[k] - mean_t);
+  }
+  if (std::abs(det(normal)) < 1e-30)
+    return;
+  m_ground_to_time      = inverse(normal) * rhs;
+  m_ground_mean         = mean_pt;
+  m_time_mean           = mean_t;
+  m_have_ground_to_time = true;
+}
+
+// Estimate the time at which a ground point is seen, using the ephemeris
+// table. Return NaN if the table is not available.
+double IsisInterfaceLineScan::estimate_time(Vector3 const& point) const {
+
+  if (!m_eph_table_ready)
+    build_ephemeris_table();
+  if (m_eph_times.empty())
+    return std::numeric_limits<double>::quiet_NaN();
+
+  double guess = 0.5 * (m_eph_times.front() + m_eph_times.back());
+  if (m_have_ground_to_time)
+    guess = m_time_mean + dot_prod(m_ground_to_time, point - m_ground_mean);
+  guess = std::max(m_eph_times.front(), std::min(m_eph_times.back(), guess));
+
+  CachedEphemerisLMA model(point, m_eph_times, m_eph_positions, m_eph_poses,
+                           m_camera->FocalLength(), m_distortmap, m_focalmap);
+  double tol = 1e-8;
+  double t = asp::secant_method(model, guess, tol, 10 * m_line_duration);
+  if (t != t)
+    return std::numeric_limits<double>::quiet_NaN();
+  return t;
+}
+
 Vector2
 IsisInterfaceLineScan::point_to_pixel(Vector3 const& point) const {
 
-  // First seed LMA with an ephemeris time in the middle of the image
-  // TODO(oalexan1): Can create an affine function that fits a 
-  // ground location to best-guess ephemeris time. This is how
-  // it is done for CSM. This may save a few iterations.
-  double middle = lines() / 2;
-  m_detectmap->SetParent(1, m_alphacube.AlphaLine(middle));
-  double start_e = m_camera->time().Et();
+  // Seed the solver with the time found using the precomputed ephemeris
+  // table. Then few iterations with the exact ephemeris are needed. If the
+  // table is not available, start from the middle of the image.
+  double start_e = estimate_time(point);
+  double dt = 0.1;
+  if (start_e == start_e) {
+    dt = std::max(m_line_duration, 1e-6);
+  } else {
+    double middle = lines() / 2;
+    m_detectmap->SetParent(1, m_alphacube.AlphaLine(middle));
+    start_e = m_camera->time().Et();
+  }
 
   // Build LMA
   EphemerisLMA model(point, m_camera.get(), m_distortmap, m_focalmap);
@@ -190,7 +397,7 @@ IsisInterfaceLineScan::point_to_pixel(Vector3 const& point) const {
   // Use the secant method to find the ideal time  
   Vector<double> solution_e(1);
   double tol = 1e-8; // Do not use a smaller tol to avoid numerical instability
-  solution_e[0] = asp::secant_method(model, start[0], tol);
+  solution_e[0] = asp::secant_method(model, start[0], tol, dt);
 
   // Old approach, based on LMA. About 2.2-2.6 times slower than secant method.
   // solution_e = math::levenberg_marquardt(model, start, objective, status);
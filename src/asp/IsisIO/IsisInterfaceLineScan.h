@@ -28,6 +28,7 @@
 #include <asp/IsisIO/IsisInterface.h>
 
 #include <string>
+#include <vector>
 
 #include <AlphaCube.h>
 
@@ -72,6 +73,21 @@ namespace isis {
     mutable vw::Vector3 m_center;
     mutable vw::Quat    m_pose;
     void SetTime(vw::Vector2 const& px, bool calc_pose = false) const;
+
+    // A table of sensor positions and poses at a dense set of times, and an
+    // affine fit of the time at which a ground point is seen. These give a
+    // good estimate for the time in point_to_pixel() without calling into
+    // SPICE. Built on first use.
+    mutable bool                     m_eph_table_ready;
+    mutable std::vector<double>      m_eph_times;
+    mutable std::vector<vw::Vector3> m_eph_positions;
+    mutable std::vector<vw::Quat>    m_eph_poses;
+    mutable double                   m_line_duration;
+    mutable bool                     m_have_ground_to_time;
+    mutable vw::Vector3              m_ground_mean, m_ground_to_time;
+    mutable double                   m_time_mean;
+    void build_ephemeris_table() const;
+    double estimate_time(vw::Vector3 const& point) const;
   };
 
 }}
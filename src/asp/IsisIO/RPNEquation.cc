@@ -19,8 +19,8 @@
 #include <vw/Math/Vector.h>
 #include <asp/IsisIO/RPNEquation.h>
 
+#include <cmath>
 #include <iomanip>
-#include <stack>
 #include <vector>
 
 #include <boost/algorithm/string/classification.hpp>
@@ -66,117 +66,126 @@ void RPNEquation::update( double t ) {
                                  m_z_consts,
                                  delta_t );
 }
+namespace {
+  // The tokens for the operations, in the order of RPNEquation::RPNOp. The
+  // first one stands for a constant.
+  const char* rpn_op_names[] = {"c", "t", "sin", "cos", "tan", "abs",
+                                "*", "/", "-", "+", "^"};
+  const int rpn_num_ops = sizeof(rpn_op_names) / sizeof(rpn_op_names[0]);
+}
+
 void RPNEquation::string_to_eqn( std::string const& str,
-                                 std::vector<std::string>& commands,
+                                 std::vector<RPNOp>& commands,
                                  std::vector<double>& consts ) {
   // Breaks a string into the equation format used internally
   commands.clear();
   consts.clear();
-  boost::split( commands, str, boost::is_any_of(" ="));
-
-  // Cleaning out any tokens that are just ""
-  for(std::vector<std::string>::iterator iter = commands.begin();
-      iter != commands.end(); ++iter ) {
-    if ( (*iter) == "" ) {
-      iter = commands.erase(iter);
-      iter--;
+  std::vector<std::string> tokens;
+  boost::split( tokens, str, boost::is_any_of(" ="));
+
+  // Compile the tokens to operations. Check that each operation has enough
+  // arguments, rather than doing that each time the equation is evaluated.
+  size_t stack_size = 0;
+  for (size_t i = 0; i < tokens.size(); i++ ) {
+    std::string const& token = tokens[i];
+    if ( token == "" )
+      continue;
+
+    if ( isdigit( token[token.size()-1] ) ) {
+      // Pulling out the numbers
+      consts.push_back( atof( token.c_str() ) );
+      commands.push_back( RPN_CONST );
+      stack_size++;
+      continue;
     }
-  }
 
-  // Pulling out the numbers
-  for(std::vector<std::string>::iterator iter = commands.begin();
-      iter != commands.end(); ++iter ) {
-    if ( isdigit( (*iter)[(*iter).size()-1] ) ) {
-      consts.push_back( atof( iter->c_str() ) );
-      *iter = "c";
+    int op = 1;
+    while ( op < rpn_num_ops && token != rpn_op_names[op] )
+      op++;
+    if ( op == rpn_num_ops )
+      vw_throw( IOErr() << "Unknown RPN operator: " << token << "\n" );
+
+    if ( op == RPN_T ) {
+      stack_size++;
+    } else if ( stack_size < 1 ) {
+      vw_throw( IOErr() << "Insufficient arguments for RPN command: "
+                << token << "\n" );
+    } else if ( op >= RPN_MUL ) {
+      if ( stack_size < 2 )
+        vw_throw( IOErr() << "Insufficient arguments for command: "
+                  << token << "\n" );
+      stack_size--; // binary operation
     }
+    commands.push_back( RPNOp(op) );
   }
+
+  if ( !commands.empty() && stack_size != 1 )
+    vw_throw( IOErr() << "Unbalanced RPN equation! More constants than need by operators.\n" );
+
+  if ( m_stack.size() < commands.size() )
+    m_stack.resize( commands.size() );
 }
 
-double RPNEquation::evaluate( std::vector<std::string> const& commands,
-                              std::vector<double>& consts,
+double RPNEquation::evaluate( std::vector<RPNOp> const& commands,
+                              std::vector<double> const& consts,
                               double t ) {
-  // Evaluates an equation in the internal format
+  // Evaluates an equation in the internal format. The equation was
+  // validated when compiled.
   if ( commands.empty() )
     return 0;
   int consts_index = 0;
-  std::stack<double> rpn_stack;
-  double buffer;
-  for ( std::vector<std::string>::const_iterator iter = commands.begin();
-        iter != commands.end(); ++iter ) {
-    if ( *iter == "c" ) {
-      rpn_stack.push( consts[consts_index] );
+  double * stack = &m_stack[0];
+  int top = -1; // index of the top of the stack
+  for ( size_t i = 0; i < commands.size(); i++ ) {
+    switch ( commands[i] ) {
+    case RPN_CONST:
+      stack[++top] = consts[consts_index];
       consts_index++;
-    } else if ( *iter == "t" ) {
-      rpn_stack.push( t );
-    } else if ( rpn_stack.size() < 1 ) {
-      vw_throw( IOErr() << "Insufficient arguments for RPN command: "
-                << *iter << "\n" );
-    } else if ( *iter == "sin" ) {
-      buffer = sin( rpn_stack.top() );
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "cos" ) {
-      buffer = cos( rpn_stack.top() );
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "tan" ) {
-      buffer = tan( rpn_stack.top() );
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "abs" ) {
-      buffer = fabs( rpn_stack.top() );
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( rpn_stack.size() < 2 ) {
-      vw_throw( IOErr() << "Insufficient arguments for command: "
-                << *iter << "\n" );
-    } else if ( *iter == "*" ) {
-      buffer = rpn_stack.top();
-      rpn_stack.pop();
-      buffer *= rpn_stack.top();
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "/" ) {
-      buffer = rpn_stack.top();
-      rpn_stack.pop();
-      buffer = rpn_stack.top() / buffer;
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "-" ) {
-      buffer = rpn_stack.top();
-      rpn_stack.pop();
-      buffer = rpn_stack.top() - buffer;
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "+" ) {
-      buffer = rpn_stack.top();
-      rpn_stack.pop();
-      buffer += rpn_stack.top();
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else if ( *iter == "^" ) {
-      buffer = rpn_stack.top();
-      rpn_stack.pop();
-      buffer = pow( rpn_stack.top(), buffer );
-      rpn_stack.pop();
-      rpn_stack.push( buffer );
-    } else {
-      vw_throw( IOErr() << "Unknown RPN operator: " << *iter << "\n" );
+      break;
+    case RPN_T:
+      stack[++top] = t;
+      break;
+    case RPN_SIN:
+      stack[top] = sin( stack[top] );
+      break;
+    case RPN_COS:
+      stack[top] = cos( stack[top] );
+      break;
+    case RPN_TAN:
+      stack[top] = tan( stack[top] );
+      break;
+    case RPN_ABS:
+      stack[top] = fabs( stack[top] );
+      break;
+    case RPN_MUL:
+      stack[top-1] *= stack[top];
+      top--;
+      break;
+    case RPN_DIV:
+      stack[top-1] /= stack[top];
+      top--;
+      break;
+    case RPN_SUB:
+      stack[top-1] -= stack[top];
+      top--;
+      break;
+    case RPN_ADD:
+      stack[top-1] += stack[top];
+      top--;
+      break;
+    case RPN_POW:
+      stack[top-1] = pow( stack[top-1], stack[top] );
+      top--;
+      break;
     }
   } // End of calculator
 
-  if ( rpn_stack.size() != 1 )
-    vw_throw( IOErr() << "Unbalanced RPN equation! More constants than need by operators.\n" );
-
-  return rpn_stack.top();
+  return stack[0];
 }
 
-// FileIO
-//-----------------------------------------------------
 void RPNEquation::write( std::ofstream &f ) {
   for ( int i = 0; i < 3; i++ ) {
-    std::vector<std::string>* eq_ptr = NULL;
+    std::vector<RPNOp>* eq_ptr = NULL;
     std::vector<double>* cs_ptr = NULL;
     switch(i) {
     case 0:
@@ -196,11 +205,11 @@ void RPNEquation::write( std::ofstream &f ) {
     f << std::setprecision( 15 );
     int cs_idx = 0;
     for ( unsigned j = 0; j < eq_ptr->size(); j++ ) {
-      if ( (*eq_ptr)[j] == "c" ) {
+      if ( (*eq_ptr)[j] == RPN_CONST ) {
         f << (*cs_ptr)[cs_idx] << " ";
         cs_idx++;
       } else {
-        f << (*eq_ptr)[j] << " ";
+        f << rpn_op_names[(*eq_ptr)[j]] << " ";
       }
     }
     f << "\n";
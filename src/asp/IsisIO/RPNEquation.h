@@ -39,19 +39,26 @@ namespace asp {
   // Remember: Have your equation space delimited
   // Also: 'c' is an internal place holder for RPNEquation
   class RPNEquation : public BaseEquation {
-    std::vector<std::string> m_x_eq;
+
+    // An equation is compiled to a list of operations on a stack when
+    // it is read, so that evaluating it does not need string comparisons.
+    enum RPNOp { RPN_CONST, RPN_T, RPN_SIN, RPN_COS, RPN_TAN, RPN_ABS,
+                 RPN_MUL, RPN_DIV, RPN_SUB, RPN_ADD, RPN_POW };
+
+    std::vector<RPNOp> m_x_eq;
     std::vector<double> m_x_consts;
-    std::vector<std::string> m_y_eq;
+    std::vector<RPNOp> m_y_eq;
     std::vector<double> m_y_consts;
-    std::vector<std::string> m_z_eq;
+    std::vector<RPNOp> m_z_eq;
     std::vector<double> m_z_consts;
+    std::vector<double> m_stack; // scratch space for evaluation
 
     void update( double t );
     void string_to_eqn( std::string const& str,
-                        std::vector<std::string>& commands,
+                        std::vector<RPNOp>& commands,
                         std::vector<double>& consts );
-    double evaluate( std::vector<std::string> const& commands,
-                     std::vector<double>& consts,
+    double evaluate( std::vector<RPNOp> const& commands,
+                     std::vector<double> const& consts,
                      double t );
   public:
     RPNEquation();
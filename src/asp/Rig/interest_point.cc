@@ -501,41 +501,6 @@ std::string matchFileName(std::string const& match_dir,
   return match_file;
 }
 
-// Build tracks from pairs  
-void buildTracks(aspOpenMVG::matching::PairWiseMatches const& match_map,
-                 std::vector<std::map<int, int>>& pid_to_cid_fid) { // output
-
-  pid_to_cid_fid.clear(); // wipe the output
-  
-  aspOpenMVG::tracks::TracksBuilder trackBuilder;
-  trackBuilder.Build(match_map);  // Build:  Efficient fusion of correspondences
-  trackBuilder.Filter();          // Filter: Remove tracks that have conflict
-  // trackBuilder.ExportToStream(std::cout);
-  // Export tracks as a map (each entry is a sequence of imageId and featureIndex):
-  //  {TrackIndex => {(imageIndex, featureIndex), ... ,(imageIndex, featureIndex)}
-  aspOpenMVG::tracks::STLMAPTracks map_tracks;
-  trackBuilder.ExportToSTL(map_tracks);
-  trackBuilder = aspOpenMVG::tracks::TracksBuilder();   // wipe it
-
-  if (map_tracks.empty())
-    LOG(FATAL) << "No tracks left after filtering. Perhaps images "
-               << "are too dis-similar?\n";
-  
-  // Populate the filtered tracks
-  size_t num_elems = map_tracks.size();
-  pid_to_cid_fid.clear();
-  pid_to_cid_fid.resize(num_elems);
-  size_t curr_id = 0;
-  for (auto itr = map_tracks.begin(); itr != map_tracks.end(); itr++) {
-    for (auto itr2 = (itr->second).begin(); itr2 != (itr->second).end(); itr2++) {
-      pid_to_cid_fid[curr_id][itr2->first] = itr2->second;
-    }
-    curr_id++;
-  }
-
-  return;
-}
-
 // The nvm file produced by Theia can have files in arbitrary order. Find the map
 // which will help bring the cid in the correct order.
 void findCidReorderMap(nvmData const& nvm,
@@ -871,7 +836,7 @@ void transformAppendNvm(// Append from these
                         std::vector<int> & fid_count,
                         std::vector<std::map<std::pair<float, float>, int>>
                         & merged_keypoint_map,
-                        std::vector<std::map<int, int>> & pid_to_cid_fid) {
+                        rig::FlatTracks & tracks) {
 
   // Sanity checks
   if (num_out_cams != fid_count.size()) 
@@ -915,7 +880,7 @@ void transformAppendNvm(// Append from these
     
     // Append the transformed track
     if (out_cid_fid.size() > 1)
-      pid_to_cid_fid.push_back(out_cid_fid);
+      tracks.push_back(out_cid_fid);
   }
   
   return;
@@ -943,20 +908,6 @@ void findFid(std::pair<float, float> const & ip,
   return;
 }
 
-// Remove duplicate tracks. There can still be two tracks with one contained
-// in the other or otherwise having shared elements. 
-void rmDuplicateTracks(std::vector<std::map<int, int>> & pid_to_cid_fid) {
-
-  int num_tracks = pid_to_cid_fid.size();
-  // vector to set, and back
-  std::set<std::map<int, int>> track_set(pid_to_cid_fid.begin(), pid_to_cid_fid.end());
-  pid_to_cid_fid.assign(track_set.begin(), track_set.end());
-
-  int diff = num_tracks - int(pid_to_cid_fid.size());
-  std::cout << "Removed " << diff << " duplicate tracks ("
-            << 100.0 * double(diff)/double(num_tracks) << "%)\n";
-}
-  
 void detectMatchFeatures(// Inputs
                          std::vector<rig::cameraImage> const& cams,
                          std::vector<camera::CameraParameters> const& cam_params,
@@ -1149,8 +1100,9 @@ void detectMatchFeatures(// Inputs
   // If feature A in image I matches feather B in image J, which
   // matches feature C in image K, then (A, B, C) belong together in
   // a track, and will have a single triangulated xyz. Build such a track.
-  buildTracks(match_map, pid_to_cid_fid);
-  std::cout << "Tracks obtained after matching: " << pid_to_cid_fid.size() << std::endl;
+  rig::FlatTracks tracks;
+  rig::buildTracks(match_map, tracks);
+  std::cout << "Tracks obtained after matching: " << tracks.size() << std::endl;
   match_map = aspOpenMVG::matching::PairWiseMatches();  // wipe this, no longer needed
 
 #endif // this should be end of function detectMatchFeatures()
@@ -1199,7 +1151,7 @@ void detectMatchFeatures(// Inputs
     rig::transformAppendNvm(nvm.pid_to_cid_fid, nvm.cid_to_keypoint_map,  
                                   nvm_cid_to_cams_cid,
                                   keypoint_offsets, cid_shift, num_images,
-                                  fid_count, keypoint_map, pid_to_cid_fid); // append
+                                  fid_count, keypoint_map, tracks); // append
   }
   
   // Create keypoint_vec from keypoint_map. That just reorganizes the data
@@ -1226,7 +1178,8 @@ void detectMatchFeatures(// Inputs
   // created in matching can duplicate tracks read from disk. Ideally also
   // shorter tracks contained in longer tracks should be removed, and tracks
   // that can be merged without conflicts should be merged.
-  rmDuplicateTracks(pid_to_cid_fid);
+  rig::rmDuplicateTracks(tracks);
+  rig::fromFlatTracks(tracks, pid_to_cid_fid);
 
   return;
 }
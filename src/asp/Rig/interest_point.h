@@ -23,6 +23,8 @@
 #include <opencv2/imgproc.hpp>
 #include <glog/logging.h>
 
+#include <Rig/tracks.h>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -237,9 +239,6 @@ std::string registrationCamName(std::string const& hugin_file,
   
 struct cameraImage;
 
-void buildTracks(aspOpenMVG::matching::PairWiseMatches const& match_map,
-                 std::vector<std::map<int, int>>& pid_to_cid_fid);
-  
 void detectMatchFeatures(// Inputs
                          std::vector<rig::cameraImage> const& cams,
                          std::vector<camera::CameraParameters> const& cam_params,
@@ -347,7 +346,7 @@ void transformAppendNvm(// Append from these
                         std::vector<int> & fid_count,
                         std::vector<std::map<std::pair<float, float>, int>>
                         & merged_keypoint_map,
-                        std::vector<std::map<int, int>> & pid_to_cid_fid);
+                        rig::FlatTracks & tracks);
   
 // Add keypoints from a map, appending to existing keypoints. Take into
 // account how this map's cid gets transformed to the new map cid.
@@ -365,10 +364,6 @@ void addKeypoints(// Append from these
                   std::vector<std::map<std::pair<float, float>, int>>
                   & merged_keypoint_map);
 
-// Remove duplicate tracks. There can still be two tracks with one contained
-// in the other or otherwise having shared elements. 
-void rmDuplicateTracks(std::vector<std::map<int, int>> & pid_to_cid_fid);
-  
 void flagOutlierByExclusionDist(// Inputs
                                 std::vector<camera::CameraParameters> const& cam_params,
                                 std::vector<rig::cameraImage> const& cams,
@@ -48,6 +48,7 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <algorithm>
 #include <set>
 #include <thread>
 #include <vector>
@@ -70,23 +71,25 @@ namespace rig {
 // A.pid_to_cid_fid_.
 void FindPidCorrespondences(std::vector<std::map<int, int>> const& A_cid_fid_to_pid,
                             std::vector<std::map<int, int>> const& B_cid_fid_to_pid,
-                            std::vector<std::map<int, int>> const& C_pid_to_cid_fid,
+                            rig::FlatTracks                 const& C_tracks,
                             int num_acid,  // How many images are in A
                             std::map<int, int> * A2B, std::map<int, int> * B2A) {
   A2B->clear();
   B2A->clear();
 
   std::map<int, std::map<int, int>> VoteMap;
-  for (int pid = 0; pid < static_cast<int>(C_pid_to_cid_fid.size()); pid++) {
+  for (int pid = 0; pid < static_cast<int>(C_tracks.size()); pid++) {
     // This track has some cid indices from A (those < num_acid)
     // and some from B (those >= num_acid). Ignore all other combinations.
-    auto const& cid_fid_c = C_pid_to_cid_fid[pid];  // alias
-    for (auto it_a = cid_fid_c.begin(); it_a != cid_fid_c.end(); it_a++) {
-      for (auto it_b = it_a; it_b != cid_fid_c.end(); it_b++) {
+    // The track is sorted by cid, so those from A come first.
+    rig::FlatTracks::Track cid_fid_c = C_tracks[pid];
+    auto B_begin = std::find_if(cid_fid_c.begin(), cid_fid_c.end(),
+                                [num_acid](rig::FlatTracks::CidFid const& p) {
+                                  return p.first >= num_acid; });
+    for (auto it_a = cid_fid_c.begin(); it_a != B_begin; it_a++) {
+      for (auto it_b = B_begin; it_b != cid_fid_c.end(); it_b++) {
         int cid_a = it_a->first, fid_a = it_a->second;
         int cid_b = it_b->first, fid_b = it_b->second;
-        if (cid_a >= num_acid) continue;
-        if (cid_b <  num_acid) continue;
 
         // Subtract num_acid from cid_b so it becomes a cid in B.
         cid_b -= num_acid;
@@ -657,15 +660,22 @@ void MergeMaps(rig::nvmData const& A,
                                    empty_nvm);
 
     // Split intro corresponding tracks in the two maps
-    std::vector<std::map<int, int>> A_pid_to_cid_fid, B_pid_to_cid_fid;
+    rig::FlatTracks C_tracks, A_tracks, B_tracks;
+    rig::toFlatTracks(C.pid_to_cid_fid, C_tracks);
     rig::KeypointVecT A_keypoint_vec, B_keypoint_vec;
     std::vector<rig::cameraImage> A_cams, B_cams;
     rig::splitTracksOneToOne(// Inputs
-                                   num_acid, C.pid_to_cid_fid, C_keypoint_vec, C_cams,  
+                                   num_acid, C_tracks, C_keypoint_vec, C_cams,  
                                    // Outputs
-                                   A_pid_to_cid_fid, B_pid_to_cid_fid,
+                                   A_tracks, B_tracks,
                                    A_keypoint_vec, B_keypoint_vec,  
                                    A_cams, B_cams);
+    C_tracks = rig::FlatTracks(); // wipe this
+    std::vector<std::map<int, int>> A_pid_to_cid_fid, B_pid_to_cid_fid;
+    rig::fromFlatTracks(A_tracks, A_pid_to_cid_fid);
+    rig::fromFlatTracks(B_tracks, B_pid_to_cid_fid);
+    A_tracks = rig::FlatTracks(); // wipe this
+    B_tracks = rig::FlatTracks(); // wipe this
     
 #if 1
     // TODO(oalexan1): This should be a function called findMatchingTriPoints().
@@ -766,35 +776,33 @@ void MergeMaps(rig::nvmData const& A,
                                                 Eigen::Vector2d(0, 0));
   std::vector<std::map<std::pair<float, float>, int>> merged_keypoint_map(num_out_cams);
   std::vector<int> find_count(num_out_cams, 0); // how many keypoints so far
-  std::vector<std::map<int, int>> merged_pid_to_cid_fid;
+  rig::FlatTracks merged_tracks;
   // Add A
   int cid_shift = 0; // A and C start with same images, so no shift
   rig::transformAppendNvm(A.pid_to_cid_fid, A.cid_to_keypoint_map,  
                                 cid2cid, keypoint_offsets, cid_shift, num_out_cams,
                                 // Append below
                                 find_count, merged_keypoint_map,
-                                merged_pid_to_cid_fid);
+                                merged_tracks);
   // Add B
   cid_shift = num_acid; // the B map starts later
   rig::transformAppendNvm(B.pid_to_cid_fid, B.cid_to_keypoint_map,  
                                 cid2cid, keypoint_offsets, cid_shift, num_out_cams,  
                                 // Append below
                                 find_count, merged_keypoint_map,
-                                merged_pid_to_cid_fid);
+                                merged_tracks);
   // Add C
   cid_shift = 0; // no shift, C is consistent with itself
   rig::transformAppendNvm(C.pid_to_cid_fid, C.cid_to_keypoint_map,  
                                 cid2cid, keypoint_offsets, cid_shift, num_out_cams,  
                                 // Append below
                                 find_count, merged_keypoint_map,
-                                merged_pid_to_cid_fid);
-
-  // Overwrite C.pid_to_cid_fid after the merge
-  C.pid_to_cid_fid = merged_pid_to_cid_fid;
-  merged_pid_to_cid_fid = std::vector<std::map<int, int>>();
+                                merged_tracks);
 
-  // Remove duplicate tracks
-  rig::rmDuplicateTracks(C.pid_to_cid_fid);
+  // Remove duplicate tracks, and overwrite C.pid_to_cid_fid after the merge
+  rig::rmDuplicateTracks(merged_tracks);
+  rig::fromFlatTracks(merged_tracks, C.pid_to_cid_fid);
+  merged_tracks = rig::FlatTracks(); // wipe this
 
   // Update C.cid_to_keypoint_map. This has the same data as
   // merged_keypoint_map but need to reverse key and value and use
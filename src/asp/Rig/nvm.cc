@@ -18,6 +18,7 @@
  */
 
 #include <Rig/nvm.h>
+#include <Rig/nvm_binary.h>
 #include <Rig/RigCameraParams.h>
 #include <Rig/RigRpcDistortion.h>
 #include <Rig/camera_image.h>
@@ -764,6 +765,10 @@ void readNvm(std::string                       const& input_filename,
 void readNvm(std::string const& input_filename, 
              bool nvm_no_shift,
              rig::nvmData & nvm) {
+  if (rig::isBinaryNvm(input_filename)) {
+    rig::readBinaryNvm(input_filename, nvm_no_shift, nvm);
+    return;
+  }
   readNvm(input_filename,
           nvm_no_shift,
           nvm.cid_to_keypoint_map,
@@ -777,6 +782,10 @@ void readNvm(std::string const& input_filename,
 
 // A wrapper for writing an nvm file
 void writeNvm(rig::nvmData const& nvm, std::string const& output_filename) {
+  if (rig::isBinaryNvm(output_filename)) {
+    rig::writeBinaryNvm(nvm, output_filename);
+    return;
+  }
   writeNvm(nvm.cid_to_keypoint_map,
           nvm.cid_to_filename,
           nvm.focal_lengths,
@@ -990,6 +999,14 @@ void readNvmAsCnet(std::string const& input_filename,
                    std::vector<Eigen::Affine3d> & world_to_cam,
                    std::map<std::string, Eigen::Vector2d> & optical_offsets) {
 
+  // The binary format is converted directly, without the nvm object
+  if (rig::isBinaryNvm(input_filename)) {
+    rig::BinaryNvm bnvm(input_filename);
+    rig::binaryNvmToCnet(bnvm, image_files, nvm_no_shift, cnet, world_to_cam,
+                         optical_offsets);
+    return;
+  }
+
   // Read the NVM file
   rig::nvmData nvm;
   rig::readNvm(input_filename, nvm_no_shift, nvm);
@@ -1010,6 +1027,11 @@ void writeCnetAsNvm(vw::ba::ControlNetwork const& cnet,
                     std::vector<Eigen::Affine3d> const& world_to_cam,
                     std::string const& output_filename) {
 
+  if (rig::isBinaryNvm(output_filename)) {
+    rig::writeCnetAsBinaryNvm(cnet, optical_offsets, world_to_cam, output_filename);
+    return;
+  }
+
   // Convert to an nvm
   rig::nvmData nvm;
   rig::cnetToNvm(cnet, optical_offsets, world_to_cam, nvm);
@@ -96,7 +96,8 @@ void writeNvmOffsets(std::string const& offset_path,
                      std::map<std::string, Eigen::Vector2d> const& offsets);
   
 // Write an NVM file. Subtract from the interest points the given offset.
-// The offsets are saved in a separate file.
+// The offsets are saved in a separate file. If the file extension is .nvmb,
+// use instead the binary format (nvm_binary.h).
 void writeNvm(rig::nvmData const& nvm, std::string const& output_filename);
 
 // Write an nvm file. Keypoints are written as-is, and maybe shifted or not
@@ -141,7 +142,8 @@ void writePinholeCameras(std::vector<std::string>              const& cam_names,
                          std::vector<Eigen::Affine3d>          const& world_to_cam,
                          std::string                           const& out_dir);
  
-// Read an NVM file. Any offset is applied upon reading.
+// Read an NVM file. Any offset is applied upon reading. The binary format
+// is read as well.
 void readNvm(std::string const& input_filename, bool nvm_no_shift, rig::nvmData & nvm);
 
 // Read an NVM file into the VisionWorkbench control network format. The flag
@@ -0,0 +1,511 @@
+/* Copyright (c) 2021, United States Government, as represented by the
+ * Administrator of the National Aeronautics and Space Administration.
+ *
+ * All rights reserved.
+ *
+ * The "ISAAC - Integrated System for Autonomous and Adaptive Caretaking
+ * platform" software is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <Rig/nvm_binary.h>
+#include <Rig/nvm.h>
+
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+#include <vw/FileIO/FileUtils.h>
+#include <vw/BundleAdjustment/ControlNetwork.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <cstring>
+#include <fstream>
+
+namespace fs = boost::filesystem;
+
+namespace rig {
+
+// The layout of a binary nvm file. All values are in native byte order.
+// Each section starts at a multiple of 8 bytes, so that the arrays can be
+// accessed in place once the file is memory-mapped.
+//   magic string (8 bytes)
+//   int64: number of cameras, points, observations, and 1 if there are
+//          optical centers, 0 otherwise
+//   for each camera:
+//     int64 name length, name, padded with zeros to a multiple of 8 bytes
+//     double: focal length, world-to-camera transform (3x4 matrix, row-major),
+//             optical center (2 values)
+//   int64 track offsets (number of points + 1)
+//   double xyz (3 per point)
+//   double pixels (2 per observation)
+//   int32 camera ids (1 per observation)
+//   int32 feature ids (1 per observation)
+const char BINARY_NVM_MAGIC[8] = {'A', 'S', 'P', 'N', 'V', 'M', 'B', '1'};
+
+bool isBinaryNvm(std::string const& filename) {
+  return boost::to_lower_copy(fs::path(filename).extension().string()) == ".nvmb";
+}
+
+namespace {
+
+template<class T>
+void writeVal(std::ofstream & ofs, T val) {
+  ofs.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void writeString(std::ofstream & ofs, std::string const& str) {
+  writeVal<std::int64_t>(ofs, str.size());
+  ofs.write(str.data(), str.size());
+  const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  ofs.write(zeros, (8 - str.size() % 8) % 8);
+}
+
+// Sequential reading from the memory-mapped file, with bounds checks
+class MappedReader {
+public:
+  MappedReader(const char* data, size_t len, std::string const& filename):
+    m_data(data), m_len(len), m_pos(0), m_filename(filename) {}
+
+  // Return a pointer to the next num values of type T, and move past them
+  template<class T>
+  T const* take(std::int64_t num) {
+    if (num < 0 || std::uint64_t(num) > (m_len - m_pos) / sizeof(T))
+      vw::vw_throw(vw::ArgumentErr() << "Truncated binary nvm file: " << m_filename << ".\n");
+    T const* ptr = reinterpret_cast<T const*>(m_data + m_pos);
+    m_pos += num * sizeof(T);
+    return ptr;
+  }
+
+  template<class T>
+  T read() {
+    T val;
+    std::memcpy(&val, take<char>(sizeof(T)), sizeof(T));
+    return val;
+  }
+
+  std::string readString() {
+    std::int64_t len = read<std::int64_t>();
+    const char* ptr = take<char>(len);
+    take<char>((8 - len % 8) % 8);
+    return std::string(ptr, len);
+  }
+
+private:
+  const char* m_data;
+  size_t m_len, m_pos;
+  std::string m_filename;
+};
+
+// Write the header and the cameras
+void writeBinaryNvmCameras(std::ofstream & ofs,
+                           std::vector<std::string> const& cid_to_filename,
+                           std::vector<double> const& focal_lengths,
+                           std::vector<Eigen::Affine3d> const& world_to_cam,
+                           std::map<std::string, Eigen::Vector2d> const& optical_centers,
+                           std::int64_t num_points, std::int64_t num_obs) {
+
+  if (cid_to_filename.size() != world_to_cam.size())
+    vw::vw_throw(vw::ArgumentErr() << "Unequal number of filename and camera transforms.");
+
+  ofs.write(BINARY_NVM_MAGIC, sizeof(BINARY_NVM_MAGIC));
+  writeVal<std::int64_t>(ofs, cid_to_filename.size());
+  writeVal<std::int64_t>(ofs, num_points);
+  writeVal<std::int64_t>(ofs, num_obs);
+  writeVal<std::int64_t>(ofs, !optical_centers.empty());
+
+  for (size_t cid = 0; cid < cid_to_filename.size(); cid++) {
+    writeString(ofs, cid_to_filename[cid]);
+
+    double focal_length = 1.0;
+    if (!focal_lengths.empty())
+      focal_length = focal_lengths[cid];
+    writeVal(ofs, focal_length);
+
+    Eigen::Matrix4d T = world_to_cam[cid].matrix();
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++)
+        writeVal(ofs, T(row, col));
+    }
+
+    Eigen::Vector2d offset = Eigen::Vector2d::Zero();
+    if (!optical_centers.empty()) {
+      auto map_it = optical_centers.find(cid_to_filename[cid]);
+      if (map_it == optical_centers.end())
+        vw::vw_throw(vw::ArgumentErr() << "Cannot find optical offset for image "
+                     << cid_to_filename[cid] << "\n");
+      offset = map_it->second;
+    }
+    writeVal(ofs, offset[0]);
+    writeVal(ofs, offset[1]);
+  }
+}
+
+// Open the output file with a large buffer. The data is first written to a
+// temporary file, which is renamed when done, so an interrupted write does
+// not leave behind a truncated file.
+void openBinaryNvm(std::string const& output_filename, std::vector<char> & buf,
+                   std::ofstream & ofs) {
+  vw::create_out_dir(output_filename);
+  vw::vw_out() << "Writing: " << output_filename << std::endl;
+  buf.resize(1 << 22);
+  ofs.rdbuf()->pubsetbuf(&buf[0], buf.size());
+  ofs.open((output_filename + ".tmp").c_str(), std::ios::binary);
+  if (!ofs.good())
+    vw::vw_throw(vw::ArgumentErr() << "Cannot write: " << output_filename << ".\n");
+}
+
+void closeBinaryNvm(std::string const& output_filename, std::ofstream & ofs) {
+  ofs.close();
+  if (!ofs.good())
+    vw::vw_throw(vw::ArgumentErr() << "Failed writing: " << output_filename << ".\n");
+  fs::rename(output_filename + ".tmp", output_filename);
+}
+
+// The optical centers to return on reading
+void binaryNvmOffsets(rig::BinaryNvm const& bnvm, bool nvm_no_shift,
+                      std::map<std::string, Eigen::Vector2d> & offsets) {
+  if (nvm_no_shift) {
+    offsets.clear();
+    for (auto const& name: bnvm.cidToFilename())
+      offsets[name] = Eigen::Vector2d(0, 0);
+  } else {
+    if (bnvm.opticalCenters().empty())
+      vw::vw_throw(vw::ArgumentErr() << "The binary nvm file has no optical centers.\n");
+    offsets = bnvm.opticalCenters();
+  }
+}
+
+} // end anonymous namespace
+
+BinaryNvm::BinaryNvm(std::string const& filename) {
+
+  vw::vw_out() << "Reading: " << filename << "\n";
+  try {
+    m_file.reset(new boost::iostreams::mapped_file_source(filename));
+  } catch (std::exception const& e) {
+    vw::vw_throw(vw::ArgumentErr() << "Cannot read: " << filename << ". "
+                 << e.what() << "\n");
+  }
+
+  MappedReader reader(m_file->data(), m_file->size(), filename);
+  if (std::memcmp(reader.take<char>(sizeof(BINARY_NVM_MAGIC)), BINARY_NVM_MAGIC,
+                  sizeof(BINARY_NVM_MAGIC)) != 0)
+    vw::vw_throw(vw::ArgumentErr() << "Not a binary nvm file: " << filename << ".\n");
+
+  std::int64_t num_cams = reader.read<std::int64_t>();
+  m_num_points = reader.read<std::int64_t>();
+  m_num_obs = reader.read<std::int64_t>();
+  bool have_optical_centers = reader.read<std::int64_t>();
+  if (num_cams < 1)
+    vw::vw_throw(vw::ArgumentErr() << "NVM file is missing cameras.");
+  if (m_num_points < 1)
+    vw::vw_throw(vw::ArgumentErr() << "The NVM file has no triangulated points.");
+
+  // Each camera, point, and observation takes at least one byte, so larger
+  // counts are from a corrupt header. Check before allocating or multiplying.
+  std::int64_t file_size = m_file->size();
+  if (num_cams > file_size || m_num_points > file_size || m_num_obs < 0 ||
+      m_num_obs > file_size)
+    vw::vw_throw(vw::ArgumentErr() << "Truncated binary nvm file: " << filename << ".\n");
+
+  m_cid_to_filename.resize(num_cams);
+  m_focal_lengths.resize(num_cams);
+  m_world_to_cam.resize(num_cams);
+  for (std::int64_t cid = 0; cid < num_cams; cid++) {
+    m_cid_to_filename[cid] = reader.readString();
+    m_focal_lengths[cid] = reader.read<double>();
+
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++)
+        T(row, col) = reader.read<double>();
+    }
+    m_world_to_cam[cid].matrix() = T;
+
+    Eigen::Vector2d offset;
+    offset[0] = reader.read<double>();
+    offset[1] = reader.read<double>();
+    if (have_optical_centers)
+      m_optical_centers[m_cid_to_filename[cid]] = offset;
+  }
+
+  m_track_offsets = reader.take<std::int64_t>(m_num_points + 1);
+  m_xyz           = reader.take<double>(3 * m_num_points);
+  m_pixels        = reader.take<double>(2 * m_num_obs);
+  m_cids          = reader.take<std::int32_t>(m_num_obs);
+  m_fids          = reader.take<std::int32_t>(m_num_obs);
+
+  // Validate the tracks once, so that users of this class need not check
+  if (m_track_offsets[0] != 0 || m_track_offsets[m_num_points] != m_num_obs)
+    vw::vw_throw(vw::ArgumentErr() << "Invalid track offsets in: " << filename << ".\n");
+  for (std::int64_t pid = 0; pid < m_num_points; pid++) {
+    if (m_track_offsets[pid + 1] < m_track_offsets[pid])
+      vw::vw_throw(vw::ArgumentErr() << "Invalid track offsets in: " << filename << ".\n");
+  }
+  for (std::int64_t obs = 0; obs < m_num_obs; obs++) {
+    if (m_cids[obs] < 0 || m_cids[obs] >= num_cams || m_fids[obs] < 0)
+      vw::vw_throw(vw::ArgumentErr() << "Invalid camera or feature id in: "
+                   << filename << ".\n");
+  }
+}
+
+// Write an nvm object in the binary format
+void writeBinaryNvm(rig::nvmData const& nvm, std::string const& output_filename) {
+
+  if (nvm.cid_to_filename.size() != nvm.cid_to_keypoint_map.size())
+    vw::vw_throw(vw::ArgumentErr() << "Unequal number of filenames and keypoints.");
+  if (nvm.pid_to_cid_fid.size() != nvm.pid_to_xyz.size())
+    vw::vw_throw(vw::ArgumentErr()
+                 << "Unequal number of pid_to_cid_fid and xyz measurements.");
+
+  std::int64_t num_points = nvm.pid_to_cid_fid.size(), num_obs = 0;
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    if (nvm.pid_to_cid_fid[pid].size() <= 1)
+      vw::vw_throw(vw::ArgumentErr() << "PID " << pid << " has "
+                   << nvm.pid_to_cid_fid[pid].size() << " measurements.");
+    num_obs += nvm.pid_to_cid_fid[pid].size();
+  }
+
+  std::vector<char> buf;
+  std::ofstream ofs;
+  openBinaryNvm(output_filename, buf, ofs);
+  writeBinaryNvmCameras(ofs, nvm.cid_to_filename, nvm.focal_lengths, nvm.world_to_cam,
+                        nvm.optical_centers, num_points, num_obs);
+
+  std::int64_t offset = 0;
+  writeVal(ofs, offset);
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    offset += nvm.pid_to_cid_fid[pid].size();
+    writeVal(ofs, offset);
+  }
+
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    for (int coord = 0; coord < 3; coord++)
+      writeVal(ofs, nvm.pid_to_xyz[pid][coord]);
+  }
+
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    for (auto const& cid_fid: nvm.pid_to_cid_fid[pid]) {
+      Eigen::Vector2d pix = nvm.cid_to_keypoint_map[cid_fid.first].col(cid_fid.second);
+      writeVal(ofs, pix[0]);
+      writeVal(ofs, pix[1]);
+    }
+  }
+
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    for (auto const& cid_fid: nvm.pid_to_cid_fid[pid])
+      writeVal<std::int32_t>(ofs, cid_fid.first);
+  }
+
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    for (auto const& cid_fid: nvm.pid_to_cid_fid[pid])
+      writeVal<std::int32_t>(ofs, cid_fid.second);
+  }
+
+  closeBinaryNvm(output_filename, ofs);
+}
+
+// Read a binary nvm file
+void readBinaryNvm(std::string const& input_filename, bool nvm_no_shift,
+                   rig::nvmData & nvm) {
+
+  rig::BinaryNvm bnvm(input_filename);
+
+  nvm = rig::nvmData();
+  nvm.cid_to_filename = bnvm.cidToFilename();
+  nvm.focal_lengths   = bnvm.focalLengths();
+  nvm.world_to_cam    = bnvm.worldToCam();
+  binaryNvmOffsets(bnvm, nvm_no_shift, nvm.optical_centers);
+
+  std::int64_t num_cams = bnvm.numCameras(), num_points = bnvm.numPoints(),
+    num_obs = bnvm.numObservations();
+  std::int64_t const* offsets = bnvm.trackOffsets();
+  double const* xyz = bnvm.xyz();
+  double const* pixels = bnvm.pixels();
+  std::int32_t const* cids = bnvm.cids();
+  std::int32_t const* fids = bnvm.fids();
+
+  // Size the keypoint maps first, to avoid resizing them repeatedly
+  std::vector<std::int64_t> num_fids(num_cams, 0);
+  for (std::int64_t obs = 0; obs < num_obs; obs++)
+    num_fids[cids[obs]] = std::max<std::int64_t>(num_fids[cids[obs]], fids[obs] + 1);
+  nvm.cid_to_keypoint_map.resize(num_cams);
+  for (std::int64_t cid = 0; cid < num_cams; cid++)
+    nvm.cid_to_keypoint_map[cid] = Eigen::Matrix2Xd::Zero(2, num_fids[cid]);
+
+  nvm.pid_to_xyz.resize(num_points);
+  nvm.pid_to_cid_fid.resize(num_points);
+  for (std::int64_t pid = 0; pid < num_points; pid++) {
+    nvm.pid_to_xyz[pid] = Eigen::Vector3d(xyz[3 * pid], xyz[3 * pid + 1], xyz[3 * pid + 2]);
+    for (std::int64_t obs = offsets[pid]; obs < offsets[pid + 1]; obs++) {
+      nvm.pid_to_cid_fid[pid][cids[obs]] = fids[obs];
+      nvm.cid_to_keypoint_map[cids[obs]].col(fids[obs])
+        = Eigen::Vector2d(pixels[2 * obs], pixels[2 * obs + 1]);
+    }
+  }
+}
+
+// Convert a binary nvm file to a cnet
+void binaryNvmToCnet(rig::BinaryNvm const& bnvm,
+                     std::vector<std::string> const& image_files,
+                     bool nvm_no_shift,
+                     // Outputs
+                     vw::ba::ControlNetwork                 & cnet,
+                     std::vector<Eigen::Affine3d>           & world_to_cam,
+                     std::map<std::string, Eigen::Vector2d> & offsets) {
+
+  // The index of each image in the output. Must ensure the image list in the
+  // file agrees with the input image list, as for remapNvm().
+  std::vector<std::string> const& cid_to_filename = bnvm.cidToFilename();
+  std::int64_t num_cams = cid_to_filename.size();
+  std::vector<int> cid2cid(num_cams);
+  std::vector<std::string> out_files = cid_to_filename;
+  if (image_files.empty()) {
+    for (std::int64_t cid = 0; cid < num_cams; cid++)
+      cid2cid[cid] = cid;
+  } else {
+    if ((std::int64_t)image_files.size() != num_cams)
+      vw::vw_throw(vw::ArgumentErr()
+                   << "The nvm and input images do not have the same files.\n");
+    std::map<std::string, int> image_file2cid;
+    for (size_t i = 0; i < image_files.size(); i++)
+      image_file2cid[image_files[i]] = i;
+    std::set<int> used;
+    for (std::int64_t cid = 0; cid < num_cams; cid++) {
+      auto it = image_file2cid.find(cid_to_filename[cid]);
+      if (it == image_file2cid.end() || used.find(it->second) != used.end())
+        vw::vw_throw(vw::ArgumentErr() << "Cannot find image: " << cid_to_filename[cid]
+                     << " in the input images, or it is repeated in the nvm.\n");
+      cid2cid[cid] = it->second;
+      used.insert(it->second);
+    }
+    out_files = image_files;
+  }
+
+  cnet = vw::ba::ControlNetwork("ASP_control_network");
+  for (size_t cid = 0; cid < out_files.size(); cid++)
+    cnet.add_image_name(out_files[cid]);
+
+  world_to_cam.resize(num_cams);
+  for (std::int64_t cid = 0; cid < num_cams; cid++)
+    world_to_cam[cid2cid[cid]] = bnvm.worldToCam()[cid];
+  binaryNvmOffsets(bnvm, nvm_no_shift, offsets);
+
+  std::int64_t const* track_offsets = bnvm.trackOffsets();
+  double const* xyz = bnvm.xyz();
+  double const* pixels = bnvm.pixels();
+  std::int32_t const* cids = bnvm.cids();
+  for (std::int64_t pid = 0; pid < bnvm.numPoints(); pid++) {
+    vw::ba::ControlPoint cp;
+    cp.set_position(vw::Vector3(xyz[3 * pid], xyz[3 * pid + 1], xyz[3 * pid + 2]));
+    cp.set_type(vw::ba::ControlPoint::TiePoint); // this is the default
+    for (std::int64_t obs = track_offsets[pid]; obs < track_offsets[pid + 1]; obs++) {
+      double sigma = 1.0;
+      cp.add_measure(vw::ba::ControlMeasure(pixels[2 * obs], pixels[2 * obs + 1],
+                                            sigma, sigma, cid2cid[cids[obs]]));
+    }
+    cnet.add_control_point(cp);
+  }
+}
+
+// Write a cnet to a binary nvm file
+void writeCnetAsBinaryNvm(vw::ba::ControlNetwork                 const& cnet,
+                          std::map<std::string, Eigen::Vector2d> const& offsets,
+                          std::vector<Eigen::Affine3d>           const& world_to_cam,
+                          std::string                            const& output_filename,
+                          std::vector<Eigen::Vector3d>           const& tri_vec,
+                          std::set<int>                          const& outliers) {
+
+  std::vector<std::string> const& cid_to_filename = cnet.get_image_list();
+  if (cid_to_filename.size() != world_to_cam.size())
+    vw::vw_throw(vw::ArgumentErr()
+                 << "writeCnetAsBinaryNvm: Mismatch in cnet and world_to_cam.\n");
+  int num_points = cnet.size();
+  if (!tri_vec.empty() && (int)tri_vec.size() != num_points)
+    vw::vw_throw(vw::ArgumentErr() << "writeCnetAsBinaryNvm: Mismatch in tri_vec and cnet.\n");
+
+  std::int64_t num_inliers = 0, num_obs = 0;
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    if (cnet[pid].size() <= 1)
+      vw::vw_throw(vw::ArgumentErr() << "PID " << pid << " has "
+                   << cnet[pid].size() << " measurements.");
+    num_inliers++;
+    num_obs += cnet[pid].size();
+  }
+
+  std::vector<double> focal_lengths; // unknown, will write 1.0
+  std::vector<char> buf;
+  std::ofstream ofs;
+  openBinaryNvm(output_filename, buf, ofs);
+  writeBinaryNvmCameras(ofs, cid_to_filename, focal_lengths, world_to_cam, offsets,
+                        num_inliers, num_obs);
+
+  std::int64_t offset = 0;
+  writeVal(ofs, offset);
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    offset += cnet[pid].size();
+    writeVal(ofs, offset);
+  }
+
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    Eigen::Vector3d P;
+    if (tri_vec.empty()) {
+      vw::Vector3 Q = cnet[pid].position();
+      P = Eigen::Vector3d(Q[0], Q[1], Q[2]);
+    } else {
+      P = tri_vec[pid];
+    }
+    for (int coord = 0; coord < 3; coord++)
+      writeVal(ofs, P[coord]);
+  }
+
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    vw::ba::ControlPoint const& cp = cnet[pid];
+    for (size_t m = 0; m < cp.size(); m++) {
+      vw::Vector2 pix = cp[m].position();
+      writeVal(ofs, pix[0]);
+      writeVal(ofs, pix[1]);
+    }
+  }
+
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    vw::ba::ControlPoint const& cp = cnet[pid];
+    for (size_t m = 0; m < cp.size(); m++)
+      writeVal<std::int32_t>(ofs, cp[m].image_id());
+  }
+
+  // Number the features of each image in the order they are seen
+  std::vector<std::int32_t> num_fids(cid_to_filename.size(), 0);
+  for (int pid = 0; pid < num_points; pid++) {
+    if (outliers.find(pid) != outliers.end())
+      continue;
+    vw::ba::ControlPoint const& cp = cnet[pid];
+    for (size_t m = 0; m < cp.size(); m++)
+      writeVal<std::int32_t>(ofs, num_fids[cp[m].image_id()]++);
+  }
+
+  closeBinaryNvm(output_filename, ofs);
+}
+
+}  // end namespace rig
@@ -0,0 +1,133 @@
+/* Copyright (c) 2021, United States Government, as represented by the
+ * Administrator of the National Aeronautics and Space Administration.
+ *
+ * All rights reserved.
+ *
+ * The "ISAAC - Integrated System for Autonomous and Adaptive Caretaking
+ * platform" software is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// A binary version of the nvm format, for large maps. The tracks are stored
+// in compressed sparse row form: the observations of track pid are at
+// indices track_offsets[pid] to track_offsets[pid + 1] - 1 in the arrays of
+// camera ids, feature ids, and pixels. The file is memory-mapped on reading.
+// Unlike for the text format, the interest points are stored without a shift,
+// and the optical centers are kept in the same file.
+
+#ifndef NVM_BINARY_H_
+#define NVM_BINARY_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <boost/shared_ptr.hpp>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace boost {
+  namespace iostreams {
+    class mapped_file_source;
+  }
+}
+
+namespace vw {
+  namespace ba {
+    class ControlNetwork;
+  }
+}
+
+namespace rig {
+
+struct nvmData;
+
+// If this file is in the binary nvm format, judging by its extension (.nvmb)
+bool isBinaryNvm(std::string const& filename);
+
+// Read-only access to a binary nvm file. The cameras are read into memory,
+// while the tracks are accessed in place in the memory-mapped file.
+class BinaryNvm {
+public:
+  explicit BinaryNvm(std::string const& filename);
+
+  std::int64_t numCameras() const { return m_cid_to_filename.size(); }
+  std::int64_t numPoints() const { return m_num_points; }
+  std::int64_t numObservations() const { return m_num_obs; }
+
+  std::vector<std::string>     const& cidToFilename() const { return m_cid_to_filename; }
+  std::vector<double>          const& focalLengths()  const { return m_focal_lengths; }
+  std::vector<Eigen::Affine3d> const& worldToCam()    const { return m_world_to_cam; }
+
+  // Empty if the file has no optical centers
+  std::map<std::string, Eigen::Vector2d> const& opticalCenters() const {
+    return m_optical_centers;
+  }
+
+  // Arrays of size numPoints() + 1, 3 * numPoints(), numObservations(),
+  // numObservations(), and 2 * numObservations(), respectively.
+  std::int64_t const* trackOffsets() const { return m_track_offsets; }
+  double       const* xyz()          const { return m_xyz; }
+  std::int32_t const* cids()         const { return m_cids; }
+  std::int32_t const* fids()         const { return m_fids; }
+  double       const* pixels()       const { return m_pixels; }
+
+private:
+  boost::shared_ptr<boost::iostreams::mapped_file_source> m_file;
+  std::int64_t m_num_points, m_num_obs;
+  std::vector<std::string> m_cid_to_filename;
+  std::vector<double> m_focal_lengths;
+  std::vector<Eigen::Affine3d> m_world_to_cam;
+  std::map<std::string, Eigen::Vector2d> m_optical_centers;
+  std::int64_t const* m_track_offsets;
+  double const* m_xyz;
+  std::int32_t const* m_cids;
+  std::int32_t const* m_fids;
+  double const* m_pixels;
+};
+
+// Write an nvm object in the binary format
+void writeBinaryNvm(rig::nvmData const& nvm, std::string const& output_filename);
+
+// Read a binary nvm file. If nvm_no_shift is true, the optical centers are
+// set to zero, as for the text format. The interest points are never shifted.
+void readBinaryNvm(std::string const& input_filename, bool nvm_no_shift,
+                   rig::nvmData & nvm);
+
+// Convert a binary nvm file to a cnet, without creating an nvm object first.
+// If image_files is not empty, the images in the cnet are in this order.
+// The flag nvm_no_shift has the same meaning as for readBinaryNvm().
+void binaryNvmToCnet(rig::BinaryNvm const& bnvm,
+                     std::vector<std::string> const& image_files,
+                     bool nvm_no_shift,
+                     // Outputs
+                     vw::ba::ControlNetwork                 & cnet,
+                     std::vector<Eigen::Affine3d>           & world_to_cam,
+                     std::map<std::string, Eigen::Vector2d> & offsets);
+
+// Write a cnet to a binary nvm file, without creating an nvm object first.
+// Each observation gets its own feature id. Optionally, updated triangulated
+// points and outlier flags can be passed in, as for cnetToNvm().
+void writeCnetAsBinaryNvm(vw::ba::ControlNetwork                 const& cnet,
+                          std::map<std::string, Eigen::Vector2d> const& offsets,
+                          std::vector<Eigen::Affine3d>           const& world_to_cam,
+                          std::string                            const& output_filename,
+                          std::vector<Eigen::Vector3d> const& tri_vec
+                          = std::vector<Eigen::Vector3d>(),
+                          std::set<int> const& outliers = std::set<int>());
+
+}  // namespace rig
+
+#endif  // NVM_BINARY_H_
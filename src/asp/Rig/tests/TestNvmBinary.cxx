@@ -0,0 +1,322 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Rig/nvm.h>
+#include <asp/Rig/nvm_binary.h>
+
+#include <vw/Core/Exception.h>
+#include <vw/BundleAdjustment/ControlNetwork.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+using namespace vw;
+using namespace vw::test;
+
+namespace fs = boost::filesystem;
+
+// A small map with 3 cameras and 5 tracks, with optical centers
+rig::nvmData syntheticNvm() {
+
+  rig::nvmData nvm;
+  int num_cams = 3, num_points = 5;
+  for (int cid = 0; cid < num_cams; cid++) {
+    std::string name = "image" + std::to_string(cid) + ".tif";
+    nvm.cid_to_filename.push_back(name);
+    nvm.focal_lengths.push_back(1000.0 + 10.5 * cid);
+    nvm.optical_centers[name] = Eigen::Vector2d(320.25 + cid, 240.75 - cid);
+
+    Eigen::Affine3d T;
+    T.linear() = Eigen::AngleAxisd(0.1 * (cid + 1), Eigen::Vector3d(1, 2, 3).normalized())
+      .toRotationMatrix();
+    T.translation() = Eigen::Vector3d(0.5 * cid, -1.0, 2.0 + cid);
+    nvm.world_to_cam.push_back(T);
+
+    nvm.cid_to_keypoint_map.push_back(Eigen::Matrix2Xd(2, num_points));
+  }
+
+  // The first points are seen in all cameras, the rest in all but one. The
+  // feature id is the same as the point id.
+  for (int pid = 0; pid < num_points; pid++) {
+    nvm.pid_to_xyz.push_back(Eigen::Vector3d(pid, 2.0 * pid - 1.5, 10.0 + 0.25 * pid));
+    std::map<int, int> cid_fid;
+    for (int cid = 0; cid < num_cams; cid++) {
+      nvm.cid_to_keypoint_map[cid].col(pid)
+        = Eigen::Vector2d(100.125 * pid + cid, 50.5 * cid + pid + 0.375);
+      if (cid != pid % num_cams || pid < num_cams - 1)
+        cid_fid[cid] = pid;
+    }
+    nvm.pid_to_cid_fid.push_back(cid_fid);
+  }
+
+  return nvm;
+}
+
+void expectNvmNear(rig::nvmData const& a, rig::nvmData const& b, double tol) {
+
+  EXPECT_EQ(a.cid_to_filename, b.cid_to_filename);
+  EXPECT_EQ(a.pid_to_cid_fid, b.pid_to_cid_fid);
+  EXPECT_EQ(a.focal_lengths, b.focal_lengths);
+  ASSERT_EQ(a.world_to_cam.size(), b.world_to_cam.size());
+  for (size_t cid = 0; cid < a.world_to_cam.size(); cid++)
+    EXPECT_LE((a.world_to_cam[cid].matrix() - b.world_to_cam[cid].matrix()).norm(), tol);
+
+  ASSERT_EQ(a.optical_centers.size(), b.optical_centers.size());
+  for (auto const& it: a.optical_centers) {
+    ASSERT_EQ(b.optical_centers.count(it.first), 1u);
+    EXPECT_LE((it.second - b.optical_centers.at(it.first)).norm(), tol);
+  }
+
+  ASSERT_EQ(a.pid_to_xyz.size(), b.pid_to_xyz.size());
+  for (size_t pid = 0; pid < a.pid_to_xyz.size(); pid++)
+    EXPECT_LE((a.pid_to_xyz[pid] - b.pid_to_xyz[pid]).norm(), tol);
+
+  // Compare only the keypoints in the tracks
+  for (size_t pid = 0; pid < a.pid_to_cid_fid.size(); pid++) {
+    for (auto const& cid_fid: a.pid_to_cid_fid[pid]) {
+      Eigen::Vector2d pa = a.cid_to_keypoint_map[cid_fid.first].col(cid_fid.second);
+      Eigen::Vector2d pb = b.cid_to_keypoint_map[cid_fid.first].col(cid_fid.second);
+      EXPECT_LE((pa - pb).norm(), tol);
+    }
+  }
+}
+
+// The measures of each control point, indexed by image name, as the images
+// can be in a different order in each network.
+std::vector<std::map<std::string, vw::Vector2>>
+cnetMeasures(vw::ba::ControlNetwork const& cnet) {
+  std::vector<std::string> const& images = cnet.get_image_list();
+  std::vector<std::map<std::string, vw::Vector2>> measures(cnet.size());
+  for (size_t pid = 0; pid < cnet.size(); pid++) {
+    for (size_t m = 0; m < cnet[pid].size(); m++)
+      measures[pid][images[cnet[pid][m].image_id()]] = cnet[pid][m].position();
+  }
+  return measures;
+}
+
+TEST(NvmBinary, WriteRead) {
+
+  UnlinkName dir("nvm_binary_write_read");
+  std::string text_file = dir + "/map.nvm", bin_file = dir + "/map.nvmb";
+  EXPECT_FALSE(rig::isBinaryNvm(text_file));
+  EXPECT_TRUE(rig::isBinaryNvm(bin_file));
+
+  // Go through the text format first, then convert it to binary. The binary
+  // format stores all values exactly, so the result must be the same as
+  // what is read from the text file.
+  rig::nvmData orig = syntheticNvm(), text_nvm, bin_nvm;
+  rig::writeNvm(orig, text_file);
+  rig::readNvm(text_file, false, text_nvm);
+  expectNvmNear(orig, text_nvm, 1e-10);
+
+  rig::writeNvm(text_nvm, bin_file);
+  EXPECT_FALSE(fs::exists(bin_file + ".tmp"));
+  rig::readNvm(bin_file, false, bin_nvm);
+  expectNvmNear(text_nvm, bin_nvm, 0.0);
+
+  rig::BinaryNvm bnvm(bin_file);
+  EXPECT_EQ(bnvm.numCameras(), 3);
+  EXPECT_EQ(bnvm.numPoints(), 5);
+  EXPECT_EQ(bnvm.numObservations(), 12);
+  EXPECT_EQ(bnvm.trackOffsets()[bnvm.numPoints()], bnvm.numObservations());
+
+  // Without the shift, the optical centers are zero and the interest points
+  // are still as stored.
+  rig::nvmData no_shift_nvm;
+  rig::readBinaryNvm(bin_file, true, no_shift_nvm);
+  for (auto const& it: no_shift_nvm.optical_centers)
+    EXPECT_EQ(it.second, Eigen::Vector2d(0, 0));
+  no_shift_nvm.optical_centers = bin_nvm.optical_centers;
+  expectNvmNear(bin_nvm, no_shift_nvm, 0.0);
+}
+
+TEST(NvmBinary, Cnet) {
+
+  UnlinkName dir("nvm_binary_cnet");
+  std::string text_file = dir + "/map.nvm", bin_file = dir + "/map.nvmb";
+  rig::nvmData orig = syntheticNvm();
+  rig::writeNvm(orig, text_file);
+  rig::writeNvm(orig, bin_file);
+
+  // Read both formats as a cnet, with the images in reverse order
+  std::vector<std::string> image_files(orig.cid_to_filename.rbegin(),
+                                       orig.cid_to_filename.rend());
+  vw::ba::ControlNetwork text_cnet("text"), bin_cnet("bin");
+  std::vector<Eigen::Affine3d> text_world_to_cam, bin_world_to_cam;
+  std::map<std::string, Eigen::Vector2d> text_offsets, bin_offsets;
+  rig::readNvmAsCnet(text_file, image_files, false, text_cnet, text_world_to_cam,
+                     text_offsets);
+  rig::readNvmAsCnet(bin_file, image_files, false, bin_cnet, bin_world_to_cam,
+                     bin_offsets);
+
+  EXPECT_EQ(bin_cnet.get_image_list(), image_files);
+  EXPECT_EQ(text_cnet.get_image_list(), image_files);
+  ASSERT_EQ(bin_cnet.size(), orig.pid_to_xyz.size());
+  ASSERT_EQ(bin_world_to_cam.size(), image_files.size());
+  for (size_t cid = 0; cid < image_files.size(); cid++) {
+    int orig_cid = image_files.size() - 1 - cid;
+    EXPECT_EQ(bin_world_to_cam[cid].matrix(), orig.world_to_cam[orig_cid].matrix());
+    EXPECT_TRUE(text_world_to_cam[cid].matrix().isApprox(bin_world_to_cam[cid].matrix(),
+                                                         1e-10));
+  }
+  EXPECT_EQ(bin_offsets, orig.optical_centers);
+
+  auto text_measures = cnetMeasures(text_cnet), bin_measures = cnetMeasures(bin_cnet);
+  ASSERT_EQ(text_measures.size(), bin_measures.size());
+  for (size_t pid = 0; pid < bin_measures.size(); pid++) {
+    EXPECT_VECTOR_NEAR(bin_cnet[pid].position(), text_cnet[pid].position(), 1e-10);
+    ASSERT_EQ(bin_measures[pid].size(), text_measures[pid].size());
+    for (auto const& it: bin_measures[pid]) {
+      ASSERT_EQ(text_measures[pid].count(it.first), 1u);
+      EXPECT_VECTOR_NEAR(it.second, text_measures[pid][it.first], 1e-10);
+    }
+  }
+
+  // Write the cnet back in both formats, skipping an outlier. The binary
+  // writer gives each observation its own feature id, so compare the pixels.
+  std::string text_out = dir + "/out.nvm", bin_out = dir + "/out.nvmb";
+  rig::writeCnetAsNvm(bin_cnet, bin_offsets, bin_world_to_cam, text_out);
+  rig::writeCnetAsNvm(bin_cnet, bin_offsets, bin_world_to_cam, bin_out);
+  std::set<int> outliers = {1};
+  std::string bin_out_inliers = dir + "/out_inliers.nvmb";
+  rig::writeCnetAsBinaryNvm(bin_cnet, bin_offsets, bin_world_to_cam, bin_out_inliers,
+                            std::vector<Eigen::Vector3d>(), outliers);
+
+  rig::nvmData text_out_nvm, bin_out_nvm, inliers_nvm;
+  rig::readNvm(text_out, false, text_out_nvm);
+  rig::readNvm(bin_out, false, bin_out_nvm);
+  rig::readNvm(bin_out_inliers, false, inliers_nvm);
+  EXPECT_EQ(bin_out_nvm.cid_to_filename, image_files);
+  ASSERT_EQ(bin_out_nvm.pid_to_cid_fid.size(), orig.pid_to_cid_fid.size());
+  ASSERT_EQ(inliers_nvm.pid_to_cid_fid.size(), orig.pid_to_cid_fid.size() - 1);
+  for (size_t pid = 0; pid < bin_out_nvm.pid_to_cid_fid.size(); pid++) {
+    auto const& bin_track  = bin_out_nvm.pid_to_cid_fid[pid];
+    auto const& text_track = text_out_nvm.pid_to_cid_fid[pid];
+    ASSERT_EQ(bin_track.size(), text_track.size());
+    EXPECT_EQ(bin_out_nvm.pid_to_xyz[pid], orig.pid_to_xyz[pid]);
+    for (auto const& cid_fid: bin_track) {
+      ASSERT_EQ(text_track.count(cid_fid.first), 1u);
+      Eigen::Vector2d pb = bin_out_nvm.cid_to_keypoint_map[cid_fid.first].col(cid_fid.second);
+      Eigen::Vector2d pt = text_out_nvm.cid_to_keypoint_map[cid_fid.first]
+        .col(text_track.at(cid_fid.first));
+      EXPECT_LE((pb - pt).norm(), 1e-10);
+    }
+  }
+  EXPECT_EQ(inliers_nvm.pid_to_xyz[0], orig.pid_to_xyz[0]);
+  EXPECT_EQ(inliers_nvm.pid_to_xyz[1], orig.pid_to_xyz[2]);
+}
+
+TEST(NvmBinary, EmptyTracks) {
+
+  // A map with cameras but no tracks can be written, but like the text
+  // format, it is refused on reading.
+  UnlinkName dir("nvm_binary_empty");
+  rig::nvmData nvm = syntheticNvm();
+  nvm.pid_to_cid_fid.clear();
+  nvm.pid_to_xyz.clear();
+
+  std::string text_file = dir + "/map.nvm", bin_file = dir + "/map.nvmb";
+  rig::writeNvm(nvm, text_file);
+  rig::writeNvm(nvm, bin_file);
+
+  rig::nvmData out;
+  EXPECT_THROW(rig::readNvm(text_file, false, out), vw::ArgumentErr);
+  EXPECT_THROW(rig::readNvm(bin_file, false, out), vw::ArgumentErr);
+  EXPECT_THROW(rig::BinaryNvm bnvm(bin_file), vw::ArgumentErr);
+
+  // Same when going through a cnet
+  vw::ba::ControlNetwork cnet("empty");
+  for (auto const& name: nvm.cid_to_filename)
+    cnet.add_image_name(name);
+  std::string cnet_file = dir + "/cnet.nvmb";
+  rig::writeCnetAsNvm(cnet, nvm.optical_centers, nvm.world_to_cam, cnet_file);
+  std::vector<Eigen::Affine3d> world_to_cam;
+  std::map<std::string, Eigen::Vector2d> offsets;
+  EXPECT_THROW(rig::readNvmAsCnet(cnet_file, std::vector<std::string>(), false, cnet,
+                                  world_to_cam, offsets), vw::ArgumentErr);
+}
+
+// Write the given bytes to a file
+void writeBytes(std::string const& file, std::string const& bytes) {
+  std::ofstream ofs(file.c_str(), std::ios::binary);
+  ofs.write(bytes.data(), bytes.size());
+}
+
+TEST(NvmBinary, InvalidFile) {
+
+  UnlinkName dir("nvm_binary_invalid");
+  std::string good_file = dir + "/good.nvmb", bad_file = dir + "/bad.nvmb";
+  rig::nvmData nvm = syntheticNvm();
+  rig::writeNvm(nvm, good_file);
+  std::int64_t num_obs = 0;
+  for (auto const& track: nvm.pid_to_cid_fid)
+    num_obs += track.size();
+
+  std::string good;
+  {
+    std::ifstream ifs(good_file.c_str(), std::ios::binary);
+    good.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+  ASSERT_EQ(good.size(), fs::file_size(good_file));
+
+  // Truncated at various places: in the header, the cameras, and the tracks
+  for (size_t size: {size_t(0), size_t(4), size_t(20), good.size() / 3, good.size() - 1}) {
+    writeBytes(bad_file, good.substr(0, size));
+    EXPECT_THROW(rig::readNvm(bad_file, false, nvm), vw::ArgumentErr) << "size " << size;
+  }
+
+  // Not a binary nvm file
+  writeBytes(bad_file, "NVM_V3\n3\n");
+  EXPECT_THROW(rig::readNvm(bad_file, false, nvm), vw::ArgumentErr);
+
+  // Overwrite a value in a copy of the good file and read it
+  auto corrupt = [&](size_t pos, std::int64_t val) {
+    std::string bad = good;
+    std::memcpy(&bad[pos], &val, sizeof(val));
+    writeBytes(bad_file, bad);
+    rig::readNvm(bad_file, false, nvm);
+  };
+
+  // The header is the magic string and the number of cameras, points, and
+  // observations. Counts which are too large or negative must not be trusted.
+  std::int64_t big = std::numeric_limits<std::int64_t>::max();
+  EXPECT_THROW(corrupt(8,  big), vw::ArgumentErr);
+  EXPECT_THROW(corrupt(16, big), vw::ArgumentErr);
+  EXPECT_THROW(corrupt(24, big), vw::ArgumentErr);
+  EXPECT_THROW(corrupt(24, -1),  vw::ArgumentErr);
+  EXPECT_THROW(corrupt(24, num_obs - 1), vw::ArgumentErr); // disagrees with the tracks
+
+  // The length of the first image name
+  EXPECT_THROW(corrupt(40, -5),  vw::ArgumentErr);
+  EXPECT_THROW(corrupt(40, big), vw::ArgumentErr);
+
+  // The feature ids are last, preceded by the camera ids. Overwrite the
+  // first two camera ids, making the first one out of range.
+  std::int32_t bad_cids[2] = {100, 0};
+  std::int64_t val;
+  std::memcpy(&val, bad_cids, sizeof(val));
+  EXPECT_THROW(corrupt(good.size() - 8 * num_obs, val), vw::ArgumentErr);
+
+  UnlinkName missing("nvm_binary_missing.nvmb");
+  EXPECT_THROW(rig::readNvm(missing, false, nvm), vw::ArgumentErr);
+}
@@ -31,12 +31,219 @@
 #include <OpenMVG/tracks.hpp>
 #pragma GCC diagnostic pop
 
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <limits>
 #include <set>
 #include <vector>
 #include <map>
 
 namespace rig {
   
+void FlatTracks::clear() {
+  m_offsets.assign(1, 0);
+  m_cid_fid.clear();
+}
+
+void FlatTracks::reserve(size_t num_tracks, size_t num_obs) {
+  m_offsets.reserve(num_tracks + 1);
+  m_cid_fid.reserve(num_obs);
+}
+
+void FlatTracks::push_back(std::map<int, int> const& track) {
+  push_back(track.begin(), track.end());
+}
+
+void toFlatTracks(TrackT const& pid_to_cid_fid, FlatTracks & tracks) {
+  size_t num_obs = 0;
+  for (size_t pid = 0; pid < pid_to_cid_fid.size(); pid++)
+    num_obs += pid_to_cid_fid[pid].size();
+
+  tracks.clear();
+  tracks.reserve(pid_to_cid_fid.size(), num_obs);
+  for (size_t pid = 0; pid < pid_to_cid_fid.size(); pid++)
+    tracks.push_back(pid_to_cid_fid[pid]);
+}
+
+void fromFlatTracks(FlatTracks const& tracks, TrackT & pid_to_cid_fid) {
+  pid_to_cid_fid.clear();
+  pid_to_cid_fid.resize(tracks.size());
+  for (size_t pid = 0; pid < tracks.size(); pid++) {
+    auto & cid_fid = pid_to_cid_fid[pid]; // alias
+    for (auto const& it: tracks[pid])
+      cid_fid.emplace_hint(cid_fid.end(), it.first, it.second);
+  }
+}
+
+// Build tracks from pairs. Each matched (cid, fid) is a node in a union-find
+// structure, and matches join the nodes. The nodes are numbered in order of
+// (cid, fid), without creating a std::set of them, and the finding of the
+// node indices and the grouping of the nodes into tracks are done in parallel.
+// The tracks differ from those of aspOpenMVG::tracks::TracksBuilder, with
+// Build(), Filter() and ExportToSTL(), when a set of matched features has an
+// image more than once. Here such a set is discarded whole. Filter() and
+// ExportToSTL() there read the union-find parent links instead of the set
+// roots, so parts of such a set could still be kept as tracks.
+void buildTracks(aspOpenMVG::matching::PairWiseMatches const& match_map,
+                 FlatTracks & tracks) { // output
+
+  tracks.clear(); // wipe the output
+
+  // Put the image pairs in a vector, for parallel access
+  std::vector<aspOpenMVG::matching::PairWiseMatches::const_iterator> pairs;
+  std::vector<std::int64_t> match_start(1, 0);
+  int num_images = 0;
+  for (auto it = match_map.begin(); it != match_map.end(); it++) {
+    pairs.push_back(it);
+    match_start.push_back(match_start.back() + it->second.size());
+    num_images = std::max(num_images,
+                          int(std::max(it->first.first, it->first.second)) + 1);
+  }
+
+  // The matched features in each image, sorted, without repetition
+  std::vector<std::vector<int>> cid_to_fids(num_images);
+  for (size_t p = 0; p < pairs.size(); p++) {
+    int cid1 = pairs[p]->first.first, cid2 = pairs[p]->first.second;
+    for (auto const& match: pairs[p]->second) {
+      cid_to_fids[cid1].push_back(match.i_);
+      cid_to_fids[cid2].push_back(match.j_);
+    }
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (int cid = 0; cid < num_images; cid++) {
+    auto & fids = cid_to_fids[cid]; // alias
+    std::sort(fids.begin(), fids.end());
+    fids.erase(std::unique(fids.begin(), fids.end()), fids.end());
+  }
+
+  // The index of the first node of each image
+  std::vector<std::int64_t> node_start(num_images + 1, 0);
+  for (int cid = 0; cid < num_images; cid++)
+    node_start[cid + 1] = node_start[cid] + cid_to_fids[cid].size();
+  std::int64_t num_nodes = node_start[num_images];
+  if (num_nodes >= std::int64_t(std::numeric_limits<unsigned int>::max()))
+    LOG(FATAL) << "Too many matched features to build tracks.\n";
+
+  // The pair of nodes for each match
+  std::vector<std::pair<unsigned int, unsigned int>> edges(match_start.back());
+#pragma omp parallel for schedule(dynamic)
+  for (int p = 0; p < int(pairs.size()); p++) {
+    int cid1 = pairs[p]->first.first, cid2 = pairs[p]->first.second;
+    auto const& fids1 = cid_to_fids[cid1];
+    auto const& fids2 = cid_to_fids[cid2];
+    auto const& matches = pairs[p]->second;
+    for (size_t m = 0; m < matches.size(); m++) {
+      int fid1 = matches[m].i_, fid2 = matches[m].j_;
+      edges[match_start[p] + m]
+        = std::make_pair(node_start[cid1] + (std::lower_bound(fids1.begin(), fids1.end(),
+                                                              fid1) - fids1.begin()),
+                         node_start[cid2] + (std::lower_bound(fids2.begin(), fids2.end(),
+                                                              fid2) - fids2.begin()));
+    }
+  }
+
+  // Join the matched nodes. This is near-linear in the number of matches.
+  aspOpenMVG::UnionFind uf_tree;
+  uf_tree.InitSets(num_nodes);
+  for (size_t e = 0; e < edges.size(); e++)
+    uf_tree.Union(edges[e].first, edges[e].second);
+  edges = std::vector<std::pair<unsigned int, unsigned int>>(); // wipe
+
+  // Group the nodes by the root of their set, with a counting sort. The
+  // nodes in each group stay in the order of (cid, fid).
+  std::vector<unsigned int> node_root(num_nodes);
+  std::vector<std::int64_t> root_start(num_nodes + 1, 0);
+  for (std::int64_t node = 0; node < num_nodes; node++) {
+    node_root[node] = uf_tree.Find(node);
+    root_start[node_root[node] + 1]++;
+  }
+  uf_tree = aspOpenMVG::UnionFind(); // wipe
+  for (std::int64_t root = 0; root < num_nodes; root++)
+    root_start[root + 1] += root_start[root];
+  std::vector<FlatTracks::CidFid> grouped(num_nodes);
+  {
+    std::vector<std::int64_t> pos(root_start.begin(), root_start.end() - 1);
+    for (int cid = 0; cid < num_images; cid++) {
+      for (size_t k = 0; k < cid_to_fids[cid].size(); k++) {
+        std::int64_t node = node_start[cid] + k;
+        grouped[pos[node_root[node]]++] = std::make_pair(cid, cid_to_fids[cid][k]);
+      }
+    }
+  }
+
+  // Keep the groups with at least two images, each seen only once
+  std::vector<char> keep(num_nodes, 0);
+#pragma omp parallel for
+  for (std::int64_t root = 0; root < num_nodes; root++) {
+    std::int64_t beg = root_start[root], end = root_start[root + 1];
+    if (end - beg < 2)
+      continue;
+    bool good = true;
+    for (std::int64_t k = beg + 1; k < end; k++) {
+      if (grouped[k].first == grouped[k - 1].first) {
+        good = false;
+        break;
+      }
+    }
+    keep[root] = good;
+  }
+
+  // Copy the kept groups to the output, in order of their root
+  std::vector<std::int64_t> & offsets = tracks.offsets();
+  std::vector<std::int64_t> out_start;
+  for (std::int64_t root = 0; root < num_nodes; root++) {
+    if (!keep[root])
+      continue;
+    out_start.push_back(root);
+    offsets.push_back(offsets.back() + root_start[root + 1] - root_start[root]);
+  }
+  std::vector<FlatTracks::CidFid> & cid_fid = tracks.cidFid();
+  cid_fid.resize(offsets.back());
+#pragma omp parallel for
+  for (std::int64_t pid = 0; pid < std::int64_t(out_start.size()); pid++) {
+    std::int64_t root = out_start[pid];
+    std::copy(grouped.begin() + root_start[root], grouped.begin() + root_start[root + 1],
+              cid_fid.begin() + offsets[pid]);
+  }
+
+  if (tracks.empty())
+    LOG(FATAL) << "No tracks left after filtering. Perhaps images "
+               << "are too dis-similar?\n";
+}
+
+// Remove duplicate tracks. There can still be two tracks with one contained
+// in the other or otherwise having shared elements. The tracks are sorted
+// in the same order as std::map<int, int> objects would be.
+void rmDuplicateTracks(FlatTracks & tracks) {
+
+  int num_tracks = tracks.size();
+  std::vector<int> order(num_tracks);
+  for (int pid = 0; pid < num_tracks; pid++)
+    order[pid] = pid;
+  std::sort(order.begin(), order.end(), [&tracks](int a, int b) {
+      FlatTracks::Track ta = tracks[a], tb = tracks[b];
+      return std::lexicographical_compare(ta.begin(), ta.end(), tb.begin(), tb.end());
+    });
+
+  FlatTracks out;
+  out.reserve(num_tracks, tracks.numObservations());
+  for (int it = 0; it < num_tracks; it++) {
+    FlatTracks::Track t = tracks[order[it]];
+    if (it > 0) {
+      FlatTracks::Track prev = tracks[order[it - 1]];
+      if (prev.size() == t.size() && std::equal(t.begin(), t.end(), prev.begin()))
+        continue;
+    }
+    out.push_back(t.begin(), t.end());
+  }
+  std::swap(tracks, out);
+
+  int diff = num_tracks - int(tracks.size());
+  std::cout << "Removed " << diff << " duplicate tracks ("
+            << 100.0 * double(diff)/double(num_tracks) << "%)\n";
+}
+
 // Given tracks in a map C that has images from one map A followed by
 // images from second map named B, split the tracks that have at least
 // two features in each map into tracks for the two maps. For the
@@ -45,44 +252,42 @@ namespace rig {
 // one-to-one correspondence.
 void splitTracksOneToOne(// Inputs
                          int num_acid, // number of images in map A
-                         TrackT                              const & C_pid_to_cid_fid, 
-                         KeypointVecT                        const & C_keypoint_vec, 
+                         FlatTracks                    const & C_tracks,
+                         KeypointVecT                  const & C_keypoint_vec, 
                          std::vector<rig::cameraImage> const & C_cams,
                          // Outputs
-                         TrackT                                    & A_pid_to_cid_fid, 
-                         TrackT                                    & B_pid_to_cid_fid, 
-                         KeypointVecT                              & A_keypoint_vec, 
-                         KeypointVecT                              & B_keypoint_vec, 
+                         FlatTracks                          & A_tracks,
+                         FlatTracks                          & B_tracks,
+                         KeypointVecT                        & A_keypoint_vec, 
+                         KeypointVecT                        & B_keypoint_vec, 
                          std::vector<rig::cameraImage>       & A_cams, 
                          std::vector<rig::cameraImage>       & B_cams) {
   
   // Wipe the outputs
-  A_pid_to_cid_fid.clear();
-  B_pid_to_cid_fid.clear();
+  A_tracks.clear();
+  B_tracks.clear();
   A_keypoint_vec.clear();
   B_keypoint_vec.clear();
   A_cams.clear();
   B_cams.clear();
   
-  for (size_t pid = 0; pid < C_pid_to_cid_fid.size(); pid++) {
+  std::vector<FlatTracks::CidFid> B_cid_fid;
+  for (size_t pid = 0; pid < C_tracks.size(); pid++) {
 
-    auto & cid_fid = C_pid_to_cid_fid[pid];
-    std::map<int, int> A_cid_fid, B_cid_fid;
-    
-    for (auto map_it = cid_fid.begin(); map_it != cid_fid.end(); map_it++) {
-      int cid = map_it->first;
-      int fid = map_it->second;
-      if (cid < num_acid) 
-        A_cid_fid[cid] = fid; // belongs to A
-      else
-        B_cid_fid[cid - num_acid] = fid; // belongs to B
-    }
+    // The track is sorted by cid, so the part in A comes first
+    FlatTracks::Track cid_fid = C_tracks[pid];
+    auto B_begin = std::find_if(cid_fid.begin(), cid_fid.end(),
+                                [num_acid](FlatTracks::CidFid const& p) {
+                                  return p.first >= num_acid; });
     
-    if (A_cid_fid.size() > 1 && B_cid_fid.size() > 1) {
+    if (B_begin - cid_fid.begin() > 1 && cid_fid.end() - B_begin > 1) {
       // This is a shared track, that we break in two. Each obtained track
       // must have at least two images.
-      A_pid_to_cid_fid.push_back(A_cid_fid);
-      B_pid_to_cid_fid.push_back(B_cid_fid);
+      A_tracks.push_back(cid_fid.begin(), B_begin);
+      B_cid_fid.clear();
+      for (auto it = B_begin; it != cid_fid.end(); it++)
+        B_cid_fid.push_back(std::make_pair(it->first - num_acid, it->second));
+      B_tracks.push_back(B_cid_fid.begin(), B_cid_fid.end());
     }
   }
   
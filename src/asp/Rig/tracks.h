@@ -19,29 +19,110 @@
 #ifndef RIG_CALIBRATOR_TRACKS_H_
 #define RIG_CALIBRATOR_TRACKS_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <set>
 #include <vector>
 #include <map>
 
 // TODO(oalexan1): Move here all tracks logic from interest_point.cc and tensor.cc.
 
+namespace aspOpenMVG {
+  namespace matching {
+    struct PairWiseMatches;
+  }
+}
+
 namespace rig {
 
 typedef std::vector<std::vector<std::pair<float, float>>> KeypointVecT;
 typedef std::vector<std::map<int, int>> TrackT;
 class cameraImage;
 
+// Tracks stored contiguously. The (cid, fid) pairs of track pid are at
+// indices offsets[pid] to offsets[pid + 1] - 1, sorted by cid, with no
+// repeated cid. Passes over all tracks do not chase pointers. Track pid is
+// accessed as tracks[pid], which can be iterated over like a
+// std::map<int, int>, but not modified. The nvm data and the triangulation
+// still use TrackT, so tracks are converted to that when passed to them,
+// and both copies exist until the flat one is wiped.
+class FlatTracks {
+public:
+  typedef std::pair<int, int> CidFid;
+  typedef CidFid const* const_iterator;
+
+  // A read-only view of one track
+  class Track {
+  public:
+    Track(const_iterator b, const_iterator e): m_begin(b), m_end(e) {}
+    const_iterator begin() const { return m_begin; }
+    const_iterator end()   const { return m_end; }
+    size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+  private:
+    const_iterator m_begin, m_end;
+  };
+
+  FlatTracks(): m_offsets(1, 0) {}
+
+  // The number of tracks
+  size_t size() const { return m_offsets.size() - 1; }
+  bool empty() const { return size() == 0; }
+  size_t numObservations() const { return m_cid_fid.size(); }
+
+  Track operator[](size_t pid) const {
+    return Track(m_cid_fid.data() + m_offsets[pid], m_cid_fid.data() + m_offsets[pid + 1]);
+  }
+
+  void clear();
+  void reserve(size_t num_tracks, size_t num_obs);
+
+  // Append a track
+  void push_back(std::map<int, int> const& track);
+
+  // Append a track given by a range of (cid, fid) pairs, sorted by cid
+  template<class Iter>
+  void push_back(Iter begin, Iter end) {
+    m_cid_fid.insert(m_cid_fid.end(), begin, end);
+    m_offsets.push_back(m_cid_fid.size());
+  }
+
+  std::vector<std::int64_t> const& offsets() const { return m_offsets; }
+  std::vector<CidFid>       const& cidFid()  const { return m_cid_fid; }
+
+  // For filling the arrays directly. The invariants above must hold after.
+  std::vector<std::int64_t> & offsets() { return m_offsets; }
+  std::vector<CidFid>       & cidFid()  { return m_cid_fid; }
+
+private:
+  std::vector<std::int64_t> m_offsets;
+  std::vector<CidFid> m_cid_fid;
+};
+
+// Conversions between the two ways of storing tracks
+void toFlatTracks(TrackT const& pid_to_cid_fid, FlatTracks & tracks);
+void fromFlatTracks(FlatTracks const& tracks, TrackT & pid_to_cid_fid);
+
+// Build tracks from pairwise matches. Tracks having the same image more than
+// once are removed.
+void buildTracks(aspOpenMVG::matching::PairWiseMatches const& match_map,
+                 FlatTracks & tracks);
+
+// Remove duplicate tracks. There can still be two tracks with one contained
+// in the other or otherwise having shared elements.
+void rmDuplicateTracks(FlatTracks & tracks);
+
 // See tracks.cc for the doc
 void splitTracksOneToOne(// Inputs
                          int num_acid, // number of images in map A
-                         TrackT                              const & C_pid_to_cid_fid, 
-                         KeypointVecT                        const & C_keypoint_vec, 
+                         FlatTracks                    const & C_tracks,
+                         KeypointVecT                  const & C_keypoint_vec, 
                          std::vector<rig::cameraImage> const & C_cams,
                          // Outputs
-                         TrackT                                    & A_pid_to_cid_fid, 
-                         TrackT                                    & B_pid_to_cid_fid, 
-                         KeypointVecT                              & A_keypoint_vec, 
-                         KeypointVecT                              & B_keypoint_vec, 
+                         FlatTracks                          & A_tracks,
+                         FlatTracks                          & B_tracks,
+                         KeypointVecT                        & A_keypoint_vec, 
+                         KeypointVecT                        & B_keypoint_vec, 
                          std::vector<rig::cameraImage>       & A_cams, 
                          std::vector<rig::cameraImage>       & B_cams);
   
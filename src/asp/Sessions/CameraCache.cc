@@ -0,0 +1,201 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file CameraCache.cc
+///
+
+#include <asp/Sessions/CameraCache.h>
+#include <asp/Camera/CsmModel.h>
+#include <asp/Core/StereoSettings.h>
+
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <typeinfo>
+
+namespace fs = boost::filesystem;
+
+namespace asp {
+
+// The layout of a cache file. All integers are 64-bit, in native byte order,
+// as the cache is only ever read on the machine that wrote it.
+//   magic string
+//   modification time of the camera file
+//   size of the camera file
+//   session name length, session name
+//   camera file length, camera file
+//   load options length, load options
+//   model state length, model state
+const char CAMERA_CACHE_MAGIC[] = "ASPCAMCACHE2";
+
+std::string cameraCacheFile(std::string const& out_prefix,
+                            std::string const& camera_file) {
+  // Distinguish the cameras by a hash of their absolute path
+  std::string path = fs::absolute(camera_file).string();
+  std::ostringstream os;
+  os << out_prefix << "-camera-cache-" << std::hex << std::hash<std::string>()(path)
+     << ".bin";
+  return os.str();
+}
+
+namespace {
+
+void writeInt(std::ofstream & ofs, std::int64_t val) {
+  ofs.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void writeString(std::ofstream & ofs, std::string const& str) {
+  writeInt(ofs, str.size());
+  ofs.write(str.data(), str.size());
+}
+
+// Read from a memory buffer, keeping track of the position. Return false
+// if the buffer is too short.
+bool readInt(const char* data, size_t len, size_t & pos, std::int64_t & val) {
+  if (pos + sizeof(val) > len)
+    return false;
+  std::memcpy(&val, data + pos, sizeof(val));
+  pos += sizeof(val);
+  return true;
+}
+
+bool readString(const char* data, size_t len, size_t & pos, std::string & str) {
+  std::int64_t str_len = 0;
+  if (!readInt(data, len, pos, str_len) || str_len < 0 || pos + str_len > len)
+    return false;
+  str.assign(data + pos, str_len);
+  pos += str_len;
+  return true;
+}
+
+// The options which change how a camera is loaded. A cache made with
+// other values of these is stale.
+std::string cameraLoadOptions() {
+  std::ostringstream os;
+  os << "aster_use_csm=" << stereo_settings().aster_use_csm
+     << " enable_velocity_aberration_correction="
+     << stereo_settings().enable_velocity_aberration_correction
+     << " enable_atmospheric_refraction_correction="
+     << stereo_settings().enable_atmospheric_refraction_correction;
+  return os.str();
+}
+
+} // end anonymous namespace
+
+bool writeCameraCache(std::string const& out_prefix,
+                      std::string const& session_name,
+                      std::string const& camera_file,
+                      vw::CamPtr cam) {
+
+  // Cameras of classes derived from CsmModel, such as for DG and Pleiades,
+  // have more than the CSM state, and callers may need their type.
+  // So only plain CSM cameras are cached.
+  if (cam.get() == NULL || typeid(*cam) != typeid(asp::CsmModel) ||
+      !fs::exists(camera_file))
+    return false;
+  asp::CsmModel const* csm_cam = dynamic_cast<asp::CsmModel const*>(cam.get());
+
+  std::string cache_file = cameraCacheFile(out_prefix, camera_file);
+  std::string tmp_file = cache_file + ".tmp";
+  try {
+    bool good = false;
+    {
+      std::ofstream ofs(tmp_file.c_str(), std::ios::binary);
+      if (ofs.good()) {
+        ofs.write(CAMERA_CACHE_MAGIC, sizeof(CAMERA_CACHE_MAGIC));
+        writeInt(ofs, fs::last_write_time(camera_file));
+        writeInt(ofs, fs::file_size(camera_file));
+        writeString(ofs, session_name);
+        writeString(ofs, camera_file);
+        writeString(ofs, cameraLoadOptions());
+        writeString(ofs, csm_cam->model_state());
+        ofs.close();
+        good = ofs.good();
+      }
+    }
+    if (!good) {
+      boost::system::error_code ec;
+      fs::remove(tmp_file, ec);
+      return false;
+    }
+    fs::rename(tmp_file, cache_file);
+  } catch (...) {
+    boost::system::error_code ec;
+    fs::remove(tmp_file, ec);
+    throw;
+  }
+
+  vw::vw_out() << "Wrote camera cache: " << cache_file << "\n";
+  return true;
+}
+
+vw::CamPtr readCameraCache(std::string const& out_prefix,
+                           std::string const& session_name,
+                           std::string const& camera_file) {
+
+  std::string cache_file = cameraCacheFile(out_prefix, camera_file);
+  if (!fs::exists(cache_file) || !fs::exists(camera_file))
+    return vw::CamPtr();
+
+  std::string model_state;
+  try {
+    boost::iostreams::mapped_file_source mapped(cache_file);
+    const char* data = mapped.data();
+    size_t len = mapped.size(), pos = 0;
+
+    if (len < sizeof(CAMERA_CACHE_MAGIC) ||
+        std::memcmp(data, CAMERA_CACHE_MAGIC, sizeof(CAMERA_CACHE_MAGIC)) != 0)
+      return vw::CamPtr();
+    pos += sizeof(CAMERA_CACHE_MAGIC);
+
+    std::int64_t mtime = 0, size = 0;
+    std::string cached_session, cached_camera, cached_options;
+    if (!readInt(data, len, pos, mtime) || !readInt(data, len, pos, size) ||
+        !readString(data, len, pos, cached_session) ||
+        !readString(data, len, pos, cached_camera) ||
+        !readString(data, len, pos, cached_options) ||
+        !readString(data, len, pos, model_state))
+      return vw::CamPtr();
+
+    // Reject a stale cache
+    if (mtime != std::int64_t(fs::last_write_time(camera_file)) ||
+        size != std::int64_t(fs::file_size(camera_file)) ||
+        cached_session != session_name || cached_camera != camera_file ||
+        cached_options != cameraLoadOptions())
+      return vw::CamPtr();
+
+  } catch (std::exception const& e) {
+    vw::vw_out(vw::WarningMessage) << "Could not read camera cache " << cache_file
+                                   << ": " << e.what() << "\n";
+    return vw::CamPtr();
+  }
+
+  boost::shared_ptr<asp::CsmModel> cam(new asp::CsmModel());
+  bool recreate_model = true;
+  cam->setModelFromStateString(model_state, recreate_model);
+  return cam;
+}
+
+} // end namespace asp
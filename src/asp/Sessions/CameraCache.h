@@ -0,0 +1,58 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+/// \file CameraCache.h
+/// Cache camera models next to the stereo outputs, so that each of the many
+/// processes launched by parallel_stereo can load them quickly, rather than
+/// parsing the original camera files. Only plain CSM cameras are cached, as
+/// their full state is a CSM model state string. Cameras of derived classes,
+/// such as for DG and Pleiades, are loaded as before, keeping their type.
+
+#ifndef __STEREO_SESSION_CAMERA_CACHE_H__
+#define __STEREO_SESSION_CAMERA_CACHE_H__
+
+#include <vw/Camera/CameraModel.h>
+
+#include <string>
+
+namespace asp {
+
+/// The file having the cached camera for the given camera file
+std::string cameraCacheFile(std::string const& out_prefix,
+                            std::string const& camera_file);
+
+/// Save a camera to the cache. The camera must not have any bundle adjustment
+/// or pixel offset applied. Return false if this camera type cannot be cached
+/// or the file could not be written. The file is written to a temporary
+/// location and then renamed, so processes reading the cache at the same time
+/// never see a partial file.
+bool writeCameraCache(std::string const& out_prefix,
+                      std::string const& session_name,
+                      std::string const& camera_file,
+                      vw::CamPtr cam);
+
+/// Load a camera from the cache, by memory-mapping the cache file. Return an
+/// empty pointer if there is no cache, or if it was made with a different
+/// session, with different camera loading options, or from a camera file with
+/// a different size or modification time.
+vw::CamPtr readCameraCache(std::string const& out_prefix,
+                           std::string const& session_name,
+                           std::string const& camera_file);
+
+} // end namespace asp
+
+#endif // __STEREO_SESSION_CAMERA_CACHE_H__
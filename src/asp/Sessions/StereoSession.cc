@@ -24,6 +24,7 @@
 #include <asp/Camera/RPCModel.h>
 #include <asp/Core/AspStringUtils.h>
 #include <asp/Sessions/CameraUtils.h>
+#include <asp/Sessions/CameraCache.h>
 
 #include <vw/Core/Exception.h>
 #include <vw/Core/Log.h>
@@ -386,11 +387,33 @@ StereoSession::camera_model(std::string const& image_file, std::string const& ca
                                                  m_right_image_file,
                                                  image_file);
   
+  // No camera file provided, use the image file.
+  std::string cam_file = camera_file;
+  if (cam_file == "")
+    cam_file = image_file;
+
+  vw::Stopwatch sw;
+  sw.start();
+
+  // Try the camera cache saved in preprocessing first. Only plain CSM
+  // cameras are cached, so the camera type is the same either way.
   vw::CamPtr cam;
-  if (camera_file == "") // No camera file provided, use the image file.
-    cam = load_camera_model(image_file, image_file, ba_prefix, pixel_offset);
-  else // Camera file provided
-    cam  = load_camera_model(image_file, camera_file, ba_prefix, pixel_offset);
+  bool use_cache = (!stereo_settings().no_camera_cache && !m_out_prefix.empty());
+  if (use_cache) {
+    vw::CamPtr raw_cam = asp::readCameraCache(m_out_prefix, name(), cam_file);
+    if (raw_cam)
+      cam = load_adjusted_model(raw_cam, image_file, cam_file, ba_prefix, pixel_offset);
+  }
+
+  bool from_cache = (cam.get() != NULL);
+  if (!from_cache)
+    cam = load_camera_model(image_file, cam_file, ba_prefix, pixel_offset);
+
+  sw.stop();
+  if (!quiet)
+    vw_out(vw::DebugMessage, "asp") << "Camera loading took " << sw.elapsed_seconds()
+                                    << " seconds" << (from_cache ? " (cached)" : "")
+                                    << ".\n";
 
   {
     // Save the camera model in the map to not load it again. Ensure thread safety. 
@@ -401,6 +424,35 @@ StereoSession::camera_model(std::string const& image_file, std::string const& ca
   return cam;
 }
 
+// Save the cameras for faster loading in later stereo steps. Only the
+// unadjusted cameras are saved, as adjustments are applied on loading.
+void StereoSession::save_camera_cache() {
+
+  if (stereo_settings().no_camera_cache || stereo_settings().correlator_mode)
+    return;
+
+  std::vector<std::string> image_files, camera_files;
+  image_files.push_back(m_left_image_file);
+  image_files.push_back(m_right_image_file);
+  camera_files.push_back(m_left_camera_file);
+  camera_files.push_back(m_right_camera_file);
+
+  for (size_t it = 0; it < image_files.size(); it++) {
+    std::string cam_file = camera_files[it];
+    if (cam_file == "")
+      cam_file = image_files[it];
+    try {
+      vw::CamPtr cam = camera_model(image_files[it], camera_files[it]);
+      asp::writeCameraCache(m_out_prefix, name(), cam_file,
+                            vw::camera::unadjusted_model(cam));
+    } catch (std::exception const& e) {
+      // The cache is only an optimization, so do not fail here
+      vw_out(vw::WarningMessage) << "Could not save the camera cache for "
+                                 << cam_file << ": " << e.what() << "\n";
+    }
+  }
+}
+
 // Default preprocessing hook. Some sessions may override it.
 void StereoSession::preprocessing_hook(bool adjust_left_image_size,
                                        std::string const& left_input_file,
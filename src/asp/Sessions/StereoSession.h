@@ -88,6 +88,10 @@ namespace asp {
                  std::string const& camera_file = "",
                  bool quiet = false);
 
+    /// Save the left and right cameras to disk, so that later stereo steps
+    /// can load them faster. See CameraCache.h.
+    void save_camera_cache();
+
     /// Method to help determine what session we actually have
     virtual std::string name() const = 0;
 
@@ -17,6 +17,7 @@
 
 
 #include <asp/Sessions/StereoSessionGdal.h>
+#include <asp/Sessions/CameraCache.h>
 #include <asp/Camera/XMLBase.h>
 #include <asp/Camera/RPC_XML.h>
 #include <asp/Camera/RPCModel.h>
@@ -26,6 +27,9 @@
 #include <vw/Stereo/StereoModel.h>
 
 #include <vw/Cartography/GeoTransform.h>
+#include <vw/Camera/CameraUtilities.h>
+
+#include <boost/filesystem.hpp>
 
 using namespace vw;
 using namespace asp;
@@ -110,3 +114,16 @@ TEST(StereoSessionDG, ProjectRPC) {
   EXPECT_VECTOR_NEAR( rpc_model->point_to_pixel( xyz ),
                       dg_model->point_to_pixel( xyz ), 25 );
 }
+
+// DG cameras are not cached, as they would come back as plain CSM cameras
+TEST(StereoSessionDG, NoCameraCache) {
+  StereoSessionDG session;
+  boost::shared_ptr<camera::CameraModel> cam = session.camera_model("", "dg_example1.xml");
+  ASSERT_TRUE(cam.get() != 0);
+
+  UnlinkName prefix("dg_camera_cache");
+  EXPECT_FALSE(asp::writeCameraCache(prefix, session.name(), "dg_example1.xml",
+                                     vw::camera::unadjusted_model(cam)));
+  EXPECT_FALSE(boost::filesystem::exists(asp::cameraCacheFile(prefix, "dg_example1.xml")));
+  EXPECT_TRUE(asp::readCameraCache(prefix, session.name(), "dg_example1.xml").get() == 0);
+}
@@ -30,8 +30,10 @@
 #include <asp/Camera/BundleAdjustCostFuns.h> // Ceres included in this file
 #include <asp/Camera/LinescanUtils.h>
 #include <asp/Camera/CsmModel.h>
+#include <asp/Camera/SolverCheckpoint.h>
 #include <asp/Core/PointUtils.h>
 #include <asp/Rig/nvm.h>
+#include <asp/Rig/nvm_binary.h>
 #include <asp/Core/Macros.h>
 #include <asp/Core/StereoSettings.h>
 #include <asp/Core/IpMatchingAlgs.h> // Lightweight header for ip matching
@@ -90,6 +92,49 @@ private:
   asp::BAParams const& m_param_storage;
 };
 
+// Save the points, cameras, intrinsics, and outliers, to be able to resume
+// with --resume-from-checkpoint. The pass is the one to resume at.
+void saveBaCheckpoint(asp::BaOptions const& opt, asp::BAParams & param_storage,
+                      int pass) {
+  asp::SolverCheckpoint cp;
+  cp.pass = pass;
+  cp.param_blocks.push_back(param_storage.get_point_vector());
+  cp.param_blocks.push_back(param_storage.get_camera_vector());
+  cp.param_blocks.push_back(param_storage.get_intrinsics_vector());
+  for (int ipt = 0; ipt < param_storage.num_points(); ipt++) {
+    if (param_storage.get_point_outlier(ipt))
+      cp.outliers.insert(ipt);
+  }
+  asp::writeCheckpoint(asp::checkpointFile(opt.out_prefix), cp);
+}
+
+// Restore the state saved by saveBaCheckpoint(). Return the pass to resume at.
+int loadBaCheckpoint(asp::BaOptions const& opt, asp::BAParams & param_storage) {
+
+  std::string file = asp::checkpointFile(opt.out_prefix);
+  vw_out() << "Resuming from checkpoint: " << file << "\n";
+  asp::SolverCheckpoint cp;
+  asp::readCheckpoint(file, cp);
+
+  // The problem must be the same as when the checkpoint was saved
+  if (cp.param_blocks.size() != 3 ||
+      cp.param_blocks[0].size() != param_storage.get_point_vector().size() ||
+      cp.param_blocks[1].size() != param_storage.get_camera_vector().size() ||
+      cp.param_blocks[2].size() != param_storage.get_intrinsics_vector().size())
+    vw_throw(ArgumentErr() << "The checkpoint " << file << " does not agree with "
+             << "the current problem. If the images or the matches changed, "
+             << "use instead --input-adjustments-prefix to start from the "
+             << "previous solution.\n");
+
+  param_storage.get_point_vector()      = cp.param_blocks[0];
+  param_storage.get_camera_vector()     = cp.param_blocks[1];
+  param_storage.get_intrinsics_vector() = cp.param_blocks[2];
+  for (int ipt = 0; ipt < param_storage.num_points(); ipt++)
+    param_storage.set_point_outlier(ipt, cp.outliers.find(ipt) != cp.outliers.end());
+
+  return cp.pass;
+}
+
 // ----------------------------------------------------------------
 // Start outlier functions
 
@@ -303,6 +348,7 @@ int add_to_outliers(vw::ba::ControlNetwork & cnet,
 int do_ba_ceres_one_pass(asp::BaOptions      & opt,
                          asp::CRNJ      const& crn,
                          bool                  first_pass,
+                         int                   checkpoint_pass, // -1 for none
                          bool                  remove_outliers, 
                          asp::BAParams       & param_storage, 
                          asp::BAParams const & orig_parameters,
@@ -523,6 +569,15 @@ int do_ba_ceres_one_pass(asp::BaOptions      & opt,
     options.update_state_every_iteration = true;
   }
 
+  // Save the state periodically, to be able to resume if interrupted
+  asp::CheckpointCallback checkpoint_callback(opt.checkpoint_interval, [&]() {
+    saveBaCheckpoint(opt, param_storage, checkpoint_pass);
+  });
+  if (opt.checkpoint_interval > 0 && checkpoint_pass >= 0) {
+    options.callbacks.push_back(&checkpoint_callback);
+    options.update_state_every_iteration = true;
+  }
+
   // Set solver options according to the recommendations in the Ceres solving FAQs
   options.linear_solver_type = ceres::SPARSE_SCHUR;
   if (num_cameras < 100)
@@ -613,7 +668,8 @@ void runRandomPasses(asp::BaOptions & opt, asp::BAParams & param_storage,
     bool first_pass = true; // this needs more thinking
     bool convergence_reached = true;
     double curr_cost = 0.0; // will be set
-    do_ba_ceres_one_pass(opt, crn, first_pass, remove_outliers,
+    int checkpoint_pass = -1; // random passes are not checkpointed
+    do_ba_ceres_one_pass(opt, crn, first_pass, checkpoint_pass, remove_outliers,
                          param_storage, orig_parameters,
                          convergence_reached, curr_cost);
     
@@ -852,20 +908,29 @@ void do_ba_ceres(asp::BaOptions & opt, std::vector<Vector3> const& estimated_cam
   if (opt.num_passes <= 0)
     vw_throw(ArgumentErr() << "Error: Expecting at least one bundle adjust pass.\n");
   
+  // Resume from the checkpoint saved by an interrupted run. This must
+  // happen after orig_parameters is set.
+  int start_pass = 0;
+  if (opt.resume_from_checkpoint && !opt.apply_initial_transform_only)
+    start_pass = loadBaCheckpoint(opt, param_storage);
+
   bool remove_outliers = (opt.num_passes > 1);
   double final_cost = 0.0;
-  for (int pass = 0; pass < opt.num_passes; pass++) {
+  for (int pass = start_pass; pass < opt.num_passes; pass++) {
 
     if (opt.apply_initial_transform_only)
       continue;
       
     vw_out() << "--> Bundle adjust pass: " << pass << std::endl;
 
-    bool first_pass = (pass == 0);
+    // When resuming, the initial condition files exist from the earlier run
+    bool first_pass = (pass == 0 && !opt.resume_from_checkpoint);
     bool convergence_reached = true; // will change
-    do_ba_ceres_one_pass(opt, crn, first_pass, remove_outliers,
+    do_ba_ceres_one_pass(opt, crn, first_pass, pass, remove_outliers,
                          param_storage, orig_parameters,
                          convergence_reached, final_cost);
+    if (opt.checkpoint_interval > 0)
+      saveBaCheckpoint(opt, param_storage, pass + 1);
     int num_points_remaining = num_points - param_storage.get_num_outliers();
     if (num_points_remaining < opt.min_matches && num_gcp == 0) {
       // Do not throw if there exist gcp, as maybe that's all there is, and there
@@ -948,7 +1013,7 @@ void do_ba_ceres(asp::BaOptions & opt, std::vector<Vector3> const& estimated_cam
     asp::saveUpdatedIsisCnet(opt.out_prefix, cnet, param_storage, isisCnetData);
   else if (opt.output_cnet_type == "isis-cnet")
     asp::saveIsisCnet(opt.out_prefix, opt.datum, cnet, param_storage);
-  else if (opt.output_cnet_type == "nvm") {
+  else if (opt.output_cnet_type == "nvm" || opt.output_cnet_type == "nvmb") {
     asp::saveNvm(opt, opt.no_poses_from_nvm, cnet, param_storage, 
                   world_to_cam, optical_offsets);
   }
@@ -1266,8 +1331,9 @@ void handle_arguments(int argc, char *argv[], asp::BaOptions& opt) {
     ("output-cnet-type", po::value(&opt.output_cnet_type)->default_value(""),
       "The format in which to save the control network of interest point matches. "
       "Options: 'match-files' (match files in ASP's format), 'isis-cnet' (ISIS "
-      "jigsaw format), 'nvm' (plain text VisualSfM NVM format). If not set, the same "
-      "format as for the input is used.")
+      "jigsaw format), 'nvm' (plain text VisualSfM NVM format), 'nvmb' (binary "
+      "NVM format, for large control networks). If not set, the same format as for "
+      "the input is used.")
     ("no-poses-from-nvm", 
       po::bool_switch(&opt.no_poses_from_nvm)->default_value(false)->implicit_value(true),
      "Do not read the camera poses from the NVM file or write them to such a file. "
@@ -1385,6 +1451,13 @@ void handle_arguments(int argc, char *argv[], asp::BaOptions& opt) {
      "Only use image matches which can be loaded from disk. This implies --force-reuse-match-files.")
     ("save-intermediate-cameras", po::bool_switch(&opt.save_intermediate_cameras)->default_value(false)->implicit_value(true),
      "Save the values for the cameras at each iteration.")
+    ("checkpoint-interval", po::value(&opt.checkpoint_interval)->default_value(0),
+     "Save the state of the optimization every this many iterations, and at the end "
+     "of each pass, to <output prefix>-checkpoint.bin. Use with "
+     "--resume-from-checkpoint to continue an interrupted run.")
+    ("resume-from-checkpoint", po::bool_switch(&opt.resume_from_checkpoint)->default_value(false)->implicit_value(true),
+     "Continue an interrupted run from the state saved with --checkpoint-interval. "
+     "All other options must be the same as for that run.")
     ("apply-initial-transform-only", po::bool_switch(&opt.apply_initial_transform_only)->default_value(false)->implicit_value(true),
      "Apply to the cameras the transform given by --initial-transform. "
      "No iterations, GCP loading, image matching, or report generation "
@@ -1528,6 +1601,8 @@ void handle_arguments(int argc, char *argv[], asp::BaOptions& opt) {
   if (opt.output_cnet_type == "") {
     if (opt.isis_cnet != "")
       opt.output_cnet_type = "isis-cnet";
+    else if (opt.nvm != "" && rig::isBinaryNvm(opt.nvm))
+      opt.output_cnet_type = "nvmb";
     else if (opt.nvm != "")
       opt.output_cnet_type = "nvm";
     else
@@ -1535,7 +1610,7 @@ void handle_arguments(int argc, char *argv[], asp::BaOptions& opt) {
   } 
   // Sanity check in case the user set this option manually.
   if (opt.output_cnet_type != "match-files" && opt.output_cnet_type != "isis-cnet" && 
-      opt.output_cnet_type != "nvm")
+      opt.output_cnet_type != "nvm" && opt.output_cnet_type != "nvmb")
     vw_throw(ArgumentErr() << "Unknown value for --output-cnet-type: "
                            << opt.output_cnet_type << ".\n");
   
@@ -30,6 +30,8 @@
 #include <vw/FileIO/DiskImageView.h>
 
 #include <vw/Core/StringUtils.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Camera/PinholeModel.h>
 #include <vw/Cartography/Datum.h>
 #include <vw/Cartography/GeoReference.h>
@@ -60,12 +62,12 @@ struct Options : public vw::GdalWriteOptions {
   Vector2 height_range;
   float input_nodata_value, output_nodata_value;
   double semi_major, semi_minor;
-  double gsd;
-  int num_samples;
+  double gsd, pixel_accuracy;
+  int num_samples, num_sample_threads;
   Datum datum;
   Options(): penalty_weight(-1.0), no_crop(false),
              skip_computing_rpc(false), save_tif(false), has_output_nodata(false),
-             gsd(-1.0), num_samples(-1) {}
+             gsd(-1.0), pixel_accuracy(-1.0), num_samples(-1), num_sample_threads(1) {}
 };
 
 void handle_arguments(int argc, char *argv[], Options& opt) {
@@ -86,7 +88,13 @@ void handle_arguments(int argc, char *argv[], Options& opt) {
      "Compute the longitude-latitude-height box in which to fit the RPC camera as the "
       "bounding box of the portion of this DEM that is seen by the input camera.")
     ("num-samples", po::value(&opt.num_samples)->default_value(40),
-     "How many samples to use in each direction in the longitude-latitude-height range.")
+     "How many samples to use in each direction in the longitude-latitude-height range. "
+     "With --pixel-accuracy, this is the finest sampling to refine to.")
+    ("pixel-accuracy", po::value(&opt.pixel_accuracy)->default_value(0.01),
+     "Start with a coarse sampling of the longitude-latitude-height range and refine it "
+     "where the RPC model fits the camera worst, until the largest error at the check "
+     "points, in pixels, is below this value. Set to 0 to use the full grid given by "
+     "--num-samples instead.")
     ("penalty-weight", po::value(&opt.penalty_weight)->default_value(0.03), // check here!
      "A higher penalty weight will result in smaller higher-order RPC coefficients.")
     ("save-tif-image", po::bool_switch(&opt.save_tif)->default_value(false),
@@ -201,15 +209,61 @@ void handle_arguments(int argc, char *argv[], Options& opt) {
   // There must be at least 2 samples in each dimension
   if (opt.num_samples < 2)
     vw_throw(ArgumentErr() << "Must have at least 2 samples in each dimension.\n");
+
+  if (opt.pixel_accuracy < 0)
+    vw_throw(ArgumentErr() << "The pixel accuracy must be non-negative.\n");
+}
+
+// Project ground points into the camera. This is done in parallel, unless the
+// camera is not thread-safe, as for ISIS. A projection is valid if it succeeds
+// and is in image_box. The llh values are made to agree with the datum by
+// going to xyz and back. This is a bugfix for the 360 deg offset problem.
+void project_llh(vw::CamPtr cam, vw::cartography::Datum const& datum,
+                 BBox2 const& image_box, int num_threads,
+                 // Outputs
+                 std::vector<Vector3> & llh,
+                 std::vector<Vector2> & pixels,
+                 std::vector<char> & valid) {
+
+  pixels.resize(llh.size());
+  valid.assign(llh.size(), 0);
+
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+  for (int i = 0; i < int(llh.size()); i++) {
+    Vector3 xyz = datum.geodetic_to_cartesian(llh[i]);
+    llh[i] = datum.cartesian_to_geodetic(xyz);
+    try {
+      // The point_to_pixel function can be capricious
+      pixels[i] = cam->point_to_pixel(xyz);
+    } catch(...) {
+      continue;
+    }
+    valid[i] = image_box.contains(pixels[i]);
+  }
+}
+
+// Append the valid llh and pixel pairs to the outputs
+void append_valid(std::vector<Vector3> const& llh,
+                  std::vector<Vector2> const& pixels,
+                  std::vector<char> const& valid,
+                  std::vector<Vector3> & all_llh,
+                  std::vector<Vector2> & all_pixels) {
+  for (size_t i = 0; i < llh.size(); i++) {
+    if (!valid[i])
+      continue;
+    all_llh.push_back(llh[i]);
+    all_pixels.push_back(pixels[i]);
+  }
 }
 
 // Add pixel and llh samples along the perimeter and diagonals of image_box.
 // Constrain by the ll box.
-void add_perimeter_diag_points(BBox2 const& image_box, 
+void add_perimeter_diag_points(BBox2 const& image_box,
                                vw::CamPtr cam,
                                vw::cartography::Datum const& datum,
                                BBox2 const& ll, // lon-lat box
                                Vector2 const& H, // height range
+                               int num_threads,
                                // Outputs (append to these)
                                std::vector<Vector3> & all_llh,
                                std::vector<Vector2> & all_pixels) {
@@ -223,47 +277,49 @@ void add_perimeter_diag_points(BBox2 const& image_box,
   int num_steps = std::max(100, int(all_llh.size()/10));
   std::vector<vw::Vector2> points;
   vw::cartography::sample_float_box(b, points, num_steps);
-  
-  // Use only the min and max heights
-  for (size_t i = 0; i < H.size(); i++) {
-    double h = H[i];
-
-    for (size_t j = 0; j < points.size(); j++) {
-      vw::Vector2 pix = points[j];
-      
-      double semi_major = datum.semi_major_axis() + h;
-      double semi_minor = datum.semi_minor_axis() + h;
-      vw::Vector3 intersection;
-      try {
-        intersection 
-          = vw::cartography::datum_intersection(semi_major, semi_minor, 
-                                                cam->camera_center(pix), 
-                                                cam->pixel_to_vector(pix));
-        if (intersection == vw::Vector3())
-          continue;
-      } catch (...) {
-        continue;
-      }
 
-      vw::Vector3 llh = datum.cartesian_to_geodetic(intersection);
-      
-      // Must be contained in the lon-lat box
-      if (!ll.contains(Vector2(llh[0], llh[1])))
+  // Use only the min and max heights
+  int num_pts = points.size();
+  std::vector<Vector3> llh(H.size() * num_pts);
+  std::vector<Vector2> pixels(llh.size());
+  std::vector<char> valid(llh.size(), 0);
+
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+  for (int k = 0; k < int(llh.size()); k++) {
+    double h = H[k / num_pts];
+    vw::Vector2 pix = points[k % num_pts];
+
+    double semi_major = datum.semi_major_axis() + h;
+    double semi_minor = datum.semi_minor_axis() + h;
+    vw::Vector3 intersection;
+    try {
+      intersection
+        = vw::cartography::datum_intersection(semi_major, semi_minor,
+                                              cam->camera_center(pix),
+                                              cam->pixel_to_vector(pix));
+      if (intersection == vw::Vector3())
         continue;
-        
-      all_llh.push_back(llh);
-      all_pixels.push_back(pix);
+    } catch (...) {
+      continue;
     }
+
+    llh[k] = datum.cartesian_to_geodetic(intersection);
+    pixels[k] = pix;
+
+    // Must be contained in the lon-lat box
+    valid[k] = ll.contains(Vector2(llh[k][0], llh[k][1]));
   }
 
+  append_valid(llh, pixels, valid, all_llh, all_pixels);
 }
 
 // Add pixel and llh samples along the perimeter and diagonals of image_box.
 // using the DEM.
-void sample_dem_perim_diag(BBox2 const& image_box, 
+void sample_dem_perim_diag(BBox2 const& image_box,
                            vw::CamPtr cam,
                            ImageViewRef<PixelMask<float>> dem,
                            GeoReference const& dem_geo,
+                           int num_threads,
                            // Outputs (append to these)
                            std::vector<Vector3> & all_llh,
                            std::vector<Vector2> & all_pixels) {
@@ -276,36 +332,41 @@ void sample_dem_perim_diag(BBox2 const& image_box,
   int num_steps = 100;
   std::vector<vw::Vector2> points;
   vw::cartography::sample_float_box(b, points, num_steps);
-  
+
   double height_guess = vw::cartography::demHeightGuess(dem);
-  vw::Vector3 xyz_guess(0, 0, 0); // will be updated
-  
-  for (size_t j = 0; j < points.size(); j++) {
+
+  std::vector<Vector3> llh(points.size());
+  std::vector<char> valid(points.size(), 0);
+
+  // The points are done in parallel, so each starts from the height guess
+  // rather than from the previous intersection.
+  #pragma omp parallel for schedule(dynamic, 4) num_threads(num_threads)
+  for (int j = 0; j < int(points.size()); j++) {
     vw::Vector2 pix = points[j];
-    
+
     // Intersect the ray going from the given camera pixel with a DEM
-    // Use xyz_guess as initial guess and overwrite it with the new value
     bool treat_nodata_as_zero = false;
     bool has_intersection = false;
     double max_abs_tol = 1e-14;
     double max_rel_tol = max_abs_tol;
     double dem_height_error_tol = 1e-3; // 1 mm
     int num_max_iter = 100;
+    vw::Vector3 xyz_guess(0, 0, 0);
     vw::Vector3 xyz;
     try {
-      
+
       // Intersect with the DEM
       xyz = vw::cartography::
-        camera_pixel_to_dem_xyz(cam->camera_center(pix), 
+        camera_pixel_to_dem_xyz(cam->camera_center(pix),
                                 cam->pixel_to_vector(pix),
                                 dem,
-                                dem_geo, 
+                                dem_geo,
                                 treat_nodata_as_zero,
-                                has_intersection, 
-                                dem_height_error_tol, 
-                                max_abs_tol, max_rel_tol, 
-                                num_max_iter, 
-                                xyz_guess, 
+                                has_intersection,
+                                dem_height_error_tol,
+                                max_abs_tol, max_rel_tol,
+                                num_max_iter,
+                                xyz_guess,
                                 height_guess);
     } catch (...) {
       continue;
@@ -314,16 +375,13 @@ void sample_dem_perim_diag(BBox2 const& image_box,
     if (!has_intersection || xyz == vw::Vector3())
       continue;
 
-    // Update the guess for nex time, now that we have a valid intersection point
-    xyz_guess = xyz;
+    llh[j] = dem_geo.datum().cartesian_to_geodetic(xyz);
+    valid[j] = 1;
 
-    vw::Vector3 llh = dem_geo.datum().cartesian_to_geodetic(xyz);
-      
-    all_llh.push_back(llh);
-    all_pixels.push_back(pix);
-    
   } // end loop through points
-  
+
+  append_valid(llh, points, valid, all_llh, all_pixels);
+
   return;
 }
 
@@ -331,16 +389,16 @@ void sample_dem_perim_diag(BBox2 const& image_box,
 void calc_llh_bbox_from_dem(Options & opt, vw::CamPtr cam,
                             vw::BBox2 const& image_box,
                             ImageViewRef<PixelMask<float>> input_img) {
-  
+
   vw::vw_out() << "Estimating the lon-lat-height range from DEM: " << opt.dem_file << "\n";
-  
+
   std::vector<Vector3> all_llh;
   std::vector<Vector2> all_pixels;
-  
-  float dem_nodata_val = -std::numeric_limits<float>::max(); 
+
+  float dem_nodata_val = -std::numeric_limits<float>::max();
   vw::read_nodata_val(opt.dem_file, dem_nodata_val);
 
-  ImageViewRef<PixelMask<float>> dem 
+  ImageViewRef<PixelMask<float>> dem
     = create_mask(DiskImageView<float>(opt.dem_file), dem_nodata_val);
 
   GeoReference dem_geo;
@@ -355,50 +413,46 @@ void calc_llh_bbox_from_dem(Options & opt, vw::CamPtr cam,
   // coefficients.
   double delta_col = std::max(1.0, dem.cols()/double(opt.num_samples));
   double delta_row = std::max(1.0, dem.rows()/double(opt.num_samples));
-  
-  vw::TerminalProgressCallback tpc("asp", "\t--> ");  
+
+  vw::TerminalProgressCallback tpc("asp", "\t--> ");
   double inc_amount = delta_col / dem.cols();
-  
+
+  // Read the DEM samples. They are projected into the camera further down.
+  std::vector<Vector3> dem_llh;
   tpc.report_progress(0);
   for (double dcol = 0; dcol < dem.cols(); dcol += delta_col) {
     for (double drow = 0; drow < dem.rows(); drow += delta_row) {
       int col = dcol, row = drow; // cast to int
 
-      if (!is_valid(dem(col, row))) 
+      if (!is_valid(dem(col, row)))
         continue;
 
       Vector2 pix(col, row);
       Vector2 lonlat = dem_geo.pixel_to_lonlat(pix);
 
       // Lon lat height
-      Vector3 llh;
-      llh[0] = lonlat[0]; llh[1] = lonlat[1]; llh[2] = dem(col, row).child();
-      Vector3 xyz = opt.datum.geodetic_to_cartesian(llh);
-
-      // Go back to llh. This is a bugfix for the 360 deg offset problem.
-      llh = opt.datum.cartesian_to_geodetic(xyz);
-
-      Vector2 cam_pix;
-      try {
-        // The point_to_pixel function can be capricious
-        cam_pix = cam->point_to_pixel(xyz);
-      } catch(...) {
-        continue;
-      }
-
-      if (image_box.contains(cam_pix) && is_valid(input_img(cam_pix[0], cam_pix[1]))) {
-        all_llh.push_back(llh);
-        all_pixels.push_back(cam_pix);
-      }
-
+      dem_llh.push_back(Vector3(lonlat[0], lonlat[1], dem(col, row).child()));
     }
     tpc.report_incremental_progress(inc_amount);
   } // end loop through DEM pixels
   tpc.report_finished();
 
+  std::vector<Vector2> dem_pixels;
+  std::vector<char> valid;
+  project_llh(cam, opt.datum, image_box, opt.num_sample_threads,
+              dem_llh, dem_pixels, valid);
+  for (size_t i = 0; i < dem_llh.size(); i++) {
+    Vector2 cam_pix = dem_pixels[i];
+    if (valid[i] && is_valid(input_img(cam_pix[0], cam_pix[1]))) {
+      all_llh.push_back(dem_llh[i]);
+      all_pixels.push_back(cam_pix);
+    }
+  }
+
   // Add pixel and llh samples along the perimeter and diagonals of image_box.
   // using the DEM.
-  sample_dem_perim_diag(image_box, cam, dem, dem_geo, all_llh, all_pixels);
+  sample_dem_perim_diag(image_box, cam, dem, dem_geo, opt.num_sample_threads,
+                        all_llh, all_pixels);
 
   // Based on these, find th lon-lat and height ranges
   opt.lon_lat_range = BBox2();
@@ -410,17 +464,17 @@ void calc_llh_bbox_from_dem(Options & opt, vw::CamPtr cam,
     opt.height_range[0] = std::min(opt.height_range[0], llh[2]);
     opt.height_range[1] = std::max(opt.height_range[1], llh[2]);
   }
-  
+
   vw::vw_out() << "Computed lon-lat range: " << opt.lon_lat_range << std::endl;
   vw::vw_out() << "Computed height range: " << opt.height_range << std::endl;
-  
+
   return;
 }
 
-// Sample the llh box and shoot the 3D points into the camera.
-// Filter by image box.
+// Sample the llh box with num_samples intervals in each direction and shoot
+// the 3D points into the camera. Filter by image box.
 void sample_llh_bbox(Options const& opt, vw::CamPtr cam,
-                     BBox2 const& image_box,
+                     BBox2 const& image_box, int num_samples,
                      // Outputs
                      std::vector<Vector3> & all_llh,
                      std::vector<Vector2> & all_pixels) {
@@ -429,44 +483,273 @@ void sample_llh_bbox(Options const& opt, vw::CamPtr cam,
   all_llh.clear();
   all_pixels.clear();
 
+  BBox2 ll = opt.lon_lat_range; // shortcut
+  Vector2 H = opt.height_range;
+  double delta_lon = (ll.max()[0] - ll.min()[0])/double(num_samples);
+  double delta_lat = (ll.max()[1] - ll.min()[1])/double(num_samples);
+  double delta_ht  = (H[1] - H[0])/double(num_samples);
+
+  std::vector<Vector3> llh;
+  for (int i = 0; i <= num_samples; i++) {
+    for (int j = 0; j <= num_samples; j++) {
+      for (int k = 0; k <= num_samples; k++)
+        llh.push_back(Vector3(ll.min()[0] + i * delta_lon,
+                              ll.min()[1] + j * delta_lat,
+                              H[0]        + k * delta_ht));
+    }
+  }
+
+  std::vector<Vector2> pixels;
+  std::vector<char> valid;
+  project_llh(cam, opt.datum, image_box, opt.num_sample_threads, llh, pixels, valid);
+  append_valid(llh, pixels, valid, all_llh, all_pixels);
+}
+
+// The RPC model fit to the samples, and the normalization of its inputs and
+// outputs.
+struct RpcFit {
+  Vector3 llh_scale, llh_offset;
+  Vector2 pixel_scale, pixel_offset;
+  asp::RPCModel::CoeffVec line_num, line_den, samp_num, samp_den;
+};
+
+// Find the lon-lat-height box of the samples and their pixel box, with the
+// latter expanded to integer values and cropped to the image box, unless
+// --no-crop is set. The pixel box is max-exclusive.
+void calc_sample_boxes(Options const& opt, BBox2 const& image_box,
+                       std::vector<Vector3> const& all_llh,
+                       std::vector<Vector2> const& all_pixels,
+                       BBox3 & llh_box, BBox2 & pixel_box) {
+
+  pixel_box = BBox2();
+  for (size_t i = 0; i < all_pixels.size(); i++)
+    pixel_box.grow(all_pixels[i]);
+
+  // Below we assume pixel_box to be max-exclusive, so expand it by 1
+  pixel_box.max() += Vector2(1, 1);
+
+  // Find the range of lon-lat-heights
+  llh_box = BBox3();
+  for (size_t i = 0; i < all_llh.size(); i++)
+    llh_box.grow(all_llh[i]);
+
+  if (!opt.no_crop) {
+    // Cast to int so that we can crop properly
+    pixel_box.min() = floor(pixel_box.min());
+    pixel_box.max() = ceil(pixel_box.max());
+    pixel_box.crop(image_box);
+  }
+}
+
+// Normalize the samples to the [-1, 1] range based on the given boxes and
+// find the RPC coefficients.
+void fit_rpc(Options const& opt,
+             std::vector<Vector3> const& all_llh,
+             std::vector<Vector2> const& all_pixels,
+             BBox3 const& llh_box, BBox2 const& pixel_box,
+             RpcFit & fit) {
+
+  fit.llh_scale  = (llh_box.max() - llh_box.min())/2.0; // half range
+  fit.llh_offset = (llh_box.max() + llh_box.min())/2.0; // center point
+
+  fit.pixel_scale  = (pixel_box.max() - pixel_box.min())/2.0; // half range
+  fit.pixel_offset = (pixel_box.max() + pixel_box.min())/2.0; // center point
+
+  Vector<double> normalized_llh;
+  Vector<double> normalized_pixels;
+  int num_total_pts = all_llh.size();
+  normalized_llh.set_size(asp::RPCModel::GEODETIC_COORD_SIZE*num_total_pts);
+  normalized_pixels.set_size(asp::RPCModel::IMAGE_COORD_SIZE*num_total_pts
+                             + asp::RpcSolveLMA::NUM_PENALTY_TERMS);
+  for (size_t i = 0; i < normalized_pixels.size(); i++) {
+    // Important: The extra penalty terms are all set to zero here.
+    normalized_pixels[i] = 0.0;
+  }
+
+  // Form the arrays of normalized pixels and normalized llh
+  for (int pt = 0; pt < num_total_pts; pt++) {
+    // Normalize the pixel to -1 <> 1 range
+    Vector3 llh_n   = elem_quot(all_llh[pt]    - fit.llh_offset,   fit.llh_scale);
+    Vector2 pixel_n = elem_quot(all_pixels[pt] - fit.pixel_offset, fit.pixel_scale);
+    subvector(normalized_llh, asp::RPCModel::GEODETIC_COORD_SIZE*pt,
+              asp::RPCModel::GEODETIC_COORD_SIZE) = llh_n;
+    subvector(normalized_pixels, asp::RPCModel::IMAGE_COORD_SIZE*pt,
+              asp::RPCModel::IMAGE_COORD_SIZE) = pixel_n;
+  }
+
+  // Find the RPC coefficients
+  std::string output_prefix = "";
+  vw_out() << "Generating the RPC approximation using " << num_total_pts
+           << " point pairs.\n";
+  asp::gen_rpc(// Inputs
+               opt.penalty_weight, output_prefix,
+               normalized_llh, normalized_pixels,
+               fit.llh_scale, fit.llh_offset, fit.pixel_scale, fit.pixel_offset,
+               // Outputs
+               fit.line_num, fit.line_den, fit.samp_num, fit.samp_den);
+}
+
+// A box in the lon-lat-height range. The RPC fit is checked at its center,
+// and the box is split into 8 if the error there is too large.
+struct SampleCell {
+  Vector3 llh;        // the center
+  Vector3 half_size;
+  Vector2 pixel;      // the center projected in the camera
+  int level;          // how many times the initial cell was split
+};
+
+// Project the centers of the cells into the camera and keep the valid ones.
+// Return the number of camera evaluations.
+int project_cells(Options const& opt, vw::CamPtr cam, BBox2 const& image_box,
+                  std::vector<SampleCell> & cells) {
+
+  std::vector<Vector3> llh(cells.size());
+  for (size_t i = 0; i < cells.size(); i++)
+    llh[i] = cells[i].llh;
+
+  std::vector<Vector2> pixels;
+  std::vector<char> valid;
+  project_llh(cam, opt.datum, image_box, opt.num_sample_threads, llh, pixels, valid);
+
+  std::vector<SampleCell> valid_cells;
+  for (size_t i = 0; i < cells.size(); i++) {
+    if (!valid[i])
+      continue;
+    SampleCell c = cells[i];
+    c.llh   = llh[i];
+    c.pixel = pixels[i];
+    valid_cells.push_back(c);
+  }
+  cells.swap(valid_cells);
+
+  return llh.size();
+}
+
+// Start with a coarse grid of samples and add more where the RPC model fits
+// the camera worst. The cells of the grid are checked at their centers. If
+// the error at a center is above --pixel-accuracy, the center becomes a
+// sample and the cell is split into 8, whose centers are checked next. Stop
+// when the accuracy is reached or the cells are as small as given by
+// --num-samples. The samples along the perimeter and diagonals of the image
+// are added before the first fit. Return the samples and the last fit.
+void refine_samples(Options const& opt, vw::CamPtr cam, BBox2 const& image_box,
+                    // Outputs
+                    std::vector<Vector3> & all_llh,
+                    std::vector<Vector2> & all_pixels,
+                    RpcFit & fit) {
+
+  vw::Stopwatch sw;
+  sw.start();
+
+  // The initial grid. The cells are split in half each time, so the finest
+  // cells have at least the size of the grid given by --num-samples.
+  int num_init_samples = std::min(opt.num_samples, 8);
+  int max_level = 0;
+  while (num_init_samples * (1 << (max_level + 1)) <= opt.num_samples)
+    max_level++;
+
   vw_out() << "Sampling the ground points and camera pixels.\n";
-  double inc_amount = 1.0 / double(opt.num_samples);
+  sample_llh_bbox(opt, cam, image_box, num_init_samples, all_llh, all_pixels);
+  int num_cam_evals = (num_init_samples + 1) * (num_init_samples + 1) * (num_init_samples + 1);
+
+  add_perimeter_diag_points(image_box, cam, opt.datum, opt.lon_lat_range, opt.height_range,
+                            opt.num_sample_threads, all_llh, all_pixels);
 
   BBox2 ll = opt.lon_lat_range; // shortcut
   Vector2 H = opt.height_range;
-  double delta_lon = (ll.max()[0] - ll.min()[0])/double(opt.num_samples);
-  double delta_lat = (ll.max()[1] - ll.min()[1])/double(opt.num_samples);
-  double delta_ht  = (H[1] - H[0])/double(opt.num_samples);
-  vw::TerminalProgressCallback tpc("asp", "\t--> ");
-  tpc.report_progress(0);
-  for (double lon = ll.min()[0]; lon <= ll.max()[0]; lon += delta_lon) {
-    for (double lat = ll.min()[1]; lat <= ll.max()[1]; lat += delta_lat) {
-      for (double ht = H[0]; ht <= H[1]; ht += delta_ht) {
-
-        Vector3 llh(lon, lat, ht);
-        Vector3 xyz = opt.datum.geodetic_to_cartesian(llh);
-
-        // Go back to llh. This is a bugfix for the 360 deg offset problem.
-        llh = opt.datum.cartesian_to_geodetic(xyz);
-
-        Vector2 cam_pix;
-        try {
-          // The point_to_pixel function can be capricious
-          cam_pix = cam->point_to_pixel(xyz);
-        } catch(...) {
-          continue;
-        }
-        if (image_box.contains(cam_pix)) {
-          all_llh.push_back(llh);
-          all_pixels.push_back(cam_pix);
-        }
+  Vector3 cell_size((ll.max()[0] - ll.min()[0])/double(num_init_samples),
+                    (ll.max()[1] - ll.min()[1])/double(num_init_samples),
+                    (H[1] - H[0])/double(num_init_samples));
+  std::vector<SampleCell> cells;
+  for (int i = 0; i < num_init_samples; i++) {
+    for (int j = 0; j < num_init_samples; j++) {
+      for (int k = 0; k < num_init_samples; k++) {
+        SampleCell c;
+        c.half_size = cell_size / 2.0;
+        c.llh = Vector3(ll.min()[0], ll.min()[1], H[0])
+          + elem_prod(Vector3(i, j, k), cell_size) + c.half_size;
+        c.level = 0;
+        cells.push_back(c);
+      }
+    }
+  }
+  num_cam_evals += project_cells(opt, cam, image_box, cells);
 
+  vw_out() << "Refining the samples until the RPC error at the check points "
+           << "is below " << opt.pixel_accuracy << " pixels.\n";
+  for (int iter = 0; ; iter++) {
+
+    BBox3 llh_box;
+    BBox2 pixel_box;
+    calc_sample_boxes(opt, image_box, all_llh, all_pixels, llh_box, pixel_box);
+    fit_rpc(opt, all_llh, all_pixels, llh_box, pixel_box, fit);
+
+    // The error at the cell centers
+    asp::RPCModel rpc(opt.datum, fit.line_num, fit.line_den, fit.samp_num, fit.samp_den,
+                      fit.pixel_offset, fit.pixel_scale, fit.llh_offset, fit.llh_scale);
+    int num = cells.size();
+    std::vector<double> lon(num), lat(num), ht(num), pix_x(num), pix_y(num);
+    for (int i = 0; i < num; i++) {
+      lon[i] = cells[i].llh[0];
+      lat[i] = cells[i].llh[1];
+      ht[i]  = cells[i].llh[2];
+    }
+    rpc.geodetic_to_pixel(num, lon.data(), lat.data(), ht.data(), pix_x.data(), pix_y.data());
+    std::vector<double> err(num);
+    double max_err = 0.0, mean_err = 0.0;
+    for (int i = 0; i < num; i++) {
+      err[i] = norm_2(Vector2(pix_x[i], pix_y[i]) - cells[i].pixel);
+      max_err = std::max(max_err, err[i]);
+      mean_err += err[i] / num;
+    }
+
+    sw.stop();
+    vw_out() << "Iteration " << iter << ": " << all_llh.size() << " samples, "
+             << num << " check points, " << num_cam_evals << " camera evaluations, "
+             << "max error " << max_err << " pixels, mean error " << mean_err
+             << " pixels, elapsed time " << sw.elapsed_seconds() << " seconds.\n";
+    sw.start();
+
+    if (max_err <= opt.pixel_accuracy || num == 0)
+      break;
+
+    // Split the cells with a large error, and keep the rest for checking
+    std::vector<SampleCell> kept_cells, new_cells;
+    for (int i = 0; i < num; i++) {
+      SampleCell const& c = cells[i];
+      if (err[i] <= opt.pixel_accuracy || c.level >= max_level) {
+        kept_cells.push_back(c);
+        continue;
+      }
+
+      all_llh.push_back(c.llh);
+      all_pixels.push_back(c.pixel);
+      for (int q = 0; q < 8; q++) {
+        SampleCell d;
+        d.half_size = c.half_size / 2.0;
+        d.llh = c.llh + elem_prod(Vector3(q & 1 ? 1 : -1, q & 2 ? 1 : -1, q & 4 ? 1 : -1),
+                                  d.half_size);
+        d.level = c.level + 1;
+        new_cells.push_back(d);
       }
     }
-    tpc.report_incremental_progress(inc_amount);
+
+    if (new_cells.empty()) {
+      vw_out(WarningMessage) << "Could not reach the desired accuracy of "
+                             << opt.pixel_accuracy << " pixels with the sampling given "
+                             << "by --num-samples. Increase that, or the camera cannot "
+                             << "be approximated well by an RPC model in this range.\n";
+      break;
+    }
+
+    num_cam_evals += project_cells(opt, cam, image_box, new_cells);
+    kept_cells.insert(kept_cells.end(), new_cells.begin(), new_cells.end());
+    cells.swap(kept_cells);
   }
-  tpc.report_finished();
-  
+
+  sw.stop();
+  vw_out() << "Used " << num_cam_evals << " camera evaluations and "
+           << sw.elapsed_seconds() << " seconds to sample and fit the RPC model.\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -510,6 +793,11 @@ int main(int argc, char *argv[]) {
 
     vw::CamPtr cam = session->camera_model(opt.image_file, opt.camera_file);
 
+    // Sample the camera in parallel, except for ISIS, which is not thread-safe
+    opt.num_sample_threads = 1;
+    if (session->supports_multi_threading())
+      opt.num_sample_threads = vw_settings().default_num_threads();
+
     // Get the input nodata value from the image file, unless the
     // user overwrites it.
     float val = std::numeric_limits<float>::quiet_NaN();
@@ -550,38 +838,35 @@ int main(int argc, char *argv[]) {
     // Put this here, after peeking inside the DEM with calc_llh_bbox_from_dem()
     vw_out() << "Datum: " << opt.datum << std::endl;
 
-    // Generate point pairs
+    // Generate point pairs. With --pixel-accuracy, start with a coarse
+    // sampling and refine it while fitting the RPC model.
     std::vector<Vector3> all_llh;
     std::vector<Vector2> all_pixels;
-    sample_llh_bbox(opt, cam, image_box, 
-                    all_llh, all_pixels); // outputs
-    
-    // Add points for pixels along the perimeter and diagonals of image_box. Constrain
-    // by the ll box.
-    add_perimeter_diag_points(image_box, cam, opt.datum, opt.lon_lat_range, opt.height_range,
-                              all_llh, all_pixels); // outputs
-
-    // The pixel box
-    BBox2 pixel_box;
-    for (size_t i = 0; i < all_pixels.size(); i++) 
-      pixel_box.grow(all_pixels[i]);
+    RpcFit fit;
+    bool have_fit = false;
+    if (opt.pixel_accuracy > 0 && !opt.skip_computing_rpc) {
+      refine_samples(opt, cam, image_box, all_llh, all_pixels, fit); // outputs
+      have_fit = true;
+    } else {
+      vw_out() << "Sampling the ground points and camera pixels.\n";
+      sample_llh_bbox(opt, cam, image_box, opt.num_samples,
+                      all_llh, all_pixels); // outputs
+
+      // Add points for pixels along the perimeter and diagonals of image_box. Constrain
+      // by the ll box.
+      add_perimeter_diag_points(image_box, cam, opt.datum, opt.lon_lat_range,
+                                opt.height_range, opt.num_sample_threads,
+                                all_llh, all_pixels); // outputs
+    }
 
-    // Below we assume pixel_box to be max-exclusive, so expand it by 1
-    pixel_box.max() += Vector2(1, 1);
-    
-    // Find the range of lon-lat-heights
+    // The pixel box and the range of lon-lat-heights
     BBox3 llh_box;
-    for (size_t i = 0; i < all_llh.size(); i++) 
-      llh_box.grow(all_llh[i]);
+    BBox2 pixel_box;
+    calc_sample_boxes(opt, image_box, all_llh, all_pixels, llh_box, pixel_box);
 
     // If cropping, adjust the pixels
     BBox2 crop_box;
     if (!opt.no_crop) {
-      // Cast to int so that we can crop properly
-      pixel_box.min() = floor(pixel_box.min());
-      pixel_box.max() = ceil(pixel_box.max());
-      pixel_box.crop(image_box);
-
       crop_box = pixel_box; // save it before we modify pixel_box
 
       // Shift all pixels by the crop corner, including the pixel box itself
@@ -622,67 +907,35 @@ int main(int argc, char *argv[]) {
     if (opt.skip_computing_rpc) 
       return 0;
 
-    Vector3 llh_scale  = (llh_box.max() - llh_box.min())/2.0; // half range
-    Vector3 llh_offset = (llh_box.max() + llh_box.min())/2.0; // center point
-
-    Vector2 pixel_scale  = (pixel_box.max() - pixel_box.min())/2.0; // half range 
-    Vector2 pixel_offset = (pixel_box.max() + pixel_box.min())/2.0; // center point
-
     vw_out() << "Lon-lat-height box for the RPC approx: " << llh_box   << std::endl;
     vw_out() << "Camera pixel box for the RPC approx (after crop): " << pixel_box << std::endl;
 
-    Vector<double> normalized_llh;
-    Vector<double> normalized_pixels;
-    int num_total_pts = all_llh.size();
-    normalized_llh.set_size(asp::RPCModel::GEODETIC_COORD_SIZE*num_total_pts);
-    normalized_pixels.set_size(asp::RPCModel::IMAGE_COORD_SIZE*num_total_pts
-                               + asp::RpcSolveLMA::NUM_PENALTY_TERMS);
-    for (size_t i = 0; i < normalized_pixels.size(); i++) {
-      // Important: The extra penalty terms are all set to zero here.
-      normalized_pixels[i] = 0.0; 
-    }
-
-    // Form the arrays of normalized pixels and normalized llh
-    for (int pt = 0; pt < num_total_pts; pt++) {
-      // Normalize the pixel to -1 <> 1 range
-      Vector3 llh_n   = elem_quot(all_llh[pt]    - llh_offset,   llh_scale);
-      Vector2 pixel_n = elem_quot(all_pixels[pt] - pixel_offset, pixel_scale);
-      subvector(normalized_llh, asp::RPCModel::GEODETIC_COORD_SIZE*pt,
-                asp::RPCModel::GEODETIC_COORD_SIZE) = llh_n;
-      subvector(normalized_pixels, asp::RPCModel::IMAGE_COORD_SIZE*pt,
-                asp::RPCModel::IMAGE_COORD_SIZE) = pixel_n;
-    }
-
-    // Find the RPC coefficients
-    asp::RPCModel::CoeffVec line_num, line_den, samp_num, samp_den;
-    std::string output_prefix = "";
-    vw_out() << "Generating the RPC approximation using " << num_total_pts 
-             << " point pairs.\n";
-    asp::gen_rpc(// Inputs
-                 opt.penalty_weight, output_prefix,
-                 normalized_llh, normalized_pixels,
-                 llh_scale, llh_offset, pixel_scale, pixel_offset,
-                 // Outputs
-                 line_num, line_den, samp_num, samp_den);
+    // Find the RPC coefficients. The fit done while refining the samples used
+    // the pixels before the crop, and their normalized values are the same,
+    // so only the pixel offset needs to change.
+    if (!have_fit)
+      fit_rpc(opt, all_llh, all_pixels, llh_box, pixel_box, fit);
+    else if (!opt.no_crop)
+      fit.pixel_offset -= crop_box.min();
 
     // TODO: Integrate this with aster2asp existing functionality!
     // Have a generic function for saving WV RPC files. 
-    std::string lineoffset   = vw::num_to_str(pixel_offset.y());
-    std::string sampoffset   = vw::num_to_str(pixel_offset.x());
-    std::string latoffset    = vw::num_to_str(llh_offset.y());
-    std::string longoffset   = vw::num_to_str(llh_offset.x());
-    std::string heightoffset = vw::num_to_str(llh_offset.z());
-
-    std::string linescale   = vw::num_to_str(pixel_scale.y());
-    std::string sampscale   = vw::num_to_str(pixel_scale.x());
-    std::string latscale    = vw::num_to_str(llh_scale.y());
-    std::string longscale   = vw::num_to_str(llh_scale.x());
-    std::string heightscale = vw::num_to_str(llh_scale.z());
-
-    std::string linenumcoef = vw::vec_to_str(line_num);
-    std::string linedencoef = vw::vec_to_str(line_den);
-    std::string sampnumcoef = vw::vec_to_str(samp_num);
-    std::string sampdencoef = vw::vec_to_str(samp_den);
+    std::string lineoffset   = vw::num_to_str(fit.pixel_offset.y());
+    std::string sampoffset   = vw::num_to_str(fit.pixel_offset.x());
+    std::string latoffset    = vw::num_to_str(fit.llh_offset.y());
+    std::string longoffset   = vw::num_to_str(fit.llh_offset.x());
+    std::string heightoffset = vw::num_to_str(fit.llh_offset.z());
+
+    std::string linescale   = vw::num_to_str(fit.pixel_scale.y());
+    std::string sampscale   = vw::num_to_str(fit.pixel_scale.x());
+    std::string latscale    = vw::num_to_str(fit.llh_scale.y());
+    std::string longscale   = vw::num_to_str(fit.llh_scale.x());
+    std::string heightscale = vw::num_to_str(fit.llh_scale.z());
+
+    std::string linenumcoef = vw::vec_to_str(fit.line_num);
+    std::string linedencoef = vw::vec_to_str(fit.line_den);
+    std::string sampnumcoef = vw::vec_to_str(fit.samp_num);
+    std::string sampdencoef = vw::vec_to_str(fit.samp_den);
 
     std::string gsd_str = vw::num_to_str(opt.gsd);
 
@@ -20,6 +20,8 @@
 #include <vw/FileIO/DiskImageView.h>
 #include <vw/Cartography/GeoTransform.h>
 #include <vw/Cartography/PointImageManipulation.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Core/Thread.h>
 
 
 using std::endl;
@@ -224,6 +226,77 @@ void dem2dem_diff(Options& opt) {
   }
 }
 
+// Convert a range of CSV records to DEM pixels and heights above the DEM datum
+class CsvToDemPixelTask: public vw::Task, private boost::noncopyable {
+  asp::CsvConv const& m_csv_conv;
+  std::vector<asp::CsvConv::CsvRecord> const& m_records;
+  GeoReference m_csv_georef, m_dem_georef; // make copies to be thread-safe
+  size_t m_beg, m_end;
+  std::vector<Vector3> & m_llh;
+  std::vector<Vector2> & m_pix;
+
+public:
+  CsvToDemPixelTask(asp::CsvConv const& csv_conv,
+                    std::vector<asp::CsvConv::CsvRecord> const& records,
+                    GeoReference const& csv_georef, GeoReference const& dem_georef,
+                    size_t beg, size_t end,
+                    std::vector<Vector3> & llh, std::vector<Vector2> & pix):
+    m_csv_conv(csv_conv), m_records(records), m_csv_georef(csv_georef),
+    m_dem_georef(dem_georef), m_beg(beg), m_end(end), m_llh(llh), m_pix(pix) {}
+
+  void operator()() {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t it = m_beg; it < m_end; it++) {
+      m_pix[it] = Vector2(nan, nan);
+      Vector3 xyz = m_csv_conv.csv_to_cartesian(m_records[it], m_csv_georef);
+      if (xyz == Vector3() || xyz != xyz)
+        continue; // invalid point
+      m_llh[it] = m_dem_georef.datum().cartesian_to_geodetic(xyz); // use the dem's datum
+      m_pix[it] = m_dem_georef.lonlat_to_pixel(subvector(m_llh[it], 0, 2));
+    }
+  }
+};
+
+// Interpolate the DEM at the CSV points falling in the given DEM tile. The
+// tile is read once, with a one-pixel margin for bilinear interpolation.
+class DemTileDiffTask: public vw::Task, private boost::noncopyable {
+  DiskImageView<double> const& m_dem;
+  double m_dem_nodata;
+  BBox2i m_tile;
+  std::vector<size_t> const& m_indices;
+  std::vector<Vector2> const& m_pix;
+  std::vector<PixelMask<double>> & m_dem_ht;
+  Mutex & m_mutex;
+  vw::TerminalProgressCallback & m_tpc;
+  double m_inc_amount;
+
+public:
+  DemTileDiffTask(DiskImageView<double> const& dem, double dem_nodata, BBox2i const& tile,
+                  std::vector<size_t> const& indices, std::vector<Vector2> const& pix,
+                  std::vector<PixelMask<double>> & dem_ht,
+                  Mutex & mutex, vw::TerminalProgressCallback & tpc, double inc_amount):
+    m_dem(dem), m_dem_nodata(dem_nodata), m_tile(tile), m_indices(indices),
+    m_pix(pix), m_dem_ht(dem_ht), m_mutex(mutex), m_tpc(tpc), m_inc_amount(inc_amount) {}
+
+  void operator()() {
+    BBox2i read_box = m_tile;
+    read_box.max() += Vector2i(1, 1);
+    read_box.crop(bounding_box(m_dem));
+    ImageView<double> dem_tile = crop(m_dem, read_box);
+    ImageViewRef<PixelMask<double>> interp_dem
+      = interpolate(create_mask(dem_tile, m_dem_nodata),
+                    BilinearInterpolation(), ConstantEdgeExtension());
+    for (size_t k = 0; k < m_indices.size(); k++) {
+      size_t it = m_indices[k];
+      m_dem_ht[it] = interp_dem(m_pix[it][0] - read_box.min().x(),
+                                m_pix[it][1] - read_box.min().y());
+    }
+
+    Mutex::Lock lock(m_mutex);
+    m_tpc.report_incremental_progress(m_inc_amount);
+  }
+};
+
 // From a DEM, subtract a csv file. Reverse the sign is 'reverse' is true.
 void dem2csv_diff(Options & opt, std::string const& dem_file,
                   std::string const & csv_file, bool reverse){
@@ -269,53 +342,92 @@ void dem2csv_diff(Options & opt, std::string const& dem_file,
   GeoReference csv_georef = dem_georef;
   csv_conv.parse_georef(csv_georef);
 
-  std::list<asp::CsvConv::CsvRecord> csv_records;
-  typedef std::list<asp::CsvConv::CsvRecord>::const_iterator RecordIter;
+  std::vector<asp::CsvConv::CsvRecord> csv_records;
   csv_conv.read_csv_file(csv_file, csv_records);
-  
-  std::vector<Vector3> csv_llh;
-  for (RecordIter iter = csv_records.begin(); iter != csv_records.end(); iter++) {
-    Vector3 xyz = csv_conv.csv_to_cartesian(*iter, csv_georef);
-    if (xyz == Vector3() || xyz != xyz)
-      continue; // invalid point
-    Vector3 llh = dem_georef.datum().cartesian_to_geodetic(xyz); // use the dem's datum
-    csv_llh.push_back(llh);
+
+  // Convert the points to DEM pixels with multiple threads
+  size_t num_pts = csv_records.size();
+  std::vector<Vector3> csv_llh(num_pts);
+  std::vector<Vector2> csv_pix(num_pts);
+  int num_threads = vw_settings().default_num_threads();
+  {
+    FifoWorkQueue queue(num_threads);
+    size_t chunk = std::max(size_t(1), num_pts / (4 * num_threads) + 1);
+    for (size_t beg = 0; beg < num_pts; beg += chunk) {
+      boost::shared_ptr<CsvToDemPixelTask>
+        task(new CsvToDemPixelTask(csv_conv, csv_records, csv_georef, dem_georef,
+                                   beg, std::min(beg + chunk, num_pts),
+                                   csv_llh, csv_pix));
+      queue.add_task(task);
+    }
+    queue.join_all();
+  }
+  csv_records = std::vector<asp::CsvConv::CsvRecord>(); // free up the memory
+
+  // Group the points by DEM tile, so that each tile is read only once,
+  // rather than reading tiles in the order of the points in the file.
+  int tile_size = 1024;
+  int num_tile_cols = (dem.cols() + tile_size - 1) / tile_size;
+  int num_tile_rows = (dem.rows() + tile_size - 1) / tile_size;
+  std::vector<std::vector<size_t>> tile_points(size_t(num_tile_cols) * num_tile_rows);
+  for (size_t it = 0; it < num_pts; it++) {
+    Vector2 pix = csv_pix[it];
+    // Check for out of range. This also skips invalid points, which are NaN.
+    if (!(pix[0] >= 0 && pix[0] <= dem.cols() - 1)) continue;
+    if (!(pix[1] >= 0 && pix[1] <= dem.rows() - 1)) continue;
+    int tx = std::min(int(pix[0]) / tile_size, num_tile_cols - 1);
+    int ty = std::min(int(pix[1]) / tile_size, num_tile_rows - 1);
+    tile_points[size_t(ty) * num_tile_cols + tx].push_back(it);
   }
 
-  // We will interpolate into the DEM to find the difference
-  ImageViewRef<PixelMask<double>> interp_dem
-    = interpolate(create_mask(dem, dem_nodata),
-		  BilinearInterpolation(), ConstantEdgeExtension());
+  // Interpolate into the DEM to find the difference. Process each tile
+  // once, with multiple threads.
+  vw::TerminalProgressCallback tpc("Diff:", "\t--> ");
+  tpc.report_progress(0);
+  PixelMask<double> invalid_ht;
+  invalid_ht.invalidate();
+  std::vector<PixelMask<double>> dem_ht(num_pts, invalid_ht);
+  {
+    int num_tiles = 0;
+    for (size_t t = 0; t < tile_points.size(); t++)
+      num_tiles += int(!tile_points[t].empty());
+    double inc_amount = 1.0 / std::max(num_tiles, 1);
+    Mutex mutex;
+    FifoWorkQueue queue(num_threads);
+    for (int ty = 0; ty < num_tile_rows; ty++) {
+      for (int tx = 0; tx < num_tile_cols; tx++) {
+        std::vector<size_t> const& indices = tile_points[size_t(ty) * num_tile_cols + tx];
+        if (indices.empty())
+          continue;
+        BBox2i tile(tx * tile_size, ty * tile_size, tile_size, tile_size);
+        tile.crop(bounding_box(dem));
+        boost::shared_ptr<DemTileDiffTask>
+          task(new DemTileDiffTask(dem, dem_nodata, tile, indices, csv_pix, dem_ht,
+                                   mutex, tpc, inc_amount));
+        queue.add_task(task);
+      }
+    }
+    queue.join_all();
+  }
+  tpc.report_finished();
 
-  // Save the diffs
+  // Save the diffs, in the original order of the points
   int    count     = 0;
   double diff_min  = std::numeric_limits<double>::max();
   double diff_max  = -diff_min;
   double diff_mean = 0.0;
   double diff_std  = 0.0;
 
-  vw::TerminalProgressCallback tpc("Diff:", "\t--> ");
-  tpc.report_progress(0);
-  double hundred = 100.0;
-  double inc_amount = hundred / std::max(csv_llh.size(), size_t(1));
-
   std::vector<Vector3> csv_diff;
   std::vector<double> csv_errs;
-  int prev_progress = 0;
-  for (size_t it = 0; it < csv_llh.size(); it++) {
+  for (size_t it = 0; it < num_pts; it++) {
+
+    if (!is_valid(dem_ht[it]))
+      continue; // out of range, or invalid point or DEM height
 
     Vector3 llh = csv_llh[it];
     Vector2 ll  = subvector(llh, 0, 2);
-    Vector2 pix = dem_georef.lonlat_to_pixel(ll);
-    
-    // Check for out of range
-    if (pix[0] < 0 || pix[0] > dem.cols() - 1) continue;
-    if (pix[1] < 0 || pix[1] > dem.rows() - 1) continue;
-    PixelMask<double> dem_ht = interp_dem(pix[0], pix[1]);
-    if (!is_valid(dem_ht))
-      continue;
-
-    double diff = dem_ht.child() - llh[2];
+    double diff = dem_ht[it].child() - llh[2];
     if (reverse) 
       diff *= -1;
     if (opt.use_absolute)
@@ -329,16 +441,8 @@ void dem2csv_diff(Options & opt, std::string const& dem_file,
     count     += 1;
     csv_diff.push_back(Vector3(ll[0], ll[1], diff));
     csv_errs.push_back(diff);
-    
-    int percent_progress = (int)round(it * inc_amount);
-    if (percent_progress != prev_progress) {
-      tpc.report_incremental_progress(1.0 / hundred);
-      prev_progress = percent_progress;
-    }
   }
   
-  tpc.report_finished();
-  
 
   if (count > 0) {
     diff_mean /= count;
@@ -37,6 +37,7 @@
 #include <asp/Camera/JitterSolveRigUtils.h>
 #include <asp/Camera/LinescanUtils.h>
 #include <asp/Camera/BundleAdjustResiduals.h>
+#include <asp/Camera/SolverCheckpoint.h>
 #include <asp/Core/Macros.h>
 #include <asp/Core/Common.h>
 #include <asp/Core/StereoSettings.h>
@@ -150,6 +151,14 @@ void handle_arguments(int argc, char *argv[], Options& opt, rig::RigSet & rig) {
      "Stop when the relative error in the variables being optimized is less than this.")
     ("num-iterations",       po::value(&opt.num_iterations)->default_value(500),
      "Set the maximum number of iterations.")
+    ("checkpoint-interval", po::value(&opt.checkpoint_interval)->default_value(0),
+     "Save the state of the optimization every this many iterations, and at the end "
+     "of each pass, to <output prefix>-checkpoint.bin. Use with "
+     "--resume-from-checkpoint to continue an interrupted run.")
+    ("resume-from-checkpoint",
+     po::bool_switch(&opt.resume_from_checkpoint)->default_value(false)->implicit_value(true),
+     "Continue an interrupted run from the state saved with --checkpoint-interval. "
+     "All other options must be the same as for that run.")
     ("tri-weight", po::value(&opt.tri_weight)->default_value(0.1),
      "The weight to give to the constraint that optimized triangulated points stay "
       "close to original triangulated points. A positive value will help ensure the "
@@ -978,6 +987,53 @@ void saveCsmCameras(std::string const& out_prefix,
   
 }
 
+// Save the camera states, rig transforms, outliers, and the triangulated
+// points from the initial cameras, to be able to resume with
+// --resume-from-checkpoint. The pass is the one to resume at.
+void saveJitterCheckpoint(Options const& opt, int pass,
+                          std::vector<asp::CsmModel*> const& csm_models,
+                          std::vector<double> const& ref_to_curr_sensor_vec,
+                          std::vector<double> const& orig_tri_points_vec,
+                          std::set<int> const& outliers) {
+  asp::SolverCheckpoint cp;
+  cp.pass = pass;
+  for (size_t icam = 0; icam < csm_models.size(); icam++)
+    cp.strings.push_back(csm_models[icam]->model_state());
+  cp.param_blocks.push_back(ref_to_curr_sensor_vec);
+  cp.param_blocks.push_back(orig_tri_points_vec);
+  cp.outliers = outliers;
+  asp::writeCheckpoint(asp::checkpointFile(opt.out_prefix), cp);
+}
+
+// Restore the state saved by saveJitterCheckpoint(). Return the pass to resume at.
+int loadJitterCheckpoint(Options const& opt,
+                         std::vector<asp::CsmModel*> & csm_models,
+                         std::vector<double> & ref_to_curr_sensor_vec,
+                         std::vector<double> & orig_tri_points_vec,
+                         std::set<int> & outliers) {
+
+  std::string file = asp::checkpointFile(opt.out_prefix);
+  vw_out() << "Resuming from checkpoint: " << file << "\n";
+  asp::SolverCheckpoint cp;
+  asp::readCheckpoint(file, cp);
+
+  if (cp.strings.size() != csm_models.size() || cp.param_blocks.size() != 2 ||
+      cp.param_blocks[0].size() != ref_to_curr_sensor_vec.size())
+    vw_throw(ArgumentErr() << "The checkpoint " << file << " does not agree with "
+             << "the current problem. If the images or the matches changed, "
+             << "use instead --input-adjustments-prefix to start from the "
+             << "previous solution.\n");
+
+  bool recreate_model = true;
+  for (size_t icam = 0; icam < csm_models.size(); icam++)
+    csm_models[icam]->setModelFromStateString(cp.strings[icam], recreate_model);
+  ref_to_curr_sensor_vec = cp.param_blocks[0];
+  orig_tri_points_vec = cp.param_blocks[1];
+  outliers = cp.outliers;
+
+  return cp.pass;
+}
+
 // Run one pass of solving for jitter. At each pass the cameras we have so far
 // are used to triangulate the points and the DEM constraint is refreshed if
 // applicable, and then the cameras are optimized. More than one pass
@@ -1068,11 +1124,12 @@ void jitterSolvePass(int                                 pass,
                      pixel_vec, weight_vec, isAnchor_vec, pix2xyz_index,
                      local_orig_tri_points_vec, tri_points_vec);
   
-  // Save the original camera positions and triangulated points for the initial pass
-  if (pass == 0) {
+  // Save the original camera positions and triangulated points for the initial
+  // pass. When resuming from a checkpoint, these are set earlier.
+  if (orig_tri_points_vec.empty())
     orig_tri_points_vec = local_orig_tri_points_vec;
+  if (orig_cam_positions.empty())
     asp::calcCameraCenters(opt.camera_models, orig_cam_positions);
-  }
       
   // The above structures must not be resized anymore, as we will get pointers
   // to individual blocks within them.
@@ -1182,8 +1239,9 @@ void jitterSolvePass(int                                 pass,
                          // Outputs
                          frame_params, weight_per_residual, problem); // outputs
 
-  // Save residuals before optimization
-  if (pass == 0) {
+  // Save residuals before optimization. When resuming, these exist from the
+  // earlier run.
+  if (pass == 0 && !opt.resume_from_checkpoint) {
     std::string residual_prefix = opt.out_prefix + "-initial_residuals";
     saveJitterResiduals(problem, residual_prefix, opt, cnet, crn, opt.datum,
                    tri_points_vec, outliers, weight_per_residual,
@@ -1209,6 +1267,20 @@ void jitterSolvePass(int                                 pass,
   options.linear_solver_type  = ceres::ITERATIVE_SCHUR;
   options.preconditioner_type = ceres::SCHUR_JACOBI;
   options.use_explicit_schur_complement = false; // Only matters with ITERATIVE_SCHUR
+
+  // Save the state periodically, to be able to resume if interrupted. The
+  // frame cameras and rig sensors must be updated from the parameters first.
+  asp::CheckpointCallback checkpoint_callback(opt.checkpoint_interval, [&]() {
+    updateCameras(have_rig, rig, rig_cam_info,
+                  opt.cam2group, timestamp_map, ref_to_curr_sensor_vec,
+                  csm_models, frame_params);
+    saveJitterCheckpoint(opt, pass, csm_models, ref_to_curr_sensor_vec,
+                         orig_tri_points_vec, outliers);
+  });
+  if (opt.checkpoint_interval > 0) {
+    options.callbacks.push_back(&checkpoint_callback);
+    options.update_state_every_iteration = true;
+  }
   
   // Solve the problem
   vw_out() << "Starting the Ceres optimizer." << std::endl;
@@ -1440,14 +1512,29 @@ void run_jitter_solve(int argc, char* argv[]) {
   std::vector<vw::Vector3> orig_cam_positions;
   std::vector<double> orig_tri_points_vec;
   
+  // Resume from the checkpoint saved by an interrupted run. Record the
+  // original camera positions first.
+  int start_pass = 0;
+  if (opt.resume_from_checkpoint) {
+    asp::calcCameraCenters(opt.camera_models, orig_cam_positions);
+    start_pass = loadJitterCheckpoint(opt, csm_models, ref_to_curr_sensor_vec,
+                                      orig_tri_points_vec, outliers);
+    if (have_rig)
+      asp::updateRig(ref_to_curr_sensor_vec, rig);
+  }
+
   // Do this many passes
-  for (int pass = 0; pass < opt.num_passes; pass++)
+  for (int pass = start_pass; pass < opt.num_passes; pass++) {
     jitterSolvePass(pass, have_rig, opt, crn, rig_cam_info, 
                     timestamp_map,
                     // Outputs
                     cnet, outliers, csm_models,
                     orig_cam_positions, orig_tri_points_vec, rig, 
                     ref_to_curr_sensor_vec);
+    if (opt.checkpoint_interval > 0)
+      saveJitterCheckpoint(opt, pass + 1, csm_models, ref_to_curr_sensor_vec,
+                           orig_tri_points_vec, outliers);
+  }
   
   return;
 }
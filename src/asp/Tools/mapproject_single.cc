@@ -76,6 +76,17 @@ void handle_arguments(int argc, char *argv[], asp::MapprojOptions& opt) {
     ("ot",  po::value(&opt.output_type)->default_value("Float32"), "Output data type, when the input is single channel. Supported types: Byte, UInt16, Int16, UInt32, Int32, Float32. If the output type is a kind of integer, values are rounded and then clamped to the limits of that type. This option will be ignored for multi-channel images, when the output type is set to be the same as the input type.")
     ("nearest-neighbor", po::bool_switch(&opt.nearest_neighbor)->default_value(false),
      "Use nearest neighbor interpolation.  Useful for classification images.")
+    ("legacy-resample", po::bool_switch(&opt.legacy_resample)->default_value(false),
+     "For single-channel images, resample the input image with a per-pixel "
+     "interpolation view, rather than a tile at a time with a vectorized kernel. "
+     "The results agree to within float precision. Useful for comparisons.")
+    ("sparse-grid-tol", po::value(&opt.sparse_grid_tol)->default_value(0.0),
+     "If positive, project into the camera exactly only on a sparse grid in each "
+     "tile and interpolate in between, refining the grid where the interpolation "
+     "error exceeds this value, in pixels. A value of 0.01 is suggested. This "
+     "greatly reduces the number of camera projections for smooth terrain. "
+     "Applies to single-channel images, unless --legacy-resample or "
+     "--nearest-neighbor is used.")
     ("mo",  po::value(&opt.metadata)->default_value(""), "Write metadata to the output file. Provide as a string in quotes if more than one item, separated by a space, such as 'VAR1=VALUE1 VAR2=VALUE2'. Neither the variable names nor the values should contain spaces.")
     ("no-geoheader-info", po::bool_switch(&opt.noGeoHeaderInfo)->default_value(false),
      "Do not write metadata information in the geoheader. See the doc for more info.")
@@ -0,0 +1,165 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# __BEGIN_LICENSE__
+#  Copyright (c) 2009-2013, United States Government as represented by the
+#  Administrator of the National Aeronautics and Space Administration. All
+#  rights reserved.
+#
+#  The NGT platform is licensed under the Apache License, Version 2.0 (the
+#  "License"); you may not use this file except in compliance with the
+#  License. You may obtain a copy of the License at
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+# __END_LICENSE__
+
+'''
+Merge the trace files written by the stereo programs with the --trace
+option, for the whole run and for each tile, into <output prefix>-trace.json,
+which can be viewed in chrome://tracing or https://ui.perfetto.dev, and
+summarize them in <output prefix>-trace-report.txt. This is invoked by
+parallel_stereo when --trace is set, but can also be run by hand.
+
+Usage: merge_stereo_traces.py <output prefix> [num slowest tiles to list]
+'''
+
+from __future__ import print_function
+import sys, os, glob, json
+
+def find_traces(prefix):
+    '''The traces for the whole run and for the tiles in the subdirectories
+    prefix-*/, but not the merged trace.'''
+    merged = os.path.abspath(prefix + '-trace.json')
+    files = glob.glob(prefix + '-*-trace.json') + glob.glob(prefix + '-*/*-trace.json')
+    return sorted(set(f for f in files if os.path.abspath(f) != merged))
+
+def seconds(us):
+    return us / 1.0e6
+
+def merge(files, out_file):
+    '''Give each trace its own process id, as the same process can handle
+    several tiles, and concatenate the events.'''
+
+    events = []
+    traces = []
+    for count, f in enumerate(files):
+        try:
+            with open(f, 'r') as fh:
+                trace = json.load(fh)
+        except Exception as e:
+            print('Skipping invalid trace ' + f + ': ' + str(e))
+            continue
+
+        other = trace.get('otherData', {})
+        pid = count + 1
+        for e in trace.get('traceEvents', []):
+            e['pid'] = pid
+            events.append(e)
+        traces.append({'file': f, 'pid': pid, 'other': other,
+                       'events': [e for e in trace.get('traceEvents', [])
+                                  if e.get('ph') == 'X']})
+
+    with open(out_file, 'w') as fh:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, fh)
+    print('Wrote: ' + out_file)
+
+    return traces
+
+def report(traces, out_file, num_slowest):
+
+    # Totals per program and per function
+    progs = {}
+    funcs = {}
+    tiles = []
+    start = None
+    end = None
+    for t in traces:
+        prog = t['other'].get('program', 'unknown')
+        p = progs.setdefault(prog, {'traces': 0, 'read_mb': 0.0, 'written_mb': 0.0,
+                                    'peak_rss_mb': 0.0})
+        p['traces'] += 1
+        p['read_mb'] += t['other'].get('read_mb', 0.0)
+        p['written_mb'] += t['other'].get('written_mb', 0.0)
+        p['peak_rss_mb'] = max(p['peak_rss_mb'], t['other'].get('peak_rss_mb', 0.0))
+
+        for e in t['events']:
+            ts, dur = e.get('ts', 0), e.get('dur', 0)
+            start = ts if start is None else min(start, ts)
+            end = ts + dur if end is None else max(end, ts + dur)
+
+            args = e.get('args', {})
+            f = funcs.setdefault((prog, e['name']),
+                                 {'count': 0, 'total': 0, 'max': 0,
+                                  'read_mb': 0.0, 'written_mb': 0.0, 'peak_rss_mb': 0.0})
+            f['count'] += 1
+            f['total'] += dur
+            f['max'] = max(f['max'], dur)
+            f['read_mb'] += args.get('read_mb', 0.0)
+            f['written_mb'] += args.get('written_mb', 0.0)
+            f['peak_rss_mb'] = max(f['peak_rss_mb'], args.get('peak_rss_mb', 0.0))
+
+            if e['name'] == 'tile':
+                tiles.append((dur, prog, t['other'].get('out_prefix', t['file']),
+                              args.get('peak_rss_mb', 0.0)))
+
+    lines = []
+    lines.append('Traces: %d' % len(traces))
+    if start is not None:
+        lines.append('Elapsed time (first to last traced event): %.2f s'
+                     % seconds(end - start))
+    lines.append('')
+
+    lines.append('Per program. The I/O is for the whole process, including the page cache.')
+    lines.append('%-16s %8s %12s %12s %12s' % ('program', 'traces', 'read_mb',
+                                               'written_mb', 'peak_rss_mb'))
+    for prog in sorted(progs):
+        p = progs[prog]
+        lines.append('%-16s %8d %12.1f %12.1f %12.1f' % (prog, p['traces'], p['read_mb'],
+                                                         p['written_mb'], p['peak_rss_mb']))
+    lines.append('')
+
+    lines.append('Per function, slowest first. Nested and concurrent calls are counted '
+                 'separately, so the totals can exceed the elapsed time.')
+    lines.append('%-16s %-26s %8s %12s %10s %10s %12s %12s %12s'
+                 % ('program', 'function', 'count', 'total_s', 'mean_s', 'max_s',
+                    'read_mb', 'written_mb', 'peak_rss_mb'))
+    for key in sorted(funcs, key = lambda k: -funcs[k]['total']):
+        f = funcs[key]
+        lines.append('%-16s %-26s %8d %12.2f %10.2f %10.2f %12.1f %12.1f %12.1f'
+                     % (key[0], key[1], f['count'], seconds(f['total']),
+                        seconds(f['total']) / f['count'], seconds(f['max']),
+                        f['read_mb'], f['written_mb'], f['peak_rss_mb']))
+    lines.append('')
+
+    tiles.sort(reverse = True)
+    lines.append('Slowest tiles')
+    lines.append('%-16s %10s %12s  %s' % ('program', 'time_s', 'peak_rss_mb', 'tile'))
+    for dur, prog, tile, rss in tiles[0:num_slowest]:
+        lines.append('%-16s %10.2f %12.1f  %s' % (prog, seconds(dur), rss, tile))
+
+    with open(out_file, 'w') as fh:
+        fh.write('\n'.join(lines) + '\n')
+    print('Wrote: ' + out_file)
+
+if __name__ == '__main__':
+
+    if len(sys.argv) < 2:
+        print('Usage: ' + sys.argv[0] + ' <output prefix> [num slowest tiles to list]')
+        sys.exit(1)
+
+    prefix = sys.argv[1]
+    num_slowest = 10
+    if len(sys.argv) >= 3:
+        num_slowest = int(sys.argv[2])
+
+    files = find_traces(prefix)
+    if len(files) == 0:
+        print('No trace files found for prefix: ' + prefix)
+        sys.exit(1)
+
+    traces = merge(files, prefix + '-trace.json')
+    report(traces, prefix + '-trace-report.txt', num_slowest)
@@ -173,6 +173,10 @@ void handle_arguments(int argc, char *argv[], asp::SatSimOptions& opt,
      ("blur-sigma", po::value(&opt.blur_sigma)->default_value(0.0),
       "When creating images, blur them with a Gaussian with this sigma. The sigma is "
       "in input orthoimage pixel units.")
+     ("render-method", po::value(&opt.render_method)->default_value("raytrace"),
+      "How to create the images. Options: raytrace (intersect the ray through each "
+      "pixel with the DEM), zbuffer (project the DEM triangles into the camera, "
+      "keeping the closest surface at each pixel). The latter is much faster.")
      ("help,h", "Display this help message.")
     ;
   general_options.add(vw::GdalWriteOptionsDescription(opt));
@@ -228,6 +232,10 @@ void handle_arguments(int argc, char *argv[], asp::SatSimOptions& opt,
       vw::vw_throw(vw::ArgumentErr() << "The image size must be at least 2 x 2.\n");
   }
   
+  if (opt.render_method != "raytrace" && opt.render_method != "zbuffer")
+    vw::vw_throw(vw::ArgumentErr() << "The value of --render-method must be "
+                 << "raytrace or zbuffer.\n");
+
   if (opt.camera_list != "" && opt.no_images)
     vw::vw_throw(vw::ArgumentErr() << "The --camera-list and --no-images options "
       "cannot be used together.\n");
@@ -38,6 +38,8 @@
 #include <algorithm>
 
 #include <vw/FileIO/DiskImageManager.h>
+#include <vw/FileIO/DiskImageView.h>
+#include <vw/Image/Manipulation.h>
 #include <vw/Image/InpaintView.h>
 #include <vw/Image/Algorithms2.h>
 #include <vw/Image/Filter.h>
@@ -84,26 +86,26 @@ struct Options: vw::GdalWriteOptions {
              shadow_blend_length(0.0), min_blend_size(0.0) {}
 };
 
-// The workhorse of this code, do the blending
+// The workhorse of this code, do the blending. Each pixel has the
+// blended DEM value and the blending weight, so that both are found in
+// one pass.
 class SfsBlendView: public ImageViewBase<SfsBlendView>{
   
   ImageViewRef<float> m_sfs_dem, m_lola_dem, m_image_mosaic;
   float m_sfs_nodata, m_lola_nodata, m_weight_nodata;
   int m_extra;
-  bool m_save_weight;
   Options const& m_opt;
   
-  typedef float PixelT;
+  typedef Vector2f PixelT;
   
 public:
   SfsBlendView(ImageViewRef<float> sfs_dem, ImageViewRef<float> lola_dem,
                ImageViewRef<float> image_mosaic,
                float sfs_nodata, float lola_nodata, float weight_nodata, int extra,
-               bool save_weight, Options const& opt):
+               Options const& opt):
     m_sfs_dem(sfs_dem), m_lola_dem(lola_dem), m_image_mosaic(image_mosaic),
     m_sfs_nodata(sfs_nodata), m_lola_nodata(lola_nodata),
-    m_weight_nodata(weight_nodata), m_extra(extra),
-    m_save_weight(save_weight), m_opt(opt) {}
+    m_weight_nodata(weight_nodata), m_extra(extra), m_opt(opt) {}
 
   typedef PixelT pixel_type;
   typedef PixelT result_type;
@@ -128,16 +130,16 @@ public:
     biased_box.crop(bounding_box(m_sfs_dem));
 
     // Make crops in memory (from references)
-    ImageView<pixel_type> sfs_dem_crop = crop(m_sfs_dem, biased_box);
-    ImageView<pixel_type> lola_dem_crop = crop(m_lola_dem, biased_box);
-    ImageView<pixel_type> image_mosaic_crop = crop(m_image_mosaic, biased_box);
+    ImageView<float> sfs_dem_crop = crop(m_sfs_dem, biased_box);
+    ImageView<float> lola_dem_crop = crop(m_lola_dem, biased_box);
+    ImageView<float> image_mosaic_crop = crop(m_image_mosaic, biased_box);
 
     // The mask of lit pixels
-    ImageView< PixelMask<pixel_type> > mask = create_mask_less_or_equal(image_mosaic_crop,
-                                                                        m_opt.image_threshold);
+    ImageView< PixelMask<float> > mask = create_mask_less_or_equal(image_mosaic_crop,
+                                                                   m_opt.image_threshold);
     
     // The mask of unlit pixels
-    ImageView< PixelMask<pixel_type> > inv_mask = vw::copy(mask);
+    ImageView< PixelMask<float> > inv_mask = vw::copy(mask);
     for (int col = 0; col < inv_mask.cols(); col++) {
       for (int row = 0; row < inv_mask.rows(); row++) {
         if (is_valid(mask(col, row))) {
@@ -156,13 +158,13 @@ public:
 
     // Fill small holes that we don't blend in those, then compute the distance
     // to the remaining holes
-    ImageView<pixel_type> lit_grass_dist
+    ImageView<float> lit_grass_dist
       = vw::grassfire(vw::copy(vw::fill_holes_grass(mask, m_opt.min_blend_size)),
                       no_zero_at_border);
 
     // The grassfire weights are positive in the shadow region, with
     // zero at the light-shadow boundary
-    ImageView<pixel_type> shadow_grass_dist = vw::grassfire(inv_mask, no_zero_at_border);
+    ImageView<float> shadow_grass_dist = vw::grassfire(inv_mask, no_zero_at_border);
 
     // Find the clamped signed distance to the boundary. Note that our
     // boundary is in fact two pixel wide at the light-shadow
@@ -236,15 +238,12 @@ public:
       dist_to_bd = vw::gaussian_filter(dist_to_bd, m_opt.weight_blur_sigma);
 
     // Do the blending
-    ImageView<float> blended_dem;
+    ImageView<pixel_type> blended_dem;
     blended_dem.set_size(sfs_dem_crop.cols(), sfs_dem_crop.rows());
     for (int col = 0; col < sfs_dem_crop.cols(); col++) {
       for (int row = 0; row < sfs_dem_crop.rows(); row++) {
 
-        if (!m_save_weight)
-          blended_dem(col, row) = m_sfs_nodata;
-        else
-          blended_dem(col, row) = m_weight_nodata;
+        blended_dem(col, row) = pixel_type(m_sfs_nodata, m_weight_nodata);
 
         // The signed distance to the boundary is modified so that the smallest
         // value is 0, the largest is 1, and in a band close to the boundary it
@@ -265,11 +264,9 @@ public:
         if (lola_dem_crop(col, row) == m_lola_nodata) 
           continue;
 
-        if (!m_save_weight) 
-          blended_dem(col, row)
-            = weight * sfs_dem_crop(col, row) + (1.0 - weight) * lola_dem_crop(col, row);
-        else
-          blended_dem(col, row) = weight;
+        blended_dem(col, row)[0]
+          = weight * sfs_dem_crop(col, row) + (1.0 - weight) * lola_dem_crop(col, row);
+        blended_dem(col, row)[1] = weight;
       }
     }
     
@@ -560,33 +557,41 @@ int main(int argc, char *argv[]) {
     int block_size = 256 + 2 * extra;
     block_size = 16*ceil(block_size/16.0); // internal constraint
 
-    vw_out() << "Writing: " << opt.output_dem << std::endl;
-    bool has_georef = true, has_nodata = true;
+    // The DEM and weight are computed together, block by block, in
+    // parallel, and saved to a temporary file with big blocks. Then each
+    // is written with the usual block size. The memory usage depends only
+    // on the block size, not on the DEM size.
+    std::string tmp_file
+      = fs::path(opt.output_dem).replace_extension(".tmp.tif").string();
+    vw_out() << "Writing: " << tmp_file << std::endl;
+    bool has_georef = true, has_nodata = false;
     TerminalProgressCallback tpc("asp", ": ");
     float weight_nodata = -1.0;
-    bool save_weight = false;
-    asp::save_with_temp_big_blocks(block_size,
-                                   opt.output_dem,
-                                   SfsBlendView(sfs_dem, lola_dem, image_mosaic,
-                                                sfs_nodata, lola_nodata, weight_nodata,
-                                                extra, save_weight, opt),
-                                   has_georef, sfs_georef,
-                                   has_nodata, sfs_nodata, opt, tpc);
-
-    // Write the weight. Have to rerun the same logic due to ASP's limitations,
-    // it cannot write two large files at the same time.
+    Vector2 orig_block_size = opt.raster_tile_size;
+    opt.raster_tile_size = Vector2(block_size, block_size);
+    block_write_gdal_image(tmp_file,
+                           SfsBlendView(sfs_dem, lola_dem, image_mosaic,
+                                        sfs_nodata, lola_nodata, weight_nodata,
+                                        extra, opt),
+                           has_georef, sfs_georef,
+                           has_nodata, sfs_nodata, opt, tpc);
+    opt.raster_tile_size = orig_block_size;
+
+    DiskImageView<Vector2f> blended(tmp_file);
+    has_nodata = true;
+    vw_out() << "Writing: " << opt.output_dem << std::endl;
+    block_write_gdal_image(opt.output_dem, select_channel(blended, 0),
+                           has_georef, sfs_georef,
+                           has_nodata, sfs_nodata, opt, tpc);
+
     vw_out() << "Writing the blending weight: "
              << opt.output_weight << std::endl;
-    save_weight = true;
-    asp::save_with_temp_big_blocks(block_size,
-                                   opt.output_weight,
-                                   SfsBlendView(sfs_dem, lola_dem, image_mosaic,
-                                                sfs_nodata, lola_nodata, weight_nodata,
-                                                extra, save_weight, opt),
-                                   has_georef, sfs_georef,
-                                   has_nodata, weight_nodata, opt, tpc);
-    
-    
+    block_write_gdal_image(opt.output_weight, select_channel(blended, 1),
+                           has_georef, sfs_georef,
+                           has_nodata, weight_nodata, opt, tpc);
+
+    fs::remove(tmp_file);
+
   } ASP_STANDARD_CATCHES;
 
   return 0;
@@ -21,6 +21,7 @@
 #include <asp/Core/Bathymetry.h>
 #include <asp/Sessions/StereoSessionFactory.h>
 #include <asp/Core/AspStringUtils.h>
+#include <asp/Core/Tracing.h>
 #include <asp/Camera/CameraErrorPropagation.h>
 
 #include <vw/Cartography/PointImageManipulation.h>
@@ -31,6 +32,7 @@
 #include <vw/Stereo/DisparityMap.h>
 #include <vw/FileIO/MatrixIO.h>
 #include <vw/FileIO/DiskImageUtils.h>
+#include <vw/Core/Stopwatch.h>
 
 // Can't do much about warnings in boost except to hide them
 #pragma GCC diagnostic push
@@ -39,6 +41,9 @@
 #include <boost/accumulators/statistics.hpp>
 #pragma GCC diagnostic pop
 
+#include <fstream>
+#include <sstream>
+
 using namespace vw;
 using namespace vw::cartography;
 
@@ -327,6 +332,9 @@ void parse_multiview(int argc, char* argv[],
   // Need this for the GUI, ensure that opt_vec is never empty, even on failures
   opt_vec.push_back(opt);
 
+  if (stereo_settings().trace)
+    asp::startTracing(fs::path(argv[0]).filename().string());
+
   if (files.size() < 3)
     vw_throw(ArgumentErr() << "Missing the input files and/or output prefix.\n");
 
@@ -1067,6 +1075,11 @@ void user_safety_checks(ASPGlobalOptions const& opt) {
   if (!std::isnan(stereo_settings().nodata_value) && stereo_settings().nodata_value < 0) 
      vw::vw_throw(vw::ArgumentErr() << "The value of nodata must be non-negative.\n");
 
+  if (stereo_settings().propagate_errors_method != "analytic" &&
+      stereo_settings().propagate_errors_method != "numerical")
+    vw::vw_throw(vw::ArgumentErr() << "The value of --propagate-errors-method must be "
+                  << "analytic or numerical.\n");
+
   if (stereo_settings().propagate_errors && stereo_settings().compute_error_vector) 
     vw::vw_throw(vw::ArgumentErr() << "Cannot use option --error-vector for computing "
                   << "the triangulation error vector when propagating errors (covariances) "
@@ -1198,5 +1211,96 @@ vw::stereo::CorrelationAlgorithm stereo_alg_to_num(std::string alg) {
   return vw::stereo::VW_CORRELATION_OTHER;
 }
 
+void read_tile_list(std::string const& tile_list, std::vector<TileJob> & jobs) {
+
+  jobs.clear();
+  std::ifstream ifs(tile_list.c_str());
+  if (!ifs.good())
+    vw_throw(ArgumentErr() << "Cannot open tile list: " << tile_list << "\n");
+
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream is(line);
+    TileJob job;
+    int xoff = 0, yoff = 0, xsize = 0, ysize = 0;
+    if (!(is >> job.out_prefix))
+      continue; // empty line
+    if (!(is >> xoff >> yoff >> xsize >> ysize))
+      vw_throw(ArgumentErr() << "Invalid line in tile list " << tile_list << ": "
+               << line << "\n");
+    job.crop_win = BBox2i(xoff, yoff, xsize, ysize);
+    job.corr_tile_size = 0;
+    if (!(is >> job.corr_tile_size))
+      job.corr_tile_size = 0;
+    jobs.push_back(job);
+  }
+}
+
+void run_tiles(ASPGlobalOptions const& opt,
+               std::function<void(ASPGlobalOptions &)> step) {
+
+  if (stereo_settings().tile_list.empty()) {
+    ASPGlobalOptions curr_opt = opt;
+    {
+      asp::ScopedTrace trace("tile");
+      step(curr_opt);
+    }
+    asp::saveTrace(curr_opt.out_prefix);
+    return;
+  }
+
+  std::vector<TileJob> jobs;
+  read_tile_list(stereo_settings().tile_list, jobs);
+  vw_out() << "Processing " << jobs.size() << " tiles from: "
+           << stereo_settings().tile_list << "\n";
+
+  // Tiles are relative to L.tif, which is shared by all tiles via symlinks
+  BBox2i L_box;
+  if (fs::exists(opt.out_prefix + "-L.tif"))
+    L_box = bounding_box(DiskImageView<PixelGray<float>>(opt.out_prefix + "-L.tif"));
+
+  // The steps modify the settings as they go, for example the search range
+  // and seed mode in correlation. Each tile must start from the same state.
+  StereoSettings orig_settings = stereo_settings();
+
+  for (size_t it = 0; it < jobs.size(); it++) {
+    vw::Stopwatch sw;
+    sw.start();
+    stereo_settings() = orig_settings;
+
+    // The session keeps pointing to the prefix of the first tile, and the
+    // files it reads are the same for all tiles.
+    ASPGlobalOptions curr_opt = opt;
+    curr_opt.out_prefix = jobs[it].out_prefix;
+    vw::create_out_dir(curr_opt.out_prefix);
+
+    BBox2i crop_win = jobs[it].crop_win;
+    if (!L_box.empty())
+      crop_win.crop(L_box);
+    if (crop_win.width() <= 0 || crop_win.height() <= 0) {
+      vw_out() << "Skipping empty tile: " << curr_opt.out_prefix << "\n";
+      continue;
+    }
+    stereo_settings().trans_crop_win = crop_win;
+    if (jobs[it].corr_tile_size > 0)
+      stereo_settings().corr_tile_size_ovr = jobs[it].corr_tile_size;
+
+    vw_out() << "Tile " << it + 1 << " of " << jobs.size() << ": "
+             << curr_opt.out_prefix << ", " << crop_win << "\n";
+    {
+      asp::ScopedTrace trace("tile");
+      step(curr_opt);
+    }
+    // One trace per tile, saved next to the other outputs of the tile
+    asp::saveTrace(curr_opt.out_prefix);
+
+    sw.stop();
+    vw_out() << "Tile " << curr_opt.out_prefix << " took " << sw.elapsed_seconds()
+             << " seconds.\n";
+  }
+
+  stereo_settings() = orig_settings;
+}
+
 } // end namespace asp
 
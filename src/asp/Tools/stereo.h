@@ -46,6 +46,8 @@
 #include <ctime>
 #endif
 
+#include <functional>
+
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
@@ -91,6 +93,24 @@ namespace asp {
 
   bool skip_image_normalization(ASPGlobalOptions const& opt);
 
+  /// A tile to process as part of a --tile-list run.
+  struct TileJob {
+    std::string out_prefix;
+    vw::BBox2i  crop_win;
+    int         corr_tile_size; // 0 if not set
+  };
+
+  /// Read the file passed in via --tile-list.
+  void read_tile_list(std::string const& tile_list, std::vector<TileJob> & jobs);
+
+  /// Run a stereo step for each tile listed in the file passed in via
+  /// --tile-list, reusing the parsed options, the session and the loaded
+  /// cameras. This way, parallel_stereo can process many tiles in one process.
+  /// If there is no tile list, run the step once, for the current tile. Each
+  /// tile starts with the stereo settings as they were before the first one.
+  void run_tiles(ASPGlobalOptions const& opt,
+                 std::function<void(ASPGlobalOptions &)> step);
+
   // Convert, for example, 'asp_mgm' to '2'. For ASP algorithms we
   // use the numbers 0 (BM), 1 (SGM), 2 (MGM), 3 (Final MGM).  For
   // external algorithms will have to examine closer the algorithm
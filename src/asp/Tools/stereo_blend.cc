@@ -35,10 +35,13 @@
 // blend the results.
 
 #include <vw/Image/ImageMath.h>
+#include <vw/Image/PerPixelViews.h>
+#include <vw/FileIO/DiskImageView.h>
 #include <vw/FileIO/DiskImageUtils.h>
 
 #include <vw/Stereo/DisparityMap.h>
 #include <asp/Tools/stereo.h>
+#include <asp/Core/Tracing.h>
 #include <boost/filesystem.hpp>
 
 using namespace vw;
@@ -52,6 +55,9 @@ typedef PixelMask<Vector2f> MaskedPixType;
 // Every tile has 8 neighbors
 const int NUM_NEIGHBORS = 8;
 
+// The size of the blocks in which the tiles are read
+const int BLEND_BLOCK_SIZE = 1024;
+
 // Enum for the tiles. We count later on on the fact that the
 // neighbors have indices in [0, 7]. TILE_M is the main tile and the
 // others are its neighbors.
@@ -84,16 +90,77 @@ BBox2i bbox_from_folder(std::string const& s, std::string const& in_file) {
   return BBox2i(x, y, width, height);
 }
 
-// Load an image and form its weights
-bool load_image_and_weights(std::string const& file_path,
-                            ImageView<MaskedPixType> & image, WeightsType & weights,
-                            int & num_channels, bool & has_nodata, float& nodata_value) {
+// Convert a float pixel to a disparity with both components equal to it,
+// which is invalid at the no-data value. It is simpler to do it this way
+// than to write some template-based logic.
+struct FloatToDisp: public ReturnFixedType<MaskedPixType> {
+  float m_nodata;
+  FloatToDisp(float nodata): m_nodata(nodata) {}
+  MaskedPixType operator()(float val) const {
+    if (val != m_nodata)
+      return MaskedPixType(vw::Vector2f(val, val));
+    MaskedPixType pix(vw::Vector2f(0, 0));
+    pix.invalidate();
+    return pix;
+  }
+};
+
+// Convert a blended disparity back to a float pixel with a no-data value
+struct DispToFloat: public ReturnFixedType<float> {
+  float m_nodata;
+  DispToFloat(float nodata): m_nodata(nodata) {}
+  float operator()(MaskedPixType const& pix) const {
+    if (is_valid(pix))
+      return pix.child()[0];
+    return m_nodata;
+  }
+};
+
+// The weight along a row or column, given the first and last valid pixel
+// in it. It is largest in the middle and decreases to almost 0 at the ends.
+inline double line_weight(int pos, int min_val, int max_val) {
+  double max_dist = std::max(max_val - min_val, 0)/2.0;
+  double center   = (min_val + max_val)/2.0;
+  double dist     = fabs(pos - center);
+  if (max_dist <= 0)
+    return 0.0;
+
+  // Make sure the weight is positive (even if small) at the first/last valid pixel
+  double tol = 1e-8*max_dist;
+  return std::max(0.0, (max_dist - dist + tol)/max_dist);
+}
+
+// A tile to blend. It is read from disk a block at a time. The centerline
+// weights depend only on the first and last valid pixel in each row and
+// column, so these are found in one pass over the tile. The weight at any
+// pixel is then the same as what vw::centerline_weights() finds for the
+// whole tile, without keeping the tile or its weights in memory.
+struct BlendTile {
+  ImageViewRef<MaskedPixType> image;
+  BBox2i padded_box; // where the tile is in the full image
+  std::vector<int> min_col_in_row, max_col_in_row, min_row_in_col, max_row_in_col;
+
+  // The weight at a valid pixel, in the tile coordinates
+  double weight(int col, int row) const {
+    return line_weight(col, min_col_in_row[row], max_col_in_row[row]) *
+           line_weight(row, min_row_in_col[col], max_row_in_col[col]);
+  }
+};
+
+// Open a tile and find the extent of its valid pixels. Also find if it has
+// valid pixels in check_box, which is in the tile coordinates.
+bool load_tile(std::string const& file_path, BBox2i const& padded_box,
+               BBox2i const& check_box,
+               // Outputs
+               BlendTile & tile, bool & has_valid_in_box,
+               int & num_channels, bool & has_nodata, float& nodata_value) {
 
   // Initialize the outputs to something
   num_channels = 1;
   has_nodata = false;
   nodata_value = -32768.0;
-  
+  has_valid_in_box = false;
+
   // Verify image exists
   if (file_path == "")
     return false;
@@ -122,46 +189,50 @@ bool load_image_and_weights(std::string const& file_path,
                << "expecting to have a no-data value in order to keep track of invalid pixels.");
     }
   }
-  
-  // Load the image from disk
+
   if (num_channels == 3) {
-    // Load a disparity
-    image = DiskImageView<MaskedPixType>(file_path);
+    // A disparity
+    tile.image = DiskImageView<MaskedPixType>(file_path);
   } else if (num_channels == 1) {
-    // Load a float image with a nodata value, and create a disparity. It is simpler
-    // to do it this way than to write some template-based logic.
-    ImageView<float> curr_image = DiskImageView<float>(file_path);
-    image.set_size(curr_image.cols(), curr_image.rows());
-    for (int col = 0; col < curr_image.cols(); col++) {
-      for (int row = 0; row < curr_image.rows(); row++) {
-        float val = curr_image(col, row);
-        if (val != nodata_value) {
-          image(col, row) = MaskedPixType(vw::Vector2f(val, val)); 
-          image(col, row).validate();
-        } else{
-          image(col, row) = MaskedPixType(vw::Vector2f(0, 0)); 
-          image(col, row).invalidate();
-        }
-      } 
-    }
+    // A float image with a nodata value
+    tile.image = per_pixel_filter(DiskImageView<float>(file_path), FloatToDisp(nodata_value));
   } else {
     vw_throw(ArgumentErr() << "stereo_blend: Expecting an image with 1 or 3 bands, but "
              << "image " << file_path << " has " << num_channels << " channels.\n");
   }
-  
-  // Compute the desired weights. Strictly speaking we need to compute the weights
-  // only on the portion of the image that we will use for blending, but weights
-  // computation is a cheap operation comparing to I/O time.
-  centerline_weights(image, weights);
-
-#if 0
-  // For debugging
-  std::string weights_file = file_path + "_weight.tif";
-  
-  vw_out() << "Writing: " << weights_file << std::endl;
-  write_image(weights_file, weights);
-#endif
-  
+  tile.padded_box = padded_box;
+
+  int num_cols = tile.image.cols(), num_rows = tile.image.rows();
+  tile.min_col_in_row.assign(num_rows, num_cols);
+  tile.max_col_in_row.assign(num_rows, 0);
+  tile.min_row_in_col.assign(num_cols, num_rows);
+  tile.max_row_in_col.assign(num_cols, 0);
+
+  // Go over the tile a block at a time, so that the memory usage does not
+  // depend on the tile size.
+  std::vector<BBox2i> blocks = subdivide_bbox(bounding_box(tile.image),
+                                               BLEND_BLOCK_SIZE, BLEND_BLOCK_SIZE);
+  for (size_t b = 0; b < blocks.size(); b++) {
+    BBox2i const& box = blocks[b];
+    ImageView<MaskedPixType> block = crop(tile.image, box);
+    for (int col = box.min().x(); col < box.max().x(); col++) {
+      for (int row = box.min().y(); row < box.max().y(); row++) {
+
+        if (!is_valid(block(col - box.min().x(), row - box.min().y())))
+          continue;
+
+        // Record the first and last valid column in each row, and vice versa
+        tile.min_col_in_row[row] = std::min(tile.min_col_in_row[row], col);
+        tile.max_col_in_row[row] = std::max(tile.max_col_in_row[row], col);
+        tile.min_row_in_col[col] = std::min(tile.min_row_in_col[col], row);
+        tile.max_row_in_col[col] = std::max(tile.max_row_in_col[col], row);
+
+        if (check_box.contains(Vector2i(col, row)))
+          has_valid_in_box = true;
+      }
+    }
+  }
+
   return true;
 }
 
@@ -306,157 +377,130 @@ void fill_blend_options(ASPGlobalOptions const& opt, std::string const& in_file,
 
 }
 
-// See if a given image has only invalid pixels
-bool invalid_image(ImageView<MaskedPixType> const& image) {
-  for (int col = 0; col < image.cols(); col++) {
-    for (int row = 0; row < image.rows(); row++) {
-      if (is_valid(image(col, row))) {
-        // Found a valid pixel
-        return false;
-      }
-    }
+/// Blend the borders of the main tile using the neighboring tiles, one
+/// block at a time. The blocks of the tiles are read as needed. While all
+/// the tiles have padding, the blended main tile is without padding.
+/// The main tile is the first in the list.
+class TileBlendView: public ImageViewBase<TileBlendView> {
+  BBox2i m_main_roi;
+  std::vector<BlendTile> m_tiles;
+  bool m_all_invalid;
+
+public:
+  TileBlendView(BBox2i const& main_roi, std::vector<BlendTile> const& tiles,
+                bool all_invalid):
+    m_main_roi(main_roi), m_tiles(tiles), m_all_invalid(all_invalid) {}
+
+  typedef MaskedPixType pixel_type;
+  typedef MaskedPixType result_type;
+  typedef ProceduralPixelAccessor<TileBlendView> pixel_accessor;
+
+  inline int32 cols() const { return m_main_roi.width(); }
+  inline int32 rows() const { return m_main_roi.height(); }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor(*this, 0, 0); }
+
+  inline pixel_type operator()(double/*i*/, double/*j*/, int32/*p*/ = 0) const {
+    vw_throw(NoImplErr() << "TileBlendView::operator()(...) is not implemented");
+    return pixel_type();
   }
 
-  return true;
-}
-
-/// Blend the borders of the main tile using the neighboring
-/// tiles.
-/// While all the main tile and neighbor tiles have padding, we will save
-/// the blended main tile without padding.
-
-ImageView<MaskedPixType> tile_blend(ASPGlobalOptions const& opt,
-                                    BlendOptions & blend_opt,
-                                    // These will change
-                                    int & num_channels, bool & has_nodata, float & nodata_value) {
-
-  // Initialize the outputs to something
-  num_channels = 1;
-  has_nodata = false;
-  nodata_value = -32768.0;
+  typedef CropView<ImageView<pixel_type>> prerasterize_type;
+  inline prerasterize_type prerasterize(BBox2i const& bbox) const {
 
-  // Start the output image as invalid and zero. It will be used to
-  // accumulate the weighted disparities.
-  ImageView<MaskedPixType> output_image(blend_opt.main_roi.width(), blend_opt.main_roi.height()); 
-  for (int col = 0; col < output_image.cols(); col++) {
-    for (int row = 0; row < output_image.rows(); row++) {
-      output_image(col, row) = MaskedPixType(); 
-      output_image(col, row).invalidate();
+    // Start the output image as invalid and zero. It will be used to
+    // accumulate the weighted disparities.
+    ImageView<MaskedPixType> output_image(bbox.width(), bbox.height());
+    for (int col = 0; col < output_image.cols(); col++) {
+      for (int row = 0; row < output_image.rows(); row++) {
+        output_image(col, row) = MaskedPixType();
+        output_image(col, row).invalidate();
+      }
     }
-  }
-  
-  // Accumulate here the weights
-  WeightsType output_weights(blend_opt.main_roi.width(), blend_opt.main_roi.height());
-  for (int col = 0; col < output_weights.cols(); col++) {
-    for (int row = 0; row < output_weights.rows(); row++) {
-      output_weights(col, row) = 0.0; 
+
+    // Accumulate here the weights
+    WeightsType output_weights(bbox.width(), bbox.height());
+    for (int col = 0; col < output_weights.cols(); col++) {
+      for (int row = 0; row < output_weights.rows(); row++) {
+        output_weights(col, row) = 0.0;
+      }
     }
-  }
 
-  // Add the contribution from the main tile and neighboring tiles. Note
-  // that i = -1 corresponds to the main tile.
-  for (int i = -1; i < NUM_NEIGHBORS; i++) {
+    // If there are no valid pixels in the main tile without its padding,
+    // return an invalid blended tile.
+    if (m_all_invalid)
+      return prerasterize_type(output_image, -bbox.min().x(), -bbox.min().y(),
+                               cols(), rows());
+
+    // Add the contribution from the main tile and neighboring tiles
+    for (size_t i = 0; i < m_tiles.size(); i++) {
+      BlendTile const& tile = m_tiles[i];
+
+      // The current block in the coordinate system of the padded tile.
+      // Padded tiles can overlap only partially with the central region
+      // of the main tile. If not in the overlap region, skip the work.
+      Vector2i shift = m_main_roi.min() - tile.padded_box.min();
+      BBox2i tile_box = bbox + shift;
+      tile_box.crop(bounding_box(tile.image));
+      if (tile_box.empty())
+        continue;
 
-    ImageView<MaskedPixType> image;
-    WeightsType weights;
-    BBox2i padded_box;
-    
-    if (i == -1) {
-      // Main tile
-      // The main tile better exist
-      int curr_num_channels = 1;
-      bool curr_has_nodata = false;
-      float curr_nodata_value = -32768.0;
-      bool ans = load_image_and_weights(blend_opt.main_path, image, weights,
-                                        curr_num_channels, curr_has_nodata, curr_nodata_value);
-      if (!ans) 
-        vw_throw(ArgumentErr() << "stereo_blend: main tile is missing.");
-
-      // Since the image was loaded successfully, copy its other info
-      num_channels = curr_num_channels;
-      has_nodata   = curr_has_nodata;
-      nodata_value = curr_nodata_value;
-
-      padded_box = blend_opt.padded_main;
-      
-      // If there are no valid pixels in the main tile without its padding,
-      // return an invalid blended tile.
-      if (invalid_image(crop(image, blend_opt.main_roi - blend_opt.padded_main.min())))
-        return output_image;
-      
-    } else {
-      // A neighboring tile
-      int curr_num_channels = 1;
-      bool curr_has_nodata = false;
-      float curr_nodata_value = -32768.0;
-      bool ans = load_image_and_weights(blend_opt.neib_path[i], image, weights,
-                                        curr_num_channels, curr_has_nodata, curr_nodata_value);
-      if (!ans)
-        continue; // Nothing to blend
-
-      // Since the image was loaded successfully, copy its other info. Note we assume
-      // all inputs are consistent.
-      num_channels = curr_num_channels;
-      has_nodata   = curr_has_nodata;
-      nodata_value = curr_nodata_value;
-
-      padded_box = blend_opt.padded_neib[i];
+      ImageView<MaskedPixType> image = crop(tile.image, tile_box);
+      for (int col = tile_box.min().x(); col < tile_box.max().x(); col++) {
+        for (int row = tile_box.min().y(); row < tile_box.max().y(); row++) {
+
+          MaskedPixType const& pix = image(col - tile_box.min().x(), row - tile_box.min().y());
+          if (!is_valid(pix))
+            continue; // No useful info
+          double weight = tile.weight(col, row);
+          if (weight <= 0.0)
+            continue;
+
+          // Convert the pixel to the coordinate system of the output block
+          int out_col = col - shift.x() - bbox.min().x();
+          int out_row = row - shift.y() - bbox.min().y();
+          output_image(out_col, out_row).validate();
+          output_image(out_col, out_row)   += weight * pix;
+          output_weights(out_col, out_row) += weight;
+        }
+      }
     }
 
-    // Do the blending, either with the main or neighboring tiles
+    // Normalize
     for (int col = 0; col < output_image.cols(); col++) {
       for (int row = 0; row < output_image.rows(); row++) {
 
-        // Convert the given pixel to the coordinate system of the full image
-        Vector2 pix = Vector2(col, row) + blend_opt.main_roi.min();
-
-        // Convert the pixel to the coordinate system of the current padded tile
-        pix = pix - padded_box.min();
-
-        // Padded tiles can overlap only partially with the central region of the main
-        // tile. If not in the overlap region, skip the work.
-        if (!vw::bounding_box(image).contains(pix)) 
+        if (!is_valid(output_image(col, row)))
           continue;
 
-        if (!is_valid(image(pix[0], pix[1])) || weights(pix[0], pix[1]) <= 0.0) 
-          continue; // No useful info
+        if (output_weights(col, row) <= 0) {
+          output_image(col, row).invalidate();
+          continue;
+        }
 
-        output_image(col, row).validate();
-        output_image(col, row)   += weights(pix[0], pix[1]) * image(pix[0], pix[1]);
-        output_weights(col, row) += weights(pix[0], pix[1]);
+        output_image(col, row) /= output_weights(col, row);
       }
     }
+
+    return prerasterize_type(output_image, -bbox.min().x(), -bbox.min().y(),
+                             cols(), rows());
   }
-  
-  // Normalize
-  for (int col = 0; col < output_image.cols(); col++) {
-    for (int row = 0; row < output_image.rows(); row++) {
-      
-      if (!is_valid(output_image(col, row)))
-        continue;
-      
-      if (output_weights(col, row) <= 0) {
-        output_image(col, row).invalidate();
-        continue;
-      }
-      
-      output_image(col, row) /= output_weights(col, row);
-    }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
   }
-  
-  return output_image;
-}
+};
 
 void stereo_blending(ASPGlobalOptions const& opt, std::string const& in_file,
                      std::string const& out_file) {
 
+  asp::ScopedTrace trace("stereo_blending");
+
   BlendOptions blend_opt;
   fill_blend_options(opt, in_file, blend_opt);
 
-  // Since this tool is only for follow-up processing of SGM results
-  // in parallel_stereo, it can be safely assumed that the input
-  // images are small enough to load entirely into memory.
-
   cartography::GeoReference left_georef;
   std::string left_image = opt.out_prefix + "-L.tif";
   bool   has_left_georef = read_georeference(left_georef, left_image);
@@ -464,9 +508,29 @@ void stereo_blending(ASPGlobalOptions const& opt, std::string const& in_file,
   bool has_nodata        = false;
   float nodata           = -32768.0;
 
-  ImageView<MaskedPixType> blended_disp = tile_blend(opt, blend_opt,
-                                                     // These will change
-                                                     num_channels, has_nodata, nodata);
+  // The main tile better exist. Find if it has valid pixels without its padding.
+  std::vector<BlendTile> tiles;
+  BlendTile tile;
+  bool main_has_valid = false;
+  bool ans = load_tile(blend_opt.main_path, blend_opt.padded_main,
+                       blend_opt.main_roi - blend_opt.padded_main.min(),
+                       tile, main_has_valid, num_channels, has_nodata, nodata);
+  if (!ans)
+    vw_throw(ArgumentErr() << "stereo_blend: main tile is missing.");
+  tiles.push_back(tile);
+
+  // Add the neighboring tiles, if there is anything to blend. Note we
+  // assume all inputs are consistent.
+  for (int i = 0; i < NUM_NEIGHBORS && main_has_valid; i++) {
+    int curr_num_channels = 1;
+    bool curr_has_nodata = false, has_valid = false;
+    float curr_nodata_value = -32768.0;
+    ans = load_tile(blend_opt.neib_path[i], blend_opt.padded_neib[i], BBox2i(),
+                    tile, has_valid, curr_num_channels, curr_has_nodata, curr_nodata_value);
+    if (!ans)
+      continue; // Nothing to blend
+    tiles.push_back(tile);
+  }
 
   // Sanity check
   if (num_channels == 1 && !has_nodata) {
@@ -474,6 +538,10 @@ void stereo_blending(ASPGlobalOptions const& opt, std::string const& in_file,
              << "expecting to have a no-data value in order to keep track of invalid pixels.");
   }
 
+  // The blending is done block by block as the output is written, in
+  // parallel, so the memory usage does not depend on the tile size.
+  TileBlendView blended_disp(blend_opt.main_roi, tiles, !main_has_valid);
+
   std::string full_out_file = opt.out_prefix + "-" + out_file;
   vw_out() << "Writing: " << full_out_file << "\n";
   if (num_channels == 3) {
@@ -484,16 +552,8 @@ void stereo_blending(ASPGlobalOptions const& opt, std::string const& in_file,
                                             TerminalProgressCallback("asp", "\t--> Blending :"));
   } else if (num_channels == 1) {
     // Write a single-channel image with no-data
-    ImageView<float> image(blended_disp.cols(), blended_disp.rows());
-    for (int col = 0; col < image.cols(); col++) {
-      for (int row = 0; row < image.rows(); row++) {
-        if (is_valid(blended_disp(col, row))) 
-          image(col, row) = blended_disp(col, row).child()[0];
-        else
-          image(col, row) = nodata;
-      }
-    }
-    vw::cartography::block_write_gdal_image(full_out_file, image,
+    vw::cartography::block_write_gdal_image(full_out_file,
+                                            per_pixel_filter(blended_disp, DispToFloat(nodata)),
                                             has_left_georef, left_georef,
                                             has_nodata, nodata, opt,
                                             TerminalProgressCallback("asp", "\t--> Blending:"));
@@ -520,23 +580,25 @@ int main(int argc, char* argv[]) {
     int ts = ASPGlobalOptions::rfne_tile_size();
     opt.raster_tile_size = Vector2i(ts, ts);
 
-    // This tool is only intended to run as part of parallel_stereo, which
-    //  renames the normal -D.tif file to -Dnosym.tif.
-    std::string in_file =  "Dnosym.tif";
+    asp::run_tiles(opt, [](ASPGlobalOptions & curr_opt) {
+      // This tool is only intended to run as part of parallel_stereo, which
+      //  renames the normal -D.tif file to -Dnosym.tif.
+      std::string in_file =  "Dnosym.tif";
 
-    string out_file = "B.tif";
-    if (stereo_settings().subpixel_mode > 6){
-      // No further subpixel refinement, skip to the -RD output.
-      out_file = "RD.tif";
-    }
-    stereo_blending(opt, in_file, out_file);
+      string out_file = "B.tif";
+      if (stereo_settings().subpixel_mode > 6){
+        // No further subpixel refinement, skip to the -RD output.
+        out_file = "RD.tif";
+      }
+      stereo_blending(curr_opt, in_file, out_file);
 
-    // See if to also blend L-R disp differences
-    if (stereo_settings().save_lr_disp_diff) {
-      in_file  = "L-R-disp-diff.tif";
-      out_file = "L-R-disp-diff-blend.tif";
-      stereo_blending(opt, in_file, out_file);
-    }
+      // See if to also blend L-R disp differences
+      if (stereo_settings().save_lr_disp_diff) {
+        in_file  = "L-R-disp-diff.tif";
+        out_file = "L-R-disp-diff-blend.tif";
+        stereo_blending(curr_opt, in_file, out_file);
+      }
+    });
     
     vw_out() << "\n[ " << current_posix_time_string() << " ]: BLENDING FINISHED\n";
 
@@ -30,6 +30,7 @@
 #include <asp/Core/InterestPointMatching.h>
 #include <asp/Core/IpMatchingAlgs.h>         // Lightweight header
 #include <asp/Core/LocalAlignment.h>
+#include <asp/Core/Tracing.h>
 #include <asp/Sessions/StereoSession.h>
 #include <asp/Tools/stereo.h>
 
@@ -112,6 +113,8 @@ void read_search_range_from_D_sub(std::string const& d_sub_file,
 /// Produces the low-resolution disparity file D_sub
 void produce_lowres_disparity(ASPGlobalOptions & opt) {
 
+  asp::ScopedTrace trace("produce_lowres_disparity");
+
   // Set up handles to read the input images
   DiskImageView<vw::uint8> Lmask(opt.out_prefix + "-lMask.tif"),
     Rmask(opt.out_prefix + "-rMask.tif");
@@ -608,6 +611,58 @@ void lowres_correlation(ASPGlobalOptions & opt) {
            << " ]: LOW-RESOLUTION CORRELATION FINISHED\n";
 } // End lowres_correlation
 
+/// Estimate the memory, in MB, used by the SGM/MGM cost buffers for the given
+/// full-resolution tile. SGM searches at each pixel only around the
+/// disparity found at the previous pyramid level, padded by
+/// --sgm-search-buffer, so the number of disparities varies per pixel. Here
+/// the low-resolution disparity stands in for the previous level, and its
+/// variation in a 3x3 neighborhood is used. Pixels without a valid seed
+/// use the full search range. Both the pixel costs and the accumulated
+/// costs are stored as 16-bit values.
+double estimate_sgm_memory_mb(DispImageRef const& sub_disp,
+                              Vector2 const& upscale_factor,
+                              BBox2i const& bbox,
+                              BBox2 const& search_range,
+                              Vector2i const& sgm_search_buffer) {
+
+  double full_range = (search_range.width() + 1.0) * (search_range.height() + 1.0);
+  double num_disp = 0.0;
+  if (sub_disp.cols() == 0 || sub_disp.rows() == 0) {
+    num_disp = full_range * bbox.width() * bbox.height();
+  } else {
+    BBox2i seed_bbox(elem_quot(bbox.min(), upscale_factor),
+                     elem_quot(bbox.max(), upscale_factor));
+    seed_bbox.expand(1);
+    seed_bbox.crop(bounding_box(sub_disp));
+    ImageView<PixelMask<Vector2f>> seed = crop(sub_disp, seed_bbox);
+    double pixels_per_seed = upscale_factor[0] * upscale_factor[1];
+    for (int col = 0; col < seed.cols(); col++) {
+      for (int row = 0; row < seed.rows(); row++) {
+        BBox2 range;
+        for (int c = std::max(col - 1, 0); c <= std::min(col + 1, seed.cols() - 1); c++) {
+          for (int r = std::max(row - 1, 0); r <= std::min(row + 1, seed.rows() - 1); r++) {
+            if (is_valid(seed(c, r)))
+              range.grow(seed(c, r).child());
+          }
+        }
+        if (range.empty()) {
+          num_disp += pixels_per_seed * full_range;
+          continue;
+        }
+        double w = range.width()  * upscale_factor[0] + 2 * sgm_search_buffer[0] + 1;
+        double h = range.height() * upscale_factor[1] + 2 * sgm_search_buffer[1] + 1;
+        num_disp += pixels_per_seed * std::min(w * h, full_range);
+      }
+    }
+    // Scale from the expanded seed box to the tile
+    double seed_area = pixels_per_seed * seed.cols() * seed.rows();
+    if (seed_area > 0)
+      num_disp *= double(bbox.width()) * bbox.height() / seed_area;
+  }
+
+  return num_disp * 2.0 * sizeof(vw::uint16) / (1024.0 * 1024.0);
+}
+
 /// This correlator takes a low resolution disparity image as an input
 /// so that it may narrow its search range for each tile that is processed.
 class SeededCorrelatorView: public ImageViewBase<SeededCorrelatorView> {
@@ -745,6 +800,26 @@ public:
     SemiGlobalMatcher::SgmSubpixelMode sgm_subpixel_mode = get_sgm_subpixel_mode();
     Vector2i sgm_search_buffer = stereo_settings().sgm_search_buffer;
 
+    // Report the expected size of the SGM cost buffers, to help choose the
+    // tile size and the memory per node. This is printed for each tile, so
+    // only at debug verbosity, unless the estimate is too large.
+    bool using_sgm = (stereo_alg > vw::stereo::VW_CORRELATION_BM &&
+                      stereo_alg < vw::stereo::VW_CORRELATION_OTHER);
+    if (using_sgm) {
+      BBox2i tile = bbox;
+      tile.expand(stereo_settings().sgm_collar_size);
+      tile.crop(bounding_box(m_left_image));
+      double est_mb = estimate_sgm_memory_mb(m_sub_disp, m_upscale_factor, tile,
+                                             local_search_range, sgm_search_buffer);
+      VW_OUT(DebugMessage, "stereo") << "Estimated SGM cost buffer memory for tile "
+                                     << tile << ": " << est_mb << " MB.\n";
+      if (est_mb > stereo_settings().corr_memory_limit_mb)
+        vw_out(WarningMessage) << "The estimated SGM memory use exceeds "
+                               << "--corr-memory-limit-mb (" 
+                               << stereo_settings().corr_memory_limit_mb
+                               << "). Consider a smaller tile size or search range.\n";
+    }
+
     // Now we are ready to actually perform correlation. 
     const int rm_half_kernel = 5; // Filter kernel size used by CorrelationView
     vw::stereo::PrefilterModeType prefilter_mode =
@@ -789,6 +864,8 @@ public:
 /// algorithms which can handle a 2D disparity.
 void stereo_correlation_2D(ASPGlobalOptions& opt) {
 
+  asp::ScopedTrace trace("stereo_correlation_2D");
+
   // The first thing we will do is compute the low-resolution correlation.
 
   // Note that even when we are told to skip low-resolution correlation,
@@ -972,6 +1049,10 @@ void stereo_correlation_2D(ASPGlobalOptions& opt) {
                                             has_left_georef, left_georef,
                                             has_lr_disp_nodata, lr_disp_nodata, opt, tpc);
   }
+
+  // This is for the whole process, since it started, not for any one tile
+  if (using_sgm)
+    vw_out() << "Process peak RSS: " << asp::peak_memory_mb() << " MB.\n";
   
   return;
 } // End function stereo_correlation_2D
@@ -1069,6 +1150,8 @@ void stereo_correlation_1D(ASPGlobalOptions& opt) {
   // which is incompatible with local alignment and stereo for pairs of tiles.
   if (stereo_settings().compute_low_res_disparity_only) 
     return;
+
+  asp::ScopedTrace trace("stereo_correlation_1D");
   
   // The dimensions of the tile and the final disparity
   BBox2i tile_crop_win = stereo_settings().trans_crop_win;
@@ -1533,6 +1616,16 @@ void stereo_correlation_1D(ASPGlobalOptions& opt) {
 
 } // End function stereo_correlation_1D
 
+// GDAL block write sizes must be a multiple to 16 so if the input value is
+//  not a multiple of 16 increase it until it is.
+int rounded_corr_tile_size() {
+  int ts = stereo_settings().corr_tile_size_ovr;
+  const int TILE_MULTIPLE = 16;
+  if (ts % TILE_MULTIPLE != 0)
+    ts = ((ts / TILE_MULTIPLE) + 1) * TILE_MULTIPLE;
+  return ts;
+}
+
 int main(int argc, char* argv[]) {
 
   try {
@@ -1585,35 +1678,37 @@ int main(int argc, char* argv[]) {
 
     // Integer correlator requires large tiles
     //---------------------------------------------------------
-    int ts = stereo_settings().corr_tile_size_ovr;
-
-    // GDAL block write sizes must be a multiple to 16 so if the input value is
-    //  not a multiple of 16 increase it until it is.
-    const int TILE_MULTIPLE = 16;
-    if (ts % TILE_MULTIPLE != 0)
-      ts = ((ts / TILE_MULTIPLE) + 1) * TILE_MULTIPLE;
-      
+    int ts = rounded_corr_tile_size();
     opt.raster_tile_size = Vector2i(ts, ts);
     vw_out() << "\n[ " << current_posix_time_string() << " ]: Stage 1 --> CORRELATION\n";
 
-    if (stereo_settings().alignment_method == "local_epipolar") {
+    if (stereo_settings().alignment_method == "local_epipolar" &&
+        stereo_settings().compute_low_res_disparity_only) {
       // Need to have the low-res 2D disparity to later guide the
       // per-tile correlation. Use here the ASP MGM algorithm as the
       // most reliable one, unless we do good old block-matching
-      if (stereo_settings().compute_low_res_disparity_only) {
-        if (stereo_settings().stereo_algorithm != "asp_bm")
-          stereo_settings().stereo_algorithm = "asp_mgm";
-        stereo_correlation_2D(opt);
-        return 0;
-      }
-      // This will be invoked per-tile.
-      stereo_correlation_1D(opt);
-    } else {
-      // Do 2D correlation. The first time this is invoked it will
-      // compute the low-res disparity unless told not to.
+      if (stereo_settings().stereo_algorithm != "asp_bm")
+        stereo_settings().stereo_algorithm = "asp_mgm";
       stereo_correlation_2D(opt);
+      asp::saveTrace(opt.out_prefix);
+      return 0;
     }
 
+    asp::run_tiles(opt, [](ASPGlobalOptions & curr_opt) {
+      // The correlation tile size can be set per tile
+      int ts = rounded_corr_tile_size();
+      curr_opt.raster_tile_size = Vector2i(ts, ts);
+
+      if (stereo_settings().alignment_method == "local_epipolar") {
+        // This will be invoked per-tile.
+        stereo_correlation_1D(curr_opt);
+      } else {
+        // Do 2D correlation. The first time this is invoked it will
+        // compute the low-res disparity unless told not to.
+        stereo_correlation_2D(curr_opt);
+      }
+    });
+
     vw_out() << "\n[ " << current_posix_time_string() << " ]: CORRELATION FINISHED\n";
     
     xercesc::XMLPlatformUtils::Terminate();
@@ -28,6 +28,7 @@
 #include <vw/Image/InpaintView.h>
 
 #include <asp/Core/ThreadedEdgeMask.h>
+#include <asp/Core/Tracing.h>
 #include <asp/Sessions/StereoSession.h>
 #include <asp/Gotcha/CBatchProc.h>
 
@@ -35,6 +36,8 @@
 
 #include <boost/dll.hpp>
 
+#include <cstring>
+
 using namespace vw;
 using namespace asp;
 using namespace std;
@@ -135,6 +138,25 @@ texture_aware_disparity_filter( ImageViewBase<ImageT    > const& img,
                      texture_smooth_range, texture_max, max_smooth_kernel_size);
 }
 
+// The box to read for a tile when eroding blobs of up to the given area. We
+// look beyond the current tile, to avoid cutting blobs if possible. Skinny
+// blobs will be cut though.
+BBox2i erode_read_box(BBox2i const& bbox, BBox2i const& image_box, int area) {
+  BBox2i bbox2 = bbox;
+  bbox2.expand(2*int(ceil(sqrt(double(area)))));
+  bbox2.crop(image_box);
+  return bbox2;
+}
+
+// Erode the blobs of up to the given area in a tile read with the box above
+template <class PixelT>
+void erode_tile(ImageView<PixelT> & tile_img, int area) {
+  int tile_size = max(tile_img.cols(), tile_img.rows()); // don't subsplit
+  BlobIndexThreaded smallBlobIndex(tile_img, area, tile_size);
+  ImageView<PixelT> clean_tile_img = applyErodeView(tile_img, smallBlobIndex);
+  tile_img = clean_tile_img;
+}
+
 // Erode blobs from given image by iterating through tiles, biasing
 // each tile by a factor of blob size, removing blobs in the tile,
 // then shrinking the tile back. The bias is necessary to help avoid
@@ -166,21 +188,10 @@ public:
   inline prerasterize_type prerasterize(BBox2i const& bbox) const {
 
     int area = stereo_settings().erode_max_size;
-
-    // We look a beyond the current tile, to avoid cutting blobs
-    // if possible. Skinny blobs will be cut though.
-    int bias = 2*int(ceil(sqrt(double(area))));
-
-    BBox2i bbox2 = bbox;
-    bbox2.expand(bias);
-    bbox2.crop(bounding_box(m_img));
+    BBox2i bbox2 = erode_read_box(bbox, bounding_box(m_img), area);
     ImageView<pixel_type> tile_img = crop(m_img, bbox2);
-
-    int tile_size = max(bbox2.width(), bbox2.height()); // don't subsplit
-    BlobIndexThreaded smallBlobIndex(tile_img, area, tile_size);
-    ImageView<pixel_type> clean_tile_img = applyErodeView(tile_img,
-                                                          smallBlobIndex);
-    return prerasterize_type(clean_tile_img,
+    erode_tile(tile_img, area);
+    return prerasterize_type(tile_img,
                              -bbox2.min().x(), -bbox2.min().y(),
                              cols(), rows() );
   }
@@ -230,18 +241,30 @@ struct MultipleDisparityCleanUp {
   }
 };
 
+// Sub-sampling factor for the good pixel map, so that the user can actually view it.
 template <class ImageT>
-void write_good_pixel_and_filtered(ImageViewBase<ImageT> const& inputview,
-                                   ASPGlobalOptions const& opt) {
-  // Write Good Pixel Map
-  // Sub-sampling so that the user can actually view it.
+double good_pixel_sub_scale(ImageViewBase<ImageT> const& inputview) {
   double sub_scale = double( min( inputview.impl().cols(),
                                 inputview.impl().rows() ) ) / 2048.0;
   if (sub_scale < 1) // Don't use a sub_scale less than one.
     sub_scale = 1;
+  return sub_scale;
+}
+
+// The original way of writing the good pixel map and the filtered
+// disparity. The filtering chain is rasterized once for each of the two
+// outputs. Kept for hole-filling, which needs a pass over the whole image
+// first, and for comparing with the fused engine below. The suffix is
+// appended to the output file names.
+template <class ImageT>
+void write_good_pixel_and_filtered_legacy(ImageViewBase<ImageT> const& inputview,
+                                          ASPGlobalOptions const& opt,
+                                          std::string const& suffix = "") {
+  // Write Good Pixel Map
+  double sub_scale = good_pixel_sub_scale(inputview);
 
   // Write out the good pixel map
-  std::string goodPixelFile = opt.out_prefix + "-GoodPixelMap.tif";
+  std::string goodPixelFile = opt.out_prefix + "-GoodPixelMap" + suffix + ".tif";
   vw_out() << "Writing: " << goodPixelFile << std::endl;
   ImageViewRef<  PixelRGB<uint8> > goodPixelImage
     = subsample(apply_mask
@@ -273,7 +296,7 @@ void write_good_pixel_and_filtered(ImageViewBase<ImageT> const& inputview,
 
   bool removeSmallBlobs = (stereo_settings().erode_max_size > 0);
 
-  string outF = opt.out_prefix + "-F.tif";
+  string outF = opt.out_prefix + "-F" + suffix + ".tif";
 
   // Fill holes
   if(stereo_settings().enable_fill_holes) {
@@ -339,10 +362,188 @@ void write_good_pixel_and_filtered(ImageViewBase<ImageT> const& inputview,
     }
 
   } // End no hole filling case
-} //end write_good_pixel_and_filtered
+} //end write_good_pixel_and_filtered_legacy
+
+/// Rasterize the filtering chain once per tile, with a halo if small blobs
+/// are to be removed, then remove the blobs and record the good pixel map
+/// for the tile. The result is the filtered disparity. The good pixel map
+/// is filled in as a side effect, and can be written once all tiles are
+/// done. Each tile writes to its own pixels in the good pixel map, so no
+/// locking is needed.
+template <class ImageT>
+class FusedFilterView: public ImageViewBase<FusedFilterView<ImageT> >{
+  ImageT m_img;
+  ImageViewRef<vw::uint8> m_left_mask;
+  int m_sub_factor;
+  ImageView<PixelRGB<uint8> > & m_good_pixel; // not owned
+public:
+  FusedFilterView(ImageViewBase<ImageT> const& img,
+                  ImageViewRef<vw::uint8> const& left_mask,
+                  int sub_factor,
+                  ImageView<PixelRGB<uint8> > & good_pixel):
+    m_img(img.impl()), m_left_mask(left_mask), m_sub_factor(sub_factor),
+    m_good_pixel(good_pixel) {}
+
+  // Image View interface
+  typedef typename ImageT::pixel_type pixel_type;
+  typedef pixel_type                  result_type;
+  typedef ProceduralPixelAccessor<FusedFilterView> pixel_accessor;
+
+  inline int32 cols  () const { return m_img.cols(); }
+  inline int32 rows  () const { return m_img.rows(); }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+
+  inline pixel_type operator()( double /*i*/, double /*j*/, int32 /*p*/ = 0 ) const {
+    vw_throw(NoImplErr() << "FusedFilterView::operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  typedef CropView<ImageView<pixel_type> > prerasterize_type;
+  inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+
+    // The halo for blob removal is the same as in PerTileErode
+    int area = stereo_settings().erode_max_size;
+    bool removeSmallBlobs = (area > 0);
+    BBox2i bbox2 = erode_read_box(bbox, bounding_box(m_img), removeSmallBlobs ? area : 0);
+
+    // The only read of the filtering chain for this tile
+    ImageView<pixel_type> tile_img = crop(m_img, bbox2);
+
+    // The good pixel map, before blob removal
+    ImageView<PixelRGB<uint8> > good_tile
+      = apply_mask(copy_mask(stereo::missing_pixel_image(tile_img),
+                             create_mask(crop(m_left_mask, bbox2), 0)));
+    int f = m_sub_factor;
+    int beg_col = f * ((bbox.min().x() + f - 1) / f);
+    int beg_row = f * ((bbox.min().y() + f - 1) / f);
+    for (int col = beg_col; col < bbox.max().x(); col += f) {
+      for (int row = beg_row; row < bbox.max().y(); row += f) {
+        if (col / f >= m_good_pixel.cols() || row / f >= m_good_pixel.rows())
+          continue;
+        m_good_pixel(col / f, row / f)
+          = good_tile(col - bbox2.min().x(), row - bbox2.min().y());
+      }
+    }
+
+    if (removeSmallBlobs)
+      erode_tile(tile_img, area);
+
+    return prerasterize_type(tile_img,
+                             -bbox2.min().x(), -bbox2.min().y(),
+                             cols(), rows() );
+  }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
+  }
+};
+
+// Write the filtered disparity and the good pixel map with a single
+// pass over the filtering chain.
+template <class ImageT>
+void write_good_pixel_and_filtered_fused(ImageViewBase<ImageT> const& inputview,
+                                         ASPGlobalOptions const& opt) {
+
+  DiskImageView<vw::uint8> left_mask(opt.out_prefix + "-lMask.tif");
+
+  // Use the same sampling as subsample() in the legacy path
+  double sub_scale = good_pixel_sub_scale(inputview);
+  ImageViewRef<vw::uint8> sub_mask = subsample(left_mask, sub_scale);
+  int sub_factor = std::max(1, int(sub_scale));
+  ImageView<PixelRGB<uint8> > goodPixelImage(sub_mask.cols(), sub_mask.rows());
+
+  // Determine if we can attach geo information to the output image
+  cartography::GeoReference left_georef;
+  bool has_left_georef = read_georeference(left_georef,  opt.out_prefix + "-L.tif");
+  bool has_nodata = false;
+  double nodata = -32768.0;
+
+  string outF = opt.out_prefix + "-F.tif";
+  if (stereo_settings().erode_max_size > 0)
+    vw_out() << "\t--> Removing small blobs.\n";
+  vw_out() << "Writing: " << outF << endl;
+  vw::cartography::block_write_gdal_image
+    (outF, FusedFilterView<ImageT>(inputview.impl(), left_mask, sub_factor, goodPixelImage),
+     has_left_georef, left_georef, has_nodata, nodata, opt,
+     TerminalProgressCallback("asp", "\t--> Filtering: "));
+
+  std::string goodPixelFile = opt.out_prefix + "-GoodPixelMap.tif";
+  vw_out() << "Writing: " << goodPixelFile << std::endl;
+  vw::cartography::GeoReference good_pixel_georef;
+  if (has_left_georef) {
+    double good_pixel_scale = 0.5*( double(goodPixelImage.cols())/inputview.impl().cols()
+                                    + double(goodPixelImage.rows())/inputview.impl().rows());
+    good_pixel_georef = resample(left_georef, good_pixel_scale);
+  }
+  vw::cartography::block_write_gdal_image
+    ( goodPixelFile, goodPixelImage, has_left_georef, good_pixel_georef,
+      has_nodata, nodata,
+      opt, TerminalProgressCallback("asp", "\t--> Good pixel map: ") );
+}
+
+// Count the pixels which differ between two images. Read them in strips
+// of rows to keep the memory use bounded.
+template <class PixelT>
+size_t count_differing_pixels(std::string const& file1, std::string const& file2) {
+  DiskImageView<PixelT> img1(file1), img2(file2);
+  if (img1.cols() != img2.cols() || img1.rows() != img2.rows())
+    vw_throw(ArgumentErr() << "The images " << file1 << " and " << file2
+             << " have different dimensions.\n");
+
+  size_t num_diff = 0;
+  int strip = 256;
+  for (int beg = 0; beg < img1.rows(); beg += strip) {
+    BBox2i box(0, beg, img1.cols(), std::min(strip, img1.rows() - beg));
+    ImageView<PixelT> a = crop(img1, box), b = crop(img2, box);
+    for (int col = 0; col < a.cols(); col++) {
+      for (int row = 0; row < a.rows(); row++) {
+        if (std::memcmp(&a(col, row), &b(col, row), sizeof(PixelT)) != 0)
+          num_diff++;
+      }
+    }
+  }
+  return num_diff;
+}
+
+template <class ImageT>
+void write_good_pixel_and_filtered(ImageViewBase<ImageT> const& inputview,
+                                   ASPGlobalOptions const& opt) {
+
+  // Hole-filling needs a pass over the entire image before any tile is
+  // written, so it cannot be fused.
+  if (stereo_settings().enable_fill_holes) {
+    write_good_pixel_and_filtered_legacy(inputview, opt);
+    return;
+  }
+
+  write_good_pixel_and_filtered_fused(inputview, opt);
+
+  if (!stereo_settings().compare_filter_outputs)
+    return;
+
+  // Produce the outputs the original way as well and compare
+  std::string suffix = "-legacy";
+  write_good_pixel_and_filtered_legacy(inputview, opt, suffix);
+  size_t num_diff_F
+    = count_differing_pixels<PixelMask<Vector2f> >(opt.out_prefix + "-F.tif",
+                                                   opt.out_prefix + "-F" + suffix + ".tif");
+  size_t num_diff_good
+    = count_differing_pixels<PixelRGB<uint8> >(opt.out_prefix + "-GoodPixelMap.tif",
+                                               opt.out_prefix + "-GoodPixelMap"
+                                               + suffix + ".tif");
+  vw_out() << "Number of pixels differing from the legacy filtering path: "
+           << num_diff_F << " in F.tif, " << num_diff_good << " in GoodPixelMap.tif.\n";
+  if (num_diff_F != 0 || num_diff_good != 0)
+    vw_out(WarningMessage) << "The fused and legacy filtering outputs differ.\n";
+}
 
 void stereo_filtering(ASPGlobalOptions& opt) {
 
+  asp::ScopedTrace trace("stereo_filtering");
+
   string post_correlation_fname;
   opt.session->pre_filtering_hook(opt.out_prefix+"-RD.tif",
                                   post_correlation_fname);
@@ -529,6 +730,8 @@ int main(int argc, char* argv[]) {
 
     if (stereo_settings().gotcha_disparity_refinement)
       gotcha_disparity_refinement(opt);
+
+    asp::saveTrace(opt.out_prefix);
     
     vw_out() << "\n[ " << current_posix_time_string()
              << " ]: FILTERING FINISHED\n";
@@ -243,7 +243,8 @@ void readImageNames(std::vector<std::string> const& all_files,
         // Found a gcp file
         stereo_settings().gcp_file = file;
         is_image = false;
-      } else if (get_extension(file) == ".nvm") {
+      } else if (get_extension(file) == ".nvm" ||
+                 get_extension(file) == ".nvmb") {
         // Found an nvm file
         if (!stereo_settings().nvm.empty()) // sanity check
           vw_out() << "Multiple nvm files specified. Will load only: " << file << "\n";
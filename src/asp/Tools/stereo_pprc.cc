@@ -22,6 +22,9 @@
 #include <vw/Image/InpaintView.h>
 #include <vw/Image/WindowAlgorithms.h>
 #include <vw/Image/UtilityViews.h>
+#include <vw/Image/Statistics.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Cartography/GeoTransform.h>
 #include <vw/Cartography/GeoReferenceUtils.h>
 #include <vw/InterestPoint/Matcher.h>
@@ -34,6 +37,7 @@
 #include <asp/Sessions/StereoSessionFactory.h>
 #include <xercesc/util/PlatformUtils.hpp>
 #include <asp/Core/ThreadedEdgeMask.h>
+#include <asp/Core/Tracing.h>
 
 using namespace vw;
 using namespace asp;
@@ -82,6 +86,233 @@ BlobHolder::mask_and_fill_holes(ImageViewRef<PixelGray<float>> const& img,
   return inpaint(thresh_mask.impl(), *m_blobPtr.get(), use_grassfire, default_inpaint_val);
 }
 
+/// Accumulate, one tile at a time, the data needed for the subsampled
+/// images and for the image statistics. The subsampled image is a box
+/// filter of the full-resolution image over the valid pixels, with
+/// factor x factor blocks centered at multiples of the factor. The
+/// statistics are gathered from every stat_scale-th pixel, as done in
+/// gather_stats(). This lets the previews and statistics be produced
+/// while the mask is written, without reading the image again.
+class PreviewAccumulator {
+public:
+  PreviewAccumulator(int cols, int rows, int factor, int stat_scale,
+                     float nodata_value):
+    m_factor(factor), m_stat_scale(stat_scale),
+    m_nodata_value(nodata_value) {
+    int sub_cols = (cols - 1 + factor/2)/factor + 1;
+    int sub_rows = (rows - 1 + factor/2)/factor + 1;
+    m_sum.set_size(sub_cols, sub_rows);
+    m_count.set_size(sub_cols, sub_rows);
+    m_num_valid.set_size(sub_cols, sub_rows);
+    fill(m_sum, 0.0);
+    fill(m_count, 0);
+    fill(m_num_valid, 0);
+    if (stat_scale > 0) {
+      m_samples.set_size((cols - 1)/stat_scale + 1, (rows - 1)/stat_scale + 1);
+      fill(m_samples, PixelMask<float>());
+    }
+  }
+
+  /// Add a tile of the image and of the final mask. Can be called from
+  /// multiple threads. Each pixel must be added only once.
+  void add(BBox2i const& bbox, ImageView<PixelGray<float>> const& image,
+           ImageView<uint8> const& mask) {
+
+    int f = m_factor, h = m_factor/2;
+    BBox2i sub_box(Vector2i((bbox.min().x() + h)/f,     (bbox.min().y() + h)/f),
+                   Vector2i((bbox.max().x() - 1 + h)/f + 1,
+                            (bbox.max().y() - 1 + h)/f + 1));
+
+    // Sum up locally first, to hold the lock only briefly
+    ImageView<double> sum(sub_box.width(), sub_box.height());
+    ImageView<int> count(sub_box.width(), sub_box.height()),
+      num_valid(sub_box.width(), sub_box.height());
+    fill(sum, 0.0);
+    fill(count, 0);
+    fill(num_valid, 0);
+
+    for (int row = 0; row < bbox.height(); row++) {
+      int full_row = bbox.min().y() + row;
+      int sub_row  = (full_row + h)/f - sub_box.min().y();
+      for (int col = 0; col < bbox.width(); col++) {
+        int full_col = bbox.min().x() + col;
+        int sub_col  = (full_col + h)/f - sub_box.min().x();
+        float val = image(col, row)[0];
+        count(sub_col, sub_row)++;
+        if (mask(col, row) > 0) {
+          sum(sub_col, sub_row) += val;
+          num_valid(sub_col, sub_row)++;
+        }
+
+        // Each sample pixel belongs to only one tile, so no lock is needed
+        int s = m_stat_scale;
+        if (s > 0 && full_col % s == 0 && full_row % s == 0) {
+          PixelMask<float> sample(val);
+          if (val <= m_nodata_value)
+            sample.invalidate();
+          m_samples(full_col/s, full_row/s) = sample;
+        }
+      }
+    }
+
+    vw::Mutex::Lock lock(m_mutex);
+    for (int row = 0; row < sub_box.height(); row++) {
+      for (int col = 0; col < sub_box.width(); col++) {
+        int c = sub_box.min().x() + col, r = sub_box.min().y() + row;
+        m_sum(c, r)       += sum(col, row);
+        m_count(c, r)     += count(col, row);
+        m_num_valid(c, r) += num_valid(col, row);
+      }
+    }
+  }
+
+  /// The subsampled image. A pixel is valid if more than half of the
+  /// pixels it is made of are valid.
+  ImageView<PixelMask<PixelGray<float>>> sub_image() const {
+    ImageView<PixelMask<PixelGray<float>>> out(m_sum.cols(), m_sum.rows());
+    for (int row = 0; row < out.rows(); row++) {
+      for (int col = 0; col < out.cols(); col++) {
+        out(col, row) = PixelMask<PixelGray<float>>();
+        if (2 * m_num_valid(col, row) > m_count(col, row))
+          out(col, row) = PixelMask<PixelGray<float>>
+            (PixelGray<float>(m_sum(col, row) / m_num_valid(col, row)));
+      }
+    }
+    return out;
+  }
+
+  /// Compute the image statistics in the same way as gather_stats().
+  Vector6f stats() const {
+    ChannelAccumulator<vw::math::CDFAccumulator<float>> accumulator;
+    for_each_pixel_rowwise(m_samples, accumulator);
+    Vector6f result;
+    result[0] = accumulator.quantile(0); // Min
+    result[1] = accumulator.quantile(1); // Max
+    result[2] = accumulator.approximate_mean();
+    result[3] = accumulator.approximate_stddev();
+    result[4] = accumulator.quantile(0.02); // Percentile values
+    result[5] = accumulator.quantile(0.98);
+    return result;
+  }
+
+private:
+  int m_factor, m_stat_scale;
+  float m_nodata_value;
+  vw::Mutex m_mutex;
+  ImageView<double> m_sum;
+  ImageView<int> m_count, m_num_valid;
+  ImageView<PixelMask<float>> m_samples;
+};
+
+/// A view which returns the mask as is, but as each tile is rasterized,
+/// passes it, together with the corresponding image tile, to a
+/// PreviewAccumulator.
+class MaskWithPreviewView: public ImageViewBase<MaskWithPreviewView> {
+  ImageViewRef<uint8>            m_mask;
+  ImageViewRef<PixelGray<float>> m_image;
+  PreviewAccumulator &           m_accum;
+
+public:
+  MaskWithPreviewView(ImageViewRef<uint8> const& mask,
+                      ImageViewRef<PixelGray<float>> const& image,
+                      PreviewAccumulator & accum):
+    m_mask(mask), m_image(image), m_accum(accum) {}
+
+  // Image View interface
+  typedef uint8 pixel_type;
+  typedef pixel_type result_type;
+  typedef ProceduralPixelAccessor<MaskWithPreviewView> pixel_accessor;
+
+  inline int32 cols  () const { return m_mask.cols(); }
+  inline int32 rows  () const { return m_mask.rows(); }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor(*this, 0, 0); }
+
+  inline pixel_type operator()(double /*i*/, double /*j*/, int32 /*p*/ = 0) const {
+    vw_throw(NoImplErr() << "MaskWithPreviewView::operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  typedef CropView<ImageView<pixel_type>> prerasterize_type;
+  inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+    ImageView<pixel_type> mask_tile = crop(m_mask, bbox);
+    ImageView<PixelGray<float>> image_tile = crop(m_image, bbox);
+    m_accum.add(bbox, image_tile, mask_tile);
+    return prerasterize_type(mask_tile, -bbox.min().x(), -bbox.min().y(),
+                             cols(), rows());
+  }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
+  }
+};
+
+/// The scale factor for the subsampled images, aiming for about 1500 x 1500 pixels.
+float preview_scale(ImageViewRef<PixelGray<float>> const& left_image,
+                    ImageViewRef<PixelGray<float>> const& right_image) {
+  double s = 1500.0;
+  float  sub_scale = sqrt(s * s / (float(left_image.cols ()) * float(left_image.rows ())))
+                   + sqrt(s * s / (float(right_image.cols()) * float(right_image.rows())));
+  sub_scale /= 2;
+  if ( sub_scale > 0.6 ) // ???
+    sub_scale = 0.6;
+  return sub_scale;
+}
+
+/// Write a subsampled image and its mask
+void write_preview(ASPGlobalOptions const& opt,
+                   std::string const& sub_file, std::string const& mask_sub_file,
+                   ImageView<PixelMask<PixelGray<float>>> const& sub_image,
+                   int full_cols, int full_rows,
+                   bool has_georef, vw::cartography::GeoReference const& georef,
+                   bool has_nodata, float output_nodata, std::string const& tag) {
+
+  Stopwatch sw;
+  sw.start();
+
+  // Enforce no predictor in compression, it works badly with sub-images
+  vw::GdalWriteOptions opt_nopred = opt;
+  opt_nopred.gdal_options["PREDICTOR"] = "1";
+
+  vw::cartography::GeoReference sub_georef;
+  if (has_georef) {
+    // Account for scale.
+    double scale = 0.5 * (double(sub_image.cols())/full_cols + 
+                          double(sub_image.rows())/full_rows);
+    sub_georef = resample(georef, scale);
+  }
+
+  vw::cartography::block_write_gdal_image(
+    sub_file, apply_mask(sub_image, output_nodata),
+    has_georef, sub_georef,
+    has_nodata, output_nodata,
+    opt_nopred, TerminalProgressCallback("asp", "\t    Sub " + tag + ": "));
+  vw::cartography::block_write_gdal_image(
+    mask_sub_file, channel_cast_rescale<uint8>(select_channel(sub_image, 1)),
+    has_georef, sub_georef,
+    has_nodata, output_nodata,
+    opt_nopred, TerminalProgressCallback("asp", "\t    Sub " + tag + " Mask: "));
+
+  sw.stop();
+  vw_out(DebugMessage,"asp") << "Writing " << sub_file << " and " << mask_sub_file
+                             << " elapsed time: " << sw.elapsed_seconds() << " s.\n";
+}
+
+/// Write the statistics of the un-normalized images, to be used in stereo_rfne.
+void write_stats(std::string const& out_prefix,
+                 Vector6f const& left_stats, Vector6f const& right_stats) {
+  std::string left_stats_file  = out_prefix + "-lStats.tif";
+  std::string right_stats_file = out_prefix + "-rStats.tif";
+
+  vw_out() << "Writing: " << left_stats_file << ' ' << right_stats_file << "\n";
+  Vector<float32> left_stats2  = left_stats;  // cast
+  Vector<float32> right_stats2 = right_stats; // cast
+  write_vector(left_stats_file,  left_stats2 );
+  write_vector(right_stats_file, right_stats2);
+}
+
 
 /// Instead of writing L.tif and R.tif, just create sym links from
 /// input left and right images. Creating symbolic links can be tricky.
@@ -142,6 +373,8 @@ void check_image_sizes(std::string const& file1, std::string const& file2) {
 /// The main preprocessing function
 void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
 
+  asp::ScopedTrace trace("stereo_preprocessing");
+
   // Normalize the images, or create symlinks to the original
   // images if the user chose not to normalize.
   std::string left_image_file, right_image_file;
@@ -219,6 +452,14 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
   bool  has_nodata    = true;
   float output_nodata = -32768.0;
 
+  // If image normalization is not done, we still need to compute the image
+  // stats, to do normalization on the fly in stereo_rfne.
+  bool need_stats = (skip_img_norm && stereo_settings().subpixel_mode == 2);
+
+  // The subsampled images and the stats are accumulated while the masks are
+  // written, if the masks need to be rebuilt. Then the images are read only once.
+  boost::shared_ptr<PreviewAccumulator> left_accum, right_accum;
+
   if (!rebuild) {
     vw_out() << "\t--> Using cached masks.\n";
     
@@ -348,6 +589,28 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
       }
     }
 
+    // Produce the previews with an integer subsampling factor, as then each
+    // full-resolution pixel contributes to just one preview pixel.
+    float sub_scale = preview_scale(left_image, right_image);
+    int sub_factor = std::max(1, int(round(1.0/sub_scale)));
+    int left_stat_scale = 0, right_stat_scale = 0;
+    if (need_stats) {
+      // Same sampling as in gather_stats()
+      const float TARGET_NUM_PIXELS = 1000000;
+      left_stat_scale = int(ceil(sqrt(float(left_image.cols()) * float(left_image.rows())
+                                      / TARGET_NUM_PIXELS)));
+      right_stat_scale = int(ceil(sqrt(float(right_image.cols()) * float(right_image.rows())
+                                       / TARGET_NUM_PIXELS)));
+    }
+    left_accum.reset(new PreviewAccumulator(left_image.cols(), left_image.rows(),
+                                            sub_factor, left_stat_scale,
+                                            left_nodata_value));
+    right_accum.reset(new PreviewAccumulator(right_image.cols(), right_image.rows(),
+                                             sub_factor, right_stat_scale,
+                                             right_nodata_value));
+    vw_out() << "\t--> Creating previews while writing the masks. Subsampling by a "
+             << "factor of " << sub_factor << ".\n";
+
     // Intersect the left mask with the warped version of the right
     // mask, and vice-versa to reduce noise, if the images
     // are map-projected.
@@ -371,7 +634,9 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
                   ConstantEdgeExtension(), NearestPixelInterpolation()),
                 bounding_box(left_mask));
         vw::cartography::block_write_gdal_image(left_mask_file,
-                                 apply_mask(intersect_mask(left_mask, warped_right_mask)),
+                                 MaskWithPreviewView
+                                 (apply_mask(intersect_mask(left_mask, warped_right_mask)),
+                                  left_image, *left_accum),
                                  has_left_georef, left_georef,
                                  has_nodata, output_nodata,
                                  opt, TerminalProgressCallback("asp", "\t    Mask L: "));
@@ -385,7 +650,9 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
                   ConstantEdgeExtension(), NearestPixelInterpolation()),
                 bounding_box(right_mask));
         vw::cartography::block_write_gdal_image(right_mask_file,
-                                    apply_mask(intersect_mask(right_mask, warped_left_mask)),
+                                    MaskWithPreviewView
+                                    (apply_mask(intersect_mask(right_mask, warped_left_mask)),
+                                     right_image, *right_accum),
                                     has_right_georef, right_georef,
                                     has_nodata, output_nodata,
                                     opt, TerminalProgressCallback("asp", "\t    Mask R: "));
@@ -399,18 +666,22 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
       // TODO: Even so, the trick above with intersecting the masks will still work,
       // if the images are map-projected (such as with cam2map-ed cubes),
       // but this would require careful research.
-      vw::cartography::block_write_gdal_image(left_mask_file, apply_mask(left_mask),
+      vw::cartography::block_write_gdal_image(left_mask_file,
+                                   MaskWithPreviewView(apply_mask(left_mask),
+                                                       left_image, *left_accum),
                                    has_left_georef, left_georef,
                                    has_nodata, output_nodata,
                                    opt, TerminalProgressCallback("asp", "\t Mask L: ") );
-      vw::cartography::block_write_gdal_image( right_mask_file, apply_mask(right_mask),
+      vw::cartography::block_write_gdal_image(right_mask_file,
+                                   MaskWithPreviewView(apply_mask(right_mask),
+                                                       right_image, *right_accum),
                                    has_right_georef, right_georef,
                                    has_nodata, output_nodata,
                                    opt, TerminalProgressCallback("asp", "\t Mask R: ") );
     }
 
     sw.stop();
-    vw_out(DebugMessage,"asp") << "Mask creation elapsed time: "
+    vw_out(DebugMessage,"asp") << "Mask and preview creation elapsed time: "
                                << sw.elapsed_seconds() << " s." << std::endl;
   } // End creating masks
 
@@ -419,20 +690,23 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
   std::string lmsub = opt.out_prefix+"-lMask_sub.tif";
   std::string rmsub = opt.out_prefix+"-rMask_sub.tif";
 
+  // The previews were accumulated while writing the masks
+  bool have_previews = (left_accum.get() != NULL && right_accum.get() != NULL);
+
   inputs_changed = (!is_latest_timestamp(lsub,  in_file_list ) ||
                     !is_latest_timestamp(rsub,  in_file_list)  ||
                     !is_latest_timestamp(lmsub, in_file_list ) ||
                     !is_latest_timestamp(rmsub, in_file_list )  );
 
   // We must always redo the subsampling if we are allowed to crop the images
-  rebuild = crop_left || crop_right || inputs_changed;
+  rebuild = crop_left || crop_right || inputs_changed || have_previews;
 
   try {
     // First try to see if the subsampled images exist.
     if (!fs::exists(lsub)  || !fs::exists(rsub) ||
         !fs::exists(lmsub) || !fs::exists(rmsub)) {
       rebuild = true;
-    } else {
+    } else if (!rebuild) {
       // See if the subsampled images are valid
       DiskImageView<PixelGray<float>> testl(lsub);
       DiskImageView<PixelGray<float>> testr(rsub);
@@ -444,16 +718,17 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
     rebuild = true;
   }
 
-  if (rebuild) {
+  if (rebuild && have_previews) {
+    write_preview(opt, lsub, lmsub, left_accum->sub_image(),
+                  left_image.cols(), left_image.rows(),
+                  has_left_georef, left_georef, has_nodata, output_nodata, "L");
+    write_preview(opt, rsub, rmsub, right_accum->sub_image(),
+                  right_image.cols(), right_image.rows(),
+                  has_right_georef, right_georef, has_nodata, output_nodata, "R");
+  } else if (rebuild) {
     // Produce subsampled images, these will be used later for auto
     // search range detection.
-    double s = 1500.0;
-    float  sub_scale = sqrt(s * s / (float(left_image.cols ()) * float(left_image.rows ())))
-                     + sqrt(s * s / (float(right_image.cols()) * float(right_image.rows())));
-    sub_scale /= 2;
-    if ( sub_scale > 0.6 ) // ???
-      sub_scale = 0.6;
-
+    float sub_scale = preview_scale(left_image, right_image);
     // Solving for the number of threads and the tile size to use for
     // subsampling while only using 500 MiB of memory. (The cache code
     // is a little slow on releasing so it will probably use 1.5GiB
@@ -505,82 +780,53 @@ void stereo_preprocessing(bool adjust_left_image_size, ASPGlobalOptions& opt) {
          sub_tile_size_vec, sub_threads);
     }
 
-    // Enforce no predictor in compression, it works badly with sub-images
-    vw::GdalWriteOptions opt_nopred = opt;
-    opt_nopred.gdal_options["PREDICTOR"] = "1";
-
-    vw::cartography::GeoReference left_sub_georef, right_sub_georef;
-    if (has_left_georef) {
-      // Account for scale.
-      double left_scale = 0.5 * (double(left_sub_image.cols())/left_image.cols() + 
-                                 double(left_sub_image.rows())/left_image.rows());
-      left_sub_georef = resample(left_georef, left_scale);
-    }
-    if (has_right_georef) {
-      // Account for scale.
-      double right_scale = 0.5 * (double(right_sub_image.cols())/right_image.cols() + 
-                                  double(right_sub_image.rows())/right_image.rows());
-      right_sub_georef = resample(right_georef, right_scale);
-    }
-
-    vw::cartography::block_write_gdal_image(
-      lsub, apply_mask(left_sub_image, output_nodata),
-      has_left_georef, left_sub_georef,
-      has_nodata, output_nodata,
-      opt_nopred, TerminalProgressCallback("asp", "\t    Sub L: ") );
-    vw::cartography::block_write_gdal_image(
-      rsub, apply_mask(right_sub_image, output_nodata),
-      has_right_georef, right_sub_georef,
-      has_nodata, output_nodata,
-      opt_nopred, TerminalProgressCallback("asp", "\t    Sub R: ") );
-    vw::cartography::block_write_gdal_image(
-      lmsub, channel_cast_rescale<uint8>(select_channel(left_sub_image, 1)),
-      has_left_georef, left_sub_georef,
-      has_nodata, output_nodata,
-      opt_nopred, TerminalProgressCallback("asp", "\t    Sub L Mask: ") );
-    vw::cartography::block_write_gdal_image(
-      rmsub, channel_cast_rescale<uint8>(select_channel(right_sub_image, 1)),
-      has_right_georef, right_sub_georef,
-      has_nodata, output_nodata,
-      opt_nopred, TerminalProgressCallback("asp", "\t    Sub R Mask: ") );
+    write_preview(opt, lsub, lmsub, left_sub_image,
+                  left_image.cols(), left_image.rows(),
+                  has_left_georef, left_georef, has_nodata, output_nodata, "L");
+    write_preview(opt, rsub, rmsub, right_sub_image,
+                  right_image.cols(), right_image.rows(),
+                  has_right_georef, right_georef, has_nodata, output_nodata, "R");
   } // End try/catch to see if the subsampled images have content
 
-  if (skip_img_norm && stereo_settings().subpixel_mode == 2) {
-    // If image normalization is not done, we still need to compute the image
-    // stats, to do normalization on the fly in stereo_rfne.
+  if (need_stats) {
     // This code is not in stereo_rfne, as that one is meant to be distributed
     // across multiple machines, so we want the stats to be computed just once,
     // hence they are done here.
     // TODO(oalexan1): Must integrate this in shared_preprocessing_hook,
     // as this repeats a lot of logic from there
     vw_out() << "Computing statistics for the un-normalized images.\n";
-    float left_no_data_value, right_no_data_value;
-    asp::get_nodata_values(left_rsrc, right_rsrc,
-                           left_no_data_value, right_no_data_value); 
-    if (!std::isnan(stereo_settings().nodata_value)){
-      left_no_data_value  = stereo_settings().nodata_value;
-      right_no_data_value = stereo_settings().nodata_value;
-    }
+    Stopwatch sw;
+    sw.start();
+    Vector6f left_stats, right_stats;
+    if (have_previews) {
+      // The pixels were sampled while writing the masks
+      left_stats  = left_accum->stats();
+      right_stats = right_accum->stats();
+    } else {
+      float left_no_data_value, right_no_data_value;
+      asp::get_nodata_values(left_rsrc, right_rsrc,
+                             left_no_data_value, right_no_data_value); 
+      if (!std::isnan(stereo_settings().nodata_value)){
+        left_no_data_value  = stereo_settings().nodata_value;
+        right_no_data_value = stereo_settings().nodata_value;
+      }
 
-    ImageViewRef<PixelMask<PixelGray<float>>> left_masked_image
-      = create_mask_less_or_equal(left_image, left_no_data_value);
-    ImageViewRef<PixelMask<PixelGray<float>>> right_masked_image
-      = create_mask_less_or_equal(right_image, right_no_data_value); 
-
-    Vector6f left_stats  = gather_stats(pixel_cast<PixelMask<float>>(left_masked_image), 
-                                        "left",
-                                        opt.out_prefix, left_image_file);
-    Vector6f right_stats = gather_stats(pixel_cast<PixelMask<float>>(right_masked_image), 
-                                        "right",
-                                        opt.out_prefix, right_image_file);
-    std::string left_stats_file  = opt.out_prefix + "-lStats.tif";
-    std::string right_stats_file = opt.out_prefix + "-rStats.tif";
-
-    vw_out() << "Writing: " << left_stats_file << ' ' << right_stats_file << "\n";
-    Vector<float32> left_stats2  = left_stats;  // cast
-    Vector<float32> right_stats2 = right_stats; // cast
-    write_vector(left_stats_file,  left_stats2 );
-    write_vector(right_stats_file, right_stats2);
+      ImageViewRef<PixelMask<PixelGray<float>>> left_masked_image
+        = create_mask_less_or_equal(left_image, left_no_data_value);
+      ImageViewRef<PixelMask<PixelGray<float>>> right_masked_image
+        = create_mask_less_or_equal(right_image, right_no_data_value); 
+
+      left_stats  = gather_stats(pixel_cast<PixelMask<float>>(left_masked_image), 
+                                 "left",
+                                 opt.out_prefix, left_image_file);
+      right_stats = gather_stats(pixel_cast<PixelMask<float>>(right_masked_image), 
+                                 "right",
+                                 opt.out_prefix, right_image_file);
+    }
+    write_stats(opt.out_prefix, left_stats, right_stats);
+    sw.stop();
+    vw_out(DebugMessage,"asp") << "Statistics elapsed time: "
+                               << sw.elapsed_seconds() << " s." << std::endl;
   }
 
   // When alignment method is none or epipolar, no ip were created so far, so
@@ -622,6 +868,10 @@ int main(int argc, char* argv[]) {
 
     stereo_preprocessing(adjust_left_image_size, opt);
     asp::estimate_convergence_angle(opt);
+
+    // Save the cameras for faster loading in the later stereo steps
+    opt.session->save_camera_cache();
+    asp::saveTrace(opt.out_prefix);
     
     vw_out() << "\n[ " << current_posix_time_string() << " ]: PREPROCESSING FINISHED\n";
 
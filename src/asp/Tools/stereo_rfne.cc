@@ -21,6 +21,7 @@
 
 #include <asp/Tools/stereo.h>
 #include <asp/Sessions/StereoSession.h>
+#include <asp/Core/Tracing.h>
 
 #include <vw/Stereo/PreFilter.h>
 #include <vw/Stereo/CostFunctions.h>
@@ -234,6 +235,7 @@ public:
 
   typedef CropView<ImageView<pixel_type> > prerasterize_type;
   inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+    asp::ScopedTrace trace("refine_disparity");
     ImageView<pixel_type> tile_disparity;
     bool verbose = false;
     tile_disparity = crop(refine_disparity(m_left_image, m_right_image,
@@ -264,6 +266,8 @@ per_tile_rfne(ImageViewBase<Image1T  > const& left,
 
 void stereo_refinement(ASPGlobalOptions const& opt) {
 
+  asp::ScopedTrace trace("stereo_refinement");
+
   ImageViewRef<PixelGray<float>> left_image, right_image;
   ImageViewRef<PixelMask<Vector2f> > input_disp;
   ImageViewRef<PixelMask<Vector2f> > sub_disp;
@@ -395,7 +399,7 @@ int main(int argc, char* argv[]) {
 
     // Internal Processes
     //---------------------------------------------------------
-    stereo_refinement(opt);
+    asp::run_tiles(opt, stereo_refinement);
 
     vw_out() << "\n[ " << current_posix_time_string()
              << " ]: REFINEMENT FINISHED\n";
@@ -29,8 +29,10 @@
 
 #include <asp/Core/PointUtils.h>
 #include <asp/Camera/RPCModel.h>
+#include <asp/Camera/RPCStereoModel.h>
 #include <asp/Core/DisparityProcessing.h>
 #include <asp/Core/Bathymetry.h>
+#include <asp/Core/Tracing.h>
 #include <asp/Tools/stereo.h>
 #include <asp/Tools/ccd_adjust.h>
 #include <asp/Core/IpMatchingAlgs.h>
@@ -62,6 +64,8 @@ class StereoTriangulation:
   std::vector<vw::TransformPtr> m_transforms; // e.g., map-projection or homography to undo
   vw::cartography::Datum        m_datum;
   vw::stereo::StereoModel       m_stereo_model;
+  asp::RPCStereoModel           m_rpc_model;
+  std::vector<const asp::RPCModel*> m_rpc_cams; // if to find the rays per tile
   asp::BathyStereoModel         m_bathy_model;
   bool                          m_is_map_projected;
   bool                          m_bathy_correct;
@@ -91,6 +95,7 @@ public:
     m_disparity_maps(disparity_maps), m_camera_ptrs(camera_ptrs),
     m_transforms(transforms), m_datum(datum),
     m_stereo_model(stereo_model),
+    m_rpc_model(stereo_model),
     m_bathy_model(bathy_model),
     m_is_map_projected(is_map_projected),
     m_bathy_correct(bathy_correct),
@@ -105,6 +110,12 @@ public:
         vw_throw( ArgumentErr() << "In multi-view triangulation, all disparities "
                   << "must have the same dimensions.\n" );
     }
+
+    // With RPC cameras, the rays for a tile are found at once with the
+    // batched RPC functions. Least squares refinement uses the cameras
+    // as before, so it is not affected.
+    if (!m_bathy_correct && !stereo_settings().use_least_squares)
+      m_rpc_cams = m_rpc_model.rpc_cameras();
   }
 
   inline int32 cols  () const { return m_disparity_maps[0].cols(); }
@@ -113,6 +124,147 @@ public:
 
   inline pixel_accessor origin() const { return pixel_accessor(*this); }
 
+  /// Triangulate the given left pixel and its matches, in native camera
+  /// pixel coordinates, without bathymetry correction. A match with NaN
+  /// values is not used. Return the zero vector on failure. The rays
+  /// through the pixels may be passed in, if found already.
+  inline result_type triangulate_pixels(std::vector<Vector2> const& pixVec,
+                                        std::vector<Vector3> const* ctrs = NULL,
+                                        std::vector<Vector3> const* dirs = NULL) const {
+    Vector3 errorVec;
+    pixel_type result;
+    try {
+      if (ctrs != NULL && dirs != NULL)
+        subvector(result, 0, 3) = m_rpc_model.triangulate_rays(pixVec, *ctrs, *dirs, errorVec);
+      else
+        subvector(result, 0, 3) = m_stereo_model(pixVec, errorVec);
+      double errLen = norm_2(errorVec);
+      if (!stereo_settings().propagate_errors) {
+        subvector(result, 3, 3) = errorVec;
+      } else {
+        // Store intersection error norm in band 3, horizontal
+        // stddev in band 4, and vertical stddev in band 5 (if band
+        // index starts from 0).
+        result[3] = errLen;
+        auto const& v = asp::stereo_settings().horizontal_stddev; // alias
+        subvector(result, 4, 2)
+          = asp::propagateCovariance(subvector(result, 0, 3),
+                                     m_datum, v[0], v[1],
+                                     m_camera_ptrs[0], m_camera_ptrs[1],
+                                     pixVec[0], pixVec[1]);
+      }
+      
+      // Filter by triangulation error, if desired
+      if (stereo_settings().max_valid_triangulation_error > 0.0 &&
+          errLen > stereo_settings().max_valid_triangulation_error) {
+        result = pixel_type();
+        errorVec = Vector3();
+      }
+    } catch(...) {
+      return pixel_type(); // The zero vector, it means that there is no valid data
+    }
+    
+    return result; // Contains location and error vector
+  }
+
+  /// Triangulate all pixels in the box, which must be in memory, as
+  /// produced by PreRasterHelper(). The result is identical to calling
+  /// operator() for each pixel, but the disparities are read directly, the
+  /// pixels are de-warped for the whole tile in one pass, and the
+  /// pixels with no valid disparity are skipped without any camera calls.
+  /// With RPC cameras, the rays are found for the whole tile with the
+  /// batched RPC functions, which agree with the per-pixel ones up to
+  /// rounding.
+  void triangulate_tile(BBox2i const& bbox, ImageView<pixel_type> & tile) const {
+
+    tile.set_size(bbox.width(), bbox.height());
+
+    if (m_bathy_correct) {
+      for (int row = 0; row < bbox.height(); row++) {
+        for (int col = 0; col < bbox.width(); col++)
+          tile(col, row) = (*this)(col + bbox.min().x(), row + bbox.min().y());
+      }
+      return;
+    }
+
+    int num_disp = m_disparity_maps.size();
+    std::vector<ImageView<DPixelT>> disps(num_disp);
+    for (int c = 0; c < num_disp; c++)
+      disps[c] = crop(m_disparity_maps[c], bbox);
+
+    // De-warp all pixels. The left pixel is not needed if there are no matches.
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    int num_pix = bbox.width() * bbox.height();
+    std::vector<Vector2> pixels(num_pix * (num_disp + 1), Vector2(nan, nan));
+    std::vector<bool> has_match(num_pix, false);
+    for (int row = 0; row < bbox.height(); row++) {
+      for (int col = 0; col < bbox.width(); col++) {
+        int index = row * bbox.width() + col;
+        Vector2 pix(col + bbox.min().x(), row + bbox.min().y());
+        for (int c = 0; c < num_disp; c++) {
+          DPixelT const& disp = disps[c](col, row);
+          if (!is_valid(disp))
+            continue;
+          pixels[index * (num_disp + 1) + c + 1]
+            = m_transforms[c+1]->reverse(pix + stereo::DispHelper(disp));
+          has_match[index] = true;
+        }
+        if (has_match[index])
+          pixels[index * (num_disp + 1)] = m_transforms[0]->reverse(pix);
+      }
+    }
+
+    // With RPC cameras, find the rays through all pixels in the tile at once
+    bool batch_rays = ((int)m_rpc_cams.size() == num_disp + 1);
+    std::vector<Vector3> ctrs, dirs;
+    if (batch_rays) {
+      ctrs.resize(pixels.size());
+      dirs.resize(pixels.size());
+      for (int c = 0; c <= num_disp; c++) {
+        std::vector<int> ids;
+        std::vector<double> xs, ys;
+        for (int index = 0; index < num_pix; index++) {
+          Vector2 const& pix = pixels[index * (num_disp + 1) + c];
+          if (pix != pix) // NaN
+            continue;
+          ids.push_back(index);
+          xs.push_back(pix[0]);
+          ys.push_back(pix[1]);
+        }
+        std::vector<Vector3> P(ids.size()), D(ids.size());
+        m_rpc_cams[c]->point_and_dir(ids.size(), xs.data(), ys.data(), P.data(), D.data());
+        for (size_t k = 0; k < ids.size(); k++) {
+          ctrs[ids[k] * (num_disp + 1) + c] = P[k];
+          dirs[ids[k] * (num_disp + 1) + c] = D[k];
+        }
+      }
+    }
+
+    // Triangulate
+    std::vector<Vector2> pixVec(num_disp + 1);
+    std::vector<Vector3> ctrVec(num_disp + 1), dirVec(num_disp + 1);
+    for (int row = 0; row < bbox.height(); row++) {
+      for (int col = 0; col < bbox.width(); col++) {
+        int index = row * bbox.width() + col;
+        if (!has_match[index]) {
+          tile(col, row) = pixel_type(); // no valid data
+          continue;
+        }
+        for (int c = 0; c <= num_disp; c++)
+          pixVec[c] = pixels[index * (num_disp + 1) + c];
+        if (!batch_rays) {
+          tile(col, row) = triangulate_pixels(pixVec);
+          continue;
+        }
+        for (int c = 0; c <= num_disp; c++) {
+          ctrVec[c] = ctrs[index * (num_disp + 1) + c];
+          dirVec[c] = dirs[index * (num_disp + 1) + c];
+        }
+        tile(col, row) = triangulate_pixels(pixVec, &ctrVec, &dirVec);
+      }
+    }
+  }
+
   /// Compute the 3D coordinate corresponding to a pixel location.
   /// - p is not actually used here, it should always be zero!
   inline result_type operator()(size_t i, size_t j, size_t p = 0) const {
@@ -134,42 +286,13 @@ public:
     
     // Compute the location of the 3D point observed by each input pixel
     // when no bathymetry correction is needed.
-    Vector3 errorVec;
-    pixel_type result;
-    if (!m_bathy_correct) {
-      try {
-        subvector(result, 0, 3) = m_stereo_model(pixVec, errorVec);
-        double errLen = norm_2(errorVec);
-        if (!stereo_settings().propagate_errors) {
-          subvector(result, 3, 3) = errorVec;
-        } else {
-          // Store intersection error norm in band 3, horizontal
-          // stddev in band 4, and vertical stddev in band 5 (if band
-          // index starts from 0).
-          result[3] = errLen;
-          auto const& v = asp::stereo_settings().horizontal_stddev; // alias
-          subvector(result, 4, 2)
-            = asp::propagateCovariance(subvector(result, 0, 3),
-                                       m_datum, v[0], v[1],
-                                       m_camera_ptrs[0], m_camera_ptrs[1],
-                                       pixVec[0], pixVec[1]);
-        }
-        
-        // Filter by triangulation error, if desired
-        if (stereo_settings().max_valid_triangulation_error > 0.0 &&
-            errLen > stereo_settings().max_valid_triangulation_error) {
-          result = pixel_type();
-          errorVec = Vector3();
-        }
-      } catch(...) {
-        return pixel_type(); // The zero vector, it means that there is no valid data
-      }
-      
-      return result; // Contains location and error vector
-    }
+    if (!m_bathy_correct)
+      return triangulate_pixels(pixVec);
 
     // Continue with bathymetry correction. Note how we assume no
     // multi-view stereo happens.
+    Vector3 errorVec;
+    pixel_type result;
     Vector2 lpix(i, j);
     DPixelT disp = m_disparity_maps[0](i, j, p);
     if (!is_valid(disp)) {
@@ -222,9 +345,11 @@ public:
     return result; // Contains location and error vector
   }
   
-  typedef StereoTriangulation prerasterize_type;
+  typedef CropView<ImageView<pixel_type>> prerasterize_type;
   inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
-    return PreRasterHelper(bbox, m_transforms);
+    ImageView<pixel_type> tile;
+    PreRasterHelper(bbox, m_transforms).triangulate_tile(bbox, tile);
+    return prerasterize_type(tile, -bbox.min().x(), -bbox.min().y(), cols(), rows());
   }
   template <class DestT>
   inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
@@ -245,7 +370,7 @@ private:
   
   /// RPC Map Transform needs to be explicitly copied and told to cache for performance.
   template <class T>
-  prerasterize_type PreRasterHelper(BBox2i const& bbox, std::vector<T> const& transforms) const {
+  StereoTriangulation PreRasterHelper(BBox2i const& bbox, std::vector<T> const& transforms) const {
 
     ImageViewRef<PixelMask<float>> in_memory_left_aligned_bathy_mask;
     ImageViewRef<PixelMask<float>> in_memory_right_aligned_bathy_mask;
@@ -282,7 +407,7 @@ private:
         }
       }
 
-      return prerasterize_type(disparity_cropviews, m_camera_ptrs, transforms, m_datum,
+      return StereoTriangulation(disparity_cropviews, m_camera_ptrs, transforms, m_datum,
                                m_stereo_model, m_bathy_model,
                                m_is_map_projected, m_bathy_correct, m_cloud_type,
                                in_memory_left_aligned_bathy_mask,
@@ -348,7 +473,7 @@ private:
       transforms_copy[p+1]->reverse_bbox(right_bbox);
     }
 
-    return prerasterize_type(disparity_cropviews, m_camera_ptrs, transforms_copy, m_datum,
+    return StereoTriangulation(disparity_cropviews, m_camera_ptrs, transforms_copy, m_datum,
                              m_stereo_model, m_bathy_model, m_is_map_projected,
                              m_bathy_correct, m_cloud_type,
                              in_memory_left_aligned_bathy_mask,
@@ -623,6 +748,8 @@ void disp_or_matches_work(std::string const& output_prefix,
 /// Main triangulation function
 void stereo_triangulation(std::string const& output_prefix,
                           std::vector<ASPGlobalOptions> const& opt_vec) {
+
+  asp::ScopedTrace trace("stereo_triangulation");
     
   try { // Outer try/catch
     
@@ -883,7 +1010,19 @@ int main(int argc, char* argv[]) {
     if (opt_vec.size() == 1)
       asp::estimate_convergence_angle(opt_vec[0]);
 
-    asp::stereo_triangulation(output_prefix, opt_vec);
+    if (asp::stereo_settings().tile_list.empty()) {
+      asp::stereo_triangulation(output_prefix, opt_vec);
+      asp::saveTrace(output_prefix);
+    } else {
+      // Many tiles in one process, as invoked from parallel_stereo
+      if (opt_vec.size() != 1)
+        vw_throw(ArgumentErr() << "The --tile-list option is not supported "
+                 << "with multiview triangulation.\n");
+      asp::run_tiles(opt_vec[0], [](asp::ASPGlobalOptions & curr_opt) {
+        std::vector<asp::ASPGlobalOptions> curr_opt_vec(1, curr_opt);
+        asp::stereo_triangulation(curr_opt.out_prefix, curr_opt_vec);
+      });
+    }
 
     vw_out() << "\n[ " << asp::current_posix_time_string() << " ]: TRIANGULATION FINISHED\n";
 
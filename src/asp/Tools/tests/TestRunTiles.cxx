@@ -0,0 +1,82 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2009-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NGT platform is licensed under the Apache License, Version 2.0 (the
+//  "License"); you may not use this file except in compliance with the
+//  License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <asp/Tools/stereo.h>
+#include <asp/Core/StereoSettings.h>
+
+#include <fstream>
+#include <vector>
+
+using namespace vw;
+using namespace vw::test;
+
+// The settings a step sees
+struct SeenSettings {
+  BBox2 search_range;
+  int seed_mode, corr_tile_size_ovr;
+  BBox2i trans_crop_win;
+};
+
+// Each tile must start with the same settings, even if the step modifies
+// them, as correlation does.
+TEST(RunTiles, SameSettingsPerTile) {
+
+  UnlinkName out_dir("run_tiles_out");
+  UnlinkName tile_list("run_tiles_list.txt");
+  {
+    std::ofstream ofs(tile_list.c_str());
+    ofs << out_dir << "/tile1/run 0 0 100 80 512\n";
+    ofs << out_dir << "/tile2/run 100 0 120 80\n";
+  }
+
+  asp::StereoSettings orig = asp::stereo_settings();
+  asp::stereo_settings().tile_list          = tile_list;
+  asp::stereo_settings().search_range       = BBox2(-10, -5, 20, 10);
+  asp::stereo_settings().seed_mode          = 1;
+  asp::stereo_settings().corr_tile_size_ovr = 1024;
+
+  asp::ASPGlobalOptions opt;
+  opt.out_prefix = out_dir + "/run";
+
+  std::vector<SeenSettings> seen;
+  asp::run_tiles(opt, [&seen](asp::ASPGlobalOptions & curr_opt) {
+    asp::StereoSettings & s = asp::stereo_settings();
+    seen.push_back(SeenSettings{s.search_range, s.seed_mode, s.corr_tile_size_ovr,
+                                s.trans_crop_win});
+    // Modify the settings in place, as the correlation step does
+    s.search_range += Vector2(100, 50);
+    s.seed_mode = 0;
+    s.corr_tile_size_ovr = 256;
+  });
+
+  ASSERT_EQ(seen.size(), 2u);
+  for (size_t it = 0; it < seen.size(); it++) {
+    EXPECT_EQ(seen[it].search_range, BBox2(-10, -5, 20, 10));
+    EXPECT_EQ(seen[it].seed_mode, 1);
+  }
+  EXPECT_EQ(seen[0].corr_tile_size_ovr, 512);
+  EXPECT_EQ(seen[1].corr_tile_size_ovr, 1024);
+  EXPECT_EQ(seen[0].trans_crop_win, BBox2i(0, 0, 100, 80));
+  EXPECT_EQ(seen[1].trans_crop_win, BBox2i(100, 0, 120, 80));
+
+  // The settings are restored at the end
+  EXPECT_EQ(asp::stereo_settings().search_range, BBox2(-10, -5, 20, 10));
+  EXPECT_EQ(asp::stereo_settings().seed_mode, 1);
+
+  asp::stereo_settings() = orig;
+}